@@ -0,0 +1,112 @@
+/* Benchmark of the ffasn1c BER decoder / DER encoder for RSPRO, for comparison
+ * with the asn1c based src/rspro-codec-bench.
+ *
+ * Input files are BER/DER encoded RsproPDUs named <msg>-<payload>.der, as written
+ * by 'rspro-codec-bench -w DIR'.  Output uses the same one-JSON-object-per-line
+ * format as rspro-codec-bench.  */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+#include <time.h>
+
+#include <asn1defs.h>
+
+#include "rspro.h"
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_result(const char *msg, unsigned int payload, const char *op, const char *encoding,
+			 unsigned long iterations, int64_t ns, int bytes)
+{
+	printf("{\"msg\":\"%s\",\"payload\":%u,\"op\":\"%s\",\"encoding\":\"%s\","
+	       "\"iterations\":%lu,\"ns_per_op\":%.1f,\"allocs_per_op\":null,\"bytes_per_op\":%d}\n",
+	       msg, payload, op, encoding, iterations, (double) ns / iterations, bytes);
+}
+
+static int bench_file(const char *path, unsigned long iterations)
+{
+	char name[256], msg[256];
+	unsigned int payload = 0;
+	uint8_t buf[65536];
+	struct RsproPDU *pdu;
+	uint8_t *out;
+	ASN1Error err;
+	unsigned long i;
+	int64_t start;
+	int fd, len, rc;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf));
+	close(fd);
+	if (len <= 0)
+		return -1;
+
+	snprintf(name, sizeof(name), "%s", path);
+	if (sscanf(basename(name), "%255[^-]-%u", msg, &payload) < 1)
+		snprintf(msg, sizeof(msg), "%s", basename(name));
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		rc = asn1_ber_decode((void **) &pdu, asn1_type_RsproPDU, buf, len, &err);
+		if (rc < 0) {
+			fprintf(stderr, "%s: decoding failed\n", path);
+			return -1;
+		}
+		asn1_free_value(asn1_type_RsproPDU, pdu);
+	}
+	print_result(msg, payload, "dec", "ffasn1c-ber", iterations, now_ns() - start, len);
+
+	rc = asn1_ber_decode((void **) &pdu, asn1_type_RsproPDU, buf, len, &err);
+	if (rc < 0)
+		return -1;
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		rc = asn1_der_encode(&out, asn1_type_RsproPDU, pdu);
+		if (rc < 0) {
+			fprintf(stderr, "%s: encoding failed\n", path);
+			asn1_free_value(asn1_type_RsproPDU, pdu);
+			return -1;
+		}
+		asn1_free(out);
+	}
+	print_result(msg, payload, "enc", "ffasn1c-der", iterations, now_ns() - start, rc);
+	asn1_free_value(asn1_type_RsproPDU, pdu);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 100000;
+	int i, rc = 0;
+
+	if (argc > 2 && !strcmp(argv[1], "-n")) {
+		iterations = strtoul(argv[2], NULL, 10);
+		argv += 2;
+		argc -= 2;
+	}
+	if (argc < 2 || !iterations) {
+		fprintf(stderr, "Usage: %s [-n ITERATIONS] FILE.der...\n", argv[0]);
+		exit(2);
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (bench_file(argv[i], iterations) < 0)
+			rc = 1;
+	}
+
+	return rc;
+}
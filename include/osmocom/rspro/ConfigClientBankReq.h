@@ -13,6 +13,7 @@
 /* Including external dependencies */
 #include <osmocom/rspro/BankSlot.h>
 #include <osmocom/rspro/IpPort.h>
+#include <osmocom/rspro/SocketPath.h>
 #include <constr_SEQUENCE.h>
 
 #ifdef __cplusplus
@@ -27,6 +28,7 @@ typedef struct ConfigClientBankReq {
 	 * This type is extensible,
 	 * possible extensions are below.
 	 */
+	SocketPath_t	*bankdSocketPath	/* OPTIONAL */;
 	
 	/* Context for parsing across buffer boundaries */
 	asn_struct_ctx_t _asn_ctx;
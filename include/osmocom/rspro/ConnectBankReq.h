@@ -14,6 +14,7 @@
 #include <osmocom/rspro/ComponentIdentity.h>
 #include <osmocom/rspro/BankId.h>
 #include <osmocom/rspro/SlotNumber.h>
+#include <osmocom/rspro/SocketPath.h>
 #include <constr_SEQUENCE.h>
 
 #ifdef __cplusplus
@@ -29,6 +30,7 @@ typedef struct ConnectBankReq {
 	 * This type is extensible,
 	 * possible extensions are below.
 	 */
+	SocketPath_t	*bankdSocketPath	/* OPTIONAL */;
 	
 	/* Context for parsing across buffer boundaries */
 	asn_struct_ctx_t _asn_ctx;
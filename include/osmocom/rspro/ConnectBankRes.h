@@ -13,6 +13,7 @@
 /* Including external dependencies */
 #include <osmocom/rspro/ComponentIdentity.h>
 #include <osmocom/rspro/ResultCode.h>
+#include <osmocom/rspro/RetryAfterMs.h>
 #include <constr_SEQUENCE.h>
 
 #ifdef __cplusplus
@@ -27,6 +28,7 @@ typedef struct ConnectBankRes {
 	 * This type is extensible,
 	 * possible extensions are below.
 	 */
+	RetryAfterMs_t	*retryAfterMs	/* OPTIONAL */;
 	
 	/* Context for parsing across buffer boundaries */
 	asn_struct_ctx_t _asn_ctx;
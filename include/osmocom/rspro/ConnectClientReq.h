@@ -12,6 +12,7 @@
 
 /* Including external dependencies */
 #include <osmocom/rspro/ComponentIdentity.h>
+#include <osmocom/rspro/TpduEncodings.h>
 #include <constr_SEQUENCE.h>
 
 #ifdef __cplusplus
@@ -29,6 +30,7 @@ typedef struct ConnectClientReq {
 	 * This type is extensible,
 	 * possible extensions are below.
 	 */
+	TpduEncodings_t	*tpduEncodings	/* OPTIONAL */;
 	
 	/* Context for parsing across buffer boundaries */
 	asn_struct_ctx_t _asn_ctx;
@@ -13,12 +13,17 @@
 /* Including external dependencies */
 #include <osmocom/rspro/ComponentIdentity.h>
 #include <osmocom/rspro/ResultCode.h>
+#include <osmocom/rspro/TpduEncodings.h>
+#include <osmocom/rspro/RetryAfterMs.h>
 #include <constr_SEQUENCE.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Forward declarations */
+struct ClientSlot;
+
 /* ConnectClientRes */
 typedef struct ConnectClientRes {
 	ComponentIdentity_t	 identity;
@@ -27,6 +32,9 @@ typedef struct ConnectClientRes {
 	 * This type is extensible,
 	 * possible extensions are below.
 	 */
+	TpduEncodings_t	*tpduEncodings	/* OPTIONAL */;
+	struct ClientSlot	*clientSlot	/* OPTIONAL */;
+	RetryAfterMs_t	*retryAfterMs	/* OPTIONAL */;
 	
 	/* Context for parsing across buffer boundaries */
 	asn_struct_ctx_t _asn_ctx;
@@ -39,5 +47,8 @@ extern asn_TYPE_descriptor_t asn_DEF_ConnectClientRes;
 }
 #endif
 
+/* Referred external types */
+#include <osmocom/rspro/ClientSlot.h>
+
 #endif	/* _ConnectClientRes_H_ */
 #include <asn_internal.h>
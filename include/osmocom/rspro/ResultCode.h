@@ -28,7 +28,8 @@ typedef enum ResultCode {
 	ResultCode_identityInUse	= 6,
 	ResultCode_cardNotPresent	= 100,
 	ResultCode_cardUnresponsive	= 101,
-	ResultCode_cardTransmissionError	= 102
+	ResultCode_cardTransmissionError	= 102,
+	ResultCode_tryAgainLater	= 7
 	/*
 	 * Enumeration is extensible
 	 */
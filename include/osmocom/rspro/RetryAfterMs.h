@@ -0,0 +1,38 @@
+/*
+ * Generated by asn1c-0.9.28 (http://lionet.info/asn1c)
+ * From ASN.1 module "RSPRO"
+ * 	found in "../../asn1/RSPRO.asn"
+ */
+
+#ifndef	_RetryAfterMs_H_
+#define	_RetryAfterMs_H_
+
+
+#include <asn_application.h>
+
+/* Including external dependencies */
+#include <NativeInteger.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* RetryAfterMs */
+typedef long	 RetryAfterMs_t;
+
+/* Implementation */
+extern asn_TYPE_descriptor_t asn_DEF_RetryAfterMs;
+asn_struct_free_f RetryAfterMs_free;
+asn_struct_print_f RetryAfterMs_print;
+asn_constr_check_f RetryAfterMs_constraint;
+ber_type_decoder_f RetryAfterMs_decode_ber;
+der_type_encoder_f RetryAfterMs_encode_der;
+xer_type_decoder_f RetryAfterMs_decode_xer;
+xer_type_encoder_f RetryAfterMs_encode_xer;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _RetryAfterMs_H_ */
+#include <asn_internal.h>
@@ -0,0 +1,38 @@
+/*
+ * Generated by asn1c-0.9.28 (http://lionet.info/asn1c)
+ * From ASN.1 module "RSPRO"
+ * 	found in "../../asn1/RSPRO.asn"
+ */
+
+#ifndef	_SocketPath_H_
+#define	_SocketPath_H_
+
+
+#include <asn_application.h>
+
+/* Including external dependencies */
+#include <IA5String.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* SocketPath */
+typedef IA5String_t	 SocketPath_t;
+
+/* Implementation */
+extern asn_TYPE_descriptor_t asn_DEF_SocketPath;
+asn_struct_free_f SocketPath_free;
+asn_struct_print_f SocketPath_print;
+asn_constr_check_f SocketPath_constraint;
+ber_type_decoder_f SocketPath_decode_ber;
+der_type_encoder_f SocketPath_encode_der;
+xer_type_decoder_f SocketPath_decode_xer;
+xer_type_encoder_f SocketPath_encode_xer;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _SocketPath_H_ */
+#include <asn_internal.h>
@@ -0,0 +1,43 @@
+/*
+ * Generated by asn1c-0.9.28 (http://lionet.info/asn1c)
+ * From ASN.1 module "RSPRO"
+ * 	found in "../../asn1/RSPRO.asn"
+ */
+
+#ifndef	_TpduEncodings_H_
+#define	_TpduEncodings_H_
+
+
+#include <asn_application.h>
+
+/* Including external dependencies */
+#include <BIT_STRING.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Dependencies */
+typedef enum TpduEncodings {
+	TpduEncodings_binary	= 0
+} e_TpduEncodings;
+
+/* TpduEncodings */
+typedef BIT_STRING_t	 TpduEncodings_t;
+
+/* Implementation */
+extern asn_TYPE_descriptor_t asn_DEF_TpduEncodings;
+asn_struct_free_f TpduEncodings_free;
+asn_struct_print_f TpduEncodings_print;
+asn_constr_check_f TpduEncodings_constraint;
+ber_type_decoder_f TpduEncodings_decode_ber;
+der_type_encoder_f TpduEncodings_encode_der;
+xer_type_decoder_f TpduEncodings_decode_xer;
+xer_type_encoder_f TpduEncodings_encode_xer;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _TpduEncodings_H_ */
+#include <asn_internal.h>
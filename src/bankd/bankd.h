@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -19,6 +20,9 @@
 
 extern struct value_string worker_state_names[];
 
+/* number of possible values of BankId, ClientId and SlotNumber (0..1023) in RSPRO */
+#define BANKD_NUM_IDS	1024
+
 #define LOGW(w, fmt, args...) \
 	LOGP(DBANKDW, LOGL_INFO, "[%03u B%u:%u %s] " fmt, (w)->num, (w)->slot.bank_id, (w)->slot.slot_nr, get_value_string(worker_state_names, (w)->state), \
 		## args)
@@ -44,6 +48,133 @@ enum bankd_worker_state {
 	BW_ST_CONN_CLIENT_UNMAPPED
 };
 
+/* TCP connection from a remsim-client.  A client may multiplex several of its slots over
+ * one connection; each of them is served by a worker of its own, all sharing this. */
+struct bankd_client_conn {
+	int fd;
+	struct sockaddr_storage peer_addr;
+	socklen_t peer_addr_len;
+	/* accepted on our UNIX domain socket: each record carries exactly one IPA message */
+	bool seqpacket;
+	/* identifier of this connection in bankd->capture */
+	uint32_t cap_conn_id;
+	/* serializes the writes of all workers sharing the connection */
+	pthread_mutex_t tx_mutex;
+	/* connection has failed; no more writes.  protected by tx_mutex */
+	bool dead;
+	/* worker which accepted the connection; it reads all messages and passes those
+	 * for other client slots to their worker */
+	struct bankd_worker *owner;
+	/* number of workers using the connection; protected by bankd->workers_mutex */
+	unsigned int refcnt;
+};
+
+enum bankd_mbox_msg_type {
+	/* the owner of a client connection attaches us to it, for a further client slot */
+	BW_MBOX_ATTACH,
+	/* IPA payload of an RSPRO message for our client slot, received by the owner */
+	BW_MBOX_RSPRO,
+	/* the client connection is gone */
+	BW_MBOX_DETACH,
+};
+
+/* commands to a worker thread; unlike mailbox messages, they carry no data, so pending
+ * commands are just flags in the mailbox which are set/cleared atomically */
+enum bankd_worker_cmd {
+	/* the main thread has added a slot mapping for our client slot */
+	BW_CMD_MAP_ADD		= 0x01,
+	/* the main thread has removed the slot mapping of our bank slot */
+	BW_CMD_MAP_DEL		= 0x02,
+	/* the server has requested to remove all slot mappings */
+	BW_CMD_RESET_STATE	= 0x04,
+	/* a card was inserted into some reader; retry opening ours, if we wait for it */
+	BW_CMD_CARD_EVENT	= 0x08,
+	/* print our talloc report to stderr (on SIGUSR1) */
+	BW_CMD_TALLOC_REPORT	= 0x10,
+};
+
+/* message passed to a worker thread via its mailbox */
+struct bankd_mbox_msg {
+	struct llist_head list;
+	enum bankd_mbox_msg_type type;
+	/* connection we are attached to (BW_MBOX_ATTACH) */
+	struct bankd_client_conn *conn;
+	size_t len;
+	uint8_t data[0];
+};
+
+
+/* priority classes of the per-reader scheduler, highest first */
+enum bankd_sched_prio {
+	/* AUTHENTICATE / RUN GSM ALGORITHM, as the network waits for them with a timer */
+	BANKD_SCHED_PRIO_AUTH,
+	BANKD_SCHED_PRIO_NORMAL,
+	_NUM_BANKD_SCHED_PRIO
+};
+
+/* physical card reader, shared by all of its slots.  Card operations of its slots are
+ * serialized, as they would be in the reader anyway, but in a fair order: FIFO per priority
+ * class, which is round-robin, as each worker has at most one operation outstanding */
+struct bankd_reader {
+	/* global list of readers; protected by bankd->readers_mutex */
+	struct llist_head list;
+	/* PC/SC name without the slot index */
+	char *name;
+	/* number of workers using the reader; protected by bankd->readers_mutex */
+	unsigned int num_workers;
+
+	pthread_mutex_t mutex;
+	/* members below are protected by mutex */
+	/* is a card operation in progress? */
+	bool busy;
+	uint64_t busy_since_ns;
+	/* workers waiting for their turn (struct bankd_sched_req), per priority class */
+	struct llist_head queue[_NUM_BANKD_SCHED_PRIO];
+
+	struct {
+		unsigned int queue_depth;
+		unsigned int queue_depth_max;
+		uint64_t num_ops;
+		uint64_t busy_ns;
+		uint64_t wait_ns;
+		/* values at the time of the last report, to compute the utilization */
+		uint64_t last_busy_ns;
+		uint64_t last_report_ns;
+	} stats;
+};
+
+/* maximum length of a DF identifier: AID (up to 16 bytes) or FID (2 bytes) */
+#define BANKD_APDU_CACHE_DF_MAX	16
+
+/* logical channels: basic channel 0, 1..3 and further ones 4..19 (ETSI TS 102 221 10.1.1) */
+#define BANKD_APDU_CACHE_CHANNELS	20
+
+/* file currently selected on one logical channel of the card, as far as we know */
+struct bankd_apdu_cache_sel {
+	/* is the current DF known? */
+	bool valid_df;
+	/* is the current DF + EF known? */
+	bool valid;
+	uint8_t df[BANKD_APDU_CACHE_DF_MAX];
+	uint8_t df_len;
+	/* zero if no EF is selected */
+	uint16_t ef;
+};
+
+/* per-slot cache of responses to reads of EFs with static contents; see bankd_apdu_cache.c */
+struct bankd_apdu_cache {
+	/* talloc context of the cache entries; NULL if the cache is disabled */
+	void *ctx;
+	/* list of cached responses */
+	struct llist_head entries;
+	unsigned int num_entries;
+	/* selection of each logical channel */
+	struct bankd_apdu_cache_sel sel[BANKD_APDU_CACHE_CHANNELS];
+	struct {
+		unsigned long hits;
+		unsigned long misses;
+	} stats;
+};
 
 /* bankd worker instance; one per card/slot, includes thread */
 struct bankd_worker {
@@ -59,8 +190,10 @@ struct bankd_worker {
 	unsigned int num;
 	/* worker thread state */
 	enum bankd_worker_state state;
-	/* timeout to use for blocking read */
+	/* timeout (ms) to use for blocking read; 0 for none */
 	unsigned int timeout;
+	/* delay (ms) before the next attempt to open the card, increased on each failure */
+	unsigned int open_retry_ms;
 
 	/* slot number we are representing */
 	struct bank_slot slot;
@@ -72,16 +205,31 @@ struct bankd_worker {
 
 	const struct bankd_driver_ops *ops;
 
-	/* File descriptor of the TCP connection to the remsim-client (modem) */
+	/* TCP connection to the remsim-client (modem) */
 	struct {
-		int fd;
-		struct sockaddr_storage peer_addr;
-		socklen_t peer_addr_len;
+		/* modified under bankd->workers_mutex only */
+		struct bankd_client_conn *conn;
 		struct client_slot clslot;
+		/* is clslot in the index of workers by client slot? */
+		bool clslot_indexed;
+		/* TPDU encodings (RSPRO_TPDU_ENC_*) negotiated with the client */
+		uint32_t tpdu_enc;
 	} client;
 
+	/* messages (struct bankd_mbox_msg) and commands from other threads */
+	struct {
+		/* eventfd (semaphore mode) counting the queued messages and posted commands */
+		int fd;
+		pthread_mutex_t mutex;
+		struct llist_head queue;
+		/* pending commands (enum bankd_worker_cmd); only accessed atomically */
+		unsigned int cmds;
+	} mbox;
+
 	struct {
 		const char *name;
+		/* physical reader the slot belongs to, once the card was opened */
+		struct bankd_reader *sched;
 		union {
 			struct {
 				/* PC/SC context / application handle */
@@ -97,11 +245,27 @@ struct bankd_worker {
 		unsigned int atr_len;
 	} card;
 
+	/* responses of the card served from memory (optional) */
+	struct bankd_apdu_cache apdu_cache;
+
+	/* card reset requested by the client, but not performed yet */
+	struct {
+		bool pending;
+		bool cold;
+		/* time (CLOCK_MONOTONIC, ms) at which the reset is performed at the latest */
+		uint64_t deadline_ms;
+		/* number of further resets merged into the pending one */
+		unsigned int num_coalesced;
+	} reset;
+
 	/* last known state of the SIM card VCC indication */
 	bool last_vccPresent;
 
 	/* last known state of the SIM card reset indication */
 	bool last_resetActive;
+
+	/* last known state of the SIM card clock indication */
+	bool last_clkActive;
 };
 
 /* bankd card reader driver operations */
@@ -124,6 +288,8 @@ struct bankd {
 
 	/* TCP socket at which we are listening */
 	int accept_fd;
+	/* UNIX domain (SOCK_SEQPACKET) socket for co-located clients; -1 if none */
+	int unix_accept_fd;
 
 	/* list of slot mappings. only ever modified in main thread! */
 	struct slotmaps *slotmaps;
@@ -134,13 +300,32 @@ struct bankd {
 	/* list of bankd_workers. accessed/modified by multiple threads; protected by mutex */
 	struct llist_head workers;
 	pthread_mutex_t workers_mutex;
+	/* index of workers by the slot number of the bank slot they serve; protected by
+	 * workers_mutex */
+	struct bankd_worker *worker_by_bank_slot[BANKD_NUM_IDS];
+	/* index of workers by the client slot they serve: per client ID an array (allocated on
+	 * first use) indexed by the client slot number; protected by workers_mutex */
+	struct bankd_worker **worker_by_client_slot[BANKD_NUM_IDS];
 
 	struct llist_head pcsc_slot_names;
 
+	/* list of bankd_readers, accessed by multiple threads; protected by mutex */
+	struct llist_head readers;
+	pthread_mutex_t readers_mutex;
+
+	/* capture of all client connections (optional); thread-safe */
+	struct rspro_capture *capture;
+
 	struct {
 		bool permit_shared_pcsc;
 		char *gsmtap_host;
 		int gsmtap_slot;
+		char *capture_file;
+		/* path of our UNIX domain socket for co-located clients (optional) */
+		char *unix_socket;
+		bool apdu_cache;
+		/* time window (ms) within which reset requests are merged into one */
+		unsigned int reset_window_ms;
 	} cfg;
 };
 
@@ -148,3 +333,19 @@ int bankd_pcsc_read_slotnames(struct bankd *bankd, const char *csv_file);
 const char *bankd_pcsc_get_slot_name(struct bankd *bankd, const struct bank_slot *slot);
 
 extern const struct bankd_driver_ops pcsc_driver_ops;
+int bankd_pcsc_start_monitor(struct bankd *bankd);
+void bankd_workers_card_event(struct bankd *bankd);
+
+struct bankd_reader *bankd_reader_get(struct bankd *bankd, const char *pcsc_name);
+void bankd_reader_put(struct bankd *bankd, struct bankd_reader *reader);
+void bankd_reader_acquire(struct bankd_reader *reader, enum bankd_sched_prio prio);
+void bankd_reader_release(struct bankd_reader *reader);
+enum bankd_sched_prio bankd_sched_apdu_prio(const uint8_t *apdu, size_t apdu_len);
+void bankd_readers_report(struct bankd *bankd, FILE *out);
+
+void bankd_apdu_cache_init(struct bankd_apdu_cache *cache, void *ctx);
+void bankd_apdu_cache_flush(struct bankd_apdu_cache *cache);
+int bankd_apdu_cache_lookup(struct bankd_apdu_cache *cache, const uint8_t *cmd, size_t cmd_len,
+			    uint8_t *rsp, size_t *rsp_len);
+void bankd_apdu_cache_update(struct bankd_apdu_cache *cache, const uint8_t *cmd, size_t cmd_len,
+			     const uint8_t *rsp, size_t rsp_len);
@@ -0,0 +1,338 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Cache of the responses to READ BINARY / READ RECORD of a few EFs, whose contents never change
+ * while the card is in the bank.  Modems read those at every attach and every reset, and each
+ * read costs a round-trip to a (slow) card.
+ *
+ * SELECT commands are always passed on to the card, as the card must know the current file for
+ * any command we don't serve from the cache.  We merely follow the selection of each logical
+ * channel, and consider it unknown whenever we cannot tell for sure which file is selected. */
+
+#include <errno.h>
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bit16gen.h>
+
+#include "bankd.h"
+
+/* upper bound on the number of responses cached per slot */
+#define APDU_CACHE_MAX_ENTRIES	64
+
+struct apdu_cache_entry {
+	struct llist_head list;
+	/* file the command was sent to */
+	uint8_t df[BANKD_APDU_CACHE_DF_MAX];
+	uint8_t df_len;
+	uint16_t ef;
+	/* command TPDU header (CLA INS P1 P2 P3) */
+	uint8_t hdr[5];
+	size_t rsp_len;
+	uint8_t rsp[0];
+};
+
+/* EFs whose contents never change: ICCID, EF_DIR, EF_ARR (MF), EF_ARR (ADF), SPN */
+static const uint16_t cacheable_efs[] = { 0x2fe2, 0x2f00, 0x2f06, 0x6f06, 0x6f46 };
+
+static bool ef_is_cacheable(uint16_t fid)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(cacheable_efs); i++) {
+		if (cacheable_efs[i] == fid)
+			return true;
+	}
+	return false;
+}
+
+/* commands which may modify the contents of EFs, directly or (ENVELOPE) via OTA */
+static bool ins_may_update(uint8_t ins)
+{
+	switch (ins) {
+	case 0x04:	/* INVALIDATE / DEACTIVATE FILE */
+	case 0x32:	/* INCREASE */
+	case 0x44:	/* REHABILITATE / ACTIVATE FILE */
+	case 0xc2:	/* ENVELOPE */
+	case 0xd6:	/* UPDATE BINARY */
+	case 0xdc:	/* UPDATE RECORD */
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool sw_is_ok(const uint8_t *rsp, size_t rsp_len)
+{
+	return rsp_len >= 2 && rsp[rsp_len-2] == 0x90 && rsp[rsp_len-1] == 0x00;
+}
+
+static bool select_succeeded(const uint8_t *rsp, size_t rsp_len)
+{
+	if (rsp_len < 2)
+		return false;
+
+	switch (rsp[rsp_len-2]) {
+	case 0x90:
+	case 0x91:	/* proactive command pending */
+	case 0x9f:	/* GSM: response data available */
+	case 0x61:	/* UICC: response data available */
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool fid_is_df(const uint8_t *fid)
+{
+	/* MF, DF or DF within a DF */
+	return fid[0] == 0x3f || fid[0] == 0x7f || fid[0] == 0x5f;
+}
+
+/* the selection state of the logical channel a command is sent on */
+static struct bankd_apdu_cache_sel *cmd_sel(struct bankd_apdu_cache *cache, const uint8_t *cmd)
+{
+	uint8_t cla = cmd[0];
+
+	/* further interindustry class: channels 4..19 */
+	if ((cla & 0xc0) == 0x40 || (cla & 0xf0) == 0xc0 || (cla & 0xf0) == 0xe0)
+		return &cache->sel[4 + (cla & 0x0f)];
+	/* first interindustry class (and GSM's 0xA0): channels 0..3 */
+	return &cache->sel[cla & 0x03];
+}
+
+static void sel_invalidate_all(struct bankd_apdu_cache *cache)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(cache->sel); i++) {
+		cache->sel[i].valid = false;
+		cache->sel[i].valid_df = false;
+	}
+}
+
+/* apply the selection of a single file identifier */
+static void sel_apply_fid(struct bankd_apdu_cache_sel *sel, const uint8_t *fid)
+{
+	if (fid_is_df(fid)) {
+		memcpy(sel->df, fid, 2);
+		sel->df_len = 2;
+		sel->ef = 0;
+	} else
+		sel->ef = osmo_load16be(fid);
+}
+
+/* follow a successful SELECT; we only understand selection by FID, by path and by AID */
+static void sel_update(struct bankd_apdu_cache_sel *sel, const uint8_t *cmd, size_t cmd_len)
+{
+	const uint8_t *data = cmd + 5;
+	size_t data_len = cmd_len - 5;
+	size_t i;
+
+	sel->valid = false;
+	if (cmd_len < 5 || data_len != cmd[4] || data_len == 0)
+		return;
+
+	switch (cmd[2]) {
+	case 0x00:	/* by FID */
+		if (data_len != 2)
+			return;
+		/* an EF is looked up relative to the current DF, which must be known */
+		if (!fid_is_df(data) && !sel->valid_df)
+			return;
+		sel_apply_fid(sel, data);
+		break;
+	case 0x04:	/* DF by name (AID) */
+		if (data_len > sizeof(sel->df))
+			return;
+		memcpy(sel->df, data, data_len);
+		sel->df_len = data_len;
+		sel->ef = 0;
+		break;
+	case 0x08:	/* by path from MF */
+	case 0x09:	/* by path from current DF */
+		if (data_len % 2)
+			return;
+		if (cmd[2] == 0x08)
+			sel_apply_fid(sel, (const uint8_t *) "\x3f\x00");
+		else if (!sel->valid_df)
+			return;
+		for (i = 0; i < data_len; i += 2)
+			sel_apply_fid(sel, data + i);
+		break;
+	default:
+		return;
+	}
+
+	sel->valid = true;
+	sel->valid_df = true;
+}
+
+static struct apdu_cache_entry *cache_find(struct bankd_apdu_cache *cache, const uint8_t *hdr)
+{
+	const struct bankd_apdu_cache_sel *sel = cmd_sel(cache, hdr);
+	struct apdu_cache_entry *ent;
+
+	llist_for_each_entry(ent, &cache->entries, list) {
+		if (ent->ef == sel->ef && ent->df_len == sel->df_len &&
+		    !memcmp(ent->df, sel->df, ent->df_len) && !memcmp(ent->hdr, hdr, sizeof(ent->hdr)))
+			return ent;
+	}
+	return NULL;
+}
+
+/* does the command carry a short file identifier, implicitly selecting another EF? */
+static bool cmd_has_sfi(const uint8_t *cmd)
+{
+	switch (cmd[1]) {
+	case 0x0e:	/* ERASE BINARY */
+	case 0xb0:	/* READ BINARY */
+	case 0xd6:	/* UPDATE BINARY */
+		/* SFI in P1 */
+		return cmd[2] & 0x80;
+	case 0x0c:	/* ERASE RECORD */
+	case 0xa2:	/* SEARCH RECORD */
+	case 0xb2:	/* READ RECORD */
+	case 0xdc:	/* UPDATE RECORD */
+	case 0xe2:	/* APPEND RECORD */
+		/* SFI in P2 */
+		return cmd[3] & 0xf8;
+	default:
+		return false;
+	}
+}
+
+/* is the given command a read of a cacheable EF, based on what we know about the selection? */
+static bool cmd_is_cacheable(struct bankd_apdu_cache *cache, const uint8_t *cmd, size_t cmd_len)
+{
+	const struct bankd_apdu_cache_sel *sel;
+
+	if (cmd_len != 5 || (cmd[1] != 0xb0 && cmd[1] != 0xb2))
+		return false;
+	if (cmd_has_sfi(cmd))
+		return false;
+	/* READ RECORD: only of an absolute record number; the result of first/last/next/previous
+	 * depends on the record pointer of the card */
+	if (cmd[1] == 0xb2 && (cmd[3] & 0x07) != 0x04)
+		return false;
+
+	sel = cmd_sel(cache, cmd);
+	return sel->valid && ef_is_cacheable(sel->ef);
+}
+
+void bankd_apdu_cache_init(struct bankd_apdu_cache *cache, void *ctx)
+{
+	memset(cache, 0, sizeof(*cache));
+	cache->ctx = ctx;
+	INIT_LLIST_HEAD(&cache->entries);
+}
+
+/*! Forget all cached responses as well as the current selection, e.g. after a card reset. */
+void bankd_apdu_cache_flush(struct bankd_apdu_cache *cache)
+{
+	struct apdu_cache_entry *ent, *ent2;
+
+	if (!cache->ctx)
+		return;
+
+	llist_for_each_entry_safe(ent, ent2, &cache->entries, list) {
+		llist_del(&ent->list);
+		talloc_free(ent);
+	}
+	cache->num_entries = 0;
+	sel_invalidate_all(cache);
+}
+
+/*! Try to serve a command TPDU from the cache.
+ *  \param[out] rsp caller-allocated buffer for the response (including status word)
+ *  \param[inout] rsp_len size of rsp; length of the response on return
+ *  \returns 0 if served from the cache; -ENOENT if the command must be sent to the card */
+int bankd_apdu_cache_lookup(struct bankd_apdu_cache *cache, const uint8_t *cmd, size_t cmd_len,
+			    uint8_t *rsp, size_t *rsp_len)
+{
+	struct apdu_cache_entry *ent;
+
+	if (!cache->ctx || !cmd_is_cacheable(cache, cmd, cmd_len))
+		return -ENOENT;
+
+	ent = cache_find(cache, cmd);
+	if (!ent || ent->rsp_len > *rsp_len) {
+		cache->stats.misses++;
+		return -ENOENT;
+	}
+
+	memcpy(rsp, ent->rsp, ent->rsp_len);
+	*rsp_len = ent->rsp_len;
+	cache->stats.hits++;
+	return 0;
+}
+
+/*! Feed a command TPDU and the response of the card to the cache.  Must be called for each
+ *  command sent to the card, so the cache can follow the file selection. */
+void bankd_apdu_cache_update(struct bankd_apdu_cache *cache, const uint8_t *cmd, size_t cmd_len,
+			     const uint8_t *rsp, size_t rsp_len)
+{
+	const struct bankd_apdu_cache_sel *sel;
+	struct apdu_cache_entry *ent;
+
+	if (!cache->ctx || cmd_len < 5)
+		return;
+
+	if (cmd[1] == 0xa4) {
+		if (select_succeeded(rsp, rsp_len))
+			sel_update(cmd_sel(cache, cmd), cmd, cmd_len);
+		else
+			cmd_sel(cache, cmd)->valid = false;
+		return;
+	}
+
+	/* MANAGE CHANNEL: a (re-)opened channel starts with a selection we don't track */
+	if (cmd[1] == 0x70) {
+		sel_invalidate_all(cache);
+		return;
+	}
+
+	/* we don't know which file commands with short file identifiers leave selected */
+	if (cmd_has_sfi(cmd))
+		cmd_sel(cache, cmd)->valid = false;
+
+	if (ins_may_update(cmd[1])) {
+		bankd_apdu_cache_flush(cache);
+		return;
+	}
+
+	if (!cmd_is_cacheable(cache, cmd, cmd_len) || !sw_is_ok(rsp, rsp_len))
+		return;
+	if (cache->num_entries >= APDU_CACHE_MAX_ENTRIES || cache_find(cache, cmd))
+		return;
+	sel = cmd_sel(cache, cmd);
+
+	ent = talloc_size(cache->ctx, sizeof(*ent) + rsp_len);
+	if (!ent)
+		return;
+	memcpy(ent->df, sel->df, sel->df_len);
+	ent->df_len = sel->df_len;
+	ent->ef = sel->ef;
+	memcpy(ent->hdr, cmd, sizeof(ent->hdr));
+	ent->rsp_len = rsp_len;
+	memcpy(ent->rsp, rsp, rsp_len);
+	llist_add_tail(&ent->list, &cache->entries);
+	cache->num_entries++;
+}
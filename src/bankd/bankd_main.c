@@ -25,10 +25,13 @@
 #include <unistd.h>
 #include <errno.h>
 #include <getopt.h>
+#include <poll.h>
+#include <time.h>
 
 #include <pthread.h>
 
 #include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <netdb.h>
 
 #include <osmocom/core/socket.h>
@@ -48,22 +51,24 @@
 #include "rspro_client_fsm.h"
 #include "debug.h"
 #include "rspro_util.h"
+#include "rspro_capture.h"
+#include "rspro_sock_tune.h"
 #include "gsmtap.h"
 
-/* signal indicates to worker thread that its map has been deleted */
-#define SIGMAPDEL	SIGRTMIN+1
-#define SIGMAPADD	SIGRTMIN+2
-
-static void handle_sig_usr1(int sig);
-static void handle_sig_mapdel(int sig);
-static void handle_sig_mapadd(int sig);
+/* delays between attempts to open the card of a mapped slot, unless we're woken up by the
+ * card monitor before */
+#define OPEN_RETRY_MIN_MS	500
+#define OPEN_RETRY_MAX_MS	10000
 
 __thread void *talloc_asn1_ctx;
 struct bankd *g_bankd;
 static void *g_tall_ctx;
+/* eventfd through which the SIGUSR1 handler asks the main loop for the reports */
+static struct osmo_fd g_sig_usr1_ofd;
 static char g_hostname[256];
 
 static void *worker_main(void *arg);
+static int worker_post_cmd(struct bankd_worker *worker, enum bankd_worker_cmd cmd);
 
 /***********************************************************************
 * bankd core / main thread
@@ -92,6 +97,7 @@ static void bankd_init(struct bankd *bankd)
 	/* set some defaults, overridden by commandline/config */
 	bankd->srvc.bankd.bank_id = 1;
 	bankd->srvc.bankd.num_slots = 8;
+	bankd->unix_accept_fd = -1;
 
 	bankd->comp_id.type = ComponentType_remsimBankd;
 	OSMO_STRLCPY_ARRAY(bankd->comp_id.name, g_hostname);
@@ -100,10 +106,13 @@ static void bankd_init(struct bankd *bankd)
 	/* FIXME: other members of app_comp_id */
 
 	INIT_LLIST_HEAD(&bankd->pcsc_slot_names);
+	INIT_LLIST_HEAD(&bankd->readers);
+	pthread_mutex_init(&bankd->readers_mutex, NULL);
 
 	bankd->cfg.permit_shared_pcsc = false;
 	bankd->cfg.gsmtap_host = NULL;
 	bankd->cfg.gsmtap_slot = -1;
+	bankd->cfg.reset_window_ms = 100;
 }
 
 /* create + start a new bankd_worker thread */
@@ -122,10 +131,19 @@ static struct bankd_worker *bankd_create_worker(struct bankd *bankd, unsigned in
 	worker->last_vccPresent = true; /* allow cold reset should first indication be false */
 	worker->last_resetActive = false; /* allow warm reset should first indication be true */
 
-	/* in the initial state, the worker has no client.fd, bank_slot or pcsc handle yet */
+	/* in the initial state, the worker has no client.conn, bank_slot or pcsc handle yet */
+
+	worker->mbox.fd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+	if (worker->mbox.fd < 0) {
+		talloc_free(worker);
+		return NULL;
+	}
+	pthread_mutex_init(&worker->mbox.mutex, NULL);
+	INIT_LLIST_HEAD(&worker->mbox.queue);
 
 	rc = pthread_create(&worker->thread, NULL, worker_main, worker);
 	if (rc != 0) {
+		close(worker->mbox.fd);
 		talloc_free(worker);
 		return NULL;
 	}
@@ -139,24 +157,67 @@ static struct bankd_worker *bankd_create_worker(struct bankd *bankd, unsigned in
 
 static bool terminate = false;
 
-/* deliver given signal 'sig' to the firts worker matching bs and cs (if given) */
-static void send_signal_to_worker(const struct bank_slot *bs, const struct client_slot *cs, int sig)
+/* slot of the worker index for given bank slot; NULL if it is not one of ours.
+ * Call with workers_mutex held */
+static struct bankd_worker **worker_idx_bank_slot(struct bankd *bankd, const struct bank_slot *bs)
 {
-	struct bankd_worker *worker;
-	pthread_mutex_lock(&g_bankd->workers_mutex);
-	llist_for_each_entry(worker, &g_bankd->workers, list) {
-		if (bs && (bs->bank_id != worker->slot.bank_id || bs->slot_nr != worker->slot.slot_nr))
-			continue;
-		if (cs && (cs->client_id != worker->client.clslot.client_id ||
-			   cs->slot_nr != worker->client.clslot.slot_nr))
-			continue;
-
-		pthread_kill(worker->thread, sig);
-		break;
+	if (bs->bank_id != bankd->srvc.bankd.bank_id || bs->slot_nr >= BANKD_NUM_IDS)
+		return NULL;
+	return &bankd->worker_by_bank_slot[bs->slot_nr];
+}
+
+/* slot of the worker index for given client slot; NULL if out of range or (unless 'create' is
+ * set) if no worker ever served a slot of that client.  Call with workers_mutex held */
+static struct bankd_worker **worker_idx_client_slot(struct bankd *bankd, const struct client_slot *cs,
+						    bool create)
+{
+	struct bankd_worker ***by_slot_nr;
+
+	if (cs->client_id >= BANKD_NUM_IDS || cs->slot_nr >= BANKD_NUM_IDS)
+		return NULL;
+
+	by_slot_nr = &bankd->worker_by_client_slot[cs->client_id];
+	if (!*by_slot_nr) {
+		if (!create)
+			return NULL;
+		/* shared by all threads, hence not from any (per-thread) talloc context */
+		*by_slot_nr = calloc(BANKD_NUM_IDS, sizeof(**by_slot_nr));
+		if (!*by_slot_nr)
+			return NULL;
 	}
+	return &(*by_slot_nr)[cs->slot_nr];
+}
+
+/* deliver given command to the worker serving bs or (if bs is NULL) cs, if any */
+static void send_cmd_to_worker(const struct bank_slot *bs, const struct client_slot *cs,
+			       enum bankd_worker_cmd cmd)
+{
+	struct bankd_worker **idx;
+
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	if (bs)
+		idx = worker_idx_bank_slot(g_bankd, bs);
+	else
+		idx = worker_idx_client_slot(g_bankd, cs, false);
+	if (idx && *idx)
+		worker_post_cmd(*idx, cmd);
 	pthread_mutex_unlock(&g_bankd->workers_mutex);
 }
 
+/* called by the card monitor thread: wake up all workers waiting for their card */
+void bankd_workers_card_event(struct bankd *bankd)
+{
+	struct bankd_worker *worker;
+
+	pthread_mutex_lock(&bankd->workers_mutex);
+	llist_for_each_entry(worker, &bankd->workers, list) {
+		/* a worker just entering this state tries to open the card anyway */
+		if (worker->state == BW_ST_CONN_CLIENT_MAPPED)
+			worker_post_cmd(worker, BW_CMD_CARD_EVENT);
+	}
+	pthread_mutex_unlock(&bankd->workers_mutex);
+}
+
 /* Remove a mapping */
 static void bankd_srvc_remove_mapping(struct slot_mapping *map)
 {
@@ -165,7 +226,7 @@ static void bankd_srvc_remove_mapping(struct slot_mapping *map)
 	slotmap_del(g_bankd->slotmaps, map);
 
 	/* kill/reset the respective worker, if any! */
-	send_signal_to_worker(&bs, NULL, SIGMAPDEL);
+	send_cmd_to_worker(&bs, NULL, BW_CMD_MAP_DEL);
 }
 
 /* handle incoming messages from server */
@@ -225,7 +286,7 @@ static int bankd_srvc_handle_rx(struct rspro_server_conn *srvc, const RsproPDU_t
 				LOGPFSML(srvc->fi, LOGL_ERROR, "could not create slotmap\n");
 				resp = rspro_gen_CreateMappingRes(ResultCode_illegalSlotId);
 			} else {
-				send_signal_to_worker(NULL, &cs, SIGMAPADD);
+				send_cmd_to_worker(NULL, &cs, BW_CMD_MAP_ADD);
 				resp = rspro_gen_CreateMappingRes(ResultCode_ok);
 			}
 		}
@@ -269,7 +330,7 @@ send_resp:
 		/* notify all workers about maps having disappeared */
 		pthread_mutex_lock(&g_bankd->workers_mutex);
 		llist_for_each_entry(worker, &g_bankd->workers, list) {
-			pthread_kill(worker->thread, SIGMAPDEL);
+			worker_post_cmd(worker, BW_CMD_RESET_STATE);
 		}
 		pthread_mutex_unlock(&g_bankd->workers_mutex);
 		/* send response to server */
@@ -291,7 +352,8 @@ static void printf_help(FILE *out)
 "  -h --help                    Print this help message\n"
 "  -V --version                 Print the version of the program\n"
 "  -d --debug option            Enable debug logging (e.g. DMAIN:DST2)\n"
-"  -i --server-host A.B.C.D     remsim-server IP address (mandatory)\n"
+"  -i --server-host A.B.C.D     remsim-server IP address (mandatory), or the path of its\n"
+"                               UNIX domain socket\n"
 "  -p --server-port <1-65535>   remsim-server TCP port (default: 9998)\n"
 "  -b --bank-id <1-1023>        Bank Identifier of this SIM bank (default: 1)\n"
 "  -n --num-slots <1-1023>      Number of Slots in this SIM bank (default: 8)\n"
@@ -305,6 +367,15 @@ static void printf_help(FILE *out)
 "  -L --disable-color           Disable colors for logging to stderr\n"
 "  -T --timestamp               Prefix every log line with a timestamp\n"
 "  -e --log-level number        Set a global loglevel.\n"
+"  -c --capture-file PATH       Capture all client connections to given file\n"
+"  -a --apdu-cache              Serve reads of EFs with static contents (ICCID, EF.DIR,\n"
+"                               EF.ARR, SPN) from memory after the first read\n"
+"  -R --reset-window <0-10000>  Merge card resets requested by the client within the given\n"
+"                               number of milliseconds into one (default: 100)\n"
+"  -U --unix-socket PATH        Additionally accept clients on this host at the given\n"
+"                               UNIX domain socket\n"
+"  -O --socket-profile NAME     Tuning of RSPRO sockets: none, default, low-latency\n"
+"                               (default: default)\n"
 	      );
 }
 
@@ -315,6 +386,8 @@ static void handle_options(int argc, char **argv)
 {
 	while (1) {
 		int option_index = 0, c;
+		long reset_window;
+		char *end;
 		static const struct option long_options[] = {
 			{ "help", 0, 0, 'h' },
 			{ "version", 0, 0, 'V' },
@@ -332,10 +405,15 @@ static void handle_options(int argc, char **argv)
 			{ "disable-color", 0, 0, 'L' },
 			{ "timestamp", 0, 0, 'T' },
 			{ "log-level", 1, 0, 'e' },
+			{ "capture-file", 1, 0, 'c' },
+			{ "apdu-cache", 0, 0, 'a' },
+			{ "reset-window", 1, 0, 'R' },
+			{ "unix-socket", 1, 0, 'U' },
+			{ "socket-profile", 1, 0, 'O' },
 			{ 0, 0, 0, 0 }
 		};
 
-		c = getopt_long(argc, argv, "hVd:i:p:b:n:N:I:P:sg:G:LTe:", long_options, &option_index);
+		c = getopt_long(argc, argv, "hVd:i:p:b:n:N:I:P:sg:G:LTe:c:aR:U:O:", long_options, &option_index);
 		if (c == -1)
 			break;
 
@@ -390,10 +468,68 @@ static void handle_options(int argc, char **argv)
 		case 'e':
 			log_set_log_level(osmo_stderr_target, atoi(optarg));
 			break;
+		case 'c':
+			g_bankd->cfg.capture_file = optarg;
+			break;
+		case 'a':
+			g_bankd->cfg.apdu_cache = true;
+			break;
+		case 'R':
+			errno = 0;
+			reset_window = strtol(optarg, &end, 10);
+			if (errno || end == optarg || *end) {
+				fprintf(stderr, "Invalid reset window '%s'\n", optarg);
+				exit(2);
+			}
+			g_bankd->cfg.reset_window_ms = OSMO_MAX(OSMO_MIN(reset_window, 10000), 0);
+			break;
+		case 'U':
+			g_bankd->cfg.unix_socket = optarg;
+			break;
+		case 'O':
+			if (rspro_sock_tune_set_profile(optarg) < 0) {
+				fprintf(stderr, "Unknown socket profile '%s'\n", optarg);
+				exit(2);
+			}
+			break;
 		}
 	}
 }
 
+/* SIGUSR1 may hit any of our threads, in the middle of anything: just wake up the main loop */
+static void handle_sig_usr1(int sig)
+{
+	const uint64_t one = 1;
+	int saved_errno = errno;
+
+	if (write(g_sig_usr1_ofd.fd, &one, sizeof(one)) < 0) {
+		/* nothing we could do about it here */
+	}
+	errno = saved_errno;
+}
+
+static int sig_usr1_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct bankd_worker *worker;
+	uint64_t val;
+
+	if (read(ofd->fd, &val, sizeof(val)) != sizeof(val))
+		return 0;
+
+	fprintf(stderr, "=== Talloc Report of main thread:\n");
+	talloc_report_full(g_tall_ctx, stderr);
+
+	/* ask the worker threads to dump their talloc state */
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	llist_for_each_entry(worker, &g_bankd->workers, list)
+		worker_post_cmd(worker, BW_CMD_TALLOC_REPORT);
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+
+	fprintf(stderr, "=== Card reader statistics:\n");
+	bankd_readers_report(g_bankd, stderr);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	struct rspro_server_conn *srvc;
@@ -426,8 +562,16 @@ int main(int argc, char **argv)
 	}
 
 	g_bankd->main = pthread_self();
-	signal(SIGMAPDEL, handle_sig_mapdel);
-	signal(SIGMAPADD, handle_sig_mapadd);
+	rc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (rc < 0) {
+		fprintf(stderr, "Unable to create eventfd: %s\n", strerror(errno));
+		exit(1);
+	}
+	osmo_fd_setup(&g_sig_usr1_ofd, rc, OSMO_FD_READ, sig_usr1_fd_cb, NULL, 0);
+	if (osmo_fd_register(&g_sig_usr1_ofd) < 0) {
+		fprintf(stderr, "Unable to register eventfd\n");
+		exit(1);
+	}
 	signal(SIGUSR1, handle_sig_usr1);
 
 	LOGP(DMAIN, LOGL_INFO, "Reading PCSC slots...\n");
@@ -440,6 +584,9 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	/* tell the server, so it can point clients on this host to our UNIX domain socket */
+	srvc->bankd.socket_path = g_bankd->cfg.unix_socket;
+
 	/* Connection towards remsim-server */
 	rc = server_conn_fsm_alloc(g_bankd, srvc);
 	if (rc < 0) {
@@ -451,7 +598,9 @@ int main(int argc, char **argv)
 	/* create listening socket for inbound client connections */
 	LOGP(DMAIN, LOGL_INFO, "Initiating listen TCP socket at %s:%d\n",
 	     g_bind_ip ? g_bind_ip : "INADDR_ANY", g_bind_port);
-	rc = osmo_sock_init(AF_INET, SOCK_STREAM, IPPROTO_TCP, g_bind_ip, g_bind_port, OSMO_SOCK_F_BIND);
+	/* non-blocking, as all idle workers wait for it in parallel */
+	rc = osmo_sock_init(AF_INET, SOCK_STREAM, IPPROTO_TCP, g_bind_ip, g_bind_port,
+			    OSMO_SOCK_F_BIND | OSMO_SOCK_F_NONBLOCK);
 	if (rc < 0) {
 		fprintf(stderr, "Unable to create TCP socket at %s:%d: %s\n",
 			g_bind_ip ? g_bind_ip : "INADDR_ANY", g_bind_port, strerror(errno));
@@ -459,6 +608,19 @@ int main(int argc, char **argv)
 	}
 	g_bankd->accept_fd = rc;
 
+	if (g_bankd->cfg.unix_socket) {
+		LOGP(DMAIN, LOGL_INFO, "Initiating listen UNIX domain socket at %s\n",
+		     g_bankd->cfg.unix_socket);
+		rc = osmo_sock_unix_init(SOCK_SEQPACKET, 0, g_bankd->cfg.unix_socket,
+					 OSMO_SOCK_F_BIND | OSMO_SOCK_F_NONBLOCK);
+		if (rc < 0) {
+			fprintf(stderr, "Unable to create UNIX domain socket at %s: %s\n",
+				g_bankd->cfg.unix_socket, strerror(errno));
+			exit(1);
+		}
+		g_bankd->unix_accept_fd = rc;
+	}
+
 	/* initialize gsmtap, if required */
 	if (g_bankd->cfg.gsmtap_host) {
 		LOGP(DMAIN, LOGL_INFO, "Initiating GSMTAP\n");
@@ -469,6 +631,21 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (g_bankd->cfg.capture_file) {
+		g_bankd->capture = rspro_capture_open(g_bankd, g_bankd->cfg.capture_file);
+		if (!g_bankd->capture) {
+			fprintf(stderr, "Unable to open capture file: %s\n", strerror(errno));
+			exit(1);
+		}
+	}
+
+	/* wakes up workers waiting for a card as soon as one is inserted */
+	rc = bankd_pcsc_start_monitor(g_bankd);
+	if (rc < 0) {
+		fprintf(stderr, "Unable to start card monitor thread: %s\n", strerror(-rc));
+		exit(1);
+	}
+
 	/* create worker threads: One per reader/slot! */
 	for (i = 0; i < g_bankd->srvc.bankd.num_slots; i++) {
 		struct bankd_worker *w;
@@ -518,66 +695,240 @@ static void worker_set_state(struct bankd_worker *worker, enum bankd_worker_stat
 }
 
 static void worker_set_state_timeout(struct bankd_worker *worker, enum bankd_worker_state new_state,
-				     unsigned int timeout_secs)
+				     unsigned int timeout_ms)
 {
-	LOGW(worker, "Changing state to %s (timeout=%u)\n",
-		get_value_string(worker_state_names, new_state), timeout_secs);
+	LOGW(worker, "Changing state to %s (timeout=%ums)\n",
+		get_value_string(worker_state_names, new_state), timeout_ms);
 	worker->state = new_state;
-	worker->timeout = timeout_secs;
+	worker->timeout = timeout_ms;
+}
+
+static void worker_cleanup(void *arg)
+{
+	struct bankd_worker *worker = (struct bankd_worker *) arg;
+	struct bankd *bankd = worker->bankd;
+
+	/* FIXME: should we still do this? in the thread ?!? */
+	pthread_mutex_lock(&bankd->workers_mutex);
+	llist_del(&worker->list);
+	close(worker->mbox.fd);
+	talloc_free(worker);	/* FIXME: is this safe? */
+	pthread_mutex_unlock(&bankd->workers_mutex);
+}
+
+/***********************************************************************
+ * client connections shared between workers, worker mailbox
+ *
+ * A client may multiplex several of its slots over one TCP connection.
+ * The worker which accepted the connection ('owner') reads all messages
+ * from it.  It handles those for its own client slot, and passes those
+ * for further client slots to the mailbox of the worker serving them;
+ * a ConnectClientReq for a new client slot attaches an idle worker.
+ * All workers write to the connection directly.
+ ***********************************************************************/
+
+/* queue a message to the mailbox of a worker.  May be called from any thread */
+static int worker_mbox_post(struct bankd_worker *worker, enum bankd_mbox_msg_type type,
+			    struct bankd_client_conn *conn, const uint8_t *data, size_t len)
+{
+	const uint64_t one = 1;
+	struct bankd_mbox_msg *msg;
+
+	msg = malloc(sizeof(*msg) + len);
+	if (!msg)
+		return -ENOMEM;
+	msg->type = type;
+	msg->conn = conn;
+	msg->len = len;
+	if (len)
+		memcpy(msg->data, data, len);
+
+	pthread_mutex_lock(&worker->mbox.mutex);
+	llist_add_tail(&msg->list, &worker->mbox.queue);
+	pthread_mutex_unlock(&worker->mbox.mutex);
+
+	if (write(worker->mbox.fd, &one, sizeof(one)) != sizeof(one)) {
+		LOGP(DBANKDW, LOGL_ERROR, "Cannot signal mailbox of worker %u: %s\n", worker->num,
+		     strerror(errno));
+		return -errno;
+	}
+	return 0;
 }
 
-/* signal handler for receiving SIGMAPDEL from main thread */
-static void handle_sig_mapdel(int sig)
+/* post a command to a worker; commands already pending are merged.  May be called from any
+ * thread, without holding any lock */
+static int worker_post_cmd(struct bankd_worker *worker, enum bankd_worker_cmd cmd)
 {
-	LOGW(g_worker, "SIGMAPDEL received: Main thread informs us our map is gone\n");
-	OSMO_ASSERT(sig == SIGMAPDEL);
-	if (g_worker->state >= BW_ST_CONN_CLIENT_MAPPED) {
-		g_worker->slot.bank_id = 0xffff;
-		g_worker->slot.slot_nr = 0xffff;
-		worker_set_state(g_worker, BW_ST_CONN_CLIENT_UNMAPPED);
+	const uint64_t one = 1;
+	unsigned int old;
+
+	old = __atomic_fetch_or(&worker->mbox.cmds, cmd, __ATOMIC_RELEASE);
+	if (old & cmd)
+		return 0;	/* the worker has not seen it yet, and will see it only once */
+
+	if (write(worker->mbox.fd, &one, sizeof(one)) != sizeof(one)) {
+		LOGP(DBANKDW, LOGL_ERROR, "Cannot signal mailbox of worker %u: %s\n", worker->num,
+		     strerror(errno));
+		return -errno;
 	}
+	return 0;
 }
 
-/* signal handler for receiving SIGMAPADD from main thread */
-static void handle_sig_mapadd(int sig)
+/* fetch (and clear) all commands pending for ourselves */
+static unsigned int worker_take_cmds(struct bankd_worker *worker)
 {
-	LOGW(g_worker, "SIGMAPADD received\n");
-	/* do nothing */
+	return __atomic_exchange_n(&worker->mbox.cmds, 0, __ATOMIC_ACQUIRE);
 }
 
-static void handle_sig_usr1(int sig)
+/* dequeue the next message from our own mailbox; to be called once its fd is readable.  The
+ * readable fd may also be due to a command, so the mailbox may turn out to be empty */
+static struct bankd_mbox_msg *worker_mbox_get(struct bankd_worker *worker)
 {
-	OSMO_ASSERT(sig == SIGUSR1);
+	struct bankd_mbox_msg *msg;
+	uint64_t val;
 
-	if (pthread_equal(g_bankd->main, pthread_self())) {
-		struct bankd_worker *worker;
-		/* main thread */
-		fprintf(stderr, "=== Talloc Report of main thread:\n");
-		talloc_report_full(g_tall_ctx, stderr);
+	if (read(worker->mbox.fd, &val, sizeof(val)) != sizeof(val))
+		return NULL;
 
-		/* iterate over worker threads and ask them to dump their talloc state */
-		pthread_mutex_lock(&g_bankd->workers_mutex);
-		llist_for_each_entry(worker, &g_bankd->workers, list) {
-			pthread_kill(worker->thread, SIGUSR1);
-		}
-		pthread_mutex_unlock(&g_bankd->workers_mutex);
+	pthread_mutex_lock(&worker->mbox.mutex);
+	msg = llist_first_entry_or_null(&worker->mbox.queue, struct bankd_mbox_msg, list);
+	if (msg)
+		llist_del(&msg->list);
+	pthread_mutex_unlock(&worker->mbox.mutex);
+
+	return msg;
+}
+
+static bool worker_is_owner(const struct bankd_worker *worker)
+{
+	return worker->client.conn && worker->client.conn->owner == worker;
+}
+
+/* is any other worker using our client connection? */
+static bool client_conn_shared(struct bankd_client_conn *conn)
+{
+	bool shared;
+
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	shared = conn->refcnt > 1;
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+
+	return shared;
+}
+
+/* the connection has failed; make sure nobody writes to it any longer */
+static void client_conn_set_dead(struct bankd_client_conn *conn)
+{
+	pthread_mutex_lock(&conn->tx_mutex);
+	conn->dead = true;
+	pthread_mutex_unlock(&conn->tx_mutex);
+	shutdown(conn->fd, SHUT_RDWR);
+}
+
+/* the connection we own is gone: detach all other workers using it */
+static void worker_detach_others(struct bankd_worker *worker)
+{
+	struct bankd_client_conn *conn = worker->client.conn;
+	struct bankd_worker *w;
+
+	client_conn_set_dead(conn);
+
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	conn->owner = NULL;
+	llist_for_each_entry(w, &g_bankd->workers, list) {
+		if (w != worker && w->client.conn == conn)
+			worker_mbox_post(w, BW_MBOX_DETACH, NULL, NULL, 0);
+	}
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+}
+
+/* drop our reference to the client connection; the last one closes it */
+static void worker_put_conn(struct bankd_worker *worker)
+{
+	struct bankd_client_conn *conn = worker->client.conn;
+	bool last;
+
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	worker->client.conn = NULL;
+	last = --conn->refcnt == 0;
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+
+	if (!last)
+		return;
+
+	close(conn->fd);
+	if (g_bankd->capture)
+		rspro_capture_conn_close(g_bankd->capture, conn->cap_conn_id);
+	pthread_mutex_destroy(&conn->tx_mutex);
+	free(conn);
+}
+
+/* set (or with NULL, clear) the bank slot we serve, and keep the index up to date */
+static void worker_set_bank_slot(struct bankd_worker *worker, const struct bank_slot *bs)
+{
+	struct bankd_worker **idx;
+
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	idx = worker_idx_bank_slot(g_bankd, &worker->slot);
+	if (idx && *idx == worker)
+		*idx = NULL;
+	if (bs) {
+		worker->slot = *bs;
+		idx = worker_idx_bank_slot(g_bankd, bs);
+		if (idx)
+			*idx = worker;
 	} else {
-		/* worker thread */
-		fprintf(stderr, "=== Talloc Report of %s\n", g_worker->name);
-		talloc_report_full(g_worker->tall_ctx, stderr);
+		worker->slot.bank_id = 0xffff;
+		worker->slot.slot_nr = 0xffff;
 	}
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
 }
 
-static void worker_cleanup(void *arg)
+/* set (or with NULL, clear) the client slot served by a worker, and keep the index up to date.
+ * Call with workers_mutex held */
+static void worker_set_client_slot(struct bankd_worker *worker, const struct client_slot *cs)
 {
-	struct bankd_worker *worker = (struct bankd_worker *) arg;
-	struct bankd *bankd = worker->bankd;
+	struct bankd_worker **idx;
 
-	/* FIXME: should we still do this? in the thread ?!? */
-	pthread_mutex_lock(&bankd->workers_mutex);
-	llist_del(&worker->list);
-	talloc_free(worker);	/* FIXME: is this safe? */
-	pthread_mutex_unlock(&bankd->workers_mutex);
+	if (worker->client.clslot_indexed) {
+		idx = worker_idx_client_slot(g_bankd, &worker->client.clslot, false);
+		if (idx && *idx == worker)
+			*idx = NULL;
+		worker->client.clslot_indexed = false;
+	}
+	if (cs) {
+		worker->client.clslot = *cs;
+		idx = worker_idx_client_slot(g_bankd, cs, true);
+		if (idx) {
+			*idx = worker;
+			worker->client.clslot_indexed = true;
+		}
+	} else
+		worker->client.clslot.client_id = worker->client.clslot.slot_nr = 0;
+}
+
+/* forget about the client slot we are serving, and the card we use for it */
+static void worker_reset_slot(struct bankd_worker *worker)
+{
+	memset(&worker->card, 0, sizeof(worker->card));
+	worker->ops->cleanup(worker);
+	worker->reader.name = NULL;
+	bankd_reader_put(worker->bankd, worker->reader.sched);
+	worker->reader.sched = NULL;
+	if (worker->apdu_cache.stats.hits || worker->apdu_cache.stats.misses) {
+		LOGW(worker, "APDU cache: %lu hits, %lu misses\n", worker->apdu_cache.stats.hits,
+		     worker->apdu_cache.stats.misses);
+	}
+	bankd_apdu_cache_flush(&worker->apdu_cache);
+	worker->apdu_cache.stats.hits = worker->apdu_cache.stats.misses = 0;
+	memset(&worker->reset, 0, sizeof(worker->reset));
+	worker_set_bank_slot(worker, NULL);
+	worker->client.tpdu_enc = 0;
+
+	/* the owner of our connection looks up workers by client slot */
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	worker_set_client_slot(worker, NULL);
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
 }
 
 static int worker_open_card(struct bankd_worker *worker)
@@ -619,15 +970,29 @@ static int blocking_ipa_read(struct bankd_worker *worker, uint8_t *buf, unsigned
 
 	hh = (struct ipaccess_head *) buf;
 
-	/* we use 'recv' and not 'read' below, as 'recv' will always fail with -EINTR
-	 * in case of a signal being received */
+	/* a signal (e.g. SIGUSR1) must not make us give up a partially read message, as
+	 * the connection may continue to be used for other client slots */
+
+	if (worker->client.conn->seqpacket) {
+		/* the message is read as a whole, or not at all */
+restart_rec:
+		rc = recv(worker->client.conn->fd, buf, buf_size, 0);
+		if (rc == -1 && errno == EINTR)
+			goto restart_rec;
+		else if (rc < 0)
+			return rc;
+		else if (rc < sizeof(*hh))
+			return -2;
+		len = ntohs(hh->len);
+		if (rc != sizeof(*hh) + len)
+			return -3;
+		return len;
+	}
 
 restart_hdr:
 	/* 1) blocking recv from the socket (IPA header) */
-	rc = recv(worker->client.fd, buf, sizeof(*hh), 0);
+	rc = recv(worker->client.conn->fd, buf, sizeof(*hh), 0);
 	if (rc == -1 && errno == EINTR) {
-		if (worker->state == BW_ST_CONN_CLIENT_UNMAPPED)
-			return -23;
 		goto restart_hdr;
 	} else if (rc < 0)
 		return rc;
@@ -639,22 +1004,22 @@ restart_hdr:
 
 restart_body:
 	/* 2) blocking recv from the socket (payload) */
-	rc = recv(worker->client.fd, buf+sizeof(*hh), needed, 0);
+	rc = recv(worker->client.conn->fd, buf+sizeof(*hh), needed, 0);
 	if (rc == -1 && errno == EINTR) {
-		if (worker->state == BW_ST_CONN_CLIENT_UNMAPPED)
-			return -23;
 		goto restart_body;
 	} else if (rc < 0)
 		return rc;
 	else if (rc < needed)
 		return -3;
 
+	rspro_sock_tune_rx(worker->client.conn->fd);
 	return len;
 }
 
 static int worker_send_rspro(struct bankd_worker *worker, RsproPDU_t *pdu)
 {
-	struct msgb *msg = rspro_enc_msg(pdu);
+	struct bankd_client_conn *conn = worker->client.conn;
+	struct msgb *msg = rspro_enc_msg_tpdu(pdu, worker->client.tpdu_enc);
 	int rc;
 
 	if (!msg) {
@@ -664,12 +1029,21 @@ static int worker_send_rspro(struct bankd_worker *worker, RsproPDU_t *pdu)
 	}
 
 	msg->l2h = msg->data;
+	if (g_bankd->capture)
+		rspro_capture_frame(g_bankd->capture, conn->cap_conn_id, RSPRO_CAP_EV_TX,
+				    IPAC_PROTO_OSMO, IPAC_PROTO_EXT_RSPRO, msgb_data(msg), msgb_length(msg));
 	/* prepend the header */
 	ipa_prepend_header_ext(msg, IPAC_PROTO_EXT_RSPRO);
 	ipa_prepend_header(msg, IPAC_PROTO_OSMO);
 
-	/* actually send it through the socket */
-	rc = write(worker->client.fd, msgb_data(msg), msgb_length(msg));
+	/* actually send it through the socket, which other workers may share.  No SIGPIPE,
+	 * the peer may have gone away before the reading worker noticed */
+	pthread_mutex_lock(&conn->tx_mutex);
+	if (conn->dead)
+		rc = -1;
+	else
+		rc = send(conn->fd, msgb_data(msg), msgb_length(msg), MSG_NOSIGNAL);
+	pthread_mutex_unlock(&conn->tx_mutex);
 	if (rc == msgb_length(msg))
 		rc = 0;
 	else {
@@ -691,15 +1065,16 @@ static int worker_try_slotmap(struct bankd_worker *worker)
 	if (!slmap) {
 		LOGW(worker, "No slotmap (yet) for client C(%u:%u)\n",
 			worker->client.clslot.client_id, worker->client.clslot.slot_nr);
-		/* check in 10s if the map has been installed meanwhile by main thread */
-		worker_set_state_timeout(worker, BW_ST_CONN_CLIENT_WAIT_MAP, 10);
+		/* the main thread notifies us once it has installed the map */
+		worker_set_state(worker, BW_ST_CONN_CLIENT_WAIT_MAP);
 		return -1;
 	} else {
 		LOGW(worker, "slotmap found: C(%u:%u) -> B(%u:%u)\n",
 			slmap->client.client_id, slmap->client.slot_nr,
 			slmap->bank.bank_id, slmap->bank.slot_nr);
-		worker->slot = slmap->bank;
-		worker_set_state_timeout(worker, BW_ST_CONN_CLIENT_MAPPED, 10);
+		worker_set_bank_slot(worker, &slmap->bank);
+		worker->open_retry_ms = OPEN_RETRY_MIN_MS;
+		worker_set_state_timeout(worker, BW_ST_CONN_CLIENT_MAPPED, worker->open_retry_ms);
 		return worker_open_card(worker);
 	}
 }
@@ -724,9 +1099,39 @@ static int worker_send_atr(struct bankd_worker *worker)
 	return worker_send_rspro(worker, set_atr);
 }
 
+/* retry to open the card of our (mapped) slot; on failure, retry later, with increasing delays
+ * if 'backoff' is set */
+static void worker_retry_open_card(struct bankd_worker *worker, bool backoff)
+{
+	if (worker_open_card(worker) == 0) {
+		worker_send_atr(worker);
+		return;
+	}
+
+	if (backoff)
+		worker->open_retry_ms = OSMO_MIN(worker->open_retry_ms * 2, OPEN_RETRY_MAX_MS);
+	worker->timeout = worker->open_retry_ms;
+	LOGW(worker, "Cannot open card yet, retrying in %ums\n", worker->open_retry_ms);
+}
+
+/* inform the client that our client slot is no longer served via the shared connection */
+static int worker_send_detach(struct bankd_worker *worker)
+{
+	RsproPDU_t *pdu;
+	ClientSlot_t cs;
+
+	client_slot2rspro(&cs, &worker->client.clslot);
+	pdu = rspro_gen_ErrorInd(ComponentType_remsimBankd, ErrorSeverity_minor,
+				 ErrorCode_unexpectedDisconnect, NULL, &cs, NULL);
+	if (!pdu)
+		return -1;
+	return worker_send_rspro(worker, pdu);
+}
+
 static int worker_handle_connectClientReq(struct bankd_worker *worker, const RsproPDU_t *pdu)
 {
 	const struct ComponentIdentity *cid = &pdu->msg.choice.connectClientReq.identity;
+	struct client_slot clslot;
 	RsproPDU_t *resp = NULL;
 	e_ResultCode res;
 	int rc;
@@ -750,8 +1155,13 @@ static int worker_handle_connectClientReq(struct bankd_worker *worker, const Rsp
 		rc = -103;
 		goto respond_and_err;
 	}
-	worker->client.clslot.client_id = pdu->msg.choice.connectClientReq.clientSlot->clientId;
-	worker->client.clslot.slot_nr = pdu->msg.choice.connectClientReq.clientSlot->slotNr;
+	/* under the lock, so the main thread finds us if it adds the map after our lookup below */
+	rspro2client_slot(&clslot, pdu->msg.choice.connectClientReq.clientSlot);
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	worker_set_client_slot(worker, &clslot);
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+	/* pick the TPDU encodings we support out of those offered by the client */
+	worker->client.tpdu_enc = rspro_get_tpdu_encodings(pdu) & RSPRO_TPDU_ENC_SUPPORTED;
 	worker_set_state(worker, BW_ST_CONN_CLIENT);
 
 	if (worker_try_slotmap(worker) >= 0)
@@ -760,6 +1170,11 @@ static int worker_handle_connectClientReq(struct bankd_worker *worker, const Rsp
 		res = ResultCode_cardNotPresent;
 
 	resp = rspro_gen_ConnectClientRes(&worker->bankd->comp_id, res);
+	if (resp) {
+		rspro_set_tpdu_encodings(resp, worker->client.tpdu_enc);
+		/* tell the client it may multiplex further client slots over this connection */
+		rspro_set_connect_client_res_slot(resp, pdu->msg.choice.connectClientReq.clientSlot);
+	}
 	rc = worker_send_rspro(worker, resp);
 	if (rc < 0)
 		return rc;
@@ -772,11 +1187,96 @@ static int worker_handle_connectClientReq(struct bankd_worker *worker, const Rsp
 respond_and_err:
 	if (res) {
 		resp = rspro_gen_ConnectClientRes(&worker->bankd->comp_id, res);
+		if (resp && pdu->msg.choice.connectClientReq.clientSlot)
+			rspro_set_connect_client_res_slot(resp, pdu->msg.choice.connectClientReq.clientSlot);
 		worker_send_rspro(worker, resp);
 	}
 	return rc;
 }
 
+/* card operations, in the order determined by the scheduler of the physical reader */
+static int worker_card_transceive(struct bankd_worker *worker, const uint8_t *out, size_t out_len,
+				  uint8_t *in, size_t *in_len)
+{
+	int rc;
+
+	bankd_reader_acquire(worker->reader.sched, bankd_sched_apdu_prio(out, out_len));
+	rc = worker->ops->transceive(worker, out, out_len, in, in_len);
+	bankd_reader_release(worker->reader.sched);
+
+	return rc;
+}
+
+static int worker_card_reset(struct bankd_worker *worker, bool cold_reset)
+{
+	int rc;
+
+	bankd_reader_acquire(worker->reader.sched, BANKD_SCHED_PRIO_NORMAL);
+	rc = worker->ops->reset_card(worker, cold_reset);
+	bankd_reader_release(worker->reader.sched);
+
+	/* the reset deselects all files; the next card may have been inserted */
+	bankd_apdu_cache_flush(&worker->apdu_cache);
+
+	return rc;
+}
+
+static uint64_t monotonic_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* perform the pending card reset, if any; inform the client if the ATR changed */
+static int worker_flush_reset(struct bankd_worker *worker)
+{
+	uint8_t old_atr[sizeof(worker->card.atr)];
+	unsigned int old_atr_len = worker->card.atr_len;
+	int rc;
+
+	if (!worker->reset.pending)
+		return 0;
+	worker->reset.pending = false;
+
+	if (worker->reset.num_coalesced)
+		LOGW(worker, "Performing %s reset in place of %u requested resets\n",
+		     worker->reset.cold ? "cold" : "warm", worker->reset.num_coalesced + 1);
+
+	memcpy(old_atr, worker->card.atr, old_atr_len);
+	rc = worker_card_reset(worker, worker->reset.cold);
+	if (rc < 0)
+		return rc;
+
+	/* the client answers resets of the modem with the ATR it has got from us */
+	if (worker->card.atr_len != old_atr_len || memcmp(worker->card.atr, old_atr, old_atr_len)) {
+		LOGW(worker, "ATR changed after reset\n");
+		worker_send_atr(worker);
+	}
+	return 0;
+}
+
+/* the client requests a card reset: merge it with further requests within the reset window.
+ * The reset is performed once the window expires, or before the next command to the card. */
+static int worker_request_reset(struct bankd_worker *worker, bool cold_reset)
+{
+	if (worker->reset.pending) {
+		/* a cold reset implies a warm one, but not vice versa */
+		worker->reset.cold |= cold_reset;
+		worker->reset.num_coalesced++;
+		return 0;
+	}
+
+	worker->reset.pending = true;
+	worker->reset.cold = cold_reset;
+	worker->reset.num_coalesced = 0;
+	worker->reset.deadline_ms = monotonic_ms() + g_bankd->cfg.reset_window_ms;
+
+	if (!g_bankd->cfg.reset_window_ms)
+		return worker_flush_reset(worker);
+	return 0;
+}
+
 static int worker_handle_tpduModemToCard(struct bankd_worker *worker, const RsproPDU_t *pdu)
 {
 	const struct TpduModemToCard *mdm2sim = &pdu->msg.choice.tpduModemToCard;
@@ -809,11 +1309,24 @@ static int worker_handle_tpduModemToCard(struct bankd_worker *worker, const Rspr
 		return -106;
 	}
 
-	rc = worker->ops->transceive(worker, mdm2sim->data.buf, mdm2sim->data.size,
-				     rx_buf, &rx_buf_len);
+	/* the card must have been reset before it receives the next command */
+	rc = worker_flush_reset(worker);
 	if (rc < 0)
 		return rc;
 
+	rc = bankd_apdu_cache_lookup(&worker->apdu_cache, mdm2sim->data.buf, mdm2sim->data.size,
+				     rx_buf, &rx_buf_len);
+	if (rc == 0) {
+		LOGW(worker, "Response served from APDU cache\n");
+	} else {
+		rc = worker_card_transceive(worker, mdm2sim->data.buf, mdm2sim->data.size,
+					    rx_buf, &rx_buf_len);
+		if (rc < 0)
+			return rc;
+		bankd_apdu_cache_update(&worker->apdu_cache, mdm2sim->data.buf, mdm2sim->data.size,
+					rx_buf, rx_buf_len);
+	}
+
 	LOGW(worker, "Tx RSPRO tpduCardToModem(%s)\n", osmo_hexdump_nospc(rx_buf, rx_buf_len));
 	/* encode response PDU and send it */
 	pdu_resp = rspro_gen_TpduCard2Modem(&mdm2sim->toBankSlot, &mdm2sim->fromClientSlot,
@@ -835,6 +1348,14 @@ static int worker_handle_clientSlotStatusInd(struct bankd_worker *worker, const
 	const struct SlotPhysStatus *sps = &cssi->slotPhysStatus;
 	int rc = 0;
 
+	/* clients only report changes, but older ones report every status of the modem */
+	if ((sps->resetActive != 0) == worker->last_resetActive &&
+	    (!sps->vccPresent || (*sps->vccPresent != 0) == worker->last_vccPresent) &&
+	    (!sps->clkActive || (*sps->clkActive != 0) == worker->last_clkActive)) {
+		LOGP(DBANKDW, LOGL_DEBUG, "[%03u] Rx RSPRO clientSlotStatusInd: unchanged\n", worker->num);
+		return 0;
+	}
+
 	LOGW(worker, "Rx RSPRO clientSlotStatusInd(RST=%s, VCC=%s, CLK=%s)\n",
 		sps->resetActive ? "ACTIVE" : "INACTIVE",
 		sps->vccPresent ? *sps->vccPresent ? "PRESENT" : "ABSENT" : "NULL",
@@ -846,12 +1367,12 @@ static int worker_handle_clientSlotStatusInd(struct bankd_worker *worker, const
 
 		if (worker->last_vccPresent) {
 			/* falling edge detected on VCC; perform cold reset */
-			rc = worker->ops->reset_card(worker, true);
+			rc = worker_request_reset(worker, true);
 		}
 	} else if (sps->resetActive) {
 		if (!worker->last_resetActive) {
 			/* VCC is present (or not reported) and rising edge detected on reset; perform warm reset */
-			rc = worker->ops->reset_card(worker, false);
+			rc = worker_request_reset(worker, false);
 		}
 	}
 
@@ -862,6 +1383,9 @@ static int worker_handle_clientSlotStatusInd(struct bankd_worker *worker, const
 
 	worker->last_resetActive = sps->resetActive != 0;
 
+	if (sps->clkActive)
+		worker->last_clkActive = *sps->clkActive != 0;
+
 	return rc;
 }
 
@@ -885,6 +1409,15 @@ static int worker_handle_rspro(struct bankd_worker *worker, const RsproPDU_t *pd
 		LOGW(worker, "Rx RSPRO %s\n", rspro_msgt_name(pdu));
 		rc = 0;
 		break;
+	case RsproPDUchoice_PR_errorInd:
+		if (rspro_is_client_slot_detach(pdu)) {
+			LOGW(worker, "Rx RSPRO errorInd: client detached its slot from the connection\n");
+			rc = -24;
+		} else {
+			LOGW(worker, "Rx RSPRO %s\n", rspro_msgt_name(pdu));
+			rc = 0;
+		}
+		break;
 	default:
 		LOGW(worker, "Rx RSPRO %s (unhandled)\n", rspro_msgt_name(pdu));
 		rc = -101;
@@ -894,119 +1427,274 @@ static int worker_handle_rspro(struct bankd_worker *worker, const RsproPDU_t *pd
 	return rc;
 }
 
-static int wait_for_fd_or_timeout(int fd, unsigned int timeout_secs)
+/* dispatch an RSPRO message received by the owner of a client connection: handle it
+ * ourselves, or pass it to the worker serving the client slot it refers to */
+static int worker_dispatch_rspro(struct bankd_worker *worker, const uint8_t *data, size_t len)
 {
-	struct timeval tout = { timeout_secs, 0 };
-	fd_set readset;
+	struct bankd_client_conn *conn = worker->client.conn;
+	struct bankd_worker **idx, *w, *dst = NULL;
+	const ClientSlot_t *rcs;
+	struct client_slot cs;
+	RsproPDU_t *pdu, *resp;
+	int rc;
+
+	pdu = rspro_dec_buf(data, len);
+	if (!pdu) {
+		LOGW(worker, "Error during decode of RSPRO\n");
+		client_conn_set_dead(conn);
+		return -7;
+	}
+
+	/* messages without client slot (e.g. setAtrRes) and those for our own slot are ours */
+	rcs = rspro_get_client_slot(pdu);
+	if (!rcs)
+		goto local;
+	rspro2client_slot(&cs, rcs);
+	if (worker->state != BW_ST_CONN_WAIT_ID && client_slot_equals(&worker->client.clslot, &cs))
+		goto local;
 
-	FD_ZERO(&readset);
-	FD_SET(fd, &readset);
-	return select(fd + 1, &readset, NULL, NULL, timeout_secs ? &tout : NULL);
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	idx = worker_idx_client_slot(g_bankd, &cs, false);
+	if (idx && *idx && *idx != worker && (*idx)->client.conn == conn)
+		dst = *idx;
+	if (!dst && pdu->msg.present == RsproPDUchoice_PR_connectClientReq) {
+		if (worker->state == BW_ST_CONN_WAIT_ID) {
+			/* we don't serve any client slot (anymore); take this one */
+			pthread_mutex_unlock(&g_bankd->workers_mutex);
+			goto local;
+		}
+		/* a further client slot over this connection: attach an idle worker */
+		llist_for_each_entry(w, &g_bankd->workers, list) {
+			if (w->state == BW_ST_ACCEPTING && !w->client.conn) {
+				w->client.conn = conn;
+				worker_set_client_slot(w, &cs);
+				conn->refcnt++;
+				worker_mbox_post(w, BW_MBOX_ATTACH, conn, NULL, 0);
+				dst = w;
+				break;
+			}
+		}
+	}
+	if (dst)
+		worker_mbox_post(dst, BW_MBOX_RSPRO, NULL, data, len);
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+
+	if (dst) {
+		rc = 0;
+	} else if (pdu->msg.present == RsproPDUchoice_PR_connectClientReq) {
+		LOGW(worker, "No idle worker for further client slot C(%u:%u)\n", cs.client_id, cs.slot_nr);
+		resp = rspro_gen_ConnectClientRes(&worker->bankd->comp_id, ResultCode_cardNotPresent);
+		if (resp)
+			rspro_set_connect_client_res_slot(resp, rcs);
+		rc = worker_send_rspro(worker, resp) < 0 ? -8 : 0;
+	} else {
+		LOGW(worker, "Rx RSPRO %s for unknown client slot C(%u:%u), ignoring\n",
+			rspro_msgt_name(pdu), cs.client_id, cs.slot_nr);
+		rc = 0;
+	}
+	ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+	return rc;
+
+local:
+	/* 3) handling of the message, possibly resulting in PCSC commands */
+	rc = worker_handle_rspro(worker, pdu);
+	ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+	if (rc < 0)
+		LOGW(worker, "Error handling RSPRO\n");
+	return rc;
+}
+
+static void worker_talloc_report(struct bankd_worker *worker)
+{
+	fprintf(stderr, "=== Talloc Report of %s\n", worker->name);
+	talloc_report_full(worker->tall_ctx, stderr);
+}
+
+/* apply the commands from the main thread (or card monitor) */
+static int worker_handle_cmds(struct bankd_worker *worker, unsigned int cmds)
+{
+	if (cmds & BW_CMD_TALLOC_REPORT)
+		worker_talloc_report(worker);
+
+	if (cmds & (BW_CMD_MAP_DEL | BW_CMD_RESET_STATE)) {
+		LOGW(worker, "Main thread informs us %s\n", cmds & BW_CMD_MAP_DEL ?
+		     "our map is gone" : "all maps are gone");
+		if (worker->state >= BW_ST_CONN_CLIENT_MAPPED) {
+			worker_set_bank_slot(worker, NULL);
+			worker_set_state(worker, BW_ST_CONN_CLIENT_UNMAPPED);
+			return -23;
+		}
+	}
+
+	if ((cmds & BW_CMD_MAP_ADD) && worker->state == BW_ST_CONN_CLIENT_WAIT_MAP) {
+		LOGW(worker, "Main thread informs us about our new map\n");
+		if (worker_try_slotmap(worker) == 0)
+			worker_send_atr(worker);
+	}
+
+	/* someone else's card doesn't make our own failure any less permanent */
+	if ((cmds & BW_CMD_CARD_EVENT) && worker->state == BW_ST_CONN_CLIENT_MAPPED)
+		worker_retry_open_card(worker, false);
+
+	return 0;
+}
+
+/* handle one message from our mailbox, passed on by the owner of our client connection */
+static int worker_rx_mbox(struct bankd_worker *worker)
+{
+	struct bankd_mbox_msg *msg;
+	RsproPDU_t *pdu;
+	int rc = 0;
+
+	msg = worker_mbox_get(worker);
+
+	/* commands first, so we don't serve a client slot that is no longer mapped */
+	rc = worker_handle_cmds(worker, worker_take_cmds(worker));
+	if (rc < 0 || !msg) {
+		free(msg);
+		return rc;
+	}
+
+	switch (msg->type) {
+	case BW_MBOX_RSPRO:
+		pdu = rspro_dec_buf(msg->data, msg->len);
+		if (!pdu) {
+			LOGW(worker, "Error during decode of RSPRO\n");
+			rc = -7;
+			break;
+		}
+		rc = worker_handle_rspro(worker, pdu);
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+		if (rc < 0)
+			LOGW(worker, "Error handling RSPRO\n");
+		break;
+	case BW_MBOX_DETACH:
+		LOGW(worker, "Client connection is gone\n");
+		rc = -24;
+		break;
+	default:
+		break;
+	}
+
+	free(msg);
+	return rc;
 }
 
 /* body of the main transceive loop */
 static int worker_transceive_loop(struct bankd_worker *worker)
 {
+	struct bankd_client_conn *conn = worker->client.conn;
+	const bool owner = worker_is_owner(worker);
 	struct ipaccess_head *hh;
 	struct ipaccess_head_ext *hh_ext;
 	uint8_t buf[65536]; /* maximum length expressed in 16bit length field */
-	asn_dec_rval_t rval;
-	int data_len, rc;
-	RsproPDU_t *pdu = NULL;
+	/* our mailbox, and for the owner the connection, from which all others get their messages */
+	struct pollfd pfd[2] = {
+		{ .fd = worker->mbox.fd, .events = POLLIN },
+		{ .fd = owner ? conn->fd : -1, .events = POLLIN },
+	};
+	int data_len, timeout_ms, rc;
 
 restart_wait:
-	rc = wait_for_fd_or_timeout(worker->client.fd, worker->timeout);
-	if (rc == -1 && errno == EINTR) {
-		if (worker->state == BW_ST_CONN_CLIENT_UNMAPPED)
-			return -23;
-		else
-			worker_try_slotmap(worker);
+	timeout_ms = worker->timeout ? worker->timeout : -1;
+	if (worker->reset.pending) {
+		uint64_t now = monotonic_ms();
+		timeout_ms = now < worker->reset.deadline_ms ? worker->reset.deadline_ms - now : 0;
+	}
+	rc = poll(pfd, ARRAY_SIZE(pfd), timeout_ms);
+	if (rc == -1 && errno == EINTR)
 		goto restart_wait;
-	} else if (rc < 0)
+	else if (rc < 0)
 		return rc;
 	else if (rc == 0) {
 		/* TIMEOUT case */
-		switch (worker->state) {
-		case BW_ST_CONN_CLIENT_WAIT_MAP:
-			/* re-check if mapping exists meanwhile? */
-			rc = worker_try_slotmap(worker);
-			break;
-		case BW_ST_CONN_CLIENT_MAPPED:
-			/* re-check if reader/card can be opened meanwhile? */
-			rc = worker_open_card(worker);
-			break;
-		default:
-			OSMO_ASSERT(0);
+		if (worker->reset.pending) {
+			/* a failed reset shows in the next command to the card */
+			worker_flush_reset(worker);
+			return 0;
 		}
-		if (rc == 0)
-			worker_send_atr(worker);
-		/* return early, so we do another select rather than the blocking read below */
+		OSMO_ASSERT(worker->state == BW_ST_CONN_CLIENT_MAPPED);
+		/* re-check if reader/card can be opened meanwhile */
+		worker_retry_open_card(worker, true);
+		/* return early, so we do another poll rather than the blocking read below */
 		return 0;
 	};
 
+	/* messages from other threads first; the connection remains readable */
+	if (pfd[0].revents & POLLIN)
+		return worker_rx_mbox(worker);
+	if (!(pfd[1].revents & (POLLIN | POLLERR | POLLHUP)))
+		return 0;
+
 	/* 1) blocking read of entire IPA message from the socket */
 	rc = blocking_ipa_read(worker, buf, sizeof(buf));
 	if (rc < 0)
-		return rc;
+		goto conn_err;
 	data_len = rc;
 
 	hh = (struct ipaccess_head *) buf;
+	if (g_bankd->capture)
+		rspro_capture_frame(g_bankd->capture, conn->cap_conn_id, RSPRO_CAP_EV_RX,
+				    hh->proto, -1, hh->data, data_len);
 	if (hh->proto != IPAC_PROTO_OSMO && hh->proto != IPAC_PROTO_IPACCESS) {
 		LOGW(worker, "Received unsupported IPA protocol != OSMO: 0x%02x\n", hh->proto);
-		return -4;
+		rc = -4;
+		goto conn_err;
 	}
 
 	if (hh->proto == IPAC_PROTO_IPACCESS) {
+		pthread_mutex_lock(&conn->tx_mutex);
 		switch (hh->data[0]) {
 		case IPAC_MSGT_PING:
-			return ipa_ccm_send_pong(worker->client.fd);
+			rc = ipa_ccm_send_pong(conn->fd);
+			break;
 		case IPAC_MSGT_ID_ACK:
-			return ipa_ccm_send_id_ack(g_worker->client.fd);
+			rc = ipa_ccm_send_id_ack(conn->fd);
+			break;
 		default:
 			LOGW(worker, "IPA CCM 0x%02x not implemented yet\n", hh->data[0]);
+			rc = 0;
 			break;
 		}
-		return 0;
+		pthread_mutex_unlock(&conn->tx_mutex);
+		return rc;
 	}
 
 	hh_ext = (struct ipaccess_head_ext *) buf + sizeof(*hh);
 	if (data_len < sizeof(*hh_ext)) {
 		LOGW(worker, "Received short message\n");
-		return -5;
+		rc = -5;
+		goto conn_err;
 	}
 	data_len -= sizeof(*hh_ext);
 	if (hh_ext->proto != IPAC_PROTO_EXT_RSPRO) {
 		LOGW(worker, "Received unsupported IPA EXT protocol != RSPRO: 0x%02x\n", hh_ext->proto);
-		return -6;
+		rc = -6;
+		goto conn_err;
 	}
 
-	/* 2) ASN1 BER decode of the message */
-	rval = ber_decode(NULL, &asn_DEF_RsproPDU, (void **) &pdu, hh_ext->data, data_len);
-	if (rval.code != RC_OK) {
-		LOGW(worker, "Error during BER decode of RSPRO\n");
-		return -7;
-	}
+	/* 2) decode of the message (BER, or binary TPDU if negotiated) and handling by us or
+	 * the worker serving its client slot */
+	return worker_dispatch_rspro(worker, hh_ext->data, data_len);
 
-	/* 3) handling of the message, possibly resulting in PCSC commands */
-	rc = worker_handle_rspro(worker, pdu);
-	ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
-	if (rc < 0) {
-		LOGW(worker, "Error handling RSPRO\n");
-		return rc;
-	}
-
-	/* everything OK if we reach here */
-	return 0;
+conn_err:
+	client_conn_set_dead(conn);
+	return rc;
 }
 
 /* obtain an ascii representation of the client IP/port */
-static int worker_client_addrstr(char *out, unsigned int outlen, const struct bankd_worker *worker)
+static int client_conn_addrstr(char *out, unsigned int outlen, const struct bankd_client_conn *conn)
 {
 	char hostbuf[32], portbuf[32];
 	int rc;
 
-	rc = getnameinfo((const struct sockaddr *)&worker->client.peer_addr,
-			 worker->client.peer_addr_len, hostbuf, sizeof(hostbuf),
+	if (conn->seqpacket) {
+		snprintf(out, outlen, "local");
+		return 0;
+	}
+
+	rc = getnameinfo((const struct sockaddr *)&conn->peer_addr,
+			 conn->peer_addr_len, hostbuf, sizeof(hostbuf),
 			 portbuf, sizeof(portbuf), NI_NUMERICHOST | NI_NUMERICSERV);
 	if (rc != 0) {
 		out[0] = '\0';
@@ -1016,6 +1704,83 @@ static int worker_client_addrstr(char *out, unsigned int outlen, const struct ba
 	return 0;
 }
 
+/* wait until we either accept a new client connection, or the owner of an existing one
+ * attaches us to it for a further client slot */
+static int worker_wait_conn(struct bankd_worker *worker)
+{
+	/* poll() ignores the negative fd if we don't have a UNIX domain socket */
+	struct pollfd pfd[3] = {
+		{ .fd = worker->bankd->accept_fd, .events = POLLIN },
+		{ .fd = worker->mbox.fd, .events = POLLIN },
+		{ .fd = worker->bankd->unix_accept_fd, .events = POLLIN },
+	};
+	struct bankd_client_conn *conn = NULL;
+	struct bankd_mbox_msg *msg;
+	char buf[128];
+	int listen_fd, fd, rc;
+
+	rc = poll(pfd, ARRAY_SIZE(pfd), -1);
+	if (rc < 0)
+		return -errno;
+
+	if (pfd[1].revents & POLLIN) {
+		msg = worker_mbox_get(worker);
+		/* commands refer to the client slot we served before, if any */
+		if (worker_take_cmds(worker) & BW_CMD_TALLOC_REPORT)
+			worker_talloc_report(worker);
+		if (!msg)
+			return -EAGAIN;
+		/* anything else is left over from a connection we have already left */
+		rc = msg->type == BW_MBOX_ATTACH ? 0 : -EAGAIN;
+		free(msg);
+		if (rc == 0) {
+			client_conn_addrstr(buf, sizeof(buf), worker->client.conn);
+			LOGW(worker, "Attached to connection from %s\n", buf);
+		}
+		return rc;
+	}
+	if (pfd[2].revents & POLLIN)
+		listen_fd = pfd[2].fd;
+	else if (pfd[0].revents & POLLIN)
+		listen_fd = pfd[0].fd;
+	else
+		return -EAGAIN;
+
+	pthread_mutex_lock(&g_bankd->workers_mutex);
+	/* the owner of a connection may have attached us meanwhile; we'll find it in the mailbox */
+	if (worker->client.conn) {
+		pthread_mutex_unlock(&g_bankd->workers_mutex);
+		return -EAGAIN;
+	}
+	conn = calloc(1, sizeof(*conn));
+	if (conn) {
+		conn->peer_addr_len = sizeof(conn->peer_addr);
+		fd = accept(listen_fd, (struct sockaddr *) &conn->peer_addr, &conn->peer_addr_len);
+		if (fd >= 0) {
+			conn->fd = fd;
+			conn->seqpacket = (listen_fd == worker->bankd->unix_accept_fd);
+			rspro_sock_tune_apply(fd);
+			conn->owner = worker;
+			conn->refcnt = 1;
+			pthread_mutex_init(&conn->tx_mutex, NULL);
+			worker->client.conn = conn;
+		} else {
+			/* some other idle worker was faster */
+			free(conn);
+			conn = NULL;
+		}
+	}
+	pthread_mutex_unlock(&g_bankd->workers_mutex);
+	if (!conn)
+		return -EAGAIN;
+
+	client_conn_addrstr(buf, sizeof(buf), conn);
+	LOGW(worker, "Accepted connection from %s\n", buf);
+	if (g_bankd->capture)
+		conn->cap_conn_id = rspro_capture_conn_open(g_bankd->capture, buf);
+	return 0;
+}
+
 /* worker thread main function */
 static void *worker_main(void *arg)
 {
@@ -1040,50 +1805,52 @@ static void *worker_main(void *arg)
 
 	g_worker->slot.bank_id = 0xffff;
 	g_worker->slot.slot_nr = 0xffff;
+	bankd_apdu_cache_init(&g_worker->apdu_cache, g_bankd->cfg.apdu_cache ? g_worker->tall_ctx : NULL);
 
 	/* we continuously perform the same loop here, recycling the worker thread
 	 * once the client connection is gone or we have some trouble with the card/reader */
 	while (1) {
-		char buf[128];
-
-		g_worker->client.peer_addr_len = sizeof(g_worker->client.peer_addr);
+		struct bankd_client_conn *conn;
+		bool owner;
 
 		worker_set_state(g_worker, BW_ST_ACCEPTING);
-		/* first wait for an incoming TCP connection */
-		rc = accept(g_worker->bankd->accept_fd, (struct sockaddr *) &g_worker->client.peer_addr,
-			    &g_worker->client.peer_addr_len);
-		if (rc < 0) {
-			continue;
-		}
-		g_worker->client.fd = rc;
-		worker_client_addrstr(buf, sizeof(buf), g_worker);
-		LOGW(g_worker, "Accepted connection from %s\n", buf);
+		/* first wait for an incoming TCP connection (or further client slot on one) */
+		while (worker_wait_conn(g_worker) < 0)
+			;
+		conn = g_worker->client.conn;
+		owner = worker_is_owner(g_worker);
 		worker_set_state(g_worker, BW_ST_CONN_WAIT_ID);
 
 		/* run the main worker transceive loop body until there was some error */
 		while (1) {
 			rc = worker_transceive_loop(g_worker);
-			if (rc < 0)
-				break;
-			if (g_worker->state == BW_ST_CONN_CLIENT_UNMAPPED)
+			if (rc >= 0 && g_worker->state != BW_ST_CONN_CLIENT_UNMAPPED)
+				continue;
+			/* the owner of a connection which the client uses for further slots
+			 * only gives up its own client slot, and continues to read */
+			if (!owner || conn->dead || (rc != -24 && !client_conn_shared(conn)))
 				break;
+			LOGW(g_worker, "Client slot detached (%d), continuing to serve connection\n", rc);
+			if (rc != -24)
+				worker_send_detach(g_worker);
+			worker_reset_slot(g_worker);
+			worker_set_state(g_worker, BW_ST_CONN_WAIT_ID);
 		}
 
 		if (rc == -23)
 			LOGW(g_worker, "Client unmapped: Cleaning up state\n");
+		else if (rc == -24)
+			LOGW(g_worker, "Client slot detached: Cleaning up state\n");
 		else
 			LOGW(g_worker, "Error %d occurred: Cleaning up state\n", rc);
 
 		/* clean-up: reset to sane state */
-		memset(&g_worker->card, 0, sizeof(g_worker->card));
-		g_worker->ops->cleanup(g_worker);
-		if (g_worker->reader.name)
-			g_worker->reader.name = NULL;
-		if (g_worker->client.fd >= 0)
-			close(g_worker->client.fd);
-		memset(&g_worker->client.peer_addr, 0, sizeof(g_worker->client.peer_addr));
-		g_worker->client.fd = -1;
-		g_worker->client.clslot.client_id = g_worker->client.clslot.slot_nr = 0;
+		if (!owner && rc != -24)
+			worker_send_detach(g_worker);
+		worker_reset_slot(g_worker);
+		if (owner)
+			worker_detach_others(g_worker);
+		worker_put_conn(g_worker);
 	}
 
 	pthread_cleanup_pop(1);
@@ -16,6 +16,8 @@
  *
  */
 
+/* for pthread_setname_np() */
+#define _GNU_SOURCE
 
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/talloc.h>
@@ -24,6 +26,10 @@
 #include <csv.h>
 #include <regex.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "bankd.h"
 
@@ -243,9 +249,11 @@ static int pcsc_connect_slot_regex(struct bankd_worker *worker)
 			rc = SCardConnect(worker->reader.pcsc.hContext, p, bankd_share_mode(worker->bankd),
 					  SCARD_PROTOCOL_T0, &worker->reader.pcsc.hCard,
 					  &dwActiveProtocol);
-			if (rc == SCARD_S_SUCCESS)
+			if (rc == SCARD_S_SUCCESS) {
+				if (!worker->reader.sched)
+					worker->reader.sched = bankd_reader_get(worker->bankd, p);
 				result = 0;
-			else {
+			} else {
 				LOGW_PCSC_ERROR(worker, rc, "SCardConnect");
 				goto out_readerfree;
 			}
@@ -339,3 +347,197 @@ const struct bankd_driver_ops pcsc_driver_ops = {
 	.transceive = pcsc_transceive,
 	.cleanup = pcsc_cleanup,
 };
+
+/***********************************************************************
+ * card monitor: wake up workers waiting for a card once one is inserted
+ ***********************************************************************/
+
+/* maximum number of readers we watch; pcsc-lite itself supports only 16 by default */
+#define PCSC_MON_MAX_READERS	64
+/* interval at which we re-list the readers if pcsc-lite lacks reader plug notifications */
+#define PCSC_MON_RELIST_MS	1000
+/* delay before re-trying after pcscd is unavailable */
+#define PCSC_MON_RETRY_SECS	1
+
+/* special reader name, whose state changes whenever a reader is added or removed */
+static const char pnp_reader_name[] = "\\\\?PnP?\\Notification";
+
+struct pcsc_monitor {
+	struct bankd *bankd;
+	SCARDCONTEXT hContext;
+	/* multi-string of reader names, as returned by SCardListReaders() */
+	LPSTR names;
+	/* state of each reader, followed by the PnP pseudo-reader (if supported) */
+	SCARD_READERSTATE rs[PCSC_MON_MAX_READERS + 1];
+	DWORD num_rs;
+	bool pnp;
+};
+
+/* (re-)build the list of readers to watch, keeping the last known state of known readers */
+static void pcsc_mon_list_readers(struct pcsc_monitor *mon)
+{
+	SCARD_READERSTATE old_rs[ARRAY_SIZE(mon->rs)];
+	DWORD old_num_rs = mon->num_rs;
+	DWORD dwReaders = SCARD_AUTOALLOCATE;
+	LPSTR names = NULL;
+	DWORD i;
+	LONG rc;
+	char *p;
+
+	memcpy(old_rs, mon->rs, sizeof(old_rs));
+	mon->num_rs = 0;
+
+	rc = SCardListReaders(mon->hContext, NULL, (LPSTR)&names, &dwReaders);
+	if (rc == SCARD_S_SUCCESS) {
+		for (p = names; *p && mon->num_rs < PCSC_MON_MAX_READERS; p += strlen(p) + 1) {
+			SCARD_READERSTATE *rs = &mon->rs[mon->num_rs++];
+			memset(rs, 0, sizeof(*rs));
+			rs->szReader = p;
+			rs->dwCurrentState = SCARD_STATE_UNAWARE;
+			for (i = 0; i < old_num_rs; i++) {
+				if (!strcmp(old_rs[i].szReader, p)) {
+					rs->dwCurrentState = old_rs[i].dwCurrentState;
+					break;
+				}
+			}
+		}
+	} else if (rc != SCARD_E_NO_READERS_AVAILABLE)
+		LOGP(DMAIN, LOGL_ERROR, "Card monitor: SCardListReaders failed: %s\n", pcsc_stringify_error(rc));
+
+	if (mon->pnp) {
+		SCARD_READERSTATE *rs = &mon->rs[mon->num_rs++];
+		memset(rs, 0, sizeof(*rs));
+		rs->szReader = pnp_reader_name;
+		rs->dwCurrentState = SCARD_STATE_UNAWARE;
+		if (old_num_rs && old_rs[old_num_rs-1].szReader == pnp_reader_name)
+			rs->dwCurrentState = old_rs[old_num_rs-1].dwCurrentState;
+	}
+
+	/* only now, as the old states still point into the old names */
+	if (mon->names)
+		SCardFreeMemory(mon->hContext, mon->names);
+	mon->names = names;
+}
+
+static void pcsc_mon_release(struct pcsc_monitor *mon)
+{
+	if (mon->names)
+		SCardFreeMemory(mon->hContext, mon->names);
+	mon->names = NULL;
+	mon->num_rs = 0;
+	SCardReleaseContext(mon->hContext);
+	mon->hContext = 0;
+}
+
+static void *pcsc_monitor_main(void *arg)
+{
+	struct pcsc_monitor *mon = arg;
+	bool relist = true;
+	DWORD i;
+	LONG rc;
+
+	pthread_setname_np(pthread_self(), "bankd-cardmon");
+
+	while (1) {
+		bool card_event = false;
+
+		if (!mon->hContext) {
+			rc = SCardEstablishContext(SCARD_SCOPE_SYSTEM, NULL, NULL, &mon->hContext);
+			if (rc != SCARD_S_SUCCESS) {
+				mon->hContext = 0;
+				sleep(PCSC_MON_RETRY_SECS);
+				continue;
+			}
+			relist = true;
+		}
+		if (relist) {
+			pcsc_mon_list_readers(mon);
+			relist = false;
+		}
+
+		if (!mon->num_rs) {
+			/* no readers and no PnP notifications: nothing to wait for */
+			usleep(PCSC_MON_RELIST_MS * 1000);
+			relist = true;
+			continue;
+		}
+
+		rc = SCardGetStatusChange(mon->hContext, mon->pnp ? INFINITE : PCSC_MON_RELIST_MS,
+					  mon->rs, mon->num_rs);
+		switch (rc) {
+		case SCARD_S_SUCCESS:
+			break;
+		case SCARD_E_TIMEOUT:
+		case SCARD_E_UNKNOWN_READER:
+			relist = true;
+			continue;
+		case SCARD_E_NO_SERVICE:
+		case SCARD_E_SERVICE_STOPPED:
+		case SCARD_E_INVALID_HANDLE:
+			pcsc_mon_release(mon);
+			sleep(PCSC_MON_RETRY_SECS);
+			continue;
+		default:
+			LOGP(DMAIN, LOGL_ERROR, "Card monitor: SCardGetStatusChange failed: %s\n",
+			     pcsc_stringify_error(rc));
+			sleep(PCSC_MON_RETRY_SECS);
+			relist = true;
+			continue;
+		}
+
+		for (i = 0; i < mon->num_rs; i++) {
+			SCARD_READERSTATE *rs = &mon->rs[i];
+
+			if (!(rs->dwEventState & SCARD_STATE_CHANGED))
+				continue;
+
+			if (rs->szReader == pnp_reader_name) {
+				if (rs->dwEventState & SCARD_STATE_UNKNOWN) {
+					LOGP(DMAIN, LOGL_NOTICE, "Card monitor: no reader plug notifications, "
+					     "polling for readers\n");
+					mon->pnp = false;
+				} else {
+					/* a new reader may come with a card inserted */
+					card_event = true;
+				}
+				relist = true;
+			} else if ((rs->dwEventState & SCARD_STATE_PRESENT) &&
+				   !(rs->dwCurrentState & SCARD_STATE_PRESENT) &&
+				   rs->dwCurrentState != SCARD_STATE_UNAWARE) {
+				LOGP(DMAIN, LOGL_INFO, "Card monitor: card inserted in '%s'\n", rs->szReader);
+				card_event = true;
+			}
+			rs->dwCurrentState = rs->dwEventState & ~SCARD_STATE_CHANGED;
+		}
+
+		if (card_event)
+			bankd_workers_card_event(mon->bankd);
+	}
+
+	return NULL;
+}
+
+/*! Start a thread watching all PC/SC readers; it calls bankd_workers_card_event() whenever a
+ *  card is inserted (or a reader is plugged in). */
+int bankd_pcsc_start_monitor(struct bankd *bankd)
+{
+	struct pcsc_monitor *mon;
+	pthread_t thread;
+	int rc;
+
+	/* owned by the monitor thread, which runs until exit */
+	mon = calloc(1, sizeof(*mon));
+	if (!mon)
+		return -ENOMEM;
+	mon->bankd = bankd;
+	mon->pnp = true;
+
+	rc = pthread_create(&thread, NULL, pcsc_monitor_main, mon);
+	if (rc != 0) {
+		free(mon);
+		return -rc;
+	}
+	pthread_detach(thread);
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Per-reader scheduling of card operations.
+ *
+ * Multi-slot readers (like the sysmoOCTSIM) expose each slot as a PC/SC reader of its own, but
+ * process only one command at a time.  Without coordination, whichever worker thread happens to
+ * win the race inside pcsc-lite / the IFD handler gets the reader next, so a busy slot can starve
+ * the others, and an AUTHENTICATE waits behind arbitrary file reads of other slots.  Hence we
+ * let the workers of all slots of a reader queue for it, and hand it on in FIFO order within
+ * each priority class. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/utils.h>
+
+#include "bankd.h"
+
+/* a worker waiting for its turn on a reader; lives on the stack of the worker */
+struct bankd_sched_req {
+	struct llist_head list;
+	pthread_cond_t cond;
+	bool granted;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* length of the reader part of a pcsc-lite reader name, which is "<name> <reader idx> <slot idx>"
+ * with both indexes being two hex digits */
+static size_t reader_name_len(const char *pcsc_name)
+{
+	size_t len = strlen(pcsc_name);
+
+	if (len > 3 && pcsc_name[len-3] == ' ' &&
+	    isxdigit((unsigned char) pcsc_name[len-2]) && isxdigit((unsigned char) pcsc_name[len-1]))
+		return len - 3;
+
+	return len;
+}
+
+/*! Look up (or create) the physical reader of a PC/SC slot and register a user of it.
+ *  \param[in] pcsc_name full PC/SC name of the slot
+ *  \returns reader; NULL if out of memory (card operations then simply aren't scheduled) */
+struct bankd_reader *bankd_reader_get(struct bankd *bankd, const char *pcsc_name)
+{
+	size_t len = reader_name_len(pcsc_name);
+	struct bankd_reader *reader;
+	unsigned int i;
+
+	pthread_mutex_lock(&bankd->readers_mutex);
+	llist_for_each_entry(reader, &bankd->readers, list) {
+		if (strlen(reader->name) == len && !strncmp(reader->name, pcsc_name, len))
+			goto found;
+	}
+
+	/* readers are shared between threads and kept until exit, so they are allocated
+	 * outside of talloc (which isn't thread-safe) */
+	reader = calloc(1, sizeof(*reader));
+	if (!reader)
+		goto out;
+	reader->name = strndup(pcsc_name, len);
+	if (!reader->name) {
+		free(reader);
+		reader = NULL;
+		goto out;
+	}
+	pthread_mutex_init(&reader->mutex, NULL);
+	for (i = 0; i < ARRAY_SIZE(reader->queue); i++)
+		INIT_LLIST_HEAD(&reader->queue[i]);
+	reader->stats.last_report_ns = now_ns();
+	llist_add_tail(&reader->list, &bankd->readers);
+	LOGP(DMAIN, LOGL_INFO, "Scheduling card operations of reader '%s'\n", reader->name);
+
+found:
+	reader->num_workers++;
+out:
+	pthread_mutex_unlock(&bankd->readers_mutex);
+	return reader;
+}
+
+/*! Unregister a user of the reader, obtained by bankd_reader_get() */
+void bankd_reader_put(struct bankd *bankd, struct bankd_reader *reader)
+{
+	if (!reader)
+		return;
+
+	pthread_mutex_lock(&bankd->readers_mutex);
+	OSMO_ASSERT(reader->num_workers > 0);
+	reader->num_workers--;
+	pthread_mutex_unlock(&bankd->readers_mutex);
+}
+
+/*! Wait until it is the turn of the calling worker to perform a card operation on the reader.
+ *  Must be followed by bankd_reader_release() once the card operation has completed. */
+void bankd_reader_acquire(struct bankd_reader *reader, enum bankd_sched_prio prio)
+{
+	struct bankd_sched_req req = {
+		.granted = false,
+	};
+	uint64_t t_start;
+
+	if (!reader)
+		return;
+
+	OSMO_ASSERT(prio < _NUM_BANKD_SCHED_PRIO);
+
+	pthread_mutex_lock(&reader->mutex);
+	t_start = now_ns();
+	if (reader->busy) {
+		pthread_cond_init(&req.cond, NULL);
+		llist_add_tail(&req.list, &reader->queue[prio]);
+		reader->stats.queue_depth++;
+		if (reader->stats.queue_depth > reader->stats.queue_depth_max)
+			reader->stats.queue_depth_max = reader->stats.queue_depth;
+		/* bankd_reader_release() hands the reader over to us, it never becomes idle in
+		 * between; so there's nobody to overtake us once we are woken up */
+		while (!req.granted)
+			pthread_cond_wait(&req.cond, &reader->mutex);
+		pthread_cond_destroy(&req.cond);
+	}
+	reader->busy = true;
+	reader->busy_since_ns = now_ns();
+	reader->stats.wait_ns += reader->busy_since_ns - t_start;
+	pthread_mutex_unlock(&reader->mutex);
+}
+
+/*! Finish the card operation started after bankd_reader_acquire() and pass the reader on. */
+void bankd_reader_release(struct bankd_reader *reader)
+{
+	struct bankd_sched_req *req;
+	unsigned int i;
+
+	if (!reader)
+		return;
+
+	pthread_mutex_lock(&reader->mutex);
+	OSMO_ASSERT(reader->busy);
+	reader->stats.busy_ns += now_ns() - reader->busy_since_ns;
+	reader->stats.num_ops++;
+
+	for (i = 0; i < ARRAY_SIZE(reader->queue); i++) {
+		req = llist_first_entry_or_null(&reader->queue[i], struct bankd_sched_req, list);
+		if (req)
+			break;
+	}
+	if (req) {
+		llist_del(&req->list);
+		reader->stats.queue_depth--;
+		req->granted = true;
+		pthread_cond_signal(&req->cond);
+	} else
+		reader->busy = false;
+	pthread_mutex_unlock(&reader->mutex);
+}
+
+/*! Determine the priority class of a command APDU/TPDU sent to the card */
+enum bankd_sched_prio bankd_sched_apdu_prio(const uint8_t *apdu, size_t apdu_len)
+{
+	/* AUTHENTICATE (3GPP TS 31.102) / RUN GSM ALGORITHM (3GPP TS 51.011) */
+	if (apdu_len >= 2 && apdu[1] == 0x88)
+		return BANKD_SCHED_PRIO_AUTH;
+
+	return BANKD_SCHED_PRIO_NORMAL;
+}
+
+/*! Print per-reader scheduling statistics; utilization is computed over the interval since
+ *  the previous call. */
+void bankd_readers_report(struct bankd *bankd, FILE *out)
+{
+	struct bankd_reader *reader;
+
+	pthread_mutex_lock(&bankd->readers_mutex);
+	llist_for_each_entry(reader, &bankd->readers, list) {
+		unsigned int num_workers = reader->num_workers;
+		uint64_t now, busy_ns, interval_ns;
+		unsigned int util_permille = 0;
+
+		pthread_mutex_lock(&reader->mutex);
+		now = now_ns();
+		busy_ns = reader->stats.busy_ns;
+		if (reader->busy)
+			busy_ns += now - reader->busy_since_ns;
+		interval_ns = now - reader->stats.last_report_ns;
+		if (interval_ns)
+			util_permille = ((busy_ns - reader->stats.last_busy_ns) * 1000) / interval_ns;
+
+		fprintf(out, "reader '%s': slots=%u queue=%u (max %u) ops=%" PRIu64
+			" util=%u.%u%% avg_wait=%" PRIu64 "us\n", reader->name, num_workers,
+			reader->stats.queue_depth, reader->stats.queue_depth_max, reader->stats.num_ops,
+			util_permille / 10, util_permille % 10,
+			reader->stats.num_ops ? reader->stats.wait_ns / reader->stats.num_ops / 1000 : 0);
+
+		reader->stats.last_busy_ns = busy_ns;
+		reader->stats.last_report_ns = now;
+		pthread_mutex_unlock(&reader->mutex);
+	}
+	pthread_mutex_unlock(&bankd->readers_mutex);
+}
@@ -2,6 +2,7 @@
 
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/fsm.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/rspro/RsproPDU.h>
 
 #include "rspro_util.h"
@@ -35,11 +36,6 @@ struct frontend_pts {
 	size_t len;
 };
 
-struct frontend_tpdu {
-	const uint8_t *buf;
-	size_t len;
-};
-
 /* API from generic core to frontend (modem/cardem) */
 int frontend_request_card_insert(struct bankd_client *bc);
 int frontend_request_card_remove(struct bankd_client *bc);
@@ -67,6 +63,8 @@ struct client_config {
 	bool keep_running;
 
 	char *event_script;
+	/* long-lived process receiving all events as JSON lines on stdin */
+	char *event_hook;
 
 	struct {
 		uint8_t data[ATR_SIZE_MAX];
@@ -91,6 +89,11 @@ struct client_config {
 		/* allow to define sim presence pin behaviour */
 		bool presence_valid;
 		bool presence_pol;
+		/* number of IN URBs submitted initially / at most */
+		unsigned int num_in_urbs;
+		unsigned int max_in_urbs;
+		/* number of IRQ URBs */
+		unsigned int num_irq_urbs;
 	} simtrace;
 };
 
@@ -106,10 +109,22 @@ struct bankd_client {
 	struct app_comp_id peer_comp_id;
 
 	struct bank_slot bankd_slot;
+	/* header of binary tpduModemToCard, pre-built for the current slot mapping */
+	struct rspro_tpdu_hdr tpdu_hdr;
 
 	struct client_config *cfg;
 	struct osmo_st2_cardem_inst *cardem;
+	/* physical status as last reported by the frontend */
 	struct frontend_phys_status last_status;
+	/* clientSlotStatusInd towards bankd */
+	struct {
+		/* status last sent to bankd */
+		struct frontend_phys_status sent;
+		bool sent_valid;
+		/* a change of last_status is waiting for the hold-off period to expire */
+		bool pending;
+		struct osmo_timer_list holdoff_timer;
+	} status_ind;
 	void *data;
 };
 
@@ -121,7 +136,12 @@ struct bankd_client *remsim_client_create(void *ctx, const char *name, const cha
 					  struct client_config *cfg);
 void remsim_client_set_clslot(struct bankd_client *bc, int client_id, int slot_nr);
 
+/* event_hook.c */
+int event_hook_send(const char *cmd, char **env);
+
 extern int client_user_main(struct bankd_client *g_client);
+/* only implemented by frontends which can serve several clients in one process */
+extern int client_user_main_multi(struct bankd_client **bcs, unsigned int num_bcs);
 
 
 /***********************************************************************
@@ -136,15 +156,17 @@ enum main_fsm_event {
 
 	MF_E_BANKD_CONNECTED,	/* connection to bankd established (TCP + RSPRO level) */
 	MF_E_BANKD_LOST,	/* connection to bankd was lost */
-	MF_E_BANKD_TPDU,	/* RsproPDUchoice_PR_tpduCardToModem */
 	MF_E_BANKD_ATR,		/* RsproPDUchoice_PR_setAtrReq */
 	MF_E_BANKD_SLOT_STATUS,	/* bankSlotStatusInd */
 
 	MF_E_MDM_STATUS_IND,	/* status from modem/cardem */
 	MF_E_MDM_PTS_IND,	/* PTS indication from modem/cardem */
-	MF_E_MDM_TPDU,		/* TPDU from modem/cardem */
 };
 struct osmo_fsm_inst *main_fsm_alloc(void *ctx, struct bankd_client *bc);
 
+/* data plane fast path, bypassing FSM event dispatch */
+int main_fsm_tx_tpdu(struct bankd_client *bc, const uint8_t *buf, size_t len);
+int main_fsm_rx_tpdu(struct bankd_client *bc, const uint8_t *buf, size_t len);
+
 
 
@@ -0,0 +1,358 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Long-lived event hook.  Rather than fork+exec'ing the event script for every single event,
+ * one hook process is started, and each event is written to its stdin as one line of JSON.
+ *
+ * Events which couldn't be written yet (as the hook doesn't keep up) are coalesced: a newer
+ * event of the same cause for the same client slot replaces the queued one, as only the latest
+ * state is of interest. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/exec.h>
+
+#include "client.h"
+#include "debug.h"
+
+extern char **environ;
+
+/* upper bound on the number of events waiting to be written to the hook */
+#define EVENT_HOOK_MAX_QUEUED	64
+/* minimum interval between (re)starts of the hook process */
+#define EVENT_HOOK_RESTART_S	1
+
+struct hook_event {
+	struct llist_head list;
+	/* queued events of equal key replace each other */
+	char *key;
+	/* JSON object, including the terminating newline */
+	char *line;
+	size_t len;
+	/* number of bytes of 'line' already written */
+	size_t written;
+};
+
+/* the hook is shared by all client slots of the process */
+static struct {
+	void *ctx;
+	char *cmd;
+	/* write end of the pipe to the stdin of the hook; -1 if not running */
+	struct osmo_fd ofd;
+	pid_t pid;
+	struct timespec last_start;
+	struct osmo_timer_list restart_timer;
+
+	struct llist_head queue;
+	unsigned int num_queued;
+
+	struct {
+		unsigned long coalesced;
+		unsigned long dropped;
+	} stats;
+} g_hook;
+
+static void hook_flush(void);
+static void hook_schedule_start(void);
+
+/* append 'str' to 'buf' as JSON string */
+static char *json_append_str(char *buf, const char *str)
+{
+	const char *run = str;
+	const char *c;
+
+	buf = talloc_strdup_append_buffer(buf, "\"");
+	for (c = str; buf && *c; c++) {
+		if (*c != '"' && *c != '\\' && (unsigned char) *c >= 0x20)
+			continue;
+		buf = talloc_strndup_append_buffer(buf, run, c - run);
+		if (buf)
+			buf = talloc_asprintf_append_buffer(buf, "\\u%04x", (unsigned char) *c);
+		run = c + 1;
+	}
+	if (buf)
+		buf = talloc_strdup_append_buffer(buf, run);
+	if (buf)
+		buf = talloc_strdup_append_buffer(buf, "\"");
+	return buf;
+}
+
+/* convert the script environment to a JSON object: REMSIM_FOO_BAR=x becomes "foo_bar":"x" */
+static char *env2json(void *ctx, char **env)
+{
+	char *buf = talloc_strdup(ctx, "{");
+	char name[64];
+	bool first = true;
+	unsigned int i, j;
+
+	for (i = 0; buf && env[i]; i++) {
+		const char *var = env[i];
+		const char *eq = strchr(var, '=');
+
+		if (!eq)
+			continue;
+		if (!strncmp(var, "REMSIM_", 7))
+			var += 7;
+		for (j = 0; j < sizeof(name) - 1 && var + j < eq; j++)
+			name[j] = tolower((unsigned char) var[j]);
+		name[j] = '\0';
+
+		if (!first)
+			buf = talloc_strdup_append_buffer(buf, ",");
+		first = false;
+		if (buf)
+			buf = json_append_str(buf, name);
+		if (buf)
+			buf = talloc_strdup_append_buffer(buf, ":");
+		if (buf)
+			buf = json_append_str(buf, eq + 1);
+	}
+	if (buf)
+		buf = talloc_strdup_append_buffer(buf, "}\n");
+	return buf;
+}
+
+static const char *env_get(char **env, const char *name)
+{
+	size_t len = strlen(name);
+	unsigned int i;
+
+	for (i = 0; env[i]; i++) {
+		if (!strncmp(env[i], name, len) && env[i][len] == '=')
+			return env[i] + len + 1;
+	}
+	return "";
+}
+
+static void hook_event_free(struct hook_event *ev)
+{
+	llist_del(&ev->list);
+	g_hook.num_queued--;
+	talloc_free(ev);
+}
+
+static void hook_stop(void)
+{
+	struct hook_event *ev;
+
+	osmo_fd_unregister(&g_hook.ofd);
+	close(g_hook.ofd.fd);
+	g_hook.ofd.fd = -1;
+	/* in case it is still alive but no longer reading; it's reaped via SA_NOCLDWAIT */
+	kill(g_hook.pid, SIGTERM);
+
+	/* a new hook process shall receive the entire line */
+	ev = llist_first_entry_or_null(&g_hook.queue, struct hook_event, list);
+	if (ev)
+		ev->written = 0;
+}
+
+static int hook_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	if (what & OSMO_FD_WRITE)
+		hook_flush();
+	return 0;
+}
+
+static int hook_start(void)
+{
+	int fds[2];
+	pid_t pid;
+	int rc;
+
+	clock_gettime(CLOCK_MONOTONIC, &g_hook.last_start);
+
+	rc = pipe(fds);
+	if (rc < 0) {
+		LOGP(DMAIN, LOGL_ERROR, "Cannot create pipe to event hook: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		LOGP(DMAIN, LOGL_ERROR, "Cannot fork event hook: %s\n", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		return -errno;
+	} else if (pid == 0) {
+		char *new_env[256];
+
+		/* child: events on stdin, environment as for the event script */
+		dup2(fds[0], 0);
+		osmo_close_all_fds_above(2);
+		rc = osmo_environment_filter(new_env, ARRAY_SIZE(new_env), environ,
+					     osmo_environment_whitelist);
+		if (rc < 0)
+			exit(1);
+		execle("/bin/sh", "sh", "-c", g_hook.cmd, (char *) NULL, new_env);
+		exit(1);
+	}
+
+	close(fds[0]);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+	g_hook.pid = pid;
+	osmo_fd_setup(&g_hook.ofd, fds[1], 0, hook_fd_cb, NULL, 0);
+	rc = osmo_fd_register(&g_hook.ofd);
+	if (rc < 0) {
+		close(fds[1]);
+		g_hook.ofd.fd = -1;
+		kill(pid, SIGTERM);
+		return rc;
+	}
+
+	LOGP(DMAIN, LOGL_INFO, "Started event hook '%s' (pid %d)\n", g_hook.cmd, (int) pid);
+	return 0;
+}
+
+static void hook_restart_timer_cb(void *data)
+{
+	if (hook_start() < 0) {
+		hook_schedule_start();
+		return;
+	}
+	hook_flush();
+}
+
+/* (re)start the hook process, but not more often than every EVENT_HOOK_RESTART_S */
+static void hook_schedule_start(void)
+{
+	struct timespec now;
+	long elapsed_ms;
+
+	if (osmo_timer_pending(&g_hook.restart_timer))
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed_ms = (now.tv_sec - g_hook.last_start.tv_sec) * 1000 +
+		     (now.tv_nsec - g_hook.last_start.tv_nsec) / 1000000;
+	if (g_hook.last_start.tv_sec == 0 || elapsed_ms >= EVENT_HOOK_RESTART_S * 1000) {
+		hook_restart_timer_cb(NULL);
+		return;
+	}
+
+	elapsed_ms = EVENT_HOOK_RESTART_S * 1000 - elapsed_ms;
+	osmo_timer_schedule(&g_hook.restart_timer, elapsed_ms / 1000, (elapsed_ms % 1000) * 1000);
+}
+
+/* write as many queued events to the hook as it accepts without blocking */
+static void hook_flush(void)
+{
+	struct hook_event *ev;
+	ssize_t rc;
+
+	if (g_hook.ofd.fd < 0)
+		return;
+
+	while ((ev = llist_first_entry_or_null(&g_hook.queue, struct hook_event, list))) {
+		rc = write(g_hook.ofd.fd, ev->line + ev->written, ev->len - ev->written);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				/* hook doesn't keep up; continue once it has read some */
+				g_hook.ofd.when |= OSMO_FD_WRITE;
+				return;
+			}
+			LOGP(DMAIN, LOGL_ERROR, "Cannot write to event hook (%s); restarting it\n",
+			     strerror(errno));
+			hook_stop();
+			hook_schedule_start();
+			return;
+		}
+		ev->written += rc;
+		if (ev->written == ev->len)
+			hook_event_free(ev);
+	}
+	g_hook.ofd.when &= ~OSMO_FD_WRITE;
+}
+
+/*! Report an event to the long-lived event hook, starting it if required.
+ *  \param[in] cmd shell command of the hook
+ *  \param[in] env NULL-terminated environment as built for the event script
+ *  \returns 0 on success; negative on error */
+int event_hook_send(const char *cmd, char **env)
+{
+	struct hook_event *ev, *ev2;
+
+	if (!g_hook.ctx) {
+		g_hook.ctx = talloc_named_const(OTC_GLOBAL, 0, "event_hook");
+		g_hook.cmd = talloc_strdup(g_hook.ctx, cmd);
+		if (!g_hook.cmd)
+			return -ENOMEM;
+		g_hook.ofd.fd = -1;
+		INIT_LLIST_HEAD(&g_hook.queue);
+		osmo_timer_setup(&g_hook.restart_timer, hook_restart_timer_cb, NULL);
+		/* we'd rather learn about a dead hook from write() */
+		signal(SIGPIPE, SIG_IGN);
+	}
+
+	ev = talloc_zero(g_hook.ctx, struct hook_event);
+	if (!ev)
+		return -ENOMEM;
+	ev->key = talloc_asprintf(ev, "%s %s", env_get(env, "REMSIM_CLIENT_SLOT"),
+				  env_get(env, "REMSIM_CAUSE"));
+	ev->line = env2json(ev, env);
+	if (!ev->key || !ev->line) {
+		talloc_free(ev);
+		return -ENOMEM;
+	}
+	ev->len = strlen(ev->line);
+
+	/* coalesce with a queued event of the same kind, unless it's partially written: the new one
+	 * replaces it, but goes to the end of the queue to keep the order relative to other kinds */
+	llist_for_each_entry(ev2, &g_hook.queue, list) {
+		if (ev2->written || strcmp(ev2->key, ev->key))
+			continue;
+		hook_event_free(ev2);
+		g_hook.stats.coalesced++;
+		break;
+	}
+
+	if (g_hook.num_queued >= EVENT_HOOK_MAX_QUEUED) {
+		/* the latest state is of more interest than the oldest one */
+		llist_for_each_entry(ev2, &g_hook.queue, list) {
+			if (ev2->written)
+				continue;
+			LOGP(DMAIN, LOGL_NOTICE, "Event hook doesn't keep up; dropping event\n");
+			hook_event_free(ev2);
+			g_hook.stats.dropped++;
+			break;
+		}
+	}
+	llist_add_tail(&ev->list, &g_hook.queue);
+	g_hook.num_queued++;
+
+	if (g_hook.ofd.fd < 0)
+		hook_schedule_start();
+	else
+		hook_flush();
+	return 0;
+}
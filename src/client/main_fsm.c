@@ -25,6 +25,7 @@
 #include <osmocom/core/utils.h>
 #include <osmocom/core/fsm.h>
 #include <osmocom/core/exec.h>
+#include <osmocom/core/timer.h>
 
 #include "rspro_util.h"
 #include "client.h"
@@ -83,28 +84,135 @@ static char **build_script_env(struct bankd_client *bc, const char *cause)
 static int call_script(struct bankd_client *bc, const char *cause)
 {
 	char **env, *cmd;
-	int rc;
+	int rc = 0;
 
-	if (!bc->cfg->event_script)
+	if (!bc->cfg->event_script && !bc->cfg->event_hook)
 		return 0;
 
 	env = build_script_env(bc, cause);
 	if (!env)
 		return -ENOMEM;
 
-	cmd = talloc_asprintf(env, "%s %s", bc->cfg->event_script, cause);
-	if (!cmd) {
-		talloc_free(env);
-		return -ENOMEM;
-	}
+	/* no fork+exec per event: stream it to the long-lived hook */
+	if (bc->cfg->event_hook)
+		rc = event_hook_send(bc->cfg->event_hook, env);
 
-	rc = osmo_system_nowait(cmd, osmo_environment_whitelist, env);
+	if (bc->cfg->event_script) {
+		cmd = talloc_asprintf(env, "%s %s", bc->cfg->event_script, cause);
+		if (!cmd) {
+			talloc_free(env);
+			return -ENOMEM;
+		}
+		rc = osmo_system_nowait(cmd, osmo_environment_whitelist, env);
+	}
 	talloc_free(env);
 
 	return rc;
 }
 
 
+/***********************************************************************
+ * clientSlotStatusInd towards bankd
+ ***********************************************************************/
+
+/* Some frontends (e.g. SIMtrace2) report the physical status at a high rate, mostly without any
+ * change.  Hence we only send changes to bankd, and those which don't make bankd reset the card
+ * at most once every STATUS_IND_HOLDOFF_MS; further changes within that period are coalesced. */
+#define STATUS_IND_HOLDOFF_MS	100
+
+/* frontends may report any non-zero value as 'active' */
+static int flag_norm(int flag)
+{
+	return flag < 0 ? -1 : !!flag;
+}
+
+static bool phys_flags_equal(const struct frontend_phys_status *a, const struct frontend_phys_status *b)
+{
+	return flag_norm(a->flags.reset_active) == flag_norm(b->flags.reset_active) &&
+	       flag_norm(a->flags.vcc_present) == flag_norm(b->flags.vcc_present) &&
+	       flag_norm(a->flags.clk_active) == flag_norm(b->flags.clk_active) &&
+	       flag_norm(a->flags.card_present) == flag_norm(b->flags.card_present);
+}
+
+/* does the change make bankd reset the card (rising edge on RST or falling edge on VCC)? */
+static bool phys_status_is_reset_edge(const struct frontend_phys_status *old,
+				      const struct frontend_phys_status *new)
+{
+	return (flag_norm(new->flags.reset_active) == 1 && flag_norm(old->flags.reset_active) != 1) ||
+	       (flag_norm(new->flags.vcc_present) == 0 && flag_norm(old->flags.vcc_present) != 0);
+}
+
+static void status_ind_tx(struct bankd_client *bc, const struct frontend_phys_status *pstatus)
+{
+	BankSlot_t bslot;
+	RsproPDU_t *pdu;
+
+	LOGPFSML(bc->main_fi, LOGL_DEBUG, "Tx clientSlotStatusInd(reset_act=%d, vcc_act=%d, clk_act=%d, "
+		 "card_pres=%d)\n", pstatus->flags.reset_active, pstatus->flags.vcc_present,
+		 pstatus->flags.clk_active, pstatus->flags.card_present);
+	bank_slot2rspro(&bslot, &bc->bankd_slot);
+	pdu = rspro_gen_ClientSlotStatusInd(bc->srv_conn.clslot, &bslot,
+					    pstatus->flags.reset_active,
+					    pstatus->flags.vcc_present,
+					    pstatus->flags.clk_active,
+					    pstatus->flags.card_present);
+	server_conn_send_rspro(&bc->bankd_conn, pdu);
+
+	bc->status_ind.sent = *pstatus;
+	bc->status_ind.sent_valid = true;
+	bc->status_ind.pending = false;
+	osmo_timer_schedule(&bc->status_ind.holdoff_timer, 0, STATUS_IND_HOLDOFF_MS * 1000);
+}
+
+static void status_ind_holdoff_cb(void *data)
+{
+	struct bankd_client *bc = data;
+
+	/* send the latest state, unless it changed back in the meantime */
+	if (bc->status_ind.pending && !phys_flags_equal(&bc->last_status, &bc->status_ind.sent))
+		status_ind_tx(bc, &bc->last_status);
+	bc->status_ind.pending = false;
+}
+
+/* process a physical status reported by the frontend */
+static void status_ind_update(struct bankd_client *bc, const struct frontend_phys_status *pstatus)
+{
+	bool reset_edge;
+
+	if (bc->status_ind.sent_valid && phys_flags_equal(pstatus, &bc->last_status)) {
+		/* nothing changed; neither bankd nor the script need to know */
+		bc->last_status = *pstatus;
+		return;
+	}
+
+	reset_edge = phys_status_is_reset_edge(&bc->last_status, pstatus);
+	/* bankd must see the state before the edge, or it wouldn't detect the edge */
+	if (reset_edge && bc->status_ind.pending)
+		status_ind_tx(bc, &bc->last_status);
+
+	bc->last_status = *pstatus;
+	call_script(bc, "event-modem-status");
+
+	if (!bc->status_ind.sent_valid || reset_edge ||
+	    !osmo_timer_pending(&bc->status_ind.holdoff_timer))
+		status_ind_tx(bc, pstatus);
+	else {
+		LOGPFSML(bc->main_fi, LOGL_DEBUG, "Delaying clientSlotStatusInd(reset_act=%d, vcc_act=%d, "
+			 "clk_act=%d, card_pres=%d)\n", pstatus->flags.reset_active,
+			 pstatus->flags.vcc_present, pstatus->flags.clk_active, pstatus->flags.card_present);
+		bc->status_ind.pending = true;
+	}
+}
+
+/* (new) connection to bankd: its last known state is unrelated to ours */
+static void status_ind_reset(struct bankd_client *bc)
+{
+	osmo_timer_del(&bc->status_ind.holdoff_timer);
+	bc->status_ind.sent_valid = false;
+	bc->status_ind.pending = false;
+}
+
+
 /***********************************************************************/
 
 
@@ -122,12 +230,10 @@ static const struct value_string main_fsm_event_names[] = {
 	OSMO_VALUE_STRING(MF_E_SRVC_RESET_REQ),
 	OSMO_VALUE_STRING(MF_E_BANKD_CONNECTED),
 	OSMO_VALUE_STRING(MF_E_BANKD_LOST),
-	OSMO_VALUE_STRING(MF_E_BANKD_TPDU),
 	OSMO_VALUE_STRING(MF_E_BANKD_ATR),
 	OSMO_VALUE_STRING(MF_E_BANKD_SLOT_STATUS),
 	OSMO_VALUE_STRING(MF_E_MDM_STATUS_IND),
 	OSMO_VALUE_STRING(MF_E_MDM_PTS_IND),
-	OSMO_VALUE_STRING(MF_E_MDM_TPDU),
 	{ 0, NULL }
 };
 
@@ -192,6 +298,15 @@ static void main_st_operational_onenter(struct osmo_fsm_inst *fi, uint32_t prev_
 	frontend_request_sim_remote(bc);
 	call_script(bc, "request-sim-remote");
 
+	/* Build the header of all our TPDUs once, rather than for each of them */
+	if (bc->srv_conn.clslot) {
+		rspro_tpdu_hdr_init(&bc->tpdu_hdr, RSPRO_BIN_TPDU_M2C, bc->srv_conn.clslot->clientId,
+				    bc->srv_conn.clslot->slotNr, bc->bankd_slot.bank_id,
+				    bc->bankd_slot.slot_nr);
+	}
+
+	status_ind_reset(bc);
+
 	/* Set the ATR */
 	frontend_handle_set_atr(bc, bc->cfg->atr.data, bc->cfg->atr.len);
 
@@ -208,6 +323,8 @@ static void main_st_operational_onleave(struct osmo_fsm_inst *fi, uint32_t next_
 {
 	struct bankd_client *bc = (struct bankd_client *) fi->priv;
 
+	status_ind_reset(bc);
+
 	/* Simulate a card-remval to modem */
 	frontend_request_card_remove(bc);
 	call_script(bc, "request-card-remove");
@@ -226,11 +343,10 @@ static void main_st_operational(struct osmo_fsm_inst *fi, uint32_t event, void *
 	struct bankd_client *bc = (struct bankd_client *) fi->priv;
 	struct frontend_phys_status *pstatus = NULL;
 	struct frontend_pts *pts = NULL;
-	struct frontend_tpdu *tpdu = NULL;
 	RsproPDU_t *pdu_rx = NULL;
 	RsproPDU_t *resp;
-	BankSlot_t bslot;
 	SlotPhysStatus_t *phys_status;
+	char *bankd_path;
 
 	switch (event) {
 	case MF_E_BANKD_LOST:
@@ -245,6 +361,12 @@ static void main_st_operational(struct osmo_fsm_inst *fi, uint32_t event, void *
 		osmo_talloc_replace_string(bc, &bc->bankd_conn.server_host,
 					   rspro_IpAddr2str(&pdu_rx->msg.choice.configClientBankReq.bankd.ip));
 		bc->bankd_conn.server_port = pdu_rx->msg.choice.configClientBankReq.bankd.port;
+		/* a bankd on our host is reached via its UNIX domain socket, if the server tells us */
+		bankd_path = rspro_get_bankd_socket_path(bc, pdu_rx);
+		if (bankd_path) {
+			talloc_free(bc->bankd_conn.server_host);
+			bc->bankd_conn.server_host = bankd_path;
+		}
 		rspro2bank_slot(&bc->bankd_slot, &pdu_rx->msg.choice.configClientBankReq.bankSlot);
 		LOGPFSML(fi, LOGL_INFO, "Rx configClientBankReq(%s:%u / B%u:%u)\n", bc->bankd_conn.server_host,
 			 bc->bankd_conn.server_port, bc->bankd_slot.bank_id, bc->bankd_slot.slot_nr);
@@ -261,18 +383,6 @@ static void main_st_operational(struct osmo_fsm_inst *fi, uint32_t event, void *
 		server_conn_send_rspro(&bc->srv_conn, resp);
 		call_script(bc, "event-config-bankd");
 		break;
-	case MF_E_BANKD_TPDU:
-		pdu_rx = data;
-		OSMO_ASSERT(pdu_rx);
-		OSMO_ASSERT(pdu_rx->msg.present == RsproPDUchoice_PR_tpduCardToModem);
-		LOGPFSML(fi, LOGL_NOTICE, "Rx tpduCardToModem(%s)\n",
-			 osmo_hexdump_nospc(pdu_rx->msg.choice.tpduCardToModem.data.buf,
-					    pdu_rx->msg.choice.tpduCardToModem.data.size));
-		/* forward to modem/cardem (via API) */
-		frontend_handle_card2modem(bc, pdu_rx->msg.choice.tpduCardToModem.data.buf,
-					   pdu_rx->msg.choice.tpduCardToModem.data.size);
-		/* response happens indirectly via tpduModemToCard */
-		break;
 	case MF_E_BANKD_ATR:
 		pdu_rx = data;
 		OSMO_ASSERT(pdu_rx);
@@ -307,20 +417,8 @@ static void main_st_operational(struct osmo_fsm_inst *fi, uint32_t event, void *
 	case MF_E_MDM_STATUS_IND:
 		pstatus = data;
 		OSMO_ASSERT(pstatus);
-		LOGPFSML(fi, LOGL_NOTICE, "Tx clientSlotStatusInd(reset_act=%d, vcc_act=%d, clk_act=%d, "
-			 "card_pres=%d)\n", pstatus->flags.reset_active, pstatus->flags.vcc_present,
-			 pstatus->flags.clk_active, pstatus->flags.card_present);
-		/* forward to bankd */
-		bank_slot2rspro(&bslot, &bc->bankd_slot);
-		resp = rspro_gen_ClientSlotStatusInd(bc->srv_conn.clslot, &bslot,
-						     pstatus->flags.reset_active,
-						     pstatus->flags.vcc_present,
-						     pstatus->flags.clk_active,
-						     pstatus->flags.card_present);
-		server_conn_send_rspro(&bc->bankd_conn, resp);
-		if (!memcmp(&bc->last_status.flags, &pstatus->flags, sizeof(pstatus->flags)))
-			call_script(bc, "event-modem-status");
-		bc->last_status = *pstatus;
+		/* forward changes to bankd */
+		status_ind_update(bc, pstatus);
 		break;
 	case MF_E_MDM_PTS_IND:
 		pts = data;
@@ -328,20 +426,53 @@ static void main_st_operational(struct osmo_fsm_inst *fi, uint32_t event, void *
 		LOGPFSML(fi, LOGL_NOTICE, "PTS Indication (%s)\n", osmo_hexdump_nospc(pts->buf, pts->len));
 		/* forward to bankd? */
 		break;
-	case MF_E_MDM_TPDU:
-		tpdu = data;
-		OSMO_ASSERT(tpdu);
-		LOGPFSML(fi, LOGL_INFO, "Tx tpduModemToCard (%s)\n", osmo_hexdump_nospc(tpdu->buf, tpdu->len));
-		/* forward to bankd */
-		bank_slot2rspro(&bslot, &bc->bankd_slot);
-		resp = rspro_gen_TpduModem2Card(bc->srv_conn.clslot, &bslot, tpdu->buf, tpdu->len);
-		server_conn_send_rspro(&bc->bankd_conn, resp);
-		break;
 	default:
 		OSMO_ASSERT(0);
 	}
 }
 
+/*! Forward a TPDU from the modem/cardem to the bankd.  This is the data plane fast path: it
+ *  doesn't go through FSM event dispatch, and it encodes the TPDU straight into the message
+ *  buffer whenever the bankd supports the binary TPDU encoding. */
+int main_fsm_tx_tpdu(struct bankd_client *bc, const uint8_t *buf, size_t len)
+{
+	struct osmo_fsm_inst *fi = bc->main_fi;
+	RsproPDU_t *pdu;
+	BankSlot_t bslot;
+	int rc;
+
+	if (fi->state != MF_ST_OPERATIONAL || !bc->srv_conn.clslot) {
+		LOGPFSML(fi, LOGL_ERROR, "Cannot send TPDU in state %s\n", osmo_fsm_inst_state_name(fi));
+		return -EPERM;
+	}
+
+	LOGPFSML(fi, LOGL_DEBUG, "Tx tpduModemToCard (%s)\n", osmo_hexdump_nospc(buf, len));
+	rc = server_conn_send_tpdu(&bc->bankd_conn, &bc->tpdu_hdr, buf, len);
+	if (rc != -ENOTSUP)
+		return rc;
+
+	/* bankd only supports BER */
+	bank_slot2rspro(&bslot, &bc->bankd_slot);
+	pdu = rspro_gen_TpduModem2Card(bc->srv_conn.clslot, &bslot, buf, len);
+	return server_conn_send_rspro(&bc->bankd_conn, pdu);
+}
+
+/*! Forward a TPDU received from the bankd to the modem/cardem, bypassing FSM event dispatch. */
+int main_fsm_rx_tpdu(struct bankd_client *bc, const uint8_t *buf, size_t len)
+{
+	struct osmo_fsm_inst *fi = bc->main_fi;
+
+	if (fi->state != MF_ST_OPERATIONAL) {
+		LOGPFSML(fi, LOGL_ERROR, "Ignoring tpduCardToModem in state %s\n",
+			 osmo_fsm_inst_state_name(fi));
+		return -EPERM;
+	}
+
+	LOGPFSML(fi, LOGL_DEBUG, "Rx tpduCardToModem(%s)\n", osmo_hexdump_nospc(buf, len));
+	/* response happens indirectly via tpduModemToCard */
+	return frontend_handle_card2modem(bc, buf, len);
+}
+
 static void main_allstate_action(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
 	switch (event) {
@@ -382,12 +513,10 @@ static const struct osmo_fsm_state main_fsm_states[] = {
 		.name = "OPERATIONAL",
 		.in_event_mask = S(MF_E_SRVC_CONFIG_BANK) |
 				 S(MF_E_BANKD_LOST) |
-				 S(MF_E_BANKD_TPDU) |
 				 S(MF_E_BANKD_ATR) |
 				 S(MF_E_BANKD_SLOT_STATUS) |
 				 S(MF_E_MDM_STATUS_IND) |
-				 S(MF_E_MDM_PTS_IND) |
-				 S(MF_E_MDM_TPDU),
+				 S(MF_E_MDM_PTS_IND),
 		.out_state_mask = S(MF_ST_INIT) | S(MF_ST_UNCONFIGURED) | S(MF_ST_WAIT_BANKD),
 		.action = main_st_operational,
 		.onenter = main_st_operational_onenter,
@@ -395,18 +524,27 @@ static const struct osmo_fsm_state main_fsm_states[] = {
 	},
 };
 
+static void main_fsm_cleanup(struct osmo_fsm_inst *fi, enum osmo_fsm_term_cause cause)
+{
+	struct bankd_client *bc = (struct bankd_client *) fi->priv;
+
+	osmo_timer_del(&bc->status_ind.holdoff_timer);
+}
+
 static struct osmo_fsm client_main_fsm = {
 	.name = "CLIENT_MAIN",
 	.states = main_fsm_states,
 	.num_states = ARRAY_SIZE(main_fsm_states),
 	.allstate_event_mask = S(MF_E_SRVC_LOST) | S(MF_E_SRVC_RESET_REQ),
 	.allstate_action = main_allstate_action,
+	.cleanup = main_fsm_cleanup,
 	.log_subsys = DMAIN,
 	.event_names = main_fsm_event_names,
 };
 
 struct osmo_fsm_inst *main_fsm_alloc(void *ctx, struct bankd_client *bc)
 {
+	osmo_timer_setup(&bc->status_ind.holdoff_timer, status_ind_holdoff_cb, bc);
 	return osmo_fsm_inst_alloc(&client_main_fsm, ctx, bc, LOGL_DEBUG, "main");
 }
 
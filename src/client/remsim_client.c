@@ -59,6 +59,10 @@ struct client_config *client_config_init(void *ctx)
 	cfg->atr.len = 2;
 	cfg->atr_ignore_rspro = false;
 
+	cfg->simtrace.num_in_urbs = 4;
+	cfg->simtrace.max_in_urbs = 16;
+	cfg->simtrace.num_irq_urbs = 1;
+
 	return cfg;
 };
 
@@ -80,7 +84,8 @@ static int bankd_handle_rx(struct rspro_server_conn *bankdc, const RsproPDU_t *p
 		osmo_fsm_inst_dispatch(bankdc->fi, SRVC_E_CLIENT_CONN_RES, (void *) pdu);
 		break;
 	case RsproPDUchoice_PR_tpduCardToModem:
-		return osmo_fsm_inst_dispatch(bc->main_fi, MF_E_BANKD_TPDU, (void *) pdu);
+		return main_fsm_rx_tpdu(bc, pdu->msg.choice.tpduCardToModem.data.buf,
+					pdu->msg.choice.tpduCardToModem.data.size);
 	case RsproPDUchoice_PR_setAtrReq:
 		return osmo_fsm_inst_dispatch(bc->main_fi, MF_E_BANKD_ATR, (void *) pdu);
 	case RsproPDUchoice_PR_bankSlotStatusInd:
@@ -94,6 +99,12 @@ static int bankd_handle_rx(struct rspro_server_conn *bankdc, const RsproPDU_t *p
 	return 0;
 }
 
+/* handle incoming binary-encoded TPDUs from bankd */
+static int bankd_handle_tpdu(struct rspro_server_conn *bankdc, const struct rspro_tpdu_view *tpdu)
+{
+	return main_fsm_rx_tpdu(bankdc2bankd_client(bankdc), tpdu->data, tpdu->len);
+}
+
 /* handle incoming messages from server */
 static int srvc_handle_rx(struct rspro_server_conn *srvc, const RsproPDU_t *pdu)
 {
@@ -179,6 +190,9 @@ struct bankd_client *remsim_client_create(void *ctx, const char *name, const cha
 	bankdc = &bc->bankd_conn;
 	/* server_host / server_port are configured from remsim-server */
 	bankdc->handle_rx = bankd_handle_rx;
+	bankdc->handle_tpdu = bankd_handle_tpdu;
+	/* share the connection with other client slots served by the same bankd */
+	bankdc->mux.enable = true;
 	memcpy(&bankdc->own_comp_id, &srvc->own_comp_id, sizeof(bankdc->own_comp_id));
 	rc = server_conn_fsm_alloc(bc, bankdc);
 	if (rc < 0) {
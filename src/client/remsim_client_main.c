@@ -11,6 +11,7 @@
 #include <osmocom/core/application.h>
 
 #include "client.h"
+#include "rspro_sock_tune.h"
 
 static void *g_tall_ctx;
 void __thread *talloc_asn1_ctx;
@@ -28,16 +29,23 @@ static void printf_help()
 		"  -h --help                  Print this help message\n"
 		"  -v --version               Print program version\n"
 		"  -d --debug option          Enable debug logging (e.g. DMAIN:DST2)\n"
-		"  -i --server-ip A.B.C.D     remsim-server IP address\n"
+		"  -i --server-ip A.B.C.D     remsim-server IP address, or the path of its UNIX domain socket\n"
 		"  -p --server-port 13245     remsim-server TCP port\n"
 		"  -c --client-id <0-1023>    RSPRO ClientId of this client\n"
 		"  -n --client-slot <0-1023>  RSPRO SlotNr of this client\n"
 		"  -a --atr HEXSTRING         default ATR to simulate (until bankd overrides it)\n"
 		"  -r --atr-ignore-rspro      Ignore any ATR from bankd; use only ATR given by -a)\n"
 		"  -e --event-script <path>   event script to be called by client\n"
+		"  -E --event-hook <command>  long-lived process receiving events as JSON lines on stdin\n"
+		"  -O --socket-profile NAME   Tuning of RSPRO sockets: none, default, low-latency\n"
 		"  -L --disable-color         Disable colors for logging to stderr\n"
 #ifdef SIMTRACE_SUPPORT
 		"  -Z --set-sim-presence <0-1> Define the presence pin behaviour (only supported on some boards)\n"
+		"  -u --usb-in-urbs <1-64>    Number of USB IN transfers to submit initially (default: 4)\n"
+		"  -U --usb-in-urbs-max <1-64> Maximum number of USB IN transfers (default: 16)\n"
+		"  -q --usb-irq-urbs <1-8>    Number of USB IRQ transfers (default: 1)\n"
+		"  -s --slot SLOT_NR:USB_PATH[:INTERFACE]  Serve this client slot in this process; may be\n"
+		"                             given several times (overrides -n, -H and -I)\n"
 #endif
 #ifdef USB_SUPPORT
 		"  -V --usb-vendor VENDOR_ID\n"
@@ -51,6 +59,48 @@ static void printf_help()
 	      );
 }
 
+#ifdef SIMTRACE_SUPPORT
+/* client slots to be served by this process, as given by --slot */
+static char *slot_args[64];
+static unsigned int num_slot_args;
+
+/* derive the configuration of one of several client slots from the common configuration */
+static struct client_config *slot_config(const struct client_config *cfg, char *arg)
+{
+	struct client_config *scfg;
+	char *slot_nr, *path, *if_num, *r;
+
+	scfg = talloc_memdup(cfg, cfg, sizeof(*cfg));
+	OSMO_ASSERT(scfg);
+
+	slot_nr = strtok_r(arg, ":", &r);
+	path = strtok_r(NULL, ":", &r);
+	if_num = strtok_r(NULL, ":", &r);
+	if (!slot_nr || !path) {
+		fprintf(stderr, "Slot malformed; expected SLOT_NR:USB_PATH[:INTERFACE]\n");
+		exit(2);
+	}
+
+	scfg->client_slot = atoi(slot_nr);
+	scfg->usb.path = path;
+	if (if_num)
+		scfg->usb.if_num = atoi(if_num);
+
+	return scfg;
+}
+
+static unsigned int parse_urbs(const char *arg, int max)
+{
+	int num = atoi(arg);
+
+	if (num < 1 || num > max) {
+		fprintf(stderr, "Number of USB transfers must be within 1..%d\n", max);
+		exit(2);
+	}
+	return num;
+}
+#endif
+
 static void handle_options(struct client_config *cfg, int argc, char **argv)
 {
 	int rc;
@@ -68,7 +118,15 @@ static void handle_options(struct client_config *cfg, int argc, char **argv)
 			{ "atr", 1, 0, 'a' },
 			{ "atr-ignore-rspro", 0, 0, 'r' },
 			{ "event-script", 1, 0, 'e' },
+			{ "event-hook", 1, 0, 'E' },
+			{ "socket-profile", 1, 0, 'O' },
 			{" disable-color", 0, 0, 'L' },
+#ifdef SIMTRACE_SUPPORT
+			{ "usb-in-urbs", 1, 0, 'u' },
+			{ "usb-in-urbs-max", 1, 0, 'U' },
+			{ "usb-irq-urbs", 1, 0, 'q' },
+			{ "slot", 1, 0, 's' },
+#endif
 #ifdef USB_SUPPORT
 			{ "usb-vendor", 1, 0, 'V' },
 			{ "usb-product", 1, 0, 'P' },
@@ -81,9 +139,9 @@ static void handle_options(struct client_config *cfg, int argc, char **argv)
 			{ 0, 0, 0, 0 }
 		};
 
-		c = getopt_long(argc, argv, "hvd:i:p:c:n:a:re:L"
+		c = getopt_long(argc, argv, "hvd:i:p:c:n:a:re:E:O:L"
 #ifdef SIMTRACE_SUPPORT
-						"Z:"
+						"Z:u:U:q:s:"
 #endif
 #ifdef USB_SUPPORT
 						"V:P:C:I:S:A:H:"
@@ -131,6 +189,15 @@ static void handle_options(struct client_config *cfg, int argc, char **argv)
 		case 'e':
 			osmo_talloc_replace_string(cfg, &cfg->event_script, optarg);
 			break;
+		case 'E':
+			osmo_talloc_replace_string(cfg, &cfg->event_hook, optarg);
+			break;
+		case 'O':
+			if (rspro_sock_tune_set_profile(optarg) < 0) {
+				fprintf(stderr, "Unknown socket profile '%s'\n", optarg);
+				exit(2);
+			}
+			break;
 		case 'L':
 			log_set_use_color(osmo_stderr_target, 0);
 			break;
@@ -139,6 +206,22 @@ static void handle_options(struct client_config *cfg, int argc, char **argv)
 			cfg->simtrace.presence_valid = true;
 			cfg->simtrace.presence_pol = atoi(optarg);
 			break;
+		case 'u':
+			cfg->simtrace.num_in_urbs = parse_urbs(optarg, 64);
+			break;
+		case 'U':
+			cfg->simtrace.max_in_urbs = parse_urbs(optarg, 64);
+			break;
+		case 'q':
+			cfg->simtrace.num_irq_urbs = parse_urbs(optarg, 8);
+			break;
+		case 's':
+			if (num_slot_args >= ARRAY_SIZE(slot_args)) {
+				fprintf(stderr, "Too many slots; at most %zu supported\n", ARRAY_SIZE(slot_args));
+				exit(2);
+			}
+			slot_args[num_slot_args++] = optarg;
+			break;
 #endif
 #ifdef USB_SUPPORT
 		case 'V':
@@ -204,6 +287,31 @@ int main(int argc, char **argv)
 	OSMO_ASSERT(cfg);
 	handle_options(cfg, argc, argv);
 
+#ifdef SIMTRACE_SUPPORT
+	/* serve several client slots, each with a connection to remsim-server of its own, but
+	 * with one libusb context and event loop, and sharing connections to the same bankd */
+	if (num_slot_args) {
+		struct bankd_client *bcs[ARRAY_SIZE(slot_args)];
+		unsigned int i;
+
+		for (i = 0; i < num_slot_args; i++) {
+			bcs[i] = remsim_client_create(g_tall_ctx, hostname, "remsim-client",
+						      slot_config(cfg, slot_args[i]));
+			osmo_fsm_inst_update_id_f(bcs[i]->main_fi, "%d", bcs[i]->cfg->client_slot);
+			osmo_fsm_inst_dispatch(bcs[i]->srv_conn.fi, SRVC_E_ESTABLISH, NULL);
+		}
+
+		signal(SIGUSR1, handle_sig_usr1);
+		if (avoid_zombies() < 0) {
+			LOGP(DMAIN, LOGL_FATAL, "Unable to silently reap children: %s\n", strerror(errno));
+			exit(1);
+		}
+		asn_debug = 0;
+
+		return client_user_main_multi(bcs, num_slot_args);
+	}
+#endif
+
 	g_client = remsim_client_create(g_tall_ctx, hostname, "remsim-client",cfg);
 
 	osmo_fsm_inst_dispatch(g_client->srv_conn.fi, SRVC_E_ESTABLISH, NULL);
@@ -0,0 +1,238 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <talloc.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/logging.h>
+
+#include "debug.h"
+#include "st2_usb_pool.h"
+
+/* interval after which an IN URB is retired, unless the IN queue ran empty meanwhile */
+#define ST2_USB_SHRINK_S	10
+
+static void usb_submit_urb(struct st2_urb *urb)
+{
+	urb->pool->ops->submit_urb(urb);
+}
+
+/* process all received messages, oldest first */
+static void usb_process_pending(struct st2_usb_pool *pool)
+{
+	struct st2_usb_buf *buf;
+
+	while ((buf = llist_first_entry_or_null(&pool->pending, struct st2_usb_buf, list))) {
+		llist_del(&buf->list);
+		pool->num_pending--;
+		pool->ops->process(pool, buf);
+		llist_add_tail(&buf->list, buf->irq ? &pool->free_irq : &pool->free_in);
+	}
+}
+
+static void usb_process_timer_cb(void *data)
+{
+	struct st2_usb_pool *pool = data;
+
+	pool->in_batch = 0;
+	usb_process_pending(pool);
+}
+
+static void usb_shrink_timer_cb(void *data)
+{
+	struct st2_usb_pool *pool = data;
+
+	if (pool->stats.in_starved == pool->in_starved_last && pool->num_in - pool->in_retire > pool->min_in)
+		pool->in_retire++;
+	pool->in_starved_last = pool->stats.in_starved;
+	osmo_timer_schedule(&pool->shrink_timer, ST2_USB_SHRINK_S, 0);
+}
+
+/* hand the received message of a completed URB over for processing, and give the URB a new buffer */
+static void usb_urb_buf_swap(struct st2_urb *urb, struct llist_head *free_list, unsigned long *no_buf)
+{
+	struct st2_usb_pool *pool = urb->pool;
+	struct st2_usb_buf *buf = urb->buf;
+
+	urb->buf = llist_first_entry_or_null(free_list, struct st2_usb_buf, list);
+	if (!urb->buf) {
+		/* all spare buffers wait for processing: process them now (and ours last, to
+		 * keep the order), after which we can reuse our buffer */
+		(*no_buf)++;
+		usb_process_pending(pool);
+		pool->ops->process(pool, buf);
+		urb->buf = buf;
+		return;
+	}
+	llist_del(&urb->buf->list);
+
+	llist_add_tail(&buf->list, &pool->pending);
+	pool->num_pending++;
+	if (pool->num_pending > pool->stats.max_pending)
+		pool->stats.max_pending = pool->num_pending;
+	if (!osmo_timer_pending(&pool->process_timer))
+		osmo_timer_schedule(&pool->process_timer, 0, 0);
+}
+
+/*! To be called by the USB back-end when a URB of the pool completed successfully.
+ *  \param[in] urb the completed URB
+ *  \param[in] len number of bytes received into urb->buf */
+void st2_usb_pool_completed(struct st2_urb *urb, unsigned int len)
+{
+	struct st2_usb_pool *pool = urb->pool;
+
+	urb->buf->len = len;
+
+	if (urb->irq) {
+		usb_urb_buf_swap(urb, &pool->free_irq, &pool->stats.irq_no_buf);
+		usb_submit_urb(urb);
+		return;
+	}
+
+	usb_urb_buf_swap(urb, &pool->free_in, &pool->stats.in_no_buf);
+
+	if (pool->in_retire) {
+		pool->in_retire--;
+		pool->num_in--;
+		llist_add(&urb->list, &pool->idle_in);
+		LOGP(DST2, LOGL_INFO, "USB IN queue didn't run empty for a while; using %u IN URBs\n",
+		     pool->num_in);
+		return;
+	}
+	usb_submit_urb(urb);
+
+	if (++pool->in_batch != pool->num_in)
+		return;
+
+	pool->stats.in_starved++;
+	urb = llist_first_entry_or_null(&pool->idle_in, struct st2_urb, list);
+	if (urb) {
+		llist_del(&urb->list);
+		pool->num_in++;
+		LOGP(DST2, LOGL_NOTICE, "USB IN queue ran empty (%lu times); using %u IN URBs\n",
+		     pool->stats.in_starved, pool->num_in);
+		usb_submit_urb(urb);
+	}
+}
+
+/* allocate num buffers of given size from one chunk of memory */
+static void usb_alloc_bufs(struct st2_usb_pool *pool, struct llist_head *free_list, unsigned int num,
+			   unsigned int size, bool irq)
+{
+	struct st2_usb_buf *bufs;
+	uint8_t *mem = NULL;
+	unsigned int i;
+
+	if (pool->ops->alloc_mem)
+		mem = pool->ops->alloc_mem(pool, num * size);
+	if (!mem) {
+		mem = talloc_size(pool, num * size);
+		OSMO_ASSERT(mem);
+	}
+	bufs = talloc_zero_array(pool, struct st2_usb_buf, num);
+	OSMO_ASSERT(bufs);
+
+	for (i = 0; i < num; i++) {
+		bufs[i].data = mem + i * size;
+		bufs[i].irq = irq;
+		llist_add_tail(&bufs[i].list, free_list);
+	}
+}
+
+static void usb_init_urb(struct st2_usb_pool *pool, struct st2_urb *urb, struct llist_head *free_list,
+			 bool irq)
+{
+	urb->pool = pool;
+	urb->irq = irq;
+	urb->buf = llist_first_entry(free_list, struct st2_usb_buf, list);
+	llist_del(&urb->buf->list);
+	INIT_LLIST_HEAD(&urb->list);
+	pool->ops->init_urb(urb);
+}
+
+static int st2_usb_pool_destructor(struct st2_usb_pool *pool)
+{
+	osmo_timer_del(&pool->process_timer);
+	osmo_timer_del(&pool->shrink_timer);
+	return 0;
+}
+
+/*! Allocate the URBs and buffers of a cardem instance.
+ *  \param[in] priv opaque data of the user
+ *  \param[in] num_in number of IN URBs to submit initially, and to shrink to
+ *  \param[in] max_in number of IN URBs we may use when the IN queue runs empty
+ *  \param[in] num_irq number of IRQ URBs */
+struct st2_usb_pool *st2_usb_pool_alloc(void *ctx, const struct st2_usb_pool_ops *ops, void *priv,
+					unsigned int num_in, unsigned int max_in, unsigned int num_irq)
+{
+	struct st2_usb_pool *pool;
+	unsigned int i;
+
+	max_in = OSMO_MAX(max_in, num_in);
+
+	pool = talloc_zero(ctx, struct st2_usb_pool);
+	OSMO_ASSERT(pool);
+	pool->ops = ops;
+	pool->priv = priv;
+	INIT_LLIST_HEAD(&pool->free_in);
+	INIT_LLIST_HEAD(&pool->free_irq);
+	INIT_LLIST_HEAD(&pool->pending);
+	INIT_LLIST_HEAD(&pool->idle_in);
+	osmo_timer_setup(&pool->process_timer, usb_process_timer_cb, pool);
+	osmo_timer_setup(&pool->shrink_timer, usb_shrink_timer_cb, pool);
+	talloc_set_destructor(pool, st2_usb_pool_destructor);
+
+	/* one buffer for each URB, and as many spare ones for messages waiting to be processed */
+	usb_alloc_bufs(pool, &pool->free_in, 2 * max_in, ST2_IN_BUF_SIZE, false);
+	usb_alloc_bufs(pool, &pool->free_irq, 2 * num_irq, ST2_IRQ_BUF_SIZE, true);
+
+	pool->irq_urbs = talloc_zero_array(pool, struct st2_urb, num_irq);
+	OSMO_ASSERT(pool->irq_urbs);
+	pool->num_irq = num_irq;
+	for (i = 0; i < num_irq; i++)
+		usb_init_urb(pool, &pool->irq_urbs[i], &pool->free_irq, true);
+
+	pool->in_urbs = talloc_zero_array(pool, struct st2_urb, max_in);
+	OSMO_ASSERT(pool->in_urbs);
+	for (i = 0; i < max_in; i++) {
+		usb_init_urb(pool, &pool->in_urbs[i], &pool->free_in, false);
+		llist_add_tail(&pool->in_urbs[i].list, &pool->idle_in);
+	}
+	pool->min_in = num_in;
+	pool->max_in = max_in;
+
+	return pool;
+}
+
+/*! Submit the initial URBs of a pool */
+void st2_usb_pool_start(struct st2_usb_pool *pool)
+{
+	struct st2_urb *urb;
+	unsigned int i;
+
+	for (i = 0; i < pool->num_irq; i++)
+		usb_submit_urb(&pool->irq_urbs[i]);
+	/* submit multiple IN URB in order to work around OS#4409 */
+	while (pool->num_in < pool->min_in) {
+		urb = llist_first_entry(&pool->idle_in, struct st2_urb, list);
+		llist_del(&urb->list);
+		pool->num_in++;
+		usb_submit_urb(urb);
+	}
+	osmo_timer_schedule(&pool->shrink_timer, ST2_USB_SHRINK_S, 0);
+}
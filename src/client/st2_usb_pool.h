@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/timer.h>
+
+/* Pool of the USB transfers (URBs) receiving from a cardem device, and of their buffers.
+ *
+ * IN and IRQ URBs are resubmitted right from their completion call-back, with a spare
+ * buffer from a pool allocated at start-up.  The received messages are processed (which
+ * includes encoding and sending RSPRO) later on from the main loop, so that a burst of
+ * messages from the cardem firmware never waits for that.
+ *
+ * Whenever all IN URBs complete within one iteration of the main loop, the firmware may
+ * have found no URB to send its data in: we count that as starvation, and submit another
+ * IN URB (up to a configurable maximum).  Once no starvation occurred for a while, an
+ * IN URB is retired again at its next completion, down to the initial number.
+ *
+ * The pool itself doesn't know about libusb: submitting URBs is up to the user. */
+
+struct st2_usb_pool;
+
+struct st2_usb_buf {
+	/* entry in the pool's list of free or pending buffers */
+	struct llist_head list;
+	uint8_t *data;
+	unsigned int len;
+	bool irq;
+};
+
+struct st2_urb {
+	struct st2_usb_pool *pool;
+	/* entry in the pool's list of idle IN URBs */
+	struct llist_head list;
+	/* transfer of the USB back-end, e.g. struct libusb_transfer */
+	void *xfer;
+	/* buffer currently owned by the URB */
+	struct st2_usb_buf *buf;
+	bool irq;
+};
+
+struct st2_usb_pool_ops {
+	/* allocate the transfer of a URB; IN URBs receive up to ST2_IN_BUF_SIZE bytes, IRQ
+	 * URBs up to ST2_IRQ_BUF_SIZE */
+	void (*init_urb)(struct st2_urb *urb);
+	/* (re)submit a URB, to receive into urb->buf->data */
+	void (*submit_urb)(struct st2_urb *urb);
+	/* process a message received from the device */
+	void (*process)(struct st2_usb_pool *pool, const struct st2_usb_buf *buf);
+	/* optional: allocate 'size' bytes of buffer memory, e.g. DMA-able; NULL to use talloc */
+	uint8_t *(*alloc_mem)(struct st2_usb_pool *pool, unsigned int size);
+};
+
+#define ST2_IN_BUF_SIZE		(16*256)
+#define ST2_IRQ_BUF_SIZE	64
+
+struct st2_usb_pool {
+	const struct st2_usb_pool_ops *ops;
+	void *priv;
+
+	/* buffers neither owned by a URB nor waiting to be processed */
+	struct llist_head free_in;
+	struct llist_head free_irq;
+	/* received buffers waiting to be processed, in order of completion */
+	struct llist_head pending;
+	unsigned int num_pending;
+	struct osmo_timer_list process_timer;
+
+	struct st2_urb *irq_urbs;
+	unsigned int num_irq;
+	struct st2_urb *in_urbs;
+	/* IN URBs not submitted */
+	struct llist_head idle_in;
+	/* number of IN URBs submitted initially / at most / currently */
+	unsigned int min_in;
+	unsigned int max_in;
+	unsigned int num_in;
+	/* number of IN URBs completed since the last iteration of the main loop */
+	unsigned int in_batch;
+	/* number of IN URBs to retire at their next completion */
+	unsigned int in_retire;
+	/* value of stats.in_starved at the last expiry of shrink_timer */
+	unsigned long in_starved_last;
+	struct osmo_timer_list shrink_timer;
+
+	struct {
+		/* all IN URBs completed within one iteration of the main loop */
+		unsigned long in_starved;
+		/* no spare buffer, message processed before resubmitting */
+		unsigned long in_no_buf;
+		unsigned long irq_no_buf;
+		/* maximum number of received buffers waiting to be processed */
+		unsigned int max_pending;
+	} stats;
+};
+
+struct st2_usb_pool *st2_usb_pool_alloc(void *ctx, const struct st2_usb_pool_ops *ops, void *priv,
+					unsigned int num_in, unsigned int max_in, unsigned int num_irq);
+void st2_usb_pool_start(struct st2_usb_pool *pool);
+void st2_usb_pool_completed(struct st2_urb *urb, unsigned int len);
@@ -35,6 +35,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
 
 #include <osmocom/core/select.h>
 #include <osmocom/core/application.h>
@@ -76,32 +78,88 @@ enum itmsg_type {
 	/* reset the card */
 	ITMSG_TYPE_RESET_REQ,
 	ITMSG_TYPE_RESET_RESP,
+
+	/* start/stop serving a Lun (control channel only) */
+	ITMSG_TYPE_OPEN_REQ,
+	ITMSG_TYPE_CLOSE_REQ,
 };
 
-struct itmsg {
+struct itchan;
+struct client_lun_cfg;
+
+/* request from the IFD thread to the remsim-client thread.  It lives on the stack of the IFD
+ * thread, which blocks until the client thread has completed it; hence neither the C-APDU nor
+ * the R-APDU / ATR need to be copied anywhere but into their final place. */
+struct itreq {
 	enum itmsg_type type;
+	/* C-APDU of ITMSG_TYPE_C_APDU_REQ */
+	const uint8_t *tx;
+	size_t tx_len;
+	/* caller-provided buffer for the R-APDU or ATR */
+	uint8_t *rx;
+	size_t rx_size;
+	/* channel and configuration of the Lun to open/close */
+	struct itchan *chan;
+	const struct client_lun_cfg *cfg;
+
+	/* completed by the client thread */
+	size_t rx_len;
 	uint16_t status;	/* 0 == success */
-	uint16_t len;		/* length of 'data' */
-	uint8_t data[0];
 };
 
-/* allocate + initialize msgb-wrapped inter-thread message (struct itmsg) */
-struct msgb *itmsg_alloc(enum itmsg_type type, uint16_t status, const uint8_t *data, uint16_t len)
+/* itreq.status: the R-APDU didn't fit into the caller-provided buffer */
+#define ITREQ_ST_RX_OVERFLOW	0xfffe
+
+/* single-producer (IFD thread), single-consumer (client thread) ring of requests */
+#define ITRING_SIZE	4	/* power of two */
+struct itring {
+	struct itreq *req[ITRING_SIZE];
+	/* only written by the producer */
+	atomic_uint head;
+	/* only written by the consumer */
+	atomic_uint tail;
+};
+
+static int itring_push(struct itring *ring, struct itreq *req)
+{
+	unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= ITRING_SIZE)
+		return -ENOSPC;
+	ring->req[head % ITRING_SIZE] = req;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+	return 0;
+}
+
+static struct itreq *itring_pop(struct itring *ring)
 {
-	struct msgb *msg = msgb_alloc_c(OTC_GLOBAL, sizeof(struct itmsg)+len, "Tx itmsg");
-	struct itmsg *im;
+	unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	struct itreq *req;
 
-	if (!msg)
+	if (tail == atomic_load_explicit(&ring->head, memory_order_acquire))
 		return NULL;
+	req = ring->req[tail % ITRING_SIZE];
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+	return req;
+}
 
-	im = (struct itmsg *) msgb_put(msg, sizeof(struct itmsg) + len);
-	im->type = type;
-	im->status = status;
-	im->len = len;
-	if (len)
-		memcpy(im->data, data, len);
+/* channel between the IFD thread and the remsim-client thread of one Lun */
+struct itchan {
+	struct itring ring;
+	/* eventfd waking up the client thread after a request was pushed to the ring; shared
+	 * by the channels of all Luns served by the same client thread */
+	int wake_fd;
+	/* eventfd waking up the IFD thread after its request was completed */
+	int done_fd;
+};
 
-	return msg;
+static void eventfd_signal(int fd)
+{
+	uint64_t val = 1;
+	int rc;
+
+	rc = write(fd, &val, sizeof(val));
+	OSMO_ASSERT(rc == sizeof(val));
 }
 
 /***********************************************************************
@@ -110,36 +168,59 @@ struct msgb *itmsg_alloc(enum itmsg_type type, uint16_t status, const uint8_t *d
 
 void __thread *talloc_asn1_ctx;
 
+/* configuration of a Lun; passed in from IFD thread */
+struct client_lun_cfg {
+	const char *server_host;
+	int server_port;
+	int client_id;
+	int client_slot;
+	/* serve this Lun from the client thread shared with other Luns? */
+	bool shared;
+	/* slot number of the Lun; used to identify its FSM instances */
+	unsigned int lun_slot;
+};
+
+/* configuration of client thread; passed in from IFD thread */
+struct client_thread_cfg {
+	/* eventfd waking up the thread */
+	int wake_fd;
+	/* channel for opening / closing Luns */
+	struct itchan *ctrl;
+};
+
 struct client_thread {
+	struct client_thread_cfg *cfg;
+	/* wake_fd of cfg */
+	struct osmo_fd it_ofd;
+	/* Luns served by this thread (struct client_lun) */
+	struct llist_head luns;
+	char hostname[256];
+};
+
+/* a Lun served by a client thread */
+struct client_lun {
+	/* entry in client_thread.luns */
+	struct llist_head list;
+	struct client_thread *ct;
+
 	/* bankd client running inside this thread */
 	struct bankd_client *bc;
 
-	/* inter-thread osmo-fd; communication with IFD/PCSC thread */
-	struct osmo_fd it_ofd;
-	struct llist_head it_msgq;
+	/* communication with IFD/PCSC thread */
+	struct itchan *chan;
+	/* C-APDU request waiting for the R-APDU from bankd */
+	struct itreq *apdu_req;
 
 	/* ATR as received from remsim-bankd */
 	uint8_t atr[ATR_SIZE_MAX];
 	uint8_t atr_len;
 };
 
-/* configuration of client thread; passed in from IFD thread */
-struct client_thread_cfg {
-	const char *server_host;
-	int server_port;
-	int client_id;
-	int client_slot;
-	int it_sock_fd;
-};
-
-/* enqueue a msgb (containing 'struct itmsg') towards the IFD-handler thread */
-static void enqueue_to_ifd(struct client_thread *ct, struct msgb *msg)
+/* hand a completed request back to the (blocked) IFD thread */
+static void complete_to_ifd(struct itchan *chan, struct itreq *req, uint16_t status)
 {
-	if (!msg)
-		return;
-
-	msgb_enqueue(&ct->it_msgq, msg);
-	ct->it_ofd.when |= OSMO_FD_WRITE;
+	req->status = status;
+	eventfd_signal(chan->done_fd);
 }
 
 /***********************************************************************
@@ -153,6 +234,13 @@ int frontend_request_card_insert(struct bankd_client *bc)
 
 int frontend_request_card_remove(struct bankd_client *bc)
 {
+	struct client_lun *cl = bc->data;
+
+	/* we lost the bankd; the R-APDU will never arrive */
+	if (cl->apdu_req) {
+		complete_to_ifd(cl->chan, cl->apdu_req, 0xffff);
+		cl->apdu_req = NULL;
+	}
 	return 0;
 }
 
@@ -173,23 +261,36 @@ int frontend_request_modem_reset(struct bankd_client *bc)
 
 int frontend_handle_card2modem(struct bankd_client *bc, const uint8_t *data, size_t len)
 {
-	struct client_thread *ct = bc->data;
-	struct msgb *msg;
+	struct client_lun *cl = bc->data;
+	struct itreq *req = cl->apdu_req;
 
 	OSMO_ASSERT(data);
 
 	DEBUGP(DMAIN, "R-APDU: %s\n", osmo_hexdump(data, len));
-	/* enqueue towards IFD thread */
-	msg = itmsg_alloc(ITMSG_TYPE_R_APDU_IND, 0, data, len);
-	OSMO_ASSERT(msg);
-	enqueue_to_ifd(ct, msg);
+	if (!req) {
+		LOGP(DMAIN, LOGL_ERROR, "Dropping R-APDU without pending C-APDU\n");
+		return -EINVAL;
+	}
+
+	cl->apdu_req = NULL;
+	if (len > req->rx_size) {
+		LOGP(DMAIN, LOGL_ERROR, "R-APDU of %zu bytes exceeds buffer of %zu bytes\n",
+		     len, req->rx_size);
+		complete_to_ifd(cl->chan, req, ITREQ_ST_RX_OVERFLOW);
+		return -ENOSPC;
+	}
+
+	/* straight into the buffer of the IFD thread */
+	req->rx_len = len;
+	memcpy(req->rx, data, len);
+	complete_to_ifd(cl->chan, req, 0);
 
 	return 0;
 }
 
 int frontend_handle_set_atr(struct bankd_client *bc, const uint8_t *data, size_t len)
 {
-	struct client_thread *ct = bc->data;
+	struct client_lun *cl = bc->data;
 	unsigned int atr_len;
 
 	OSMO_ASSERT(data);
@@ -198,10 +299,10 @@ int frontend_handle_set_atr(struct bankd_client *bc, const uint8_t *data, size_t
 
 	/* store ATR in local data structure until somebody needs it */
 	atr_len = len;
-	if (atr_len > sizeof(ct->atr))
-		atr_len = sizeof(ct->atr);
-	memcpy(ct->atr, data, atr_len);
-	ct->atr_len = atr_len;
+	if (atr_len > sizeof(cl->atr))
+		atr_len = sizeof(cl->atr);
+	memcpy(cl->atr, data, atr_len);
+	cl->atr_len = atr_len;
 
 	return 0;
 }
@@ -220,29 +321,28 @@ int frontend_append_script_env(struct bankd_client *bc, char **env, int idx, siz
  * Incoming command from the user application
  ***********************************************************************/
 
-/* handle a single msgb-wrapped 'struct itmsg' from the IFD-handler thread */
-static void handle_it_msg(struct client_thread *ct, struct itmsg *itmsg)
+/* handle a single request from the IFD-handler thread */
+static void handle_it_req(struct client_lun *cl, struct itreq *req)
 {
-	struct bankd_client *bc = ct->bc;
-	struct msgb *tx = NULL;
+	struct bankd_client *bc = cl->bc;
 	RsproPDU_t *pdu;
 	BankSlot_t bslot;
 
-	bank_slot2rspro(&bslot, &ct->bc->bankd_slot);
+	bank_slot2rspro(&bslot, &bc->bankd_slot);
 
-	switch (itmsg->type) {
+	switch (req->type) {
 	case ITMSG_TYPE_CARD_PRES_REQ:
 		if (bc->bankd_conn.fi->state == 2 /*SRVC_ST_CONNECTED*/)
-			tx = itmsg_alloc(ITMSG_TYPE_CARD_PRES_RESP, 0, NULL, 0);
+			complete_to_ifd(cl->chan, req, 0);
 		else
-			tx = itmsg_alloc(ITMSG_TYPE_CARD_PRES_RESP, 0xffff, NULL, 0);
-		OSMO_ASSERT(tx);
+			complete_to_ifd(cl->chan, req, 0xffff);
 		break;
 
 	case ITMSG_TYPE_ATR_REQ:
 		/* respond to IFD */
-		tx = itmsg_alloc(ITMSG_TYPE_ATR_RESP, 0, ct->atr, ct->atr_len);
-		OSMO_ASSERT(tx);
+		req->rx_len = OSMO_MIN(cl->atr_len, req->rx_size);
+		memcpy(req->rx, cl->atr, req->rx_len);
+		complete_to_ifd(cl->chan, req, 0);
 		break;
 
 	case ITMSG_TYPE_POWER_OFF_REQ:
@@ -250,8 +350,7 @@ static void handle_it_msg(struct client_thread *ct, struct itmsg *itmsg)
 						    true, false, false, true);
 		server_conn_send_rspro(&bc->bankd_conn, pdu);
 		/* respond to IFD */
-		tx = itmsg_alloc(ITMSG_TYPE_POWER_OFF_RESP, 0, NULL, 0);
-		OSMO_ASSERT(tx);
+		complete_to_ifd(cl->chan, req, 0);
 		break;
 
 	case ITMSG_TYPE_POWER_ON_REQ:
@@ -259,8 +358,7 @@ static void handle_it_msg(struct client_thread *ct, struct itmsg *itmsg)
 						    false, true, true, true);
 		server_conn_send_rspro(&bc->bankd_conn, pdu);
 		/* respond to IFD */
-		tx = itmsg_alloc(ITMSG_TYPE_POWER_ON_RESP, 0, NULL, 0);
-		OSMO_ASSERT(tx);
+		complete_to_ifd(cl->chan, req, 0);
 		break;
 
 	case ITMSG_TYPE_RESET_REQ:
@@ -273,74 +371,144 @@ static void handle_it_msg(struct client_thread *ct, struct itmsg *itmsg)
 						    false, true, true, true);
 		server_conn_send_rspro(&bc->bankd_conn, pdu);
 		/* respond to IFD */
-		tx = itmsg_alloc(ITMSG_TYPE_RESET_RESP, 0, NULL, 0);
-		OSMO_ASSERT(tx);
+		complete_to_ifd(cl->chan, req, 0);
 		break;
 	case ITMSG_TYPE_C_APDU_REQ:
-		if (!bc->srv_conn.clslot) {
-			LOGP(DMAIN, LOGL_ERROR, "Cannot send command; no client slot\n");
-			/* FIXME: Response? */
-			return;
+		if (!bc->srv_conn.clslot || cl->apdu_req) {
+			LOGP(DMAIN, LOGL_ERROR, "Cannot send command; no client slot or command pending\n");
+			complete_to_ifd(cl->chan, req, 0xffff);
+			break;
 		}
 
 		/* Send CMD APDU to [remote] card */
-		pdu = rspro_gen_TpduModem2Card(bc->srv_conn.clslot, &bslot, itmsg->data, itmsg->len);
-		server_conn_send_rspro(&bc->bankd_conn, pdu);
+		if (main_fsm_tx_tpdu(bc, req->tx, req->tx_len) < 0) {
+			complete_to_ifd(cl->chan, req, 0xffff);
+			break;
+		}
 		/* response will come in asynchronously */
+		cl->apdu_req = req;
 		break;
 	default:
-		LOGP(DMAIN, LOGL_ERROR, "Unknown inter-thread msg type %u\n", itmsg->type);
+		LOGP(DMAIN, LOGL_ERROR, "Unknown inter-thread request type %u\n", req->type);
+		complete_to_ifd(cl->chan, req, 0xffff);
 		break;
 	}
+}
+
+/* start serving a Lun */
+static struct client_lun *client_lun_open(struct client_thread *ct, const struct client_lun_cfg *cfg,
+					  struct itchan *chan)
+{
+	struct client_config *ccfg;
+	struct client_lun *cl;
+
+	cl = talloc_zero(ct, struct client_lun);
+	if (!cl)
+		return NULL;
+
+	ccfg = client_config_init(cl);
+	OSMO_ASSERT(ccfg);
+	osmo_talloc_replace_string(ccfg, &ccfg->server_host, cfg->server_host);
+	if (cfg->server_port >= 0)
+		ccfg->server_port = cfg->server_port;
+	ccfg->client_id = cfg->client_id;
+	ccfg->client_slot = cfg->client_slot;
+
+	cl->bc = remsim_client_create(cl, ct->hostname, "remsim_ifdhandler", ccfg);
+	OSMO_ASSERT(cl->bc);
+	cl->bc->data = cl;
+	osmo_fsm_inst_update_id_f(cl->bc->main_fi, "%u", cfg->lun_slot);
 
-	if (tx)
-		enqueue_to_ifd(ct, tx);
+	cl->ct = ct;
+	cl->chan = chan;
+	llist_add_tail(&cl->list, &ct->luns);
 
+	osmo_fsm_inst_dispatch(cl->bc->srv_conn.fi, SRVC_E_ESTABLISH, NULL);
+
+	return cl;
 }
 
-/* call-back function for inter-thread socket */
-static int it_sock_fd_cb(struct osmo_fd *ofd, unsigned int what)
+static void client_lun_term_conn(struct rspro_server_conn *srvc)
 {
-	struct client_thread *ct = ofd->data;
-	int rc;
+	if (!srvc->fi)
+		return;
+	osmo_fsm_inst_change_parent(srvc->fi, NULL, 0);
+	osmo_fsm_inst_term(srvc->fi, OSMO_FSM_TERM_REQUEST, NULL);
+	srvc->fi = NULL;
+}
+
+/* stop serving a Lun */
+static void client_lun_close(struct client_lun *cl)
+{
+	if (cl->apdu_req) {
+		complete_to_ifd(cl->chan, cl->apdu_req, 0xffff);
+		cl->apdu_req = NULL;
+	}
 
-	if (what & OSMO_FD_READ) {
-		struct msgb *msg = msgb_alloc_c(OTC_GLOBAL, 1024, "Rx it_fd");
-		struct itmsg *itmsg;
+	/* only detaches our client slot if the bankd connection is shared with other Luns */
+	osmo_fsm_inst_dispatch(cl->bc->bankd_conn.fi, SRVC_E_DISCONNECT, NULL);
+	osmo_fsm_inst_dispatch(cl->bc->srv_conn.fi, SRVC_E_DISCONNECT, NULL);
+	/* the connection FSMs are allocated under 'bc', not under the main FSM: terminate them
+	 * explicitly, so that they leave the per-thread list of connections before 'bc' is freed.
+	 * Detach them from the main FSM first; it must not react to their termination. */
+	client_lun_term_conn(&cl->bc->bankd_conn);
+	client_lun_term_conn(&cl->bc->srv_conn);
+	osmo_fsm_inst_term(cl->bc->main_fi, OSMO_FSM_TERM_REQUEST, NULL);
+
+	llist_del(&cl->list);
+	talloc_free(cl);
+}
 
-		OSMO_ASSERT(msg);
-		rc = read(ofd->fd, msg->tail, msgb_tailroom(msg));
-		if (rc <= 0) {
-			LOGP(DMAIN, LOGL_ERROR, "Error reading from inter-thread fd: %d\n", rc);
-			pthread_exit(NULL);
-		}
-		msgb_put(msg, rc);
-		itmsg = (struct itmsg *) msgb_data(msg);
-		if (msgb_length(msg) < sizeof(*itmsg) ||
-		    msgb_length(msg) < sizeof(*itmsg) + itmsg->len) {
-			LOGP(DMAIN, LOGL_ERROR, "Dropping short inter-thread message\n");
-		} else {
-			handle_it_msg(ct, itmsg);
-		}
-		msgb_free(msg);
-	}
-
-	if (what & OSMO_FD_WRITE) {
-		struct msgb *msg = msgb_dequeue(&ct->it_msgq);
-		if (!msg) {
-			/* last message: disable write events */
-			ofd->when &= ~OSMO_FD_WRITE;
-		} else {
-			unsigned int len = msgb_length(msg);
-			rc = write(ofd->fd, msgb_data(msg), len);
-			msgb_free(msg);
-			if (rc < len) {
-				LOGP(DMAIN, LOGL_ERROR, "Short write on inter-thread fd: %d < %d\n",
-				     rc, len);
+/* handle a single request on the control channel of the thread */
+static void handle_ctrl_req(struct client_thread *ct, struct itreq *req)
+{
+	struct client_lun *cl;
+
+	switch (req->type) {
+	case ITMSG_TYPE_OPEN_REQ:
+		cl = client_lun_open(ct, req->cfg, req->chan);
+		complete_to_ifd(ct->cfg->ctrl, req, cl ? 0 : 0xffff);
+		break;
+	case ITMSG_TYPE_CLOSE_REQ:
+		llist_for_each_entry(cl, &ct->luns, list) {
+			if (cl->chan == req->chan) {
+				client_lun_close(cl);
+				complete_to_ifd(ct->cfg->ctrl, req, 0);
+				return;
 			}
 		}
+		complete_to_ifd(ct->cfg->ctrl, req, 0xffff);
+		break;
+	default:
+		LOGP(DMAIN, LOGL_ERROR, "Unknown inter-thread control request type %u\n", req->type);
+		complete_to_ifd(ct->cfg->ctrl, req, 0xffff);
+		break;
 	}
+}
+
+/* call-back function for the inter-thread eventfd */
+static int it_wake_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct client_thread *ct = ofd->data;
+	struct client_lun *cl;
+	struct itreq *req;
+	uint64_t val;
+	int rc;
 
+	rc = read(ofd->fd, &val, sizeof(val));
+	if (rc != sizeof(val)) {
+		LOGP(DMAIN, LOGL_ERROR, "Error reading from inter-thread fd: %d\n", rc);
+		pthread_exit(NULL);
+	}
+
+	while ((req = itring_pop(&ct->cfg->ctrl->ring)))
+		handle_ctrl_req(ct, req);
+
+	/* one eventfd for all Luns: dispatch by looking at the ring of each of them */
+	llist_for_each_entry(cl, &ct->luns, list) {
+		while ((req = itring_pop(&cl->chan->ring)))
+			handle_it_req(cl, req);
+	}
 
 	return 0;
 }
@@ -351,12 +519,8 @@ static void client_pthread_cleanup(void *arg)
 	struct client_thread *ct = arg;
 
 	LOGP(DMAIN, LOGL_INFO, "Cleaning up remsim-client thread\n");
-	//FIXME remsim_client_destroy(ct->bc);
-	ct->bc = NULL;
-	msgb_queue_free(&ct->it_msgq);
+	/* all Luns have been closed before the thread is cancelled; the IFD side owns the fd */
 	osmo_fd_unregister(&ct->it_ofd);
-	close(ct->it_ofd.fd);
-	ct->it_ofd.fd = -1;
 	talloc_free(ct);
 }
 
@@ -364,46 +528,31 @@ static void client_pthread_cleanup(void *arg)
 static void *client_pthread_main(void *arg)
 {
 	struct client_thread_cfg *cfg = arg;
-	struct client_config *ccfg;
 	struct client_thread *ct;
-	char hostname[256];
 	int rc;
 
-	if (gethostname(hostname, sizeof(hostname)) < 0)
-		OSMO_STRLCPY_ARRAY(hostname, "unknown");
-
 	rc = osmo_ctx_init("client");
 	OSMO_ASSERT(rc == 0);
 	osmo_select_init();
 
 	ct = talloc_zero(OTC_GLOBAL, struct client_thread);
 	OSMO_ASSERT(ct);
+	ct->cfg = cfg;
+	INIT_LLIST_HEAD(&ct->luns);
 
-	ccfg = client_config_init(ct);
-	OSMO_ASSERT(ccfg);
-	osmo_talloc_replace_string(ccfg, &ccfg->server_host, cfg->server_host);
-	if (cfg->server_port >= 0)
-		ccfg->server_port = cfg->server_port;
-	ccfg->client_id = cfg->client_id;
-	ccfg->client_slot = cfg->client_slot;
+	if (gethostname(ct->hostname, sizeof(ct->hostname)) < 0)
+		OSMO_STRLCPY_ARRAY(ct->hostname, "unknown");
 
 	if (!talloc_asn1_ctx)
 	       talloc_asn1_ctx= talloc_named_const(ct, 0, "asn1");
 
-	ct->bc = remsim_client_create(ct, hostname, "remsim_ifdhandler", ccfg);
-	OSMO_ASSERT(ct->bc);
-	ct->bc->data = ct;
-
-	INIT_LLIST_HEAD(&ct->it_msgq);
-	osmo_fd_setup(&ct->it_ofd, cfg->it_sock_fd, OSMO_FD_READ, &it_sock_fd_cb, ct, 0);
+	osmo_fd_setup(&ct->it_ofd, cfg->wake_fd, OSMO_FD_READ, &it_wake_fd_cb, ct, 0);
 	rc = osmo_fd_register(&ct->it_ofd);
 	OSMO_ASSERT(rc == 0);
 
 	/* ensure we get properly cleaned up if cancelled */
 	pthread_cleanup_push(client_pthread_cleanup, ct);
 
-	osmo_fsm_inst_dispatch(ct->bc->srv_conn.fi, SRVC_E_ESTABLISH, NULL);
-
 	while (1) {
 		osmo_select_main(0);
 	}
@@ -420,7 +569,6 @@ static void *client_pthread_main(void *arg)
 #include <debuglog.h>
 
 #include <sys/types.h>
-#include <sys/socket.h>
 
 static const struct value_string ifd_status_names[] = {
 	OSMO_VALUE_STRING(IFD_SUCCESS),
@@ -466,86 +614,175 @@ static const struct value_string ifd_tag_names[] = {
 	Log5(r == IFD_SUCCESS ? PCSC_LOG_DEBUG : PCSC_LOG_ERROR, \
 	     "%s(0x%08lx) "fmt" => %s\n", __func__, Lun, ## args, get_value_string(ifd_status_names, r))
 
-/* IFD side handle for a remsim-client [thread] */
-struct ifd_client {
+/* IFD side handle for a remsim-client thread */
+struct ifd_thread {
 	/* the client pthread itself */
 	pthread_t pthread;
-	/* socket to talk to thread */
-	int it_fd;
+	/* channel for opening / closing Luns */
+	struct itchan ctrl;
 	/* configuration passed into the thread */
 	struct client_thread_cfg cfg;
+	/* number of Luns served by the thread */
+	unsigned int num_luns;
+};
+
+/* IFD side handle for a Lun served by a remsim-client thread */
+struct ifd_client {
+	struct ifd_thread *thread;
+	/* channel to talk to thread */
+	struct itchan chan;
+	/* configuration passed into the thread */
+	struct client_lun_cfg cfg;
 };
 
-static struct msgb *ifd_xceive_client(struct ifd_client *ic, struct msgb *tx)
+/* thread serving all Luns configured as 'shared'; NULL if there are none */
+static struct ifd_thread *shared_thread;
+
+/* pass a request to the client thread, and wait until it has been completed */
+static int ifd_xceive(struct itchan *chan, struct itreq *req)
 {
-	struct msgb *rx = msgb_alloc_c(OTC_GLOBAL, 1024, "ifd_rx itmsg");
-	struct itmsg *rx_it;
+	uint64_t val;
 	int rc;
 
-	rc = write(ic->it_fd, msgb_data(tx), msgb_length(tx));
-	msgb_free(tx);
-	if (rc < msgb_length(tx)) {
-		Log2(PCSC_LOG_ERROR, "Short write IFD->client thread: %d\n", rc);
-		msgb_free(rx);
-		return NULL;
+	/* requests are serialized by pcscd (we're not TAG_IFD_THREAD_SAFE) */
+	rc = itring_push(&chan->ring, req);
+	if (rc < 0) {
+		Log2(PCSC_LOG_ERROR, "IFD->client thread ring full: %d\n", rc);
+		return rc;
 	}
-	rc = read(ic->it_fd, rx->tail, msgb_tailroom(rx));
-	if (rc <= 0) {
+	eventfd_signal(chan->wake_fd);
+
+	rc = read(chan->done_fd, &val, sizeof(val));
+	if (rc != sizeof(val)) {
 		Log2(PCSC_LOG_ERROR, "Short read IFD<-client thread: %d\n", rc);
-		msgb_free(rx);
-		return NULL;
+		return -EIO;
 	}
-	msgb_put(rx, rc);
-	rx_it = (struct itmsg *) msgb_data(rx);
-	if (msgb_length(rx) < sizeof(*rx_it) + rx_it->len) {
-		Log2(PCSC_LOG_ERROR, "Short itmsg IFD<-client thread: %d\n", msgb_length(rx));
-		msgb_free(rx);
+	return 0;
+}
+
+static int ifd_xceive_client(struct ifd_client *ic, struct itreq *req)
+{
+	return ifd_xceive(&ic->chan, req);
+}
+
+/* function called on IFD side to start a remsim-client thread */
+static struct ifd_thread *create_ifd_thread(void)
+{
+	/* shared between the IFD thread and the client thread */
+	struct ifd_thread *it = calloc(1, sizeof(*it));
+	int rc;
+
+	if (!it)
 		return NULL;
+
+	/* create eventfds for waking up the threads */
+	it->ctrl.wake_fd = eventfd(0, 0);
+	it->ctrl.done_fd = eventfd(0, 0);
+	if (it->ctrl.wake_fd < 0 || it->ctrl.done_fd < 0)
+		goto err;
+
+	it->cfg.wake_fd = it->ctrl.wake_fd;
+	it->cfg.ctrl = &it->ctrl;
+
+	/* start the thread */
+	rc = pthread_create(&it->pthread, NULL, client_pthread_main, &it->cfg);
+	if (rc != 0) {
+		Log1(PCSC_LOG_ERROR, "Error creating remsim-client pthread\n");
+		goto err;
 	}
-	return rx;
+
+	return it;
+
+err:
+	if (it->ctrl.wake_fd >= 0)
+		close(it->ctrl.wake_fd);
+	if (it->ctrl.done_fd >= 0)
+		close(it->ctrl.done_fd);
+	free(it);
+	return NULL;
 }
 
-/* function called on IFD side to create socketpair + start remsim-client thread */
-static struct ifd_client *create_ifd_client(const struct client_thread_cfg *cfg)
+/* function called on IFD side to destroy (terminate) a remsim-client thread without Luns */
+static void put_ifd_thread(struct ifd_thread *it)
+{
+	if (it->num_luns)
+		return;
+
+	if (it == shared_thread)
+		shared_thread = NULL;
+
+	pthread_cancel(it->pthread);
+	pthread_join(it->pthread, NULL);
+	close(it->ctrl.wake_fd);
+	close(it->ctrl.done_fd);
+	free(it);
+}
+
+/* function called on IFD side to have a Lun served by a [new] remsim-client thread */
+static struct ifd_client *create_ifd_client(const struct client_lun_cfg *cfg)
 {
 	struct ifd_client *ic = talloc_zero(OTC_GLOBAL, struct ifd_client);
-	int sp[2];
-	int rc;
+	struct itreq req = {
+		.type = ITMSG_TYPE_OPEN_REQ,
+	};
+	struct ifd_thread *it;
 
 	/* copy over configuration */
 	ic->cfg = *cfg;
 
-	/* create socket pair for communication between threads */
-	rc = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sp);
-	if (rc != 0) {
-		talloc_free(ic);
-		return NULL;
+	if (cfg->shared && shared_thread)
+		it = shared_thread;
+	else {
+		it = create_ifd_thread();
+		if (!it) {
+			talloc_free(ic);
+			return NULL;
+		}
+		if (cfg->shared)
+			shared_thread = it;
 	}
+	ic->thread = it;
 
-	ic->it_fd = sp[0];
-	ic->cfg.it_sock_fd = sp[1];
+	ic->chan.wake_fd = it->ctrl.wake_fd;
+	ic->chan.done_fd = eventfd(0, 0);
+	if (ic->chan.done_fd < 0)
+		goto err;
 
-	/* start the thread */
-	rc = pthread_create(&ic->pthread, NULL, client_pthread_main, &ic->cfg);
-	if (rc != 0) {
-		Log1(PCSC_LOG_ERROR, "Error creating remsim-client pthread\n");
-		close(sp[0]);
-		close(sp[1]);
-		talloc_free(ic);
-		return NULL;
+	req.chan = &ic->chan;
+	req.cfg = &ic->cfg;
+	if (ifd_xceive(&it->ctrl, &req) < 0 || req.status != 0) {
+		Log1(PCSC_LOG_ERROR, "Error opening Lun in remsim-client thread\n");
+		goto err;
 	}
+	it->num_luns++;
 
 	return ic;
+
+err:
+	if (ic->chan.done_fd >= 0)
+		close(ic->chan.done_fd);
+	put_ifd_thread(it);
+	talloc_free(ic);
+	return NULL;
 }
 
-/* function called on IFD side to destroy (terminate) remsim-client thread */
+/* function called on IFD side to stop serving a Lun, terminating its thread if unused */
 static void destroy_ifd_client(struct ifd_client *ic)
 {
+	struct itreq req = {
+		.type = ITMSG_TYPE_CLOSE_REQ,
+	};
+
 	if (!ic)
 		return;
 
-	pthread_cancel(ic->pthread);
-	pthread_join(ic->pthread, NULL);
+	req.chan = &ic->chan;
+	ifd_xceive(&ic->thread->ctrl, &req);
+	ic->thread->num_luns--;
+	put_ifd_thread(ic->thread);
+
+	close(ic->chan.done_fd);
+	talloc_free(ic);
 }
 
 #define MAX_SLOTS	256
@@ -563,13 +800,13 @@ RESPONSECODE IFDHCreateChannel(DWORD Lun, DWORD Channel)
 RESPONSECODE IFDHCreateChannelByName(DWORD Lun, LPSTR DeviceName)
 {
 	struct ifd_client *ic;
-	struct client_thread_cfg cfg = {
+	struct client_lun_cfg cfg = {
 		.server_host = "127.0.0.1",
 		.server_port = -1,
 		.client_id = 0,
 		.client_slot = 0,
 	};
-	char *r, *client_id, *slot_nr, *host, *port;
+	char *r, *client_id, *slot_nr, *host, *port, *mode;
 
 	if (LUN2RDR(Lun) != 0)
 		return IFD_NO_SUCH_DEVICE;
@@ -579,6 +816,8 @@ RESPONSECODE IFDHCreateChannelByName(DWORD Lun, LPSTR DeviceName)
 
 	ensure_osmo_ctx();
 
+	cfg.lun_slot = LUN2SLOT(Lun);
+
 	client_id = strtok_r(DeviceName, ":", &r);
 	if (!client_id)
 		goto end_parse;
@@ -595,12 +834,18 @@ RESPONSECODE IFDHCreateChannelByName(DWORD Lun, LPSTR DeviceName)
 	cfg.server_host = strdup(host);
 
 	port = strtok_r(NULL, ":", &r);
+	if (!port)
+		goto end_parse;
 	cfg.server_port = atoi(port);
 
+	mode = strtok_r(NULL, ":", &r);
+	if (mode && !strcmp(mode, "shared"))
+		cfg.shared = true;
 
 end_parse:
-	LOGP(DMAIN, LOGL_NOTICE, "remsim-client C%d:%d bankd=%s:%d\n",
-		cfg.client_id, cfg.client_slot, cfg.server_host, cfg.server_port);
+	LOGP(DMAIN, LOGL_NOTICE, "remsim-client C%d:%d bankd=%s:%d%s\n",
+		cfg.client_id, cfg.client_slot, cfg.server_host, cfg.server_port,
+		cfg.shared ? " (shared thread)" : "");
 
 	ic = create_ifd_client(&cfg);
 	if (ic) {
@@ -665,8 +910,7 @@ RESPONSECODE IFDHGetCapabilities(DWORD Lun, DWORD Tag, PDWORD Length, PUCHAR Val
 {
 	RESPONSECODE r = IFD_COMMUNICATION_ERROR;
 	struct ifd_client *ic;
-	struct msgb *rx, *tx;
-	struct itmsg *rx_it;
+	struct itreq req;
 
 	ensure_osmo_ctx();
 
@@ -692,18 +936,16 @@ RESPONSECODE IFDHGetCapabilities(DWORD Lun, DWORD Tag, PDWORD Length, PUCHAR Val
 	switch (Tag) {
 	case TAG_IFD_ATR:
 		/* Return the ATR and its size */
-		tx = itmsg_alloc(ITMSG_TYPE_ATR_REQ, 0, NULL, 0);
-		OSMO_ASSERT(tx);
-		rx = ifd_xceive_client(ic, tx);
-		if (!rx) {
+		req = (struct itreq) {
+			.type = ITMSG_TYPE_ATR_REQ,
+			.rx = Value,
+			.rx_size = *Length,
+		};
+		if (ifd_xceive_client(ic, &req) < 0) {
 			r = IFD_NO_SUCH_DEVICE;
 			goto err;
 		}
-		rx_it = (struct itmsg *)msgb_data(rx);
-		if (*Length > rx_it->len)
-			*Length = rx_it->len;
-		memcpy(Value, rx_it->data, *Length);
-		msgb_free(rx);
+		*Length = req.rx_len;
 		break;
 	case TAG_IFD_SIMULTANEOUS_ACCESS:
 		/* Return the number of sessions (readers) the driver
@@ -790,7 +1032,7 @@ RESPONSECODE IFDHPowerICC(DWORD Lun, DWORD Action, PUCHAR Atr, PDWORD AtrLength)
 {
 	RESPONSECODE r = IFD_COMMUNICATION_ERROR;
 	struct ifd_client *ic;
-	struct msgb *rx, *tx;
+	struct itreq req = {};
 
 	ensure_osmo_ctx();
 
@@ -812,27 +1054,25 @@ RESPONSECODE IFDHPowerICC(DWORD Lun, DWORD Action, PUCHAR Atr, PDWORD AtrLength)
 
 	switch (Action) {
 	case IFD_POWER_DOWN:
-		tx = itmsg_alloc(ITMSG_TYPE_POWER_OFF_REQ, 0, NULL, 0);
+		req.type = ITMSG_TYPE_POWER_OFF_REQ;
 		break;
 	case IFD_POWER_UP:
-		tx = itmsg_alloc(ITMSG_TYPE_POWER_ON_REQ, 0, NULL, 0);
+		req.type = ITMSG_TYPE_POWER_ON_REQ;
 		break;
 	case IFD_RESET:
-		tx = itmsg_alloc(ITMSG_TYPE_RESET_REQ, 0, NULL, 0);
+		req.type = ITMSG_TYPE_RESET_REQ;
 		break;
 	default:
 		r = IFD_NOT_SUPPORTED;
 		goto err;
 	}
 
-	rx = ifd_xceive_client(ic, tx);
-	if (!rx) {
+	if (ifd_xceive_client(ic, &req) < 0) {
 		r = IFD_NO_SUCH_DEVICE;
 		goto err;
 	}
 
 	r = IFD_SUCCESS;
-	msgb_free(rx);
 
 err:
 	if (r != IFD_SUCCESS && AtrLength)
@@ -850,8 +1090,7 @@ RESPONSECODE IFDHTransmitToICC(DWORD Lun, SCARD_IO_HEADER SendPci, PUCHAR TxBuff
 {
 	RESPONSECODE r = IFD_COMMUNICATION_ERROR;
 	struct ifd_client *ic;
-	struct msgb *rx, *tx;
-	struct itmsg *rx_it;
+	struct itreq req;
 
 	ensure_osmo_ctx();
 
@@ -871,19 +1110,25 @@ RESPONSECODE IFDHTransmitToICC(DWORD Lun, SCARD_IO_HEADER SendPci, PUCHAR TxBuff
 		goto err;
 	}
 
-	tx = itmsg_alloc(ITMSG_TYPE_C_APDU_REQ, 0, TxBuffer, TxLength);
-	OSMO_ASSERT(tx);
+	req = (struct itreq) {
+		.type = ITMSG_TYPE_C_APDU_REQ,
+		.tx = TxBuffer,
+		.tx_len = TxLength,
+		.rx = RxBuffer,
+		.rx_size = *RxLength,
+	};
 	/* transmit C-APDU to remote reader + blocking wait for response from peer */
-	rx = ifd_xceive_client(ic, tx);
-	if (!rx) {
+	if (ifd_xceive_client(ic, &req) < 0) {
 		r = IFD_NO_SUCH_DEVICE;
 		goto err;
 	}
-	rx_it = (struct itmsg *) msgb_data(rx);
-	if (*RxLength > rx_it->len)
-		*RxLength = rx_it->len;
-	memcpy(RxBuffer, rx_it->data, *RxLength);
-	msgb_free(rx);
+	if (req.status == ITREQ_ST_RX_OVERFLOW) {
+		r = IFD_ERROR_INSUFFICIENT_BUFFER;
+		goto err;
+	}
+	if (req.status != 0)
+		goto err;
+	*RxLength = req.rx_len;
 
 	r = IFD_SUCCESS;
 err:
@@ -898,8 +1143,9 @@ RESPONSECODE IFDHICCPresence(DWORD Lun)
 {
 	RESPONSECODE r = IFD_COMMUNICATION_ERROR;
 	struct ifd_client *ic;
-	struct msgb *rx, *tx;
-	struct itmsg *rx_it;
+	struct itreq req = {
+		.type = ITMSG_TYPE_CARD_PRES_REQ,
+	};
 
 	ensure_osmo_ctx();
 
@@ -919,15 +1165,11 @@ RESPONSECODE IFDHICCPresence(DWORD Lun)
 		goto err;
 	}
 
-	tx = itmsg_alloc(ITMSG_TYPE_CARD_PRES_REQ, 0, NULL, 0);
-	OSMO_ASSERT(tx);
-	rx = ifd_xceive_client(ic, tx);
-	if (!rx) {
+	if (ifd_xceive_client(ic, &req) < 0) {
 		r = IFD_NO_SUCH_DEVICE;
 		goto err;
 	}
-	rx_it = (struct itmsg *) msgb_data(rx);
-	if (rx_it->status == 0)
+	if (req.status == 0)
 		r = IFD_SUCCESS;
 	else
 		r = IFD_ICC_NOT_PRESENT;
@@ -105,7 +105,6 @@ static void handle_stdin_command(struct stdin_state *ss, char *cmd)
 		};
 		osmo_fsm_inst_dispatch(bc->main_fi, MF_E_MDM_STATUS_IND, &pstatus);
 	} else {
-		struct frontend_tpdu ftpdu;
 		uint8_t buf[1024];
 
 		/* we assume the user has entered a C-APDU as hex string. parse + send */
@@ -120,9 +119,7 @@ static void handle_stdin_command(struct stdin_state *ss, char *cmd)
 		}
 
 		/* Send CMD APDU to [remote] card */
-		ftpdu.buf = buf;
-		ftpdu.len = rc;
-		osmo_fsm_inst_dispatch(bc->main_fi, MF_E_MDM_TPDU, &ftpdu);
+		main_fsm_tx_tpdu(bc, buf, rc);
 	}
 }
 
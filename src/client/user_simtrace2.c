@@ -23,7 +23,9 @@
 
 #include <osmocom/core/fsm.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/linuxlist.h>
 
 #include <osmocom/usb/libusb.h>
 
@@ -33,6 +35,7 @@
 
 #include "client.h"
 #include "debug.h"
+#include "st2_usb_pool.h"
 
 #define LOGCI(ci, lvl, fmt, args ...) \
 	LOGP(DST2, lvl, fmt, ## args)
@@ -82,36 +85,42 @@ __attribute__((unused)) static int process_do_error(struct osmo_st2_cardem_inst
 	return 0;
 }
 
-static struct osmo_apdu_context ac; // this will hold the complete APDU (across calls)
+/* per-client state of the simtrace2 frontend, in bc->data */
+struct st2_client {
+	struct osmo_st2_transport transp;
+	struct osmo_st2_slot slot;
+	/* this will hold the complete APDU (across calls) */
+	struct osmo_apdu_context ac;
+	struct st2_usb_pool *pool;
+};
 
 /*! \brief Process a RX-DATA indication message from the SIMtrace2 */
 static int process_do_rx_da(struct osmo_st2_cardem_inst *ci, uint8_t *buf, int len)
 {
 	struct cardemu_usb_msg_rx_data *data = (struct cardemu_usb_msg_rx_data *) buf;
 	struct bankd_client *bc = ci->priv;
-	struct frontend_tpdu ftpdu;
+	struct st2_client *st2 = bc->data;
+	struct osmo_apdu_context *ac = &st2->ac;
 	int rc;
 
 	LOGCI(ci, LOGL_DEBUG, "SIMtrace => DATA: flags=%x, %s\n", data->flags,
 		osmo_hexdump(data->data, data->data_len));
 
  	/* parse the APDU data in the USB message */
-	rc = osmo_apdu_segment_in(&ac, data->data, data->data_len,
+	rc = osmo_apdu_segment_in(ac, data->data, data->data_len,
 				  data->flags & CEMU_DATA_F_TPDU_HDR);
 
 	if (rc & APDU_ACT_TX_CAPDU_TO_CARD) {
 		/* there is no pending data coming from the modem */
-		uint8_t apdu_command[sizeof(ac.hdr) + ac.lc.tot];
-		memcpy(apdu_command, &ac.hdr, sizeof(ac.hdr));
-		if (ac.lc.tot)
-			memcpy(apdu_command + sizeof(ac.hdr), ac.dc, ac.lc.tot);
+		uint8_t apdu_command[sizeof(ac->hdr) + ac->lc.tot];
+		memcpy(apdu_command, &ac->hdr, sizeof(ac->hdr));
+		if (ac->lc.tot)
+			memcpy(apdu_command + sizeof(ac->hdr), ac->dc, ac->lc.tot);
 		/* send APDU to card */
-		ftpdu.buf = apdu_command;
-		ftpdu.len = sizeof(ac.hdr) + ac.lc.tot;
-		osmo_fsm_inst_dispatch(bc->main_fi, MF_E_MDM_TPDU, &ftpdu);
-	} else if (ac.lc.tot > ac.lc.cur) {
+		main_fsm_tx_tpdu(bc, apdu_command, sizeof(ac->hdr) + ac->lc.tot);
+	} else if (ac->lc.tot > ac->lc.cur) {
 		/* there is pending data from the modem: send procedure byte to get remaining data */
-		osmo_st2_cardem_request_pb_and_rx(ci, ac.hdr.ins, ac.lc.tot - ac.lc.cur);
+		osmo_st2_cardem_request_pb_and_rx(ci, ac->hdr.ins, ac->lc.tot - ac->lc.cur);
 	}
 	return 0;
 }
@@ -205,15 +214,14 @@ static int process_usb_msg_irq(struct osmo_st2_cardem_inst *ci, const uint8_t *b
 	return rc;
 }
 
-static void usb_in_xfer_cb(struct libusb_transfer *xfer)
-{
-	struct osmo_st2_cardem_inst *ci = xfer->user_data;
-	int rc;
+/***********************************************************************
+ * USB transfers, see st2_usb_pool.h
+ ***********************************************************************/
 
+static void usb_xfer_check_status(struct osmo_st2_cardem_inst *ci, struct libusb_transfer *xfer)
+{
 	switch (xfer->status) {
 	case LIBUSB_TRANSFER_COMPLETED:
-		/* hand the message up the stack */
-		process_usb_msg(ci, xfer->buffer, xfer->actual_length);
 		break;
 	case LIBUSB_TRANSFER_NO_DEVICE:
 		LOGCI(ci, LOGL_FATAL, "USB device disappeared\n");
@@ -224,89 +232,74 @@ static void usb_in_xfer_cb(struct libusb_transfer *xfer)
 		exit(1);
 		break;
 	}
-
-	/* re-submit the IN transfer */
-	rc = libusb_submit_transfer(xfer);
-	OSMO_ASSERT(rc == 0);
 }
 
+static void usb_xfer_cb(struct libusb_transfer *xfer)
+{
+	struct st2_urb *urb = xfer->user_data;
 
-static void allocate_and_submit_in(struct osmo_st2_cardem_inst *ci)
+	usb_xfer_check_status(urb->pool->priv, xfer);
+	st2_usb_pool_completed(urb, xfer->actual_length);
+}
+
+static void usb_pool_init_urb(struct st2_urb *urb)
 {
+	struct osmo_st2_cardem_inst *ci = urb->pool->priv;
 	struct osmo_st2_transport *transp = ci->slot->transp;
 	struct libusb_transfer *xfer;
-	int rc;
 
 	xfer = libusb_alloc_transfer(0);
 	OSMO_ASSERT(xfer);
 	xfer->dev_handle = transp->usb_devh;
 	xfer->flags = 0;
-	xfer->type = LIBUSB_TRANSFER_TYPE_BULK;
-	xfer->endpoint = transp->usb_ep.in;
 	xfer->timeout = 0;
-	xfer->user_data = ci;
-	xfer->length = 16*256;
-
-	xfer->buffer = libusb_dev_mem_alloc(xfer->dev_handle, xfer->length);
-	OSMO_ASSERT(xfer->buffer);
-	xfer->callback = usb_in_xfer_cb;
-
-	/* submit the IN transfer */
-	rc = libusb_submit_transfer(xfer);
-	OSMO_ASSERT(rc == 0);
+	xfer->user_data = urb;
+	xfer->callback = usb_xfer_cb;
+	if (urb->irq) {
+		xfer->type = LIBUSB_TRANSFER_TYPE_INTERRUPT;
+		xfer->endpoint = transp->usb_ep.irq_in;
+		xfer->length = ST2_IRQ_BUF_SIZE;
+	} else {
+		xfer->type = LIBUSB_TRANSFER_TYPE_BULK;
+		xfer->endpoint = transp->usb_ep.in;
+		xfer->length = ST2_IN_BUF_SIZE;
+	}
+	urb->xfer = xfer;
 }
 
-
-static void usb_irq_xfer_cb(struct libusb_transfer *xfer)
+static void usb_pool_submit_urb(struct st2_urb *urb)
 {
-	struct osmo_st2_cardem_inst *ci = xfer->user_data;
+	struct libusb_transfer *xfer = urb->xfer;
 	int rc;
 
-	switch (xfer->status) {
-	case LIBUSB_TRANSFER_COMPLETED:
-		process_usb_msg_irq(ci, xfer->buffer, xfer->actual_length);
-		break;
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		LOGCI(ci, LOGL_FATAL, "USB device disappeared\n");
-		exit(1);
-		break;
-	default:
-		LOGCI(ci, LOGL_FATAL, "USB IN transfer failed, status=%u\n", xfer->status);
-		exit(1);
-		break;
-	}
-
-	/* re-submit the IN transfer */
+	xfer->buffer = urb->buf->data;
 	rc = libusb_submit_transfer(xfer);
 	OSMO_ASSERT(rc == 0);
 }
 
-
-static void allocate_and_submit_irq(struct osmo_st2_cardem_inst *ci)
+static void usb_pool_process(struct st2_usb_pool *pool, const struct st2_usb_buf *buf)
 {
-	struct osmo_st2_transport *transp = ci->slot->transp;
-	struct libusb_transfer *xfer;
-	int rc;
-
-	xfer = libusb_alloc_transfer(0);
-	OSMO_ASSERT(xfer);
-	xfer->dev_handle = transp->usb_devh;
-	xfer->flags = 0;
-	xfer->type = LIBUSB_TRANSFER_TYPE_INTERRUPT;
-	xfer->endpoint = transp->usb_ep.irq_in;
-	xfer->timeout = 0;
-	xfer->user_data = ci;
-	xfer->length = 64;
+	if (buf->irq)
+		process_usb_msg_irq(pool->priv, buf->data, buf->len);
+	else
+		process_usb_msg(pool->priv, buf->data, buf->len);
+}
 
-	xfer->buffer = libusb_dev_mem_alloc(xfer->dev_handle, xfer->length);
-	OSMO_ASSERT(xfer->buffer);
-	xfer->callback = usb_irq_xfer_cb;
+/* DMA-able memory, if supported; libusb uses bounce buffers otherwise */
+static uint8_t *usb_pool_alloc_mem(struct st2_usb_pool *pool, unsigned int size)
+{
+	struct osmo_st2_cardem_inst *ci = pool->priv;
 
-	/* submit the IN transfer */
-	rc = libusb_submit_transfer(xfer);
-	OSMO_ASSERT(rc == 0);
+	return libusb_dev_mem_alloc(ci->slot->transp->usb_devh, size);
 }
 
+static const struct st2_usb_pool_ops usb_pool_ops = {
+	.init_urb = usb_pool_init_urb,
+	.submit_urb = usb_pool_submit_urb,
+	.process = usb_pool_process,
+	.alloc_mem = usb_pool_alloc_mem,
+};
+
 
 
 
@@ -347,15 +340,17 @@ int frontend_request_modem_reset(struct bankd_client *bc)
 int frontend_handle_card2modem(struct bankd_client *bc, const uint8_t *data, size_t len)
 {
 	struct osmo_st2_cardem_inst *ci = bc->cardem;
+	struct st2_client *st2 = bc->data;
+	struct osmo_apdu_context *ac = &st2->ac;
 	// save SW to our current APDU context
-	ac.sw[0] = data[len-2];
-	ac.sw[1] = data[len-1];
+	ac->sw[0] = data[len-2];
+	ac->sw[1] = data[len-1];
 
-	LOGCI(ci, LOGL_DEBUG, "SIMtrace <= SW=0x%02x%02x, len_rx=%zu\n", ac.sw[0], ac.sw[1], len-2);
+	LOGCI(ci, LOGL_DEBUG, "SIMtrace <= SW=0x%02x%02x, len_rx=%zu\n", ac->sw[0], ac->sw[1], len-2);
 	if (len > 2) { // send PB and data to modem
-		osmo_st2_cardem_request_pb_and_tx(ci, ac.hdr.ins, data, len-2);
+		osmo_st2_cardem_request_pb_and_tx(ci, ac->hdr.ins, data, len-2);
 	}
-	osmo_st2_cardem_request_sw_tx(ci, ac.sw); // send SW to modem
+	osmo_st2_cardem_request_sw_tx(ci, ac->sw); // send SW to modem
 	return 0;
 }
 
@@ -374,42 +369,43 @@ int frontend_handle_slot_status(struct bankd_client *bc, const SlotPhysStatus_t
 int frontend_append_script_env(struct bankd_client *bc, char **env, int i, size_t max_env)
 {
 	struct osmo_st2_cardem_inst *ci = bc->cardem;
+	struct st2_client *st2 = bc->data;
+	struct st2_usb_pool *pool = st2->pool;
 
-	if (max_env < 4)
+	if (max_env < 6)
 		return -ENOSPC;
 
 	env[i++] = talloc_asprintf(env, "REMSIM_USB_PATH=%s", ci->usb_path);
 	/* TODO: Configuration; Altsetting */
 	env[i++] = talloc_asprintf(env, "REMSIM_USB_INTERFACE=%u", bc->cfg->usb.if_num);
+	if (pool) {
+		env[i++] = talloc_asprintf(env, "REMSIM_USB_IN_URBS=%u", pool->num_in);
+		env[i++] = talloc_asprintf(env, "REMSIM_USB_IN_STARVED=%lu", pool->stats.in_starved);
+	}
 
 	return i;
 }
 
-/* FIXME: This must be cleaned up */
-static struct osmo_st2_transport _transp;
-static struct osmo_st2_slot _slot = {
-	.transp = &_transp,
-	.slot_nr = 0,
-};
-
-int client_user_main(struct bankd_client *bc)
+/* open the cardem USB device of a client and start receiving from it */
+static int st2_client_open(struct bankd_client *bc)
 {
 	struct usb_interface_match _ifm, *ifm = &_ifm;
 	struct osmo_st2_transport *transp;
 	struct osmo_st2_cardem_inst *ci;
+	struct st2_client *st2;
 	struct client_config *cfg = bc->cfg;
 	struct cardemu_usb_msg_config cardem_config = { .features = CEMU_FEAT_F_STATUS_IRQ };
-	int rc, i;
+	int rc;
 
-	rc = osmo_libusb_init(NULL);
-	if (rc < 0) {
-		LOGP(DMAIN, LOGL_ERROR, "libusb initialization failed\n");
-		return rc;
-	}
+	st2 = talloc_zero(bc, struct st2_client);
+	OSMO_ASSERT(st2);
+	st2->slot.transp = &st2->transp;
+	st2->slot.slot_nr = 0;
+	bc->data = st2;
 
 	ci = talloc_zero(bc, struct osmo_st2_cardem_inst);
 	OSMO_ASSERT(ci);
-	ci->slot = &_slot;
+	ci->slot = &st2->slot;
 	transp = ci->slot->transp;
 	ci->priv = bc;
 	bc->cardem = ci;
@@ -454,10 +450,9 @@ int client_user_main(struct bankd_client *bc)
 		goto close_exit;
 	}
 
-	allocate_and_submit_irq(ci);
-	/* submit multiple IN URB in order to work around OS#4409 */
-	for (i = 0; i < 4; i++)
-		allocate_and_submit_in(ci);
+	st2->pool = st2_usb_pool_alloc(ci, &usb_pool_ops, ci, cfg->simtrace.num_in_urbs,
+				       cfg->simtrace.max_in_urbs, cfg->simtrace.num_irq_urbs);
+	st2_usb_pool_start(st2->pool);
 
 	/* request firmware to generate STATUS on IRQ endpoint, set presence polarity */
 	if (cfg->simtrace.presence_valid) {
@@ -466,16 +461,45 @@ int client_user_main(struct bankd_client *bc)
 	}
 	osmo_st2_cardem_request_config2(ci, &cardem_config);
 
+	return 0;
+
+close_exit:
+	libusb_close(transp->usb_devh);
+	transp->usb_devh = NULL;
+	return -1;
+}
+
+/*! Serve several clients (each with a cardem USB device of its own) from one process and one
+ *  libusb context.  Returns only on error. */
+int client_user_main_multi(struct bankd_client **bcs, unsigned int num_bcs)
+{
+	unsigned int i;
+	int rc;
+
+	rc = osmo_libusb_init(NULL);
+	if (rc < 0) {
+		LOGP(DMAIN, LOGL_ERROR, "libusb initialization failed\n");
+		return rc;
+	}
+
+	for (i = 0; i < num_bcs; i++) {
+		rc = st2_client_open(bcs[i]);
+		if (rc < 0) {
+			/* devices opened so far have transfers submitted; the caller exits anyway */
+			if (i == 0)
+				osmo_libusb_exit(NULL);
+			return rc;
+		}
+	}
+
 	while (1) {
 		osmo_select_main(0);
 	}
 
 	return 0;
+}
 
-close_exit:
-	if (transp->usb_devh)
-		libusb_close(transp->usb_devh);
-	osmo_libusb_exit(NULL);
-
-	return -1;
+int client_user_main(struct bankd_client *bc)
+{
+	return client_user_main_multi(&bc, 1);
 }
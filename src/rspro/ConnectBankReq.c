@@ -34,6 +34,15 @@ static asn_TYPE_member_t asn_MBR_ConnectBankReq_1[] = {
 		0,
 		"numberOfSlots"
 		},
+	{ ATF_POINTER, 1, offsetof(struct ConnectBankReq, bankdSocketPath),
+		(ASN_TAG_CLASS_CONTEXT | (0 << 2)),
+		-1,	/* IMPLICIT tag at current level */
+		&asn_DEF_SocketPath,
+		0,	/* Defer constraints checking to the member type */
+		0,	/* PER is not compiled, use -gen-PER */
+		0,
+		"bankdSocketPath"
+		},
 };
 static const ber_tlv_tag_t asn_DEF_ConnectBankReq_tags_1[] = {
 	(ASN_TAG_CLASS_UNIVERSAL | (16 << 2))
@@ -41,16 +50,17 @@ static const ber_tlv_tag_t asn_DEF_ConnectBankReq_tags_1[] = {
 static const asn_TYPE_tag2member_t asn_MAP_ConnectBankReq_tag2el_1[] = {
     { (ASN_TAG_CLASS_UNIVERSAL | (2 << 2)), 1, 0, 1 }, /* bankId */
     { (ASN_TAG_CLASS_UNIVERSAL | (2 << 2)), 2, -1, 0 }, /* numberOfSlots */
-    { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 0, 0, 0 } /* identity */
+    { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 0, 0, 0 }, /* identity */
+    { (ASN_TAG_CLASS_CONTEXT | (0 << 2)), 3, 0, 0 } /* bankdSocketPath */
 };
 static asn_SEQUENCE_specifics_t asn_SPC_ConnectBankReq_specs_1 = {
 	sizeof(struct ConnectBankReq),
 	offsetof(struct ConnectBankReq, _asn_ctx),
 	asn_MAP_ConnectBankReq_tag2el_1,
-	3,	/* Count of tags in the map */
+	4,	/* Count of tags in the map */
 	0, 0, 0,	/* Optional elements (not needed) */
 	2,	/* Start extensions */
-	4	/* Stop extensions */
+	5	/* Stop extensions */
 };
 asn_TYPE_descriptor_t asn_DEF_ConnectBankReq = {
 	"ConnectBankReq",
@@ -73,7 +83,7 @@ asn_TYPE_descriptor_t asn_DEF_ConnectBankReq = {
 		/sizeof(asn_DEF_ConnectBankReq_tags_1[0]), /* 1 */
 	0,	/* No PER visible constraints */
 	asn_MBR_ConnectBankReq_1,
-	3,	/* Elements count */
+	4,	/* Elements count */
 	&asn_SPC_ConnectBankReq_specs_1	/* Additional specs */
 };
 
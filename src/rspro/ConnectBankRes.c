@@ -25,22 +25,32 @@ static asn_TYPE_member_t asn_MBR_ConnectBankRes_1[] = {
 		0,
 		"result"
 		},
+	{ ATF_POINTER, 1, offsetof(struct ConnectBankRes, retryAfterMs),
+		(ASN_TAG_CLASS_CONTEXT | (0 << 2)),
+		-1,	/* IMPLICIT tag at current level */
+		&asn_DEF_RetryAfterMs,
+		0,	/* Defer constraints checking to the member type */
+		0,	/* PER is not compiled, use -gen-PER */
+		0,
+		"retryAfterMs"
+		},
 };
 static const ber_tlv_tag_t asn_DEF_ConnectBankRes_tags_1[] = {
 	(ASN_TAG_CLASS_UNIVERSAL | (16 << 2))
 };
 static const asn_TYPE_tag2member_t asn_MAP_ConnectBankRes_tag2el_1[] = {
     { (ASN_TAG_CLASS_UNIVERSAL | (10 << 2)), 1, 0, 0 }, /* result */
-    { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 0, 0, 0 } /* identity */
+    { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 0, 0, 0 }, /* identity */
+    { (ASN_TAG_CLASS_CONTEXT | (0 << 2)), 2, 0, 0 } /* retryAfterMs */
 };
 static asn_SEQUENCE_specifics_t asn_SPC_ConnectBankRes_specs_1 = {
 	sizeof(struct ConnectBankRes),
 	offsetof(struct ConnectBankRes, _asn_ctx),
 	asn_MAP_ConnectBankRes_tag2el_1,
-	2,	/* Count of tags in the map */
+	3,	/* Count of tags in the map */
 	0, 0, 0,	/* Optional elements (not needed) */
 	1,	/* Start extensions */
-	3	/* Stop extensions */
+	4	/* Stop extensions */
 };
 asn_TYPE_descriptor_t asn_DEF_ConnectBankRes = {
 	"ConnectBankRes",
@@ -63,7 +73,7 @@ asn_TYPE_descriptor_t asn_DEF_ConnectBankRes = {
 		/sizeof(asn_DEF_ConnectBankRes_tags_1[0]), /* 1 */
 	0,	/* No PER visible constraints */
 	asn_MBR_ConnectBankRes_1,
-	2,	/* Elements count */
+	3,	/* Elements count */
 	&asn_SPC_ConnectBankRes_specs_1	/* Additional specs */
 };
 
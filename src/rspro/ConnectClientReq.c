@@ -16,7 +16,7 @@ static asn_TYPE_member_t asn_MBR_ConnectClientReq_1[] = {
 		0,
 		"identity"
 		},
-	{ ATF_POINTER, 1, offsetof(struct ConnectClientReq, clientSlot),
+	{ ATF_POINTER, 2, offsetof(struct ConnectClientReq, clientSlot),
 		(ASN_TAG_CLASS_UNIVERSAL | (16 << 2)),
 		0,
 		&asn_DEF_ClientSlot,
@@ -25,22 +25,32 @@ static asn_TYPE_member_t asn_MBR_ConnectClientReq_1[] = {
 		0,
 		"clientSlot"
 		},
+	{ ATF_POINTER, 1, offsetof(struct ConnectClientReq, tpduEncodings),
+		(ASN_TAG_CLASS_CONTEXT | (0 << 2)),
+		-1,	/* IMPLICIT tag at current level */
+		&asn_DEF_TpduEncodings,
+		0,	/* Defer constraints checking to the member type */
+		0,	/* PER is not compiled, use -gen-PER */
+		0,
+		"tpduEncodings"
+		},
 };
 static const ber_tlv_tag_t asn_DEF_ConnectClientReq_tags_1[] = {
 	(ASN_TAG_CLASS_UNIVERSAL | (16 << 2))
 };
 static const asn_TYPE_tag2member_t asn_MAP_ConnectClientReq_tag2el_1[] = {
     { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 0, 0, 1 }, /* identity */
-    { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 1, -1, 0 } /* clientSlot */
+    { (ASN_TAG_CLASS_UNIVERSAL | (16 << 2)), 1, -1, 0 }, /* clientSlot */
+    { (ASN_TAG_CLASS_CONTEXT | (0 << 2)), 2, 0, 0 } /* tpduEncodings */
 };
 static asn_SEQUENCE_specifics_t asn_SPC_ConnectClientReq_specs_1 = {
 	sizeof(struct ConnectClientReq),
 	offsetof(struct ConnectClientReq, _asn_ctx),
 	asn_MAP_ConnectClientReq_tag2el_1,
-	2,	/* Count of tags in the map */
+	3,	/* Count of tags in the map */
 	0, 0, 0,	/* Optional elements (not needed) */
 	1,	/* Start extensions */
-	3	/* Stop extensions */
+	4	/* Stop extensions */
 };
 asn_TYPE_descriptor_t asn_DEF_ConnectClientReq = {
 	"ConnectClientReq",
@@ -63,7 +73,7 @@ asn_TYPE_descriptor_t asn_DEF_ConnectClientReq = {
 		/sizeof(asn_DEF_ConnectClientReq_tags_1[0]), /* 1 */
 	0,	/* No PER visible constraints */
 	asn_MBR_ConnectClientReq_1,
-	2,	/* Elements count */
+	3,	/* Elements count */
 	&asn_SPC_ConnectClientReq_specs_1	/* Additional specs */
 };
 
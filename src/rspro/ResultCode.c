@@ -90,20 +90,22 @@ static const asn_INTEGER_enum_map_t asn_MAP_ResultCode_value2enum_1[] = {
 	{ 4,	26,	"unsupportedProtocolVersion" },
 	{ 5,	14,	"unknownSlotmap" },
 	{ 6,	13,	"identityInUse" },
+	{ 7,	13,	"tryAgainLater" },
 	{ 100,	14,	"cardNotPresent" },
 	{ 101,	16,	"cardUnresponsive" },
 	{ 102,	21,	"cardTransmissionError" }
 	/* This list is extensible */
 };
 static const unsigned int asn_MAP_ResultCode_enum2value_1[] = {
-	7,	/* cardNotPresent(100) */
-	9,	/* cardTransmissionError(102) */
-	8,	/* cardUnresponsive(101) */
+	8,	/* cardNotPresent(100) */
+	10,	/* cardTransmissionError(102) */
+	9,	/* cardUnresponsive(101) */
 	6,	/* identityInUse(6) */
 	2,	/* illegalBankId(2) */
 	1,	/* illegalClientId(1) */
 	3,	/* illegalSlotId(3) */
 	0,	/* ok(0) */
+	7,	/* tryAgainLater(7) */
 	5,	/* unknownSlotmap(5) */
 	4	/* unsupportedProtocolVersion(4) */
 	/* This list is extensible */
@@ -111,7 +113,7 @@ static const unsigned int asn_MAP_ResultCode_enum2value_1[] = {
 static const asn_INTEGER_specifics_t asn_SPC_ResultCode_specs_1 = {
 	asn_MAP_ResultCode_value2enum_1,	/* "tag" => N; sorted by tag */
 	asn_MAP_ResultCode_enum2value_1,	/* N => "tag"; sorted by N */
-	10,	/* Number of elements in the maps */
+	11,	/* Number of elements in the maps */
 	11,	/* Extensions before this member */
 	1,	/* Strict enumeration */
 	0,	/* Native long size */
@@ -0,0 +1,223 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bit16gen.h>
+#include <osmocom/core/bit32gen.h>
+#include <osmocom/core/bit64gen.h>
+
+#include "debug.h"
+#include "rspro_capture.h"
+
+/* size of the stdio buffer; must hold the largest record, as each record is flushed
+ * with a single write() */
+#define CAPTURE_BUF_SIZE	(sizeof(struct rspro_cap_rec_hdr) + UINT16_MAX)
+
+/***********************************************************************
+ * writer
+ ***********************************************************************/
+
+static int capture_fclose(struct rspro_capture *cap)
+{
+	int rc = 0;
+
+	if (cap->f) {
+		if (ferror(cap->f) | fclose(cap->f)) {
+			LOGP(DMAIN, LOGL_ERROR, "Error writing capture file, it may be incomplete\n");
+			rc = -EIO;
+		}
+		cap->f = NULL;
+	}
+	return rc;
+}
+
+static int capture_destructor(struct rspro_capture *cap)
+{
+	capture_fclose(cap);
+	pthread_mutex_destroy(&cap->mutex);
+	return 0;
+}
+
+/*! Open a capture file for writing; an existing file is truncated.
+ *  \returns capture on success; NULL on error (with errno set) */
+struct rspro_capture *rspro_capture_open(void *ctx, const char *path)
+{
+	struct rspro_capture *cap;
+	struct rspro_cap_file_hdr fh;
+	int fd, rc;
+
+	cap = talloc_zero(ctx, struct rspro_capture);
+	if (!cap)
+		return NULL;
+	pthread_mutex_init(&cap->mutex, NULL);
+	talloc_set_destructor(cap, capture_destructor);
+
+	/* the capture contains subscriber data (IMSI, authentication APDUs): private to us */
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		goto err;
+	cap->f = fdopen(fd, "w");
+	if (!cap->f) {
+		rc = errno;
+		close(fd);
+		errno = rc;
+		goto err;
+	}
+	setvbuf(cap->f, NULL, _IOFBF, CAPTURE_BUF_SIZE);
+
+	memset(&fh, 0, sizeof(fh));
+	memcpy(fh.magic, RSPRO_CAP_MAGIC, sizeof(fh.magic));
+	osmo_store16be(RSPRO_CAP_VERSION, &fh.version);
+	if (fwrite(&fh, sizeof(fh), 1, cap->f) != 1 || fflush(cap->f) != 0)
+		goto err;
+
+	LOGP(DMAIN, LOGL_NOTICE, "Capturing RSPRO connections to %s\n", path);
+	return cap;
+
+err:
+	rc = errno;
+	LOGP(DMAIN, LOGL_ERROR, "Cannot open capture file %s: %s\n", path, strerror(rc));
+	talloc_free(cap);
+	errno = rc;
+	return NULL;
+}
+
+/*! Close a capture file.
+ *  \returns 0 on success; -EIO if any record could not be written */
+int rspro_capture_close(struct rspro_capture *cap)
+{
+	int rc = capture_fclose(cap);
+
+	talloc_free(cap);
+	return rc;
+}
+
+static void capture_write(struct rspro_capture *cap, uint32_t conn_id, enum rspro_cap_event ev,
+			  uint8_t ipa_proto, int ipa_proto_ext, const uint8_t *data, size_t len)
+{
+	struct rspro_cap_rec_hdr rh;
+	struct timespec ts;
+	uint8_t ext = ipa_proto_ext;
+
+	if (ipa_proto_ext >= 0)
+		len = OSMO_MIN(len, UINT16_MAX - 1);
+	else
+		len = OSMO_MIN(len, UINT16_MAX);
+
+	osmo_store32be(conn_id, &rh.conn_id);
+	osmo_store16be(len + (ipa_proto_ext >= 0 ? 1 : 0), &rh.len);
+	rh.event = ev;
+	rh.ipa_proto = ipa_proto;
+
+	/* a failing capture must never affect the actual operation, so errors are only
+	 * visible through ferror() at close time.  Each record is flushed, so that the
+	 * capture is complete up to the last frame even if we crash or get killed. */
+	pthread_mutex_lock(&cap->mutex);
+	/* under the mutex, so that records of all threads are written in timestamp order */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	osmo_store64be((uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec, &rh.ts_ns);
+	fwrite(&rh, sizeof(rh), 1, cap->f);
+	if (ipa_proto_ext >= 0)
+		fwrite(&ext, 1, 1, cap->f);
+	if (len)
+		fwrite(data, len, 1, cap->f);
+	fflush(cap->f);
+	pthread_mutex_unlock(&cap->mutex);
+}
+
+/*! Record a new connection.
+ *  \param[in] peer printable description of the peer (address:port)
+ *  \returns connection identifier to use for further records of this connection */
+uint32_t rspro_capture_conn_open(struct rspro_capture *cap, const char *peer)
+{
+	uint32_t conn_id = __atomic_add_fetch(&cap->next_conn_id, 1, __ATOMIC_RELAXED);
+
+	capture_write(cap, conn_id, RSPRO_CAP_EV_OPEN, 0, -1, (const uint8_t *) peer,
+		      peer ? strlen(peer) : 0);
+	return conn_id;
+}
+
+void rspro_capture_conn_close(struct rspro_capture *cap, uint32_t conn_id)
+{
+	capture_write(cap, conn_id, RSPRO_CAP_EV_CLOSE, 0, -1, NULL, 0);
+}
+
+/*! Record an IPA frame received from / transmitted to the peer.
+ *  \param[in] ipa_proto IPA protocol of the frame
+ *  \param[in] ipa_proto_ext IPA extension protocol; negative if the frame has none
+ *  \param[in] data IPA payload (following the IPA header and extension byte)
+ *  \param[in] len length of data in bytes */
+void rspro_capture_frame(struct rspro_capture *cap, uint32_t conn_id, enum rspro_cap_event ev,
+			 uint8_t ipa_proto, int ipa_proto_ext, const uint8_t *data, size_t len)
+{
+	capture_write(cap, conn_id, ev, ipa_proto, ipa_proto_ext, data, len);
+}
+
+/***********************************************************************
+ * reader
+ ***********************************************************************/
+
+/*! Open a capture file for reading and verify its file header.
+ *  \returns stdio stream positioned at the first record; NULL on error (with errno set) */
+FILE *rspro_capture_reader_open(const char *path)
+{
+	struct rspro_cap_file_hdr fh;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+
+	if (fread(&fh, sizeof(fh), 1, f) != 1 ||
+	    memcmp(fh.magic, RSPRO_CAP_MAGIC, sizeof(fh.magic)) ||
+	    osmo_load16be(&fh.version) != RSPRO_CAP_VERSION) {
+		fclose(f);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return f;
+}
+
+/*! Read the next record from a capture file.
+ *  \returns 1 if a record was read; 0 at the end of the file; negative errno on error */
+int rspro_capture_read(FILE *f, struct rspro_cap_rec *rec)
+{
+	struct rspro_cap_rec_hdr rh;
+
+	if (fread(&rh, sizeof(rh), 1, f) != 1)
+		return feof(f) ? 0 : -EIO;
+
+	rec->ts_ns = osmo_load64be(&rh.ts_ns);
+	rec->conn_id = osmo_load32be(&rh.conn_id);
+	rec->len = osmo_load16be(&rh.len);
+	rec->event = rh.event;
+	rec->ipa_proto = rh.ipa_proto;
+
+	if (rec->len && fread(rec->data, rec->len, 1, f) != 1)
+		return -EIO;	/* truncated, e.g. writer was killed */
+
+	return 1;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/* Capture file of the IPA frames exchanged on RSPRO connections.
+ *
+ * The file starts with a struct rspro_cap_file_hdr, followed by records consisting of a
+ * struct rspro_cap_rec_hdr and rec_hdr.len bytes of data.  All multi-byte fields are in
+ * network byte order.  The data of RX/TX records is the IPA payload following the 3-byte
+ * IPA header, i.e. for IPAC_PROTO_OSMO it starts with the extension protocol byte.  The
+ * data of OPEN records is a printable description of the peer (address:port). */
+
+#define RSPRO_CAP_MAGIC		"RSPROCAP"
+#define RSPRO_CAP_VERSION	1
+
+struct rspro_cap_file_hdr {
+	char magic[8];
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t reserved2;
+} __attribute__((packed));
+
+enum rspro_cap_event {
+	RSPRO_CAP_EV_OPEN	= 1,	/* connection was established */
+	RSPRO_CAP_EV_CLOSE	= 2,	/* connection was closed */
+	RSPRO_CAP_EV_RX		= 3,	/* IPA frame received from the peer */
+	RSPRO_CAP_EV_TX		= 4,	/* IPA frame transmitted to the peer */
+};
+
+struct rspro_cap_rec_hdr {
+	/* CLOCK_REALTIME in nanoseconds */
+	uint64_t ts_ns;
+	/* identifies the connection within the capture file */
+	uint32_t conn_id;
+	uint16_t len;
+	uint8_t event;		/* enum rspro_cap_event */
+	uint8_t ipa_proto;	/* IPA protocol of RX/TX records, 0 otherwise */
+} __attribute__((packed));
+
+/* writer side; all functions are safe to call from multiple threads */
+struct rspro_capture {
+	FILE *f;
+	pthread_mutex_t mutex;
+	uint32_t next_conn_id;
+};
+
+struct rspro_capture *rspro_capture_open(void *ctx, const char *path);
+int rspro_capture_close(struct rspro_capture *cap);
+uint32_t rspro_capture_conn_open(struct rspro_capture *cap, const char *peer);
+void rspro_capture_conn_close(struct rspro_capture *cap, uint32_t conn_id);
+void rspro_capture_frame(struct rspro_capture *cap, uint32_t conn_id, enum rspro_cap_event ev,
+			 uint8_t ipa_proto, int ipa_proto_ext, const uint8_t *data, size_t len);
+
+/* reader side */
+struct rspro_cap_rec {
+	uint64_t ts_ns;
+	uint32_t conn_id;
+	enum rspro_cap_event event;
+	uint8_t ipa_proto;
+	uint16_t len;
+	uint8_t data[UINT16_MAX];
+};
+
+FILE *rspro_capture_reader_open(const char *path);
+int rspro_capture_read(FILE *f, struct rspro_cap_rec *rec);
@@ -18,9 +18,12 @@
 
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/socket.h>
 
 #include <talloc.h>
 
@@ -36,30 +39,19 @@
 #include "debug.h"
 #include "asn1c_helpers.h"
 #include "rspro_client_fsm.h"
+#include "rspro_sock_tune.h"
+#include "rspro_keepalive.h"
 
 #define S(x)	(1 << (x))
 
 #define T1_WAIT_CLIENT_CONN_RES		10
 #define T2_RECONNECT			10
 
-static const int k_reestablish_delay_s[] = {
-	0, 0, 0,                            // 3 immediate retries
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,       // 1 Hz for 30 seconds
-	2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
-	2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
-	2, 2, 2, 2, 2, 2, 2, 2, 2, 2,       // 1/2 hz for 1 minute
-	4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-	4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
-	4, 4, 4, 4, 4, 4, 4, 4, 4, 4,       // 1/4 Hz for 2 minutes
-	8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-	8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-	8, 8, 8, 8, 8, 8, 8, 8, 8, 8,       // 1/8 Hz for 4 minutes
-	16,                                 // 1/16 Hz thereafter
-};
-
-#define REESTABLISH_DELAY_COUNT ARRAY_SIZE(k_reestablish_delay_s)
+/* Re-establishment attempts are delayed by an exponential backoff from 0.5s up to 16s, with
+ * "equal jitter": a random delay between half and all of the current ceiling.  After a server
+ * restart, the thousands of clients and bankds reconnecting thus don't do so in lock-step. */
+#define REESTABLISH_BACKOFF_MIN_MS	500
+#define REESTABLISH_BACKOFF_MAX_MS	16000
 
 /***********************************************************************
  * client-side FSM for a RSPRO connection to remsim-server
@@ -82,9 +74,9 @@ static void push_and_send(struct osmo_stream_cli *cli, struct msgb *msg_tx)
 	/* msg_tx is now queued and will be freed. */
 }
 
-static int cli_conn_send_rspro(struct osmo_stream_cli *cli, RsproPDU_t *rspro)
+static int cli_conn_send_rspro(struct osmo_stream_cli *cli, RsproPDU_t *rspro, uint32_t tpdu_enc)
 {
-	struct msgb *msg = rspro_enc_msg(rspro);
+	struct msgb *msg = rspro_enc_msg_tpdu(rspro, tpdu_enc);
 	if (!msg) {
 		LOGP(DRSPRO, LOGL_ERROR, "Error encoding RSPRO: %s\n", rspro_msgt_name(rspro));
 		osmo_log_backtrace(DRSPRO, LOGL_ERROR);
@@ -95,10 +87,16 @@ static int cli_conn_send_rspro(struct osmo_stream_cli *cli, RsproPDU_t *rspro)
 	return 0;
 }
 
+/* connection via which srvc talks to its peer: our own, or the one of the owner we share */
+static struct osmo_stream_cli *srvc_cli(struct rspro_server_conn *srvc)
+{
+	return srvc->mux.owner ? srvc->mux.owner->conn : srvc->conn;
+}
+
 static int _server_conn_send_rspro(struct rspro_server_conn *srvc, RsproPDU_t *rspro)
 {
 	LOGPFSML(srvc->fi, LOGL_DEBUG, "Tx RSPRO %s\n", rspro_msgt_name(rspro));
-	return cli_conn_send_rspro(srvc->conn, rspro);
+	return cli_conn_send_rspro(srvc_cli(srvc), rspro, srvc->tpdu_enc);
 }
 
 int server_conn_send_rspro(struct rspro_server_conn *srvc, RsproPDU_t *rspro)
@@ -128,6 +126,28 @@ enum server_conn_fsm_state {
 	SRVC_ST_REESTABLISH,
 };
 
+/*! Transmit a TPDU in binary encoding, without going through FSM event dispatch and without
+ *  building an RsproPDU.
+ *  \param[in] hdr header pre-built by rspro_tpdu_hdr_init()
+ *  \returns 0 on success; -ENOTSUP if the peer doesn't support the binary encoding, in which
+ *	     case the caller must use server_conn_send_rspro(); other negative on error */
+int server_conn_send_tpdu(struct rspro_server_conn *srvc, const struct rspro_tpdu_hdr *hdr,
+			  const uint8_t *data, size_t len)
+{
+	struct msgb *msg;
+
+	if (srvc->fi->state != SRVC_ST_CONNECTED)
+		return -EPERM;
+	if (!(srvc->tpdu_enc & RSPRO_TPDU_ENC_BINARY))
+		return -ENOTSUP;
+
+	msg = rspro_enc_tpdu_hdr(hdr, data, len);
+	if (!msg)
+		return -ENOMEM;
+	push_and_send(srvc_cli(srvc), msg);
+	return 0;
+}
+
 static const struct value_string server_conn_fsm_event_names[] = {
 	OSMO_VALUE_STRING(SRVC_E_ESTABLISH),
 	OSMO_VALUE_STRING(SRVC_E_DISCONNECT),
@@ -136,13 +156,155 @@ static const struct value_string server_conn_fsm_event_names[] = {
 	OSMO_VALUE_STRING(SRVC_E_KA_TIMEOUT),
 	OSMO_VALUE_STRING(SRVC_E_CLIENT_CONN_RES),
 	OSMO_VALUE_STRING(SRVC_E_RSPRO_TX),
+	OSMO_VALUE_STRING(SRVC_E_MUX_DETACH),
 	{ 0, NULL }
 };
 
+/***********************************************************************
+ * multiplexing of several client slots over one connection to a bankd
+ *
+ * The first instance connecting to a given bankd owns the TCP connection.
+ * If the bankd indicates (by the clientSlot in its ConnectClientRes) that
+ * it accepts further client slots over that connection, further instances
+ * of the same thread connecting to that bankd become 'slaves' of the owner:
+ * they send their PDUs via the owner's connection, and the owner dispatches
+ * received PDUs to them based on the client slot they refer to.
+ ***********************************************************************/
+
+/* all instances of this thread; each thread runs its own osmo_select_main() loop */
+static __thread struct llist_head g_mux_conns;
+
+static struct llist_head *mux_conns(void)
+{
+	if (!g_mux_conns.next)
+		INIT_LLIST_HEAD(&g_mux_conns);
+	return &g_mux_conns;
+}
+
+/* find an established connection to the same bankd which we can share */
+static struct rspro_server_conn *mux_find_owner(const struct rspro_server_conn *srvc)
+{
+	struct rspro_server_conn *o;
+
+	llist_for_each_entry(o, mux_conns(), mux.list) {
+		if (o == srvc || !o->mux.enable || !o->mux.capable || o->mux.owner || !o->conn)
+			continue;
+		if (o->fi->state != SRVC_ST_CONNECTED)
+			continue;
+		if (!o->server_host || !srvc->server_host || strcmp(o->server_host, srvc->server_host) ||
+		    o->server_port != srvc->server_port)
+			continue;
+		return o;
+	}
+	return NULL;
+}
+
+static void mux_attach(struct rspro_server_conn *srvc, struct rspro_server_conn *owner)
+{
+	srvc->mux.owner = owner;
+	llist_add_tail(&srvc->mux.slave_entry, &owner->mux.slaves);
+}
+
+/* inform the bankd that our client slot no longer uses the shared connection */
+static void mux_send_detach(struct rspro_server_conn *srvc)
+{
+	RsproPDU_t *pdu;
+
+	if (!srvc->clslot)
+		return;
+	pdu = rspro_gen_ErrorInd(srvc->own_comp_id.type, ErrorSeverity_minor, ErrorCode_unexpectedDisconnect,
+				 NULL, srvc->clslot, NULL);
+	if (pdu)
+		_server_conn_send_rspro(srvc, pdu);
+}
+
+/* stop using the connection of our owner */
+static void mux_leave(struct rspro_server_conn *srvc, bool send_detach)
+{
+	if (send_detach)
+		mux_send_detach(srvc);
+	llist_del(&srvc->mux.slave_entry);
+	srvc->mux.owner = NULL;
+}
+
+/* our connection is lost; so it is for all our slaves */
+static void mux_slaves_down(struct rspro_server_conn *srvc)
+{
+	struct rspro_server_conn *s, *s2;
+
+	llist_for_each_entry_safe(s, s2, &srvc->mux.slaves, mux.slave_entry) {
+		mux_leave(s, false);
+		osmo_fsm_inst_dispatch(s->fi, SRVC_E_TCP_DOWN, NULL);
+	}
+}
+
+/* hand our (still working) connection over to our first slave, which becomes the owner */
+static void mux_handover(struct rspro_server_conn *srvc)
+{
+	struct rspro_server_conn *n, *s, *s2;
+
+	n = llist_first_entry(&srvc->mux.slaves, struct rspro_server_conn, mux.slave_entry);
+	mux_leave(n, false);
+	llist_for_each_entry_safe(s, s2, &srvc->mux.slaves, mux.slave_entry) {
+		llist_del(&s->mux.slave_entry);
+		mux_attach(s, n);
+	}
+
+	LOGPFSML(srvc->fi, LOGL_INFO, "Handing connection over to client slot %ld:%ld\n",
+		 n->clslot ? n->clslot->clientId : -1, n->clslot ? n->clslot->slotNr : -1);
+	n->conn = srvc->conn;
+	n->ka = srvc->ka;
+	talloc_steal(n->fi, n->conn);
+	osmo_stream_cli_set_data(n->conn, n);
+	srvc->conn = NULL;
+	srvc->ka = NULL;
+}
+
+/* determine the instance (ourselves or one of our slaves) a received PDU is destined to */
+static struct rspro_server_conn *mux_route_slot(struct rspro_server_conn *srvc, long client_id, long slot_nr)
+{
+	struct rspro_server_conn *s;
+
+	llist_for_each_entry(s, &srvc->mux.slaves, mux.slave_entry) {
+		if (s->clslot && s->clslot->clientId == client_id && s->clslot->slotNr == slot_nr)
+			return s;
+	}
+	return srvc;
+}
+
+static struct rspro_server_conn *mux_route(struct rspro_server_conn *srvc, const RsproPDU_t *pdu)
+{
+	const ClientSlot_t *cs;
+
+	if (llist_empty(&srvc->mux.slaves))
+		return srvc;
+	cs = rspro_get_client_slot(pdu);
+	if (!cs)
+		return srvc;
+
+	return mux_route_slot(srvc, cs->clientId, cs->slotNr);
+}
+
+/* give up our connection; if others share it, only detach our client slot from it */
+static void srvc_close(struct rspro_server_conn *srvc)
+{
+	if (srvc->mux.owner)
+		mux_leave(srvc, true);
+	else if (!llist_empty(&srvc->mux.slaves)) {
+		mux_send_detach(srvc);
+		mux_handover(srvc);
+	} else {
+		osmo_stream_cli_close(srvc->conn);
+		return;
+	}
+	osmo_fsm_inst_dispatch(srvc->fi, SRVC_E_TCP_DOWN, NULL);
+}
+
 static int srvc_connect_cb(struct osmo_stream_cli *cli)
 {
 	struct rspro_server_conn *srvc = osmo_stream_cli_get_data(cli);
 	LOGPFSML(srvc->fi, LOGL_NOTICE, "RSPRO link to %s:%d UP\n", srvc->server_host, srvc->server_port);
+	rspro_sock_tune_apply(osmo_stream_cli_get_fd(cli));
 	osmo_fsm_inst_dispatch(srvc->fi, SRVC_E_TCP_UP, 0);
 	return 0;
 }
@@ -153,10 +315,9 @@ static int srvc_disconnect_cb(struct osmo_stream_cli *cli)
 
 	LOGPFSML(srvc->fi, LOGL_NOTICE, "RSPRO link to %s:%d DOWN\n", srvc->server_host, srvc->server_port);
 
-	if (srvc->ka_fi) {
-		osmo_ipa_ka_fsm_stop(srvc->ka_fi);
-		osmo_ipa_ka_fsm_free(srvc->ka_fi);
-		srvc->ka_fi = NULL;
+	if (srvc->ka) {
+		talloc_free(srvc->ka);
+		srvc->ka = NULL;
 	}
 
 	osmo_fsm_inst_dispatch(srvc->fi, SRVC_E_TCP_DOWN, 0);
@@ -219,10 +380,20 @@ err:
 	return -1;
 }
 
+static void srvc_sock_tune_timer_cb(void *data)
+{
+	struct rspro_server_conn *srvc = data;
+
+	if (srvc->conn)
+		rspro_sock_tune_rx(osmo_stream_cli_get_fd(srvc->conn));
+}
+
 static int srvc_read_cb(struct osmo_stream_cli *cli, int res, struct msgb *msg)
 {
 	enum ipaccess_proto ipa_proto = osmo_ipa_msgb_cb_proto(msg);
 	struct rspro_server_conn *srvc = osmo_stream_cli_get_data(cli);
+	struct rspro_server_conn *dst;
+	struct rspro_tpdu_view tpdu;
 	RsproPDU_t *pdu;
 	int rc;
 
@@ -230,6 +401,9 @@ static int srvc_read_cb(struct osmo_stream_cli *cli, int res, struct msgb *msg)
 		LOGPFSML(srvc->fi, LOGL_NOTICE, "failed reading from socket: %d\n", res);
 		goto err;
 	}
+	if (!rspro_addr_is_unix(srvc->server_host))
+		rspro_sock_tune_rx_defer(&srvc->sock_tune_timer);
+	rspro_ka_rx(srvc->ka);
 
 	switch (ipa_proto) {
 	case IPAC_PROTO_IPACCESS:
@@ -240,25 +414,33 @@ static int srvc_read_cb(struct osmo_stream_cli *cli, int res, struct msgb *msg)
 			msgb_free(msg);
 			break;
 		}
-		switch (msg_type) {
-		case IPAC_MSGT_PONG:
-			osmo_ipa_ka_fsm_pong_received(srvc->ka_fi);
+		if (msg_type == IPAC_MSGT_PONG)
 			rc = 0;
-			break;
-		default:
-			break;
-		}
 		break;
 	case IPAC_PROTO_OSMO:
 		switch (osmo_ipa_msgb_cb_proto_ext(msg)) {
 		case IPAC_PROTO_EXT_RSPRO:
 			LOGPFSML(srvc->fi, LOGL_DEBUG, "Received RSPRO %s\n", msgb_hexdump(msg));
+			/* fast path for the data plane: no RsproPDU, no copy of the TPDU */
+			if (rspro_dec_tpdu_view(&tpdu, msgb_l2(msg), msgb_l2len(msg)) == 0 &&
+			    tpdu.type == RSPRO_BIN_TPDU_C2M) {
+				dst = mux_route_slot(srvc, tpdu.to_id, tpdu.to_slot);
+				if (dst->handle_tpdu) {
+					rc = dst->handle_tpdu(dst, &tpdu);
+					break;
+				}
+			}
 			pdu = rspro_dec_msg(msg);
 			if (!pdu) {
 				rc = -EIO;
 				break;
 			}
-			rc = srvc->handle_rx(srvc, pdu);
+			dst = mux_route(srvc, pdu);
+			if (dst->mux.enable && rspro_is_client_slot_detach(pdu)) {
+				LOGPFSML(dst->fi, LOGL_NOTICE, "bankd detached our client slot\n");
+				rc = osmo_fsm_inst_dispatch(dst->fi, SRVC_E_MUX_DETACH, NULL);
+			} else
+				rc = dst->handle_rx(dst, pdu);
 			ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
 			break;
 		default:
@@ -285,31 +467,59 @@ static int64_t get_monotonic_ms(void)
 	return ((1000LL * t.tv_sec) + (t.tv_nsec / 1000000));
 }
 
+/* random number in 0..max (inclusive) */
+static int64_t backoff_rand(int64_t max)
+{
+	static __thread unsigned int seed;
+	static __thread bool seeded;
+
+	if (!seeded) {
+		if (osmo_get_rand_id((uint8_t *) &seed, sizeof(seed)) < 0)
+			seed = getpid() ^ time(NULL);
+		seeded = true;
+	}
+	return rand_r(&seed) % (max + 1);
+}
+
 static void srvc_do_reestablish(struct osmo_fsm_inst *fi)
 {
 	struct rspro_server_conn *srvc = (struct rspro_server_conn *) fi->priv;
 
 	const int64_t since_last_ms = get_monotonic_ms() - srvc->reestablish_last_ms;
+	int64_t ceil_ms, delay_ms;
 
 	/* reset delay loop if it has been > 2x the longest timeout since our last attempt;
 	 * this lets us revert to rapid reconnect behavior for a good connection */
-	const int64_t reset_ms = 2*1000*(OSMO_MAX(OSMO_MAX(T1_WAIT_CLIENT_CONN_RES, T2_RECONNECT),
-		k_reestablish_delay_s[REESTABLISH_DELAY_COUNT-1]));
+	const int64_t reset_ms = 2*OSMO_MAX(1000*OSMO_MAX(T1_WAIT_CLIENT_CONN_RES, T2_RECONNECT),
+		REESTABLISH_BACKOFF_MAX_MS);
 
 	if (since_last_ms > reset_ms) {
-		srvc->reestablish_delay_idx = 0;
+		srvc->reestablish_attempt = 0;
 		LOGPFSML(fi, LOGL_DEBUG, "->REESTABLISH_DELAY reset; %" PRId64 "ms since last attempt\n",
 			since_last_ms);
 	}
 
 	/* determine if we need to delay reestablishment */
-	const int64_t need_ms = (int64_t) k_reestablish_delay_s[srvc->reestablish_delay_idx] * 1000;
-	int64_t delay_ms = need_ms - since_last_ms;
+	ceil_ms = OSMO_MIN((int64_t) REESTABLISH_BACKOFF_MIN_MS << srvc->reestablish_attempt,
+			   (int64_t) REESTABLISH_BACKOFF_MAX_MS);
+	if (!srvc->reestablish_last_ms) {
+		/* our very first connection: no reason to wait */
+		delay_ms = 0;
+	} else if (srvc->reestablish_attempt == 0) {
+		/* first attempt after a good connection was lost: quickly, but not all at once */
+		delay_ms = backoff_rand(ceil_ms);
+	} else
+		delay_ms = ceil_ms / 2 + backoff_rand(ceil_ms / 2) - since_last_ms;
+
+	/* the server told us when it will have capacity for us again; don't come any earlier */
+	if (srvc->retry_after_ms) {
+		delay_ms = OSMO_MAX(delay_ms, srvc->retry_after_ms + backoff_rand(srvc->retry_after_ms / 10));
+		srvc->retry_after_ms = 0;
+	}
 
 	if (delay_ms > 0) {
-		LOGPFSML(fi, LOGL_DEBUG, "->REESTABLISH_DELAY delay %" PRId64 "ms; %" PRId64 "ms since last attempt [step %zu/%zu@%ds]\n",
-			delay_ms, since_last_ms, srvc->reestablish_delay_idx, (REESTABLISH_DELAY_COUNT-1),
-			k_reestablish_delay_s[srvc->reestablish_delay_idx]);
+		LOGPFSML(fi, LOGL_DEBUG, "->REESTABLISH_DELAY delay %" PRId64 "ms; %" PRId64 "ms since last attempt [attempt %u, ceiling %" PRId64 "ms]\n",
+			delay_ms, since_last_ms, srvc->reestablish_attempt, ceil_ms);
 	} else {
 		/* cheat and always use a minimum delay of 1ms to ensure a fsm timeout is triggered */
 		delay_ms = 1;
@@ -318,6 +528,22 @@ static void srvc_do_reestablish(struct osmo_fsm_inst *fi)
 	osmo_fsm_inst_state_chg_ms(fi, SRVC_ST_REESTABLISH_DELAY, delay_ms, 3);
 }
 
+/* the bankd has detached our client slot from the connection, like it would close a
+ * non-shared connection, e.g. because the slot mapping was removed.  Treat it like a lost
+ * connection, with the same backoff; otherwise a bankd rejecting our slot right away would
+ * see us asking again in a tight loop.  A connection which is ours alone is closed when
+ * entering REESTABLISH_DELAY. */
+static void srvc_mux_detached(struct osmo_fsm_inst *fi)
+{
+	struct rspro_server_conn *srvc = (struct rspro_server_conn *) fi->priv;
+
+	if (srvc->mux.owner)
+		mux_leave(srvc, false);
+	else if (!llist_empty(&srvc->mux.slaves))
+		mux_handover(srvc);
+	srvc_do_reestablish(fi);
+}
+
 static void srvc_st_init(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
 	switch (event) {
@@ -332,13 +558,24 @@ static void srvc_st_established_onenter(struct osmo_fsm_inst *fi, uint32_t prev_
 	struct rspro_server_conn *srvc = (struct rspro_server_conn *) fi->priv;
 	RsproPDU_t *pdu;
 
-	osmo_ipa_ka_fsm_start(srvc->ka_fi);
+	/* slaves have no keepalive of their own; our owner's covers the connection */
+	if (srvc->ka && prev_state == SRVC_ST_REESTABLISH)
+		rspro_ka_start(srvc->ka);
+
+	/* until the peer tells us otherwise, everything is BER encoded */
+	srvc->tpdu_enc = 0;
+	srvc->mux.capable = false;
 
-	if (srvc->own_comp_id.type == ComponentType_remsimClient)
+	if (srvc->own_comp_id.type == ComponentType_remsimClient) {
 		pdu = rspro_gen_ConnectClientReq(&srvc->own_comp_id, srvc->clslot);
-	else
+		if (pdu)
+			rspro_set_tpdu_encodings(pdu, RSPRO_TPDU_ENC_SUPPORTED);
+	} else {
 		pdu = rspro_gen_ConnectBankReq(&srvc->own_comp_id, srvc->bankd.bank_id,
 					       srvc->bankd.num_slots);
+		if (pdu && srvc->bankd.socket_path)
+			rspro_set_bankd_socket_path(pdu, srvc->bankd.socket_path);
+	}
 	_server_conn_send_rspro(srvc, pdu);
 }
 
@@ -353,14 +590,28 @@ static void srvc_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *
 	case SRVC_E_KA_TIMEOUT:
 		srvc_do_reestablish(fi);
 		break;
+	case SRVC_E_MUX_DETACH:
+		srvc_mux_detached(fi);
+		break;
 	case SRVC_E_CLIENT_CONN_RES:
 		pdu = data;
 		res = rspro_get_result(pdu);
-		if (res != ResultCode_ok) {
+		if (res == ResultCode_tryAgainLater) {
+			/* an overloaded server; srvc_do_reestablish() waits as long as it asks us to */
+			srvc->retry_after_ms = OSMO_MAX(rspro_get_retry_after(pdu), 0);
+			LOGPFSML(fi, LOGL_NOTICE, "Rx RSPRO connectClientRes(result=%s, retryAfterMs=%" PRId64 "), "
+				 "closing\n", asn_enum_name(&asn_DEF_ResultCode, res), srvc->retry_after_ms);
+			srvc_close(srvc);
+		} else if (res != ResultCode_ok) {
 			LOGPFSML(fi, LOGL_ERROR, "Rx RSPRO connectClientRes(result=%s), closing\n",
 				 asn_enum_name(&asn_DEF_ResultCode, res));
-			osmo_stream_cli_close(srvc->conn);
+			srvc_close(srvc);
 		} else {
+			srvc->tpdu_enc = rspro_get_tpdu_encodings(pdu) & RSPRO_TPDU_ENC_SUPPORTED;
+			if (srvc->tpdu_enc & RSPRO_TPDU_ENC_BINARY)
+				LOGPFSML(fi, LOGL_INFO, "Using binary TPDU encoding\n");
+			/* a bankd echoing our client slot accepts further ones over this connection */
+			srvc->mux.capable = srvc->mux.enable && rspro_get_client_slot(pdu);
 			/* somehow notify the main code? */
 			osmo_fsm_inst_state_chg(fi, SRVC_ST_CONNECTED, 0, 0);
 		}
@@ -392,6 +643,9 @@ static void srvc_st_connected(struct osmo_fsm_inst *fi, uint32_t event, void *da
 		pdu = data;
 		_server_conn_send_rspro(srvc, pdu);
 		break;
+	case SRVC_E_MUX_DETACH:
+		srvc_mux_detached(fi);
+		break;
 	default:
 		OSMO_ASSERT(0);
 	}
@@ -405,35 +659,36 @@ static void srvc_st_connected_onleave(struct osmo_fsm_inst *fi, uint32_t next_st
 		osmo_fsm_inst_dispatch(fi->proc.parent, srvc->parent_disc_evt, NULL);
 }
 
-static int ipa_keepalive_send_cb(struct osmo_ipa_ka_fsm_inst *ka_fi, struct msgb *msg, void *data)
+static int ipa_keepalive_send_cb(struct rspro_ka *ka, struct msgb *msg, void *data)
 {
 	struct osmo_stream_cli *cli = data;
 	osmo_stream_cli_send(cli, msg);
 	return 0;
 }
 
-static int ipa_keepalive_timeout_cb(struct osmo_ipa_ka_fsm_inst *ka_fi, void *data)
+static void ipa_keepalive_timeout_cb(struct rspro_ka *ka, void *data)
 {
 	struct osmo_stream_cli *cli = data;
 	struct rspro_server_conn *srvc = osmo_stream_cli_get_data(cli);
 	osmo_fsm_inst_dispatch(srvc->fi, SRVC_E_KA_TIMEOUT, NULL);
-	return 0;
 }
 
 static void srvc_st_reestablish_delay_onenter(struct osmo_fsm_inst *fi, uint32_t prev_state)
 {
 	struct rspro_server_conn *srvc = (struct rspro_server_conn *) fi->priv;
 
+	if (srvc->mux.owner)
+		mux_leave(srvc, false);
 	if (srvc->conn) {
+		mux_slaves_down(srvc);
 		LOGPFSML(fi, LOGL_INFO, "Destroying existing connection to server\n");
 		osmo_stream_cli_destroy(srvc->conn);
 		srvc->conn = NULL;
 	}
 
-	/* saturate timeout at last (longest) entry */
-	if (srvc->reestablish_delay_idx < REESTABLISH_DELAY_COUNT-1) {
-		srvc->reestablish_delay_idx++;
-	}
+	/* saturate once the backoff has reached its maximum */
+	if ((REESTABLISH_BACKOFF_MIN_MS << srvc->reestablish_attempt) < REESTABLISH_BACKOFF_MAX_MS)
+		srvc->reestablish_attempt++;
 }
 
 static void srvc_st_reestablish_delay(struct osmo_fsm_inst *fi, uint32_t event, void *data)
@@ -451,6 +706,17 @@ static void srvc_st_reestablish_onenter(struct osmo_fsm_inst *fi, uint32_t prev_
 
 	srvc->reestablish_last_ms = get_monotonic_ms();
 
+	if (srvc->mux.enable) {
+		struct rspro_server_conn *owner = mux_find_owner(srvc);
+		if (owner) {
+			LOGPFSML(fi, LOGL_INFO, "Sharing existing connection to server at %s:%u\n",
+				 srvc->server_host, srvc->server_port);
+			mux_attach(srvc, owner);
+			osmo_fsm_inst_state_chg(fi, SRVC_ST_ESTABLISHED, T1_WAIT_CLIENT_CONN_RES, 1);
+			return;
+		}
+	}
+
 	LOGPFSML(fi, LOGL_INFO, "Creating TCP connection to server at %s:%u\n",
 		 srvc->server_host, srvc->server_port);
 	srvc->conn = osmo_stream_cli_create(fi);
@@ -462,9 +728,15 @@ static void srvc_st_reestablish_onenter(struct osmo_fsm_inst *fi, uint32_t prev_
 	osmo_stream_cli_set_name(srvc->conn, fi->id);
 	osmo_stream_cli_set_data(srvc->conn, srvc);
 	osmo_stream_cli_set_addr(srvc->conn, srvc->server_host);
-	osmo_stream_cli_set_port(srvc->conn, srvc->server_port);
-	osmo_stream_cli_set_proto(srvc->conn, IPPROTO_TCP);
-	osmo_stream_cli_set_nodelay(srvc->conn, true);
+	if (rspro_addr_is_unix(srvc->server_host)) {
+		/* co-located peer: record boundaries are preserved, but we keep IPA framing */
+		osmo_stream_cli_set_domain(srvc->conn, AF_UNIX);
+		osmo_stream_cli_set_type(srvc->conn, SOCK_SEQPACKET);
+	} else {
+		osmo_stream_cli_set_port(srvc->conn, srvc->server_port);
+		osmo_stream_cli_set_proto(srvc->conn, IPPROTO_TCP);
+		osmo_stream_cli_set_nodelay(srvc->conn, true);
+	}
 
 	/* Reconnect is handled by upper layers: */
 	osmo_stream_cli_set_reconnect_timeout(srvc->conn, -1);
@@ -474,16 +746,12 @@ static void srvc_st_reestablish_onenter(struct osmo_fsm_inst *fi, uint32_t prev_
 	osmo_stream_cli_set_disconnect_cb(srvc->conn, srvc_disconnect_cb);
 	osmo_stream_cli_set_read_cb2(srvc->conn, srvc_read_cb);
 
-	srvc->ka_fi = osmo_ipa_ka_fsm_alloc(srvc->conn, fi->id);
-	if (!srvc->ka_fi) {
-		LOGPFSM(fi, "Unable to create keepalive FSM\n");
+	srvc->ka = rspro_ka_alloc(srvc->conn, 30, 10, ipa_keepalive_send_cb,
+				  ipa_keepalive_timeout_cb, srvc->conn);
+	if (!srvc->ka) {
+		LOGPFSM(fi, "Unable to create keepalive\n");
 		goto err_free_cli;
 	}
-	osmo_ipa_ka_fsm_set_data(srvc->ka_fi, srvc->conn);
-	osmo_ipa_ka_fsm_set_ping_interval(srvc->ka_fi, 30);
-	osmo_ipa_ka_fsm_set_pong_timeout(srvc->ka_fi, 10);
-	osmo_ipa_ka_fsm_set_send_cb(srvc->ka_fi, ipa_keepalive_send_cb);
-	osmo_ipa_ka_fsm_set_timeout_cb(srvc->ka_fi, ipa_keepalive_timeout_cb);
 
 	/* Attempt to connect TCP socket */
 	rc = osmo_stream_cli_open(srvc->conn);
@@ -491,13 +759,13 @@ static void srvc_st_reestablish_onenter(struct osmo_fsm_inst *fi, uint32_t prev_
 		LOGPFSML(fi, LOGL_FATAL, "Unable to connect RSPRO to %s:%u - %s\n",
 			srvc->server_host, srvc->server_port, strerror(errno));
 		/* FIXME: retry? Timer? Abort? */
-		goto err_free_ka_fi;
+		goto err_free_ka;
 	}
 	return;
 
-err_free_ka_fi:
-	osmo_ipa_ka_fsm_free(srvc->ka_fi);
-	srvc->ka_fi = NULL;
+err_free_ka:
+	talloc_free(srvc->ka);
+	srvc->ka = NULL;
 err_free_cli:
 	osmo_stream_cli_destroy(srvc->conn);
 	srvc->conn = NULL;
@@ -527,11 +795,17 @@ static void srvc_allstate_action(struct osmo_fsm_inst *fi, uint32_t event, void
 	switch (event) {
 	case SRVC_E_ESTABLISH:
 		/* reset delay connect immediately on our first connection */
-		srvc->reestablish_delay_idx = 0;
+		srvc->reestablish_attempt = 0;
 		srvc->reestablish_last_ms = 0;
 		srvc_do_reestablish(fi);
 		break;
 	case SRVC_E_DISCONNECT:
+		if (srvc->mux.owner)
+			mux_leave(srvc, true);
+		else if (srvc->conn && !llist_empty(&srvc->mux.slaves)) {
+			mux_send_detach(srvc);
+			mux_handover(srvc);
+		}
 		if (srvc->conn) {
 			LOGPFSML(fi, LOGL_INFO, "Destroying existing connection to server\n");
 			osmo_stream_cli_destroy(srvc->conn);
@@ -559,7 +833,7 @@ static int server_conn_fsm_timer_cb(struct osmo_fsm_inst *fi)
 		break;
 	case 1:
 		/* no ClientConnectRes received: disconnect + reconnect */
-		osmo_stream_cli_close(srvc->conn);
+		srvc_close(srvc);
 		break;
 	default:
 		OSMO_ASSERT(0);
@@ -568,6 +842,17 @@ static int server_conn_fsm_timer_cb(struct osmo_fsm_inst *fi)
 	return 0;
 }
 
+static void server_conn_fsm_cleanup(struct osmo_fsm_inst *fi, enum osmo_fsm_term_cause cause)
+{
+	struct rspro_server_conn *srvc = (struct rspro_server_conn *) fi->priv;
+
+	osmo_timer_del(&srvc->sock_tune_timer);
+	if (srvc->mux.owner)
+		mux_leave(srvc, true);
+	mux_slaves_down(srvc);
+	llist_del(&srvc->mux.list);
+}
+
 static const struct osmo_fsm_state server_conn_fsm_states[] = {
 	[SRVC_ST_INIT] = {
 		.name = "INIT",
@@ -577,15 +862,18 @@ static const struct osmo_fsm_state server_conn_fsm_states[] = {
 	},
 	[SRVC_ST_ESTABLISHED] = {
 		.name = "ESTABLISHED",
-		.in_event_mask = S(SRVC_E_TCP_DOWN) | S(SRVC_E_KA_TIMEOUT) | S(SRVC_E_CLIENT_CONN_RES),
-		.out_state_mask = S(SRVC_ST_CONNECTED) | S(SRVC_ST_REESTABLISH_DELAY) | S(SRVC_ST_INIT),
+		.in_event_mask = S(SRVC_E_TCP_DOWN) | S(SRVC_E_KA_TIMEOUT) | S(SRVC_E_CLIENT_CONN_RES) |
+				 S(SRVC_E_MUX_DETACH),
+		.out_state_mask = S(SRVC_ST_ESTABLISHED) | S(SRVC_ST_CONNECTED) | S(SRVC_ST_REESTABLISH_DELAY) |
+				  S(SRVC_ST_INIT),
 		.action = srvc_st_established,
 		.onenter = srvc_st_established_onenter,
 	},
 	[SRVC_ST_CONNECTED] = {
 		.name = "CONNECTED",
-		.in_event_mask = S(SRVC_E_TCP_DOWN) | S(SRVC_E_KA_TIMEOUT) | S(SRVC_E_RSPRO_TX),
-		.out_state_mask = S(SRVC_ST_REESTABLISH_DELAY) | S(SRVC_ST_INIT),
+		.in_event_mask = S(SRVC_E_TCP_DOWN) | S(SRVC_E_KA_TIMEOUT) | S(SRVC_E_RSPRO_TX) |
+				 S(SRVC_E_MUX_DETACH),
+		.out_state_mask = S(SRVC_ST_ESTABLISHED) | S(SRVC_ST_REESTABLISH_DELAY) | S(SRVC_ST_INIT),
 		.action = srvc_st_connected,
 		.onenter = srvc_st_connected_onenter,
 		.onleave = srvc_st_connected_onleave,
@@ -613,6 +901,7 @@ struct osmo_fsm rspro_client_server_fsm = {
 	.allstate_event_mask = S(SRVC_E_ESTABLISH) | S(SRVC_E_DISCONNECT),
 	.allstate_action = srvc_allstate_action,
 	.timer_cb = server_conn_fsm_timer_cb,
+	.cleanup = server_conn_fsm_cleanup,
 	.log_subsys = DRSPRO,
 	.event_names = server_conn_fsm_event_names,
 };
@@ -626,8 +915,11 @@ int server_conn_fsm_alloc(void *ctx, struct rspro_server_conn *srvc)
 		return -1;
 
 	srvc->fi = fi;
-	srvc->reestablish_delay_idx = 0;
+	srvc->reestablish_attempt = 0;
 	srvc->reestablish_last_ms = 0;
+	INIT_LLIST_HEAD(&srvc->mux.slaves);
+	llist_add_tail(&srvc->mux.list, mux_conns());
+	osmo_timer_setup(&srvc->sock_tune_timer, srvc_sock_tune_timer_cb, srvc);
 
 	return 0;
 }
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <osmocom/core/fsm.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/gsm/ipa.h>
 #include <osmocom/netif/stream.h>
 #include <osmocom/rspro/RsproPDU.h>
 
 #include "rspro_util.h"
+#include "rspro_keepalive.h"
 
 enum server_conn_fsm_event {
 	SRVC_E_ESTABLISH,	/* instruct SRVC to (re)etablish TCP connection to bankd */
@@ -14,7 +16,8 @@ enum server_conn_fsm_event {
 	SRVC_E_TCP_DOWN,
 	SRVC_E_KA_TIMEOUT,
 	SRVC_E_CLIENT_CONN_RES,
-	SRVC_E_RSPRO_TX		/* transmit a RSPRO PDU to the peer */
+	SRVC_E_RSPRO_TX,	/* transmit a RSPRO PDU to the peer */
+	SRVC_E_MUX_DETACH,	/* bankd detached our client slot from a multiplexed connection */
 };
 
 /* representing a client-side connection to a RSPRO server */
@@ -22,11 +25,17 @@ struct rspro_server_conn {
 	/* state */
 	struct osmo_stream_cli *conn;
 	struct osmo_fsm_inst *fi;
-	struct osmo_ipa_ka_fsm_inst *ka_fi;
+	struct rspro_ka *ka;
+	/* re-arms socket options after reading, see rspro_sock_tune_rx_defer() */
+	struct osmo_timer_list sock_tune_timer;
 	int (*handle_rx)(struct rspro_server_conn *conn, const RsproPDU_t *pdu);
+	/* optional: handles binary-encoded tpduCardToModem instead of handle_rx() */
+	int (*handle_tpdu)(struct rspro_server_conn *conn, const struct rspro_tpdu_view *tpdu);
 
-	/* index into k_reestablish_delay[] for this connection */
-	size_t reestablish_delay_idx;
+	/* number of consecutive re-establish attempts, saturating at the maximum backoff */
+	unsigned int reestablish_attempt;
+	/* minimum delay of the next re-establish attempt, as requested by the server */
+	int64_t retry_after_ms;
 
 	/* timestamp of last re-establish attempt, in milliseconds */
 	int64_t reestablish_last_ms;
@@ -42,10 +51,29 @@ struct rspro_server_conn {
 	/* client id and slot number */
 	ClientSlot_t *clslot;
 
-	/* configuration */
+	/* TPDU encodings (RSPRO_TPDU_ENC_*) negotiated with the peer */
+	uint32_t tpdu_enc;
+
+	/* configuration; a server_host starting with '/' is the path of a UNIX domain socket */
 	char *server_host;
 	uint16_t server_port;
 
+	/* multiplexing of several client slots over one TCP connection to a bankd */
+	struct {
+		/* share the connection with other instances to the same bankd? */
+		bool enable;
+		/* does the peer accept further client slots over this connection? */
+		bool capable;
+		/* instance whose connection we are using; NULL if we use our own */
+		struct rspro_server_conn *owner;
+		/* instances using our connection (if we are the owner) */
+		struct llist_head slaves;
+		/* entry in the owner's list of slaves */
+		struct llist_head slave_entry;
+		/* entry in the per-thread list of all instances */
+		struct llist_head list;
+	} mux;
+
 	/* FSM events we are to sent to the parent FSM on connect / disconnect */
 	uint32_t parent_conn_evt;
 	uint32_t parent_disc_evt;
@@ -54,8 +82,12 @@ struct rspro_server_conn {
 	struct {
 		uint16_t bank_id;
 		uint16_t num_slots;
+		/* UNIX domain socket at which we accept co-located clients (optional) */
+		char *socket_path;
 	} bankd;
 };
 
 int server_conn_send_rspro(struct rspro_server_conn *srvc, RsproPDU_t *rspro);
+int server_conn_send_tpdu(struct rspro_server_conn *srvc, const struct rspro_tpdu_hdr *hdr,
+			  const uint8_t *data, size_t len);
 int server_conn_fsm_alloc(void *ctx, struct rspro_server_conn *srvc);
@@ -0,0 +1,504 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Micro-benchmark of the RSPRO codec in rspro_util.c
+ *
+ * For each RsproPDU choice type (and, for TPDUs, for a range of payload sizes), this
+ * measures the rspro_gen_*() constructor, the encoder (rspro_enc_msg_tpdu(): asn1c DER or
+ * the negotiated binary TPDU encoding) and the decoder (rspro_dec_msg(): asn1c BER or
+ * binary).  Results are printed to stdout as one JSON object per line:
+ *
+ *   {"msg":"tpduModemToCard","payload":5,"op":"enc","encoding":"der",
+ *    "iterations":100000,"ns_per_op":812.3,"allocs_per_op":1.00,"bytes_per_op":49}
+ *
+ * allocs_per_op counts the talloc blocks created by one operation (including the msgb
+ * of the encoder), bytes_per_op is the length of the encoded message.
+ *
+ * With -w, the DER encoding of each message is additionally written to a file, which can
+ * be fed into ffasn1c/bench to compare against the ffasn1c transcoder. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/utils.h>
+
+#include <osmocom/rspro/RsproPDU.h>
+
+#include "rspro_util.h"
+#include "debug.h"
+
+__thread void *talloc_asn1_ctx;
+
+/* number of PDUs / messages prepared up-front, so the timed loops only contain the
+ * operation under test */
+#define BATCH_SIZE	1024
+
+static void *g_msgb_ctx;
+
+static const struct app_comp_id bench_comp_id = {
+	.type = ComponentType_remsimClient,
+	.name = "remsim-client-bench",
+	.software = "remsim-client",
+	.sw_version = "1.0.0",
+	.hw_manufacturer = "sysmocom",
+	.hw_model = "sysmoQMOD",
+};
+static const ClientSlot_t bench_clslot = { .clientId = 23, .slotNr = 3 };
+static const BankSlot_t bench_bslot = { .bankId = 1, .slotNr = 42 };
+static const uint8_t bench_atr[] = {
+	0x3b, 0x9f, 0x96, 0x80, 0x1f, 0xc7, 0x80, 0x31, 0xa0, 0x73, 0xbe, 0x21, 0x13, 0x67,
+	0x43, 0x20, 0x07, 0x18, 0x00, 0x00, 0x01, 0xa5
+};
+static uint8_t bench_tpdu[255];
+
+struct bench_case {
+	/* name of the RsproPDUchoice member */
+	const char *msg;
+	/* length of the TPDU payload, if any */
+	unsigned int payload_len;
+	RsproPDU_t *(*gen)(const struct bench_case *bc);
+	/* TPDU encodings applicable in addition to BER/DER */
+	uint32_t tpdu_enc;
+};
+
+static RsproPDU_t *gen_connectBankReq(const struct bench_case *bc)
+{
+	return rspro_gen_ConnectBankReq(&bench_comp_id, bench_bslot.bankId, 8);
+}
+
+static RsproPDU_t *gen_connectBankRes(const struct bench_case *bc)
+{
+	return rspro_gen_ConnectBankRes(&bench_comp_id, ResultCode_ok);
+}
+
+static RsproPDU_t *gen_connectClientReq(const struct bench_case *bc)
+{
+	RsproPDU_t *pdu = rspro_gen_ConnectClientReq(&bench_comp_id, &bench_clslot);
+	if (pdu)
+		rspro_set_tpdu_encodings(pdu, RSPRO_TPDU_ENC_SUPPORTED);
+	return pdu;
+}
+
+static RsproPDU_t *gen_connectClientRes(const struct bench_case *bc)
+{
+	RsproPDU_t *pdu = rspro_gen_ConnectClientRes(&bench_comp_id, ResultCode_ok);
+	if (pdu)
+		rspro_set_tpdu_encodings(pdu, RSPRO_TPDU_ENC_SUPPORTED);
+	return pdu;
+}
+
+static RsproPDU_t *gen_createMappingReq(const struct bench_case *bc)
+{
+	return rspro_gen_CreateMappingReq(&bench_clslot, &bench_bslot);
+}
+
+static RsproPDU_t *gen_createMappingRes(const struct bench_case *bc)
+{
+	return rspro_gen_CreateMappingRes(ResultCode_ok);
+}
+
+static RsproPDU_t *gen_removeMappingReq(const struct bench_case *bc)
+{
+	return rspro_gen_RemoveMappingReq(&bench_clslot, &bench_bslot);
+}
+
+static RsproPDU_t *gen_removeMappingRes(const struct bench_case *bc)
+{
+	return rspro_gen_RemoveMappingRes(ResultCode_ok);
+}
+
+static RsproPDU_t *gen_configClientIdReq(const struct bench_case *bc)
+{
+	return rspro_gen_ConfigClientIdReq(&bench_clslot);
+}
+
+static RsproPDU_t *gen_configClientIdRes(const struct bench_case *bc)
+{
+	return rspro_gen_ConfigClientIdRes(ResultCode_ok);
+}
+
+static RsproPDU_t *gen_configClientBankReq(const struct bench_case *bc)
+{
+	return rspro_gen_ConfigClientBankReq(&bench_bslot, 0x7f000001, 9999);
+}
+
+static RsproPDU_t *gen_configClientBankRes(const struct bench_case *bc)
+{
+	return rspro_gen_ConfigClientBankRes(ResultCode_ok);
+}
+
+static RsproPDU_t *gen_setAtrReq(const struct bench_case *bc)
+{
+	return rspro_gen_SetAtrReq(bench_clslot.clientId, bench_clslot.slotNr, bench_atr,
+				   sizeof(bench_atr));
+}
+
+static RsproPDU_t *gen_setAtrRes(const struct bench_case *bc)
+{
+	return rspro_gen_SetAtrRes(ResultCode_ok);
+}
+
+static RsproPDU_t *gen_tpduModemToCard(const struct bench_case *bc)
+{
+	RsproPDU_t *pdu = rspro_gen_TpduModem2Card(&bench_clslot, &bench_bslot, bench_tpdu,
+						   bc->payload_len);
+	if (pdu) {
+		pdu->msg.choice.tpduModemToCard.flags.tpduHeaderPresent = 1;
+		pdu->msg.choice.tpduModemToCard.flags.finalPart = 1;
+	}
+	return pdu;
+}
+
+static RsproPDU_t *gen_tpduCardToModem(const struct bench_case *bc)
+{
+	RsproPDU_t *pdu = rspro_gen_TpduCard2Modem(&bench_bslot, &bench_clslot, bench_tpdu,
+						   bc->payload_len);
+	if (pdu)
+		pdu->msg.choice.tpduCardToModem.flags.finalPart = 1;
+	return pdu;
+}
+
+static RsproPDU_t *gen_clientSlotStatusInd(const struct bench_case *bc)
+{
+	return rspro_gen_ClientSlotStatusInd(&bench_clslot, &bench_bslot, false, 1, 1, 1);
+}
+
+static RsproPDU_t *gen_bankSlotStatusInd(const struct bench_case *bc)
+{
+	return rspro_gen_BankSlotStatusInd(&bench_bslot, &bench_clslot, false, 1, 1, 1);
+}
+
+static RsproPDU_t *gen_resetStateReq(const struct bench_case *bc)
+{
+	return rspro_gen_ResetStateReq();
+}
+
+static RsproPDU_t *gen_resetStateRes(const struct bench_case *bc)
+{
+	return rspro_gen_ResetStateRes(ResultCode_ok);
+}
+
+#define CASE(name)		{ #name, 0, gen_##name, 0 }
+#define TPDU_CASE(name, len)	{ #name, len, gen_##name, RSPRO_TPDU_ENC_BINARY }
+
+static const struct bench_case bench_cases[] = {
+	CASE(connectBankReq),
+	CASE(connectBankRes),
+	CASE(connectClientReq),
+	CASE(connectClientRes),
+	CASE(createMappingReq),
+	CASE(createMappingRes),
+	CASE(removeMappingReq),
+	CASE(removeMappingRes),
+	CASE(configClientIdReq),
+	CASE(configClientIdRes),
+	CASE(configClientBankReq),
+	CASE(configClientBankRes),
+	CASE(setAtrReq),
+	CASE(setAtrRes),
+	/* from a bare 5-byte TPDU header up to a full 255-byte command */
+	TPDU_CASE(tpduModemToCard, 5),
+	TPDU_CASE(tpduModemToCard, 13),
+	TPDU_CASE(tpduModemToCard, 64),
+	TPDU_CASE(tpduModemToCard, 128),
+	TPDU_CASE(tpduModemToCard, 255),
+	/* from a bare status word up to a 255-byte response */
+	TPDU_CASE(tpduCardToModem, 2),
+	TPDU_CASE(tpduCardToModem, 24),
+	TPDU_CASE(tpduCardToModem, 64),
+	TPDU_CASE(tpduCardToModem, 128),
+	TPDU_CASE(tpduCardToModem, 255),
+	CASE(clientSlotStatusInd),
+	CASE(bankSlotStatusInd),
+	CASE(resetStateReq),
+	CASE(resetStateRes),
+};
+
+static inline int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t live_blocks(void)
+{
+	return talloc_total_blocks(talloc_asn1_ctx) + talloc_total_blocks(g_msgb_ctx);
+}
+
+struct bench_result {
+	unsigned long iterations;
+	int64_t ns;
+	size_t allocs;
+	unsigned int bytes;
+};
+
+static void print_result(const struct bench_case *bc, const char *op, const char *encoding,
+			 const struct bench_result *res)
+{
+	printf("{\"msg\":\"%s\",\"payload\":%u,\"op\":\"%s\",\"encoding\":\"%s\","
+	       "\"iterations\":%lu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%u}\n",
+	       bc->msg, bc->payload_len, op, encoding, res->iterations,
+	       (double) res->ns / res->iterations, (double) res->allocs / res->iterations,
+	       res->bytes);
+}
+
+/* number of talloc blocks making up one PDU of the given case */
+static size_t pdu_blocks(const struct bench_case *bc)
+{
+	size_t before = live_blocks(), after;
+	RsproPDU_t *pdu = bc->gen(bc);
+
+	OSMO_ASSERT(pdu);
+	after = live_blocks();
+	ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+
+	return after - before;
+}
+
+static void bench_gen(const struct bench_case *bc, unsigned long iterations)
+{
+	RsproPDU_t *pdus[BATCH_SIZE];
+	struct bench_result res = {};
+	unsigned int i, n;
+	size_t before;
+	int64_t start;
+
+	while (res.iterations < iterations) {
+		n = OSMO_MIN(BATCH_SIZE, iterations - res.iterations);
+		before = live_blocks();
+		start = now_ns();
+		for (i = 0; i < n; i++)
+			pdus[i] = bc->gen(bc);
+		res.ns += now_ns() - start;
+		res.allocs += live_blocks() - before;
+		for (i = 0; i < n; i++)
+			ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdus[i]);
+		res.iterations += n;
+	}
+
+	print_result(bc, "gen", "-", &res);
+}
+
+static void bench_enc(const struct bench_case *bc, uint32_t tpdu_enc, unsigned long iterations)
+{
+	RsproPDU_t *pdus[BATCH_SIZE];
+	struct msgb *msgs[BATCH_SIZE];
+	struct bench_result res = {};
+	size_t before, gen_blocks = pdu_blocks(bc);
+	unsigned int i, n;
+	int64_t start;
+
+	while (res.iterations < iterations) {
+		n = OSMO_MIN(BATCH_SIZE, iterations - res.iterations);
+		for (i = 0; i < n; i++) {
+			pdus[i] = bc->gen(bc);
+			OSMO_ASSERT(pdus[i]);
+		}
+		before = live_blocks();
+		start = now_ns();
+		for (i = 0; i < n; i++)
+			msgs[i] = rspro_enc_msg_tpdu(pdus[i], tpdu_enc);
+		res.ns += now_ns() - start;
+		/* the encoder frees the PDU, which we must not count as negative allocations */
+		res.allocs += live_blocks() + n * gen_blocks - before;
+		for (i = 0; i < n; i++) {
+			OSMO_ASSERT(msgs[i]);
+			res.bytes = msgb_length(msgs[i]);
+			msgb_free(msgs[i]);
+		}
+		res.iterations += n;
+	}
+
+	print_result(bc, "enc", tpdu_enc ? "binary" : "der", &res);
+}
+
+static void bench_dec(const struct bench_case *bc, uint32_t tpdu_enc, unsigned long iterations)
+{
+	RsproPDU_t *pdus[BATCH_SIZE];
+	struct bench_result res = {};
+	struct msgb *msg;
+	unsigned int i, n;
+	size_t before;
+	int64_t start;
+
+	msg = rspro_enc_msg_tpdu(bc->gen(bc), tpdu_enc);
+	OSMO_ASSERT(msg);
+	res.bytes = msgb_length(msg);
+
+	while (res.iterations < iterations) {
+		n = OSMO_MIN(BATCH_SIZE, iterations - res.iterations);
+		before = live_blocks();
+		start = now_ns();
+		for (i = 0; i < n; i++)
+			pdus[i] = rspro_dec_msg(msg);
+		res.ns += now_ns() - start;
+		res.allocs += live_blocks() - before;
+		for (i = 0; i < n; i++) {
+			OSMO_ASSERT(pdus[i]);
+			ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdus[i]);
+		}
+		res.iterations += n;
+	}
+	msgb_free(msg);
+
+	print_result(bc, "dec", tpdu_enc ? "binary" : "ber", &res);
+}
+
+/* write DER encoding of the case to <dir>/<msg>-<payload>.der */
+static int write_case(const struct bench_case *bc, const char *dir)
+{
+	char path[PATH_MAX];
+	struct msgb *msg;
+	FILE *f;
+	int rc = 0;
+
+	snprintf(path, sizeof(path), "%s/%s-%u.der", dir, bc->msg, bc->payload_len);
+	msg = rspro_enc_msg(bc->gen(bc));
+	OSMO_ASSERT(msg);
+
+	f = fopen(path, "w");
+	if (!f) {
+		rc = -errno;
+		goto out;
+	}
+	if (fwrite(msgb_data(msg), msgb_length(msg), 1, f) != 1)
+		rc = -EIO;
+	if (fclose(f) != 0 && rc == 0)
+		rc = -errno;
+out:
+	if (rc < 0)
+		fprintf(stderr, "Cannot write %s: %s\n", path, strerror(-rc));
+	msgb_free(msg);
+	return rc;
+}
+
+static void run_case(const struct bench_case *bc, unsigned long iterations)
+{
+	uint32_t enc;
+
+	bench_gen(bc, iterations);
+	bench_enc(bc, 0, iterations);
+	bench_dec(bc, 0, iterations);
+
+	for (enc = 1; enc && enc <= bc->tpdu_enc; enc <<= 1) {
+		if (!(bc->tpdu_enc & enc))
+			continue;
+		bench_enc(bc, enc, iterations);
+		bench_dec(bc, enc, iterations);
+	}
+}
+
+static void print_help()
+{
+	printf( "Usage: rspro-codec-bench [-n ITERATIONS] [-m MSG] [-w DIR]\n"
+		"  -h --help                This text\n"
+		"  -n --iterations NUM      Number of operations per measurement (default: 100000)\n"
+		"  -m --msg NAME            Only benchmark the given RSPRO message (e.g. tpduModemToCard)\n"
+		"  -l --list                List the supported RSPRO messages\n"
+		"  -w --write-dir DIR       Write the DER encoded messages to DIR (for ffasn1c/bench)\n"
+		);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 100000;
+	const char *msg_filter = NULL;
+	const char *write_dir = NULL;
+	void *g_tall_ctx;
+	unsigned int i;
+
+	while (1) {
+		int option_index = 0, c;
+		static const struct option long_options[] = {
+			{ "help", 0, 0, 'h' },
+			{ "iterations", 1, 0, 'n' },
+			{ "msg", 1, 0, 'm' },
+			{ "list", 0, 0, 'l' },
+			{ "write-dir", 1, 0, 'w' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "hn:m:lw:", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help();
+			exit(0);
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 10);
+			if (!iterations) {
+				fprintf(stderr, "Invalid number of iterations '%s'\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'm':
+			msg_filter = optarg;
+			break;
+		case 'l':
+			for (i = 0; i < ARRAY_SIZE(bench_cases); i++) {
+				if (i == 0 || strcmp(bench_cases[i].msg, bench_cases[i-1].msg))
+					printf("%s\n", bench_cases[i].msg);
+			}
+			exit(0);
+			break;
+		case 'w':
+			write_dir = optarg;
+			break;
+		default:
+			print_help();
+			exit(2);
+			break;
+		}
+	}
+
+	g_tall_ctx = talloc_named_const(NULL, 0, "rspro-codec-bench");
+	talloc_asn1_ctx = talloc_named_const(g_tall_ctx, 0, "asn1");
+	g_msgb_ctx = msgb_talloc_ctx_init(g_tall_ctx, 0);
+	osmo_init_logging2(g_tall_ctx, &log_info);
+	/* we don't want to benchmark the logging */
+	log_set_log_level(osmo_stderr_target, LOGL_ERROR);
+
+	for (i = 0; i < sizeof(bench_tpdu); i++)
+		bench_tpdu[i] = i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_cases); i++) {
+		if (msg_filter && strcmp(msg_filter, bench_cases[i].msg))
+			continue;
+		if (write_dir && write_case(&bench_cases[i], write_dir) < 0)
+			exit(1);
+		run_case(&bench_cases[i], iterations);
+	}
+
+	talloc_free(g_tall_ctx);
+
+	return 0;
+}
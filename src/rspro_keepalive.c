@@ -0,0 +1,288 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* With one osmo_ipa_ka_fsm (and thus its own osmo_timer) per connection, a server with
+ * thousands of connections wakes up for each of their PINGs individually, and after a mass
+ * reconnect all of them fire in the same second.  Instead, all keep-alive instances of a thread
+ * are kept in a hierarchical timer wheel of 1s ticks: level 0 has one slot per second of the
+ * next 64 seconds, level 1 one slot per 64 seconds, which is cascaded into level 0 once its time
+ * has come.  Adding and removing an instance is O(1), and the wheel's only timer fires at most
+ * once per second, and only for ticks which have something to do.
+ *
+ * Pings are jittered, the first one (after a (re)connect) by up to half the interval, and
+ * suppressed if anything was received since the last one.  The price is that a peer which dies
+ * right after sending something is only detected after up to twice the ping interval (plus the
+ * pong timeout). */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/gsm/protocol/ipaccess.h>
+#include <osmocom/gsm/ipa.h>
+
+#include "rspro_keepalive.h"
+#include "debug.h"
+
+#define KA_WHEEL_BITS	6
+#define KA_WHEEL_SIZE	(1 << KA_WHEEL_BITS)
+#define KA_WHEEL_MASK	(KA_WHEEL_SIZE - 1)
+/* furthest we can schedule ahead of the current tick */
+#define KA_WHEEL_MAX	(((KA_WHEEL_SIZE - 1) << KA_WHEEL_BITS) - 1)
+
+/* like osmo_timers, the wheel is per thread */
+static __thread struct {
+	bool initialized;
+	/* last tick (second of CLOCK_MONOTONIC) which was processed */
+	uint32_t now;
+	/* tick for which the timer is scheduled */
+	uint32_t wakeup;
+	unsigned int num_entries;
+	struct llist_head slots[2][KA_WHEEL_SIZE];
+	struct osmo_timer_list timer;
+	/* for rand_r(); different in each process, to spread out reconnected clients */
+	unsigned int seed;
+} g_wheel;
+
+static void wheel_timer_cb(void *data);
+
+static void wheel_init(void)
+{
+	unsigned int i;
+
+	if (g_wheel.initialized)
+		return;
+
+	for (i = 0; i < KA_WHEEL_SIZE; i++) {
+		INIT_LLIST_HEAD(&g_wheel.slots[0][i]);
+		INIT_LLIST_HEAD(&g_wheel.slots[1][i]);
+	}
+	osmo_timer_setup(&g_wheel.timer, wheel_timer_cb, NULL);
+	if (osmo_get_rand_id((uint8_t *) &g_wheel.seed, sizeof(g_wheel.seed)) < 0)
+		g_wheel.seed = getpid() ^ time(NULL);
+	g_wheel.initialized = true;
+}
+
+static void wheel_clock(struct timespec *ts)
+{
+	osmo_clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/* put 'ka' into the slot for ka->expires; during a cascade, this may be the current tick */
+static void wheel_insert(struct rspro_ka *ka)
+{
+	uint32_t delta = ka->expires - g_wheel.now;
+
+	if (delta < KA_WHEEL_SIZE) {
+		llist_add_tail(&ka->list, &g_wheel.slots[0][ka->expires & KA_WHEEL_MASK]);
+		return;
+	}
+	if (delta > KA_WHEEL_MAX)
+		ka->expires = g_wheel.now + KA_WHEEL_MAX;
+	llist_add_tail(&ka->list, &g_wheel.slots[1][(ka->expires >> KA_WHEEL_BITS) & KA_WHEEL_MASK]);
+}
+
+/* the next tick at which there is something to do: a non-empty slot, or a cascade */
+static uint32_t wheel_next_tick(void)
+{
+	uint32_t t;
+	unsigned int i;
+
+	for (i = 1; i <= KA_WHEEL_SIZE; i++) {
+		t = g_wheel.now + i;
+		if (!(t & KA_WHEEL_MASK) || !llist_empty(&g_wheel.slots[0][t & KA_WHEEL_MASK]))
+			break;
+	}
+	return t;
+}
+
+static void wheel_arm(void)
+{
+	struct timespec ts;
+	uint32_t next;
+	int64_t delay_us;
+
+	if (!g_wheel.num_entries) {
+		osmo_timer_del(&g_wheel.timer);
+		return;
+	}
+
+	next = wheel_next_tick();
+	if (osmo_timer_pending(&g_wheel.timer) && (int32_t) (next - g_wheel.wakeup) >= 0)
+		return;
+
+	wheel_clock(&ts);
+	delay_us = ((int64_t) next - ts.tv_sec) * 1000000 - ts.tv_nsec / 1000;
+	if (delay_us < 0)
+		delay_us = 0;
+	g_wheel.wakeup = next;
+	osmo_timer_schedule(&g_wheel.timer, delay_us / 1000000, delay_us % 1000000);
+}
+
+static void ka_schedule(struct rspro_ka *ka, unsigned int delay_s)
+{
+	struct timespec ts;
+
+	wheel_clock(&ts);
+	/* the wheel is idle; nothing in it we'd skip by moving it to the present */
+	if (!g_wheel.num_entries)
+		g_wheel.now = ts.tv_sec;
+	/* relative to the clock, not to g_wheel.now: the wheel may be lagging behind */
+	ka->expires = ts.tv_sec + OSMO_MAX(delay_s, 1);
+	wheel_insert(ka);
+	g_wheel.num_entries++;
+	wheel_arm();
+}
+
+static void ka_unschedule(struct rspro_ka *ka)
+{
+	if (llist_empty(&ka->list))
+		return;
+	llist_del_init(&ka->list);
+	g_wheel.num_entries--;
+}
+
+/* 'interval' seconds, randomly off by up to 'spread' seconds in either direction */
+static unsigned int jittered(unsigned int interval, unsigned int spread)
+{
+	return interval - spread + rand_r(&g_wheel.seed) % (2 * spread + 1);
+}
+
+static void ka_expire(struct rspro_ka *ka)
+{
+	struct msgb *msg;
+
+	if (ka->rx_seen) {
+		/* the peer is alive: no PING needed (or PONG to wait for any longer) */
+		ka->rx_seen = false;
+		ka->wait_pong = false;
+		ka_schedule(ka, jittered(ka->ping_interval_s, ka->ping_interval_s / 10));
+		return;
+	}
+
+	if (ka->wait_pong) {
+		ka->wait_pong = false;
+		ka->timeout_cb(ka, ka->data);
+		return;
+	}
+
+	msg = ipa_msg_alloc(0);
+	if (!msg) {
+		/* try again later; a missing PING doesn't hurt, a false timeout would */
+		ka_schedule(ka, ka->pong_timeout_s);
+		return;
+	}
+	msgb_v_put(msg, IPAC_MSGT_PING);
+	ipa_prepend_header(msg, IPAC_PROTO_IPACCESS);
+
+	ka->wait_pong = true;
+	ka_schedule(ka, ka->pong_timeout_s);
+	ka->send_cb(ka, msg, ka->data);
+}
+
+static void wheel_tick(void)
+{
+	struct rspro_ka *ka;
+	LLIST_HEAD(list);
+
+	g_wheel.now++;
+
+	if (!(g_wheel.now & KA_WHEEL_MASK)) {
+		llist_splice_init(&g_wheel.slots[1][(g_wheel.now >> KA_WHEEL_BITS) & KA_WHEEL_MASK], &list);
+		while ((ka = llist_first_entry_or_null(&list, struct rspro_ka, list))) {
+			llist_del(&ka->list);
+			wheel_insert(ka);
+		}
+	}
+
+	/* take them off one by one: a call-back may stop (and free) any other instance */
+	llist_splice_init(&g_wheel.slots[0][g_wheel.now & KA_WHEEL_MASK], &list);
+	while ((ka = llist_first_entry_or_null(&list, struct rspro_ka, list))) {
+		ka_unschedule(ka);
+		ka_expire(ka);
+	}
+}
+
+static void wheel_timer_cb(void *data)
+{
+	struct timespec ts;
+
+	/* catch up with all the ticks we slept through */
+	wheel_clock(&ts);
+	while (g_wheel.num_entries && (int32_t) (ts.tv_sec - g_wheel.now) > 0)
+		wheel_tick();
+	wheel_arm();
+}
+
+static int ka_destructor(struct rspro_ka *ka)
+{
+	rspro_ka_stop(ka);
+	return 0;
+}
+
+/*! Allocate a keep-alive instance; it is stopped automatically when freed.
+ *  \param[in] ctx talloc context, typically the connection
+ *  \param[in] ping_interval_s seconds without anything received after which we send a PING
+ *  \param[in] pong_timeout_s seconds to wait for a response to the PING
+ *  \param[in] send_cb call-back transmitting the PING
+ *  \param[in] timeout_cb call-back invoked if there was no response
+ *  \param[in] data opaque data passed to the call-backs
+ *  \returns the new instance; NULL on error */
+struct rspro_ka *rspro_ka_alloc(void *ctx, unsigned int ping_interval_s, unsigned int pong_timeout_s,
+				rspro_ka_send_cb_t send_cb, rspro_ka_timeout_cb_t timeout_cb, void *data)
+{
+	struct rspro_ka *ka;
+
+	OSMO_ASSERT(ping_interval_s > 0 && ping_interval_s <= UINT16_MAX);
+	OSMO_ASSERT(pong_timeout_s > 0 && pong_timeout_s <= UINT16_MAX);
+
+	ka = talloc_zero(ctx, struct rspro_ka);
+	if (!ka)
+		return NULL;
+	INIT_LLIST_HEAD(&ka->list);
+	ka->ping_interval_s = ping_interval_s;
+	ka->pong_timeout_s = pong_timeout_s;
+	ka->send_cb = send_cb;
+	ka->timeout_cb = timeout_cb;
+	ka->data = data;
+	talloc_set_destructor(ka, ka_destructor);
+
+	return ka;
+}
+
+/*! Start (or restart) the keep-alive, e.g. after the connection was established. */
+void rspro_ka_start(struct rspro_ka *ka)
+{
+	wheel_init();
+	ka_unschedule(ka);
+	ka->wait_pong = false;
+	ka->rx_seen = false;
+	/* spread the first PINGs of connections established at the same time */
+	ka_schedule(ka, jittered(ka->ping_interval_s * 3 / 4, ka->ping_interval_s / 4));
+}
+
+void rspro_ka_stop(struct rspro_ka *ka)
+{
+	ka_unschedule(ka);
+	ka->wait_pong = false;
+}
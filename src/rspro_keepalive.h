@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/msgb.h>
+
+/* IPA PING/PONG keep-alive of RSPRO connections.  All instances of a thread share one timer
+ * wheel (and thus one osmo_timer) instead of having timers of their own; a PING is only sent
+ * if nothing was received from the peer during the last ping interval. */
+
+struct rspro_ka;
+
+/* transmit the (IPA CCM PING) message to the peer */
+typedef int (*rspro_ka_send_cb_t)(struct rspro_ka *ka, struct msgb *msg, void *data);
+/* the peer didn't respond in time; the instance is stopped when this is called */
+typedef void (*rspro_ka_timeout_cb_t)(struct rspro_ka *ka, void *data);
+
+struct rspro_ka {
+	/* entry in a slot of the timer wheel; empty if not scheduled */
+	struct llist_head list;
+	/* tick (second of CLOCK_MONOTONIC) at which we expire */
+	uint32_t expires;
+	/* a PING was sent, and nothing was received since */
+	bool wait_pong;
+	/* anything was received from the peer since we last looked */
+	bool rx_seen;
+
+	uint16_t ping_interval_s;
+	uint16_t pong_timeout_s;
+	rspro_ka_send_cb_t send_cb;
+	rspro_ka_timeout_cb_t timeout_cb;
+	void *data;
+};
+
+struct rspro_ka *rspro_ka_alloc(void *ctx, unsigned int ping_interval_s, unsigned int pong_timeout_s,
+				rspro_ka_send_cb_t send_cb, rspro_ka_timeout_cb_t timeout_cb, void *data);
+void rspro_ka_start(struct rspro_ka *ka);
+void rspro_ka_stop(struct rspro_ka *ka);
+
+/*! To be called for each message received from the peer (PONG or otherwise).  Deliberately
+ *  cheap, as it's on the data path. */
+static inline void rspro_ka_rx(struct rspro_ka *ka)
+{
+	if (ka)
+		ka->rx_seen = true;
+}
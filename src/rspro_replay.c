@@ -0,0 +1,541 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Replay of RSPRO capture files (see rspro_capture.h), as written by osmo-remsim-server
+ * and osmo-remsim-bankd with the --capture-file option.
+ *
+ * Without -H, every RSPRO frame of the capture is run through the RSPRO decoder
+ * (rspro_dec_buf()), and per-message statistics are printed as one JSON object per line,
+ * followed by a summary line.  With -x, each RSPRO payload is additionally written to a
+ * file of its own, which gives a seed corpus for fuzzing the decoder.
+ *
+ * With -H, one TCP connection per captured connection is established to the given
+ * osmo-remsim-server or osmo-remsim-bankd, and the frames received by the capturing
+ * process are sent over it again.  This exercises the decoder and the connection FSMs of
+ * the live process.  IPA PINGs from the peer are answered, all other frames received from
+ * it are counted and discarded.
+ *
+ * By default, the capture is replayed as fast as possible; -r replays it with the
+ * original timing, -S with the original timing sped up by the given factor. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <limits.h>
+#include <inttypes.h>
+
+#include <sys/socket.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/bit16gen.h>
+
+#include <osmocom/gsm/protocol/ipaccess.h>
+
+#include <osmocom/rspro/RsproPDU.h>
+
+#include "rspro_util.h"
+#include "rspro_capture.h"
+#include "asn1c_helpers.h"
+#include "debug.h"
+
+__thread void *talloc_asn1_ctx;
+
+/* one captured connection, replayed towards the live peer */
+struct replay_conn {
+	struct llist_head list;
+	uint32_t cap_conn_id;
+	int fd;
+	/* partially received IPA frame from the peer */
+	uint8_t rx_buf[3 + UINT16_MAX];
+	size_t rx_len;
+};
+
+/* decoder statistics per RsproPDU choice type */
+struct msg_stats {
+	struct llist_head list;
+	const char *msg;
+	unsigned long count;
+	unsigned long bytes;
+	int64_t dec_ns;
+};
+
+static struct {
+	const char *host;
+	int port;
+	const char *extract_dir;
+	double speed;		/* 0: as fast as possible */
+} g_cfg = {
+	.port = 9998,
+};
+
+static struct {
+	unsigned long records;
+	unsigned long conns;
+	unsigned long rspro_frames;
+	unsigned long dec_errors;
+	unsigned long tx_frames;
+	unsigned long tx_bytes;
+	unsigned long rx_frames;
+	unsigned long rx_bytes;
+	unsigned long conn_errors;
+} g_stats;
+
+static void *g_tall_ctx;
+static LLIST_HEAD(g_conns);
+static LLIST_HEAD(g_msg_stats);
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct msg_stats *msg_stats_get(const char *msg)
+{
+	struct msg_stats *ms;
+
+	llist_for_each_entry(ms, &g_msg_stats, list) {
+		if (!strcmp(ms->msg, msg))
+			return ms;
+	}
+
+	ms = talloc_zero(g_tall_ctx, struct msg_stats);
+	OSMO_ASSERT(ms);
+	ms->msg = talloc_strdup(ms, msg);
+	llist_add_tail(&ms->list, &g_msg_stats);
+	return ms;
+}
+
+/***********************************************************************
+ * decoding / corpus extraction
+ ***********************************************************************/
+
+static int extract_payload(const struct rspro_cap_rec *rec, const uint8_t *data, size_t len)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%06lu-%u-%s.bin", g_cfg.extract_dir, g_stats.rspro_frames,
+		 rec->conn_id, rec->event == RSPRO_CAP_EV_RX ? "rx" : "tx");
+	f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+	if (fwrite(data, len, 1, f) != 1 || fclose(f) != 0) {
+		fprintf(stderr, "Cannot write %s\n", path);
+		return -EIO;
+	}
+	return 0;
+}
+
+static int decode_record(const struct rspro_cap_rec *rec)
+{
+	const uint8_t *data = rec->data + 1;
+	size_t len = rec->len - 1;
+	struct msg_stats *ms;
+	RsproPDU_t *pdu;
+	int64_t start;
+
+	if (rec->ipa_proto != IPAC_PROTO_OSMO || rec->len < 1 || rec->data[0] != IPAC_PROTO_EXT_RSPRO)
+		return 0;
+	g_stats.rspro_frames++;
+
+	if (g_cfg.extract_dir && extract_payload(rec, data, len) < 0)
+		return -EIO;
+
+	start = now_ns();
+	pdu = rspro_dec_buf(data, len);
+	if (!pdu) {
+		g_stats.dec_errors++;
+		ms = msg_stats_get("(error)");
+	} else
+		ms = msg_stats_get(asn_choice_name(&asn_DEF_RsproPDUchoice, &pdu->msg));
+	ms->dec_ns += now_ns() - start;
+	ms->count++;
+	ms->bytes += len;
+
+	if (pdu)
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+
+	return 0;
+}
+
+/***********************************************************************
+ * replay towards a live process
+ ***********************************************************************/
+
+static struct replay_conn *conn_find(uint32_t cap_conn_id)
+{
+	struct replay_conn *conn;
+
+	llist_for_each_entry(conn, &g_conns, list) {
+		if (conn->cap_conn_id == cap_conn_id)
+			return conn;
+	}
+	return NULL;
+}
+
+static void conn_close(struct replay_conn *conn)
+{
+	llist_del(&conn->list);
+	close(conn->fd);
+	talloc_free(conn);
+}
+
+static int conn_open(const struct rspro_cap_rec *rec)
+{
+	struct replay_conn *conn;
+	int rc;
+
+	/* connection identifiers may be re-used if multiple captures were concatenated */
+	conn = conn_find(rec->conn_id);
+	if (conn)
+		conn_close(conn);
+
+	rc = osmo_sock_init(AF_UNSPEC, SOCK_STREAM, IPPROTO_TCP, g_cfg.host, g_cfg.port,
+			    OSMO_SOCK_F_CONNECT | OSMO_SOCK_F_NONBLOCK);
+	if (rc < 0) {
+		g_stats.conn_errors++;
+		fprintf(stderr, "Cannot connect to %s:%d: %s\n", g_cfg.host, g_cfg.port, strerror(errno));
+		return rc;
+	}
+
+	conn = talloc_zero(g_tall_ctx, struct replay_conn);
+	OSMO_ASSERT(conn);
+	conn->cap_conn_id = rec->conn_id;
+	conn->fd = rc;
+	llist_add_tail(&conn->list, &g_conns);
+	g_stats.conns++;
+
+	return 0;
+}
+
+/* blocking write of an entire buffer to the non-blocking socket */
+static int conn_write(struct replay_conn *conn, const uint8_t *buf, size_t len)
+{
+	struct pollfd pfd = { .fd = conn->fd, .events = POLLOUT };
+	ssize_t rc;
+
+	while (len) {
+		rc = write(conn->fd, buf, len);
+		if (rc < 0 && (errno == EAGAIN || errno == EINTR || errno == ENOTCONN)) {
+			poll(&pfd, 1, 1000);
+			continue;
+		} else if (rc <= 0)
+			return -errno;
+		buf += rc;
+		len -= rc;
+	}
+	return 0;
+}
+
+static void conn_handle_rx_frame(struct replay_conn *conn, const uint8_t *frame, size_t len)
+{
+	static const uint8_t ipa_pong[] = { 0x00, 0x01, IPAC_PROTO_IPACCESS, IPAC_MSGT_PONG };
+
+	g_stats.rx_frames++;
+	g_stats.rx_bytes += len;
+
+	if (frame[2] == IPAC_PROTO_IPACCESS && len > 3 && frame[3] == IPAC_MSGT_PING)
+		conn_write(conn, ipa_pong, sizeof(ipa_pong));
+}
+
+/* read whatever the peer sent us, without blocking */
+static int conn_drain(struct replay_conn *conn)
+{
+	size_t frame_len;
+	ssize_t rc;
+
+	while (1) {
+		rc = read(conn->fd, conn->rx_buf + conn->rx_len, sizeof(conn->rx_buf) - conn->rx_len);
+		if (rc < 0 && (errno == EAGAIN || errno == ENOTCONN))
+			return 0;
+		else if (rc < 0 && errno == EINTR)
+			continue;
+		else if (rc <= 0)
+			return -ECONNRESET;
+		conn->rx_len += rc;
+
+		while (conn->rx_len >= 3) {
+			frame_len = 3 + osmo_load16be(conn->rx_buf);
+			if (conn->rx_len < frame_len)
+				break;
+			conn_handle_rx_frame(conn, conn->rx_buf, frame_len);
+			memmove(conn->rx_buf, conn->rx_buf + frame_len, conn->rx_len - frame_len);
+			conn->rx_len -= frame_len;
+		}
+	}
+}
+
+static void drain_all(void)
+{
+	struct replay_conn *conn, *conn2;
+
+	llist_for_each_entry_safe(conn, conn2, &g_conns, list) {
+		if (conn_drain(conn) < 0) {
+			fprintf(stderr, "Connection %u closed by peer\n", conn->cap_conn_id);
+			g_stats.conn_errors++;
+			conn_close(conn);
+		}
+	}
+}
+
+static int send_record(const struct rspro_cap_rec *rec)
+{
+	struct replay_conn *conn = conn_find(rec->conn_id);
+	uint8_t hdr[3];
+	int rc;
+
+	if (!conn)
+		return 0;
+
+	osmo_store16be(rec->len, hdr);
+	hdr[2] = rec->ipa_proto;
+	rc = conn_write(conn, hdr, sizeof(hdr));
+	if (rc == 0)
+		rc = conn_write(conn, rec->data, rec->len);
+	if (rc < 0) {
+		fprintf(stderr, "Connection %u: error writing: %s\n", conn->cap_conn_id, strerror(-rc));
+		g_stats.conn_errors++;
+		conn_close(conn);
+		return 0;
+	}
+
+	g_stats.tx_frames++;
+	g_stats.tx_bytes += sizeof(hdr) + rec->len;
+
+	return 0;
+}
+
+static int replay_record(const struct rspro_cap_rec *rec)
+{
+	switch (rec->event) {
+	case RSPRO_CAP_EV_OPEN:
+		if (g_cfg.host)
+			conn_open(rec);
+		break;
+	case RSPRO_CAP_EV_CLOSE:
+		if (g_cfg.host) {
+			struct replay_conn *conn = conn_find(rec->conn_id);
+			if (conn) {
+				conn_drain(conn);
+				conn_close(conn);
+			}
+		}
+		break;
+	case RSPRO_CAP_EV_RX:
+		/* only the frames received by the capturing process are sent again; the frames it
+		 * transmitted are what we expect to get back */
+		if (g_cfg.host)
+			return send_record(rec);
+		return decode_record(rec);
+	case RSPRO_CAP_EV_TX:
+		if (!g_cfg.host)
+			return decode_record(rec);
+		break;
+	default:
+		fprintf(stderr, "Unknown record type %u, skipping\n", rec->event);
+		break;
+	}
+	return 0;
+}
+
+/* sleep until the time of the record (relative to the first record) has come */
+static void pace(int64_t start_ns, uint64_t first_ts, uint64_t ts)
+{
+	/* records may be slightly out of order (and the clock may have been set back) */
+	int64_t delta = OSMO_MAX((int64_t) (ts - first_ts), 0);
+	int64_t deadline = start_ns + (int64_t) (delta / g_cfg.speed);
+	int64_t now;
+
+	while ((now = now_ns()) < deadline) {
+		if (g_cfg.host) {
+			drain_all();
+			usleep(OSMO_MIN(deadline - now, 10000000) / 1000);
+		} else {
+			struct timespec ts = {
+				.tv_sec = (deadline - now) / 1000000000,
+				.tv_nsec = (deadline - now) % 1000000000,
+			};
+			nanosleep(&ts, NULL);
+		}
+	}
+}
+
+/***********************************************************************
+ * main
+ ***********************************************************************/
+
+static void print_help()
+{
+	printf( "Usage: rspro-replay [-H HOST [-P PORT]] [-x DIR] [-r | -S FACTOR] CAPTURE-FILE\n"
+		"  -h --help                This text\n"
+		"  -H --host HOST           Replay the capture towards remsim-server/bankd at HOST\n"
+		"  -P --port PORT           TCP port of remsim-server/bankd (default: 9998)\n"
+		"  -x --extract-dir DIR     Write each RSPRO payload to a file in DIR (fuzzing corpus)\n"
+		"  -r --realtime            Replay with the timing of the capture\n"
+		"  -S --speed FACTOR        Replay with the timing of the capture, sped up by FACTOR\n"
+		"  -d --debug option        Enable debug logging (e.g. DMAIN:DRSPRO)\n"
+		);
+}
+
+static void print_stats(int64_t elapsed_ns)
+{
+	struct msg_stats *ms;
+
+	llist_for_each_entry(ms, &g_msg_stats, list) {
+		printf("{\"msg\":\"%s\",\"count\":%lu,\"bytes\":%lu,\"dec_ns_per_op\":%.1f}\n",
+		       ms->msg, ms->count, ms->bytes, (double) ms->dec_ns / ms->count);
+	}
+
+	printf("{\"records\":%lu,\"connections\":%lu,\"rspro_frames\":%lu,\"decode_errors\":%lu,"
+	       "\"tx_frames\":%lu,\"tx_bytes\":%lu,\"rx_frames\":%lu,\"rx_bytes\":%lu,"
+	       "\"connection_errors\":%lu,\"elapsed_ns\":%" PRId64 ",\"records_per_sec\":%.1f}\n",
+	       g_stats.records, g_stats.conns, g_stats.rspro_frames, g_stats.dec_errors,
+	       g_stats.tx_frames, g_stats.tx_bytes, g_stats.rx_frames, g_stats.rx_bytes,
+	       g_stats.conn_errors, elapsed_ns,
+	       elapsed_ns ? g_stats.records * 1e9 / elapsed_ns : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+	struct rspro_cap_rec *rec;
+	struct replay_conn *conn, *conn2;
+	uint64_t first_ts = 0;
+	int64_t start;
+	FILE *f;
+	int rc;
+
+	g_tall_ctx = talloc_named_const(NULL, 0, "rspro-replay");
+	talloc_asn1_ctx = talloc_named_const(g_tall_ctx, 0, "asn1");
+	msgb_talloc_ctx_init(g_tall_ctx, 0);
+	osmo_init_logging2(g_tall_ctx, &log_info);
+	log_set_log_level(osmo_stderr_target, LOGL_ERROR);
+
+	while (1) {
+		int option_index = 0, c;
+		static const struct option long_options[] = {
+			{ "help", 0, 0, 'h' },
+			{ "host", 1, 0, 'H' },
+			{ "port", 1, 0, 'P' },
+			{ "extract-dir", 1, 0, 'x' },
+			{ "realtime", 0, 0, 'r' },
+			{ "speed", 1, 0, 'S' },
+			{ "debug", 1, 0, 'd' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "hH:P:x:rS:d:", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help();
+			exit(0);
+			break;
+		case 'H':
+			g_cfg.host = optarg;
+			break;
+		case 'P':
+			g_cfg.port = atoi(optarg);
+			break;
+		case 'x':
+			g_cfg.extract_dir = optarg;
+			break;
+		case 'r':
+			g_cfg.speed = 1.0;
+			break;
+		case 'S':
+			g_cfg.speed = strtod(optarg, NULL);
+			if (g_cfg.speed <= 0) {
+				fprintf(stderr, "Invalid speed factor '%s'\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'd':
+			log_parse_category_mask(osmo_stderr_target, optarg);
+			break;
+		default:
+			print_help();
+			exit(2);
+			break;
+		}
+	}
+
+	if (optind != argc - 1) {
+		print_help();
+		exit(2);
+	}
+	if (g_cfg.host && g_cfg.extract_dir) {
+		fprintf(stderr, "-x cannot be combined with -H\n");
+		exit(2);
+	}
+
+	f = rspro_capture_reader_open(argv[optind]);
+	if (!f) {
+		fprintf(stderr, "Cannot open capture %s: %s\n", argv[optind], strerror(errno));
+		exit(1);
+	}
+
+	rec = talloc_zero(g_tall_ctx, struct rspro_cap_rec);
+	OSMO_ASSERT(rec);
+
+	start = now_ns();
+	while ((rc = rspro_capture_read(f, rec)) > 0) {
+		if (g_stats.records++ == 0)
+			first_ts = rec->ts_ns;
+		if (g_cfg.speed > 0)
+			pace(start, first_ts, rec->ts_ns);
+		if (replay_record(rec) < 0) {
+			rc = -EIO;
+			break;
+		}
+		if (g_cfg.host)
+			drain_all();
+	}
+	if (rc < 0)
+		fprintf(stderr, "Error reading capture after %lu records: %s\n", g_stats.records, strerror(-rc));
+
+	/* connections that were still open at the end of the capture */
+	llist_for_each_entry_safe(conn, conn2, &g_conns, list) {
+		conn_drain(conn);
+		conn_close(conn);
+	}
+
+	print_stats(now_ns() - start);
+
+	fclose(f);
+	talloc_free(g_tall_ctx);
+
+	return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,422 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Benchmark of the round-trip time of an APDU over a loopback RSPRO connection, for each of
+ * the socket profiles of rspro_sock_tune.c (and for a UNIX domain socket).
+ *
+ * The "client" (main thread) sends a request of one or more IPA framed RSPRO messages (e.g. a
+ * ClientSlotStatusInd followed by a TpduModemToCard, as it happens after a reset of the
+ * modem), each with a send() of its own.  The "bankd" (a second thread) reads them the way
+ * remsim-bankd does and answers with one TpduCardToModem.  Results are printed to stdout as
+ * one JSON object per line:
+ *
+ *   {"transport":"tcp","profile":"default","msgs_per_req":2,"iterations":500,
+ *    "rtt_us_avg":61.2,"rtt_us_p50":58.0,"rtt_us_p99":112.4,"rtt_us_max":180.9}
+ *
+ * With the profile "none", a request of more than one message is subject to Nagle's
+ * algorithm on the client side and to delayed ACKs on the bankd side. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/ipaccess.h>
+
+#include <osmocom/rspro/RsproPDU.h>
+
+#include "rspro_util.h"
+#include "rspro_sock_tune.h"
+#include "debug.h"
+
+__thread void *talloc_asn1_ctx;
+
+/* upper bound on the number of messages making up one request */
+#define MAX_MSGS_PER_REQ	4
+/* exchanges before the measurement, to get past TCP slow start etc. */
+#define WARMUP_ITERATIONS	50
+
+static const ClientSlot_t bench_clslot = { .clientId = 23, .slotNr = 3 };
+static const BankSlot_t bench_bslot = { .bankId = 1, .slotNr = 42 };
+
+/* an IPA framed RSPRO message, ready to be sent */
+struct ipa_frame {
+	uint8_t buf[512];
+	size_t len;
+};
+
+struct bench_conn {
+	int client_fd;
+	int bankd_fd;
+	/* SOCK_SEQPACKET: each message is one record */
+	bool seqpacket;
+	unsigned int msgs_per_req;
+	struct ipa_frame req[MAX_MSGS_PER_REQ];
+	struct ipa_frame rsp;
+};
+
+static inline int64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* encode the PDU (binary TPDU encoding, where applicable) and prepend the IPA headers */
+static void frame_pdu(struct ipa_frame *frame, RsproPDU_t *pdu)
+{
+	struct ipaccess_head *hh = (struct ipaccess_head *) frame->buf;
+	struct ipaccess_head_ext *he = (struct ipaccess_head_ext *) hh->data;
+	struct msgb *msg = rspro_enc_msg_tpdu(pdu, RSPRO_TPDU_ENC_BINARY);
+
+	OSMO_ASSERT(msg);
+	OSMO_ASSERT(sizeof(*hh) + sizeof(*he) + msgb_length(msg) <= sizeof(frame->buf));
+	hh->proto = IPAC_PROTO_OSMO;
+	hh->len = htons(sizeof(*he) + msgb_length(msg));
+	he->proto = IPAC_PROTO_EXT_RSPRO;
+	memcpy(he->data, msgb_data(msg), msgb_length(msg));
+	frame->len = sizeof(*hh) + sizeof(*he) + msgb_length(msg);
+	msgb_free(msg);
+}
+
+static void build_frames(struct bench_conn *bconn)
+{
+	uint8_t tpdu[5 + 16], rsp[24 + 2];
+	RsproPDU_t *pdu;
+	unsigned int i;
+
+	/* UPDATE BINARY of 16 bytes; 24 bytes of response data + SW */
+	memset(tpdu, 0x42, sizeof(tpdu));
+	memcpy(tpdu, "\x00\xd6\x00\x00\x10", 5);
+	memset(rsp, 0x23, sizeof(rsp));
+	memcpy(rsp + sizeof(rsp) - 2, "\x90\x00", 2);
+
+	for (i = 0; i < bconn->msgs_per_req - 1; i++) {
+		pdu = rspro_gen_ClientSlotStatusInd(&bench_clslot, &bench_bslot, false, 1, 1, 1);
+		frame_pdu(&bconn->req[i], pdu);
+	}
+	pdu = rspro_gen_TpduModem2Card(&bench_clslot, &bench_bslot, tpdu, sizeof(tpdu));
+	OSMO_ASSERT(pdu);
+	pdu->msg.choice.tpduModemToCard.flags.tpduHeaderPresent = 1;
+	pdu->msg.choice.tpduModemToCard.flags.finalPart = 1;
+	frame_pdu(&bconn->req[i], pdu);
+
+	pdu = rspro_gen_TpduCard2Modem(&bench_bslot, &bench_clslot, rsp, sizeof(rsp));
+	OSMO_ASSERT(pdu);
+	pdu->msg.choice.tpduCardToModem.flags.finalPart = 1;
+	frame_pdu(&bconn->rsp, pdu);
+}
+
+static int recv_all(int fd, uint8_t *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t rc;
+
+	while (done < len) {
+		rc = recv(fd, buf + done, len - done, 0);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			return -1;
+		done += rc;
+	}
+	return 0;
+}
+
+/* read one IPA message, like remsim-bankd does: header first, then the payload */
+static int read_ipa(int fd, bool seqpacket, uint8_t *buf, size_t buf_size)
+{
+	struct ipaccess_head *hh = (struct ipaccess_head *) buf;
+	ssize_t rc;
+
+	if (seqpacket) {
+		rc = recv(fd, buf, buf_size, 0);
+		if (rc < (ssize_t) sizeof(*hh) || rc != sizeof(*hh) + ntohs(hh->len))
+			return -1;
+		return 0;
+	}
+
+	if (recv_all(fd, buf, sizeof(*hh)) < 0)
+		return -1;
+	if (sizeof(*hh) + ntohs(hh->len) > buf_size)
+		return -1;
+	if (recv_all(fd, buf + sizeof(*hh), ntohs(hh->len)) < 0)
+		return -1;
+	rspro_sock_tune_rx(fd);
+	return 0;
+}
+
+static int send_frame(int fd, const struct ipa_frame *frame)
+{
+	return send(fd, frame->buf, frame->len, MSG_NOSIGNAL) == frame->len ? 0 : -1;
+}
+
+/* the "bankd": answer each complete request with one response */
+static void *bankd_thread(void *arg)
+{
+	struct bench_conn *bconn = arg;
+	uint8_t buf[1024];
+	unsigned int i;
+
+	while (1) {
+		for (i = 0; i < bconn->msgs_per_req; i++) {
+			if (read_ipa(bconn->bankd_fd, bconn->seqpacket, buf, sizeof(buf)) < 0)
+				return NULL;
+		}
+		if (send_frame(bconn->bankd_fd, &bconn->rsp) < 0)
+			return NULL;
+	}
+}
+
+static int exchange(struct bench_conn *bconn)
+{
+	uint8_t buf[1024];
+	unsigned int i;
+
+	for (i = 0; i < bconn->msgs_per_req; i++) {
+		if (send_frame(bconn->client_fd, &bconn->req[i]) < 0)
+			return -1;
+	}
+	return read_ipa(bconn->client_fd, bconn->seqpacket, buf, sizeof(buf));
+}
+
+/* connected pair of TCP sockets over loopback */
+static int open_tcp(struct bench_conn *bconn)
+{
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(sin);
+	int lfd;
+
+	lfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (lfd < 0)
+		return -errno;
+	if (bind(lfd, (struct sockaddr *) &sin, sizeof(sin)) < 0 || listen(lfd, 1) < 0 ||
+	    getsockname(lfd, (struct sockaddr *) &sin, &len) < 0)
+		goto err;
+
+	bconn->client_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (bconn->client_fd < 0)
+		goto err;
+	if (connect(bconn->client_fd, (struct sockaddr *) &sin, sizeof(sin)) < 0)
+		goto err_client;
+	bconn->bankd_fd = accept(lfd, NULL, NULL);
+	if (bconn->bankd_fd < 0)
+		goto err_client;
+	close(lfd);
+
+	rspro_sock_tune_apply(bconn->client_fd);
+	rspro_sock_tune_apply(bconn->bankd_fd);
+	bconn->seqpacket = false;
+	return 0;
+
+err_client:
+	close(bconn->client_fd);
+err:
+	close(lfd);
+	return -errno;
+}
+
+static int open_unix(struct bench_conn *bconn)
+{
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0)
+		return -errno;
+	bconn->client_fd = fds[0];
+	bconn->bankd_fd = fds[1];
+	bconn->seqpacket = true;
+	return 0;
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+static int run_case(const char *transport, const char *profile, unsigned int msgs_per_req,
+		    unsigned long iterations)
+{
+	struct bench_conn bconn = { .msgs_per_req = msgs_per_req };
+	int64_t *rtt, sum = 0, start;
+	pthread_t thread;
+	unsigned long i;
+	int rc;
+
+	build_frames(&bconn);
+	rtt = calloc(iterations, sizeof(*rtt));
+	OSMO_ASSERT(rtt);
+
+	if (!strcmp(transport, "unix")) {
+		rc = open_unix(&bconn);
+	} else {
+		OSMO_ASSERT(rspro_sock_tune_set_profile(profile) == 0);
+		rc = open_tcp(&bconn);
+	}
+	if (rc < 0) {
+		fprintf(stderr, "Cannot open %s connection: %s\n", transport, strerror(-rc));
+		goto out_free;
+	}
+
+	rc = pthread_create(&thread, NULL, bankd_thread, &bconn);
+	if (rc != 0) {
+		fprintf(stderr, "Cannot start thread: %s\n", strerror(rc));
+		rc = -rc;
+		goto out_close;
+	}
+
+	for (i = 0; i < WARMUP_ITERATIONS + iterations; i++) {
+		start = now_ns();
+		rc = exchange(&bconn);
+		if (rc < 0) {
+			fprintf(stderr, "Exchange over %s connection failed\n", transport);
+			break;
+		}
+		if (i >= WARMUP_ITERATIONS)
+			rtt[i - WARMUP_ITERATIONS] = now_ns() - start;
+	}
+
+	/* makes the thread return */
+	shutdown(bconn.client_fd, SHUT_RDWR);
+	pthread_join(thread, NULL);
+	if (rc < 0)
+		goto out_close;
+
+	for (i = 0; i < iterations; i++)
+		sum += rtt[i];
+	qsort(rtt, iterations, sizeof(*rtt), cmp_int64);
+	printf("{\"transport\":\"%s\",\"profile\":\"%s\",\"msgs_per_req\":%u,\"iterations\":%lu,"
+	       "\"rtt_us_avg\":%.1f,\"rtt_us_p50\":%.1f,\"rtt_us_p99\":%.1f,\"rtt_us_max\":%.1f}\n",
+	       transport, profile, msgs_per_req, iterations, (double) sum / iterations / 1000,
+	       rtt[iterations / 2] / 1000.0, rtt[iterations * 99 / 100] / 1000.0,
+	       rtt[iterations - 1] / 1000.0);
+	fflush(stdout);
+
+out_close:
+	close(bconn.client_fd);
+	close(bconn.bankd_fd);
+out_free:
+	free(rtt);
+	return rc;
+}
+
+static void print_help()
+{
+	printf( "Usage: rspro-rtt-bench [-n ITERATIONS] [-m MSGS] [-O PROFILE]\n"
+		"  -h --help                This text\n"
+		"  -n --iterations NUM      Number of measured APDU exchanges per case (default: 500)\n"
+		"  -m --msgs-per-req <1-4>  Only measure requests of the given number of messages\n"
+		"                           (default: 1 and 2)\n"
+		"  -O --socket-profile NAME Only measure TCP with the given socket profile\n"
+		"                           (default: all, and a UNIX domain socket)\n"
+		);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long iterations = 500;
+	unsigned int msgs_min = 1, msgs_max = 2, m;
+	const char *profile_filter = NULL;
+	void *g_tall_ctx;
+	unsigned int i;
+
+	while (1) {
+		int option_index = 0, c;
+		static const struct option long_options[] = {
+			{ "help", 0, 0, 'h' },
+			{ "iterations", 1, 0, 'n' },
+			{ "msgs-per-req", 1, 0, 'm' },
+			{ "socket-profile", 1, 0, 'O' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "hn:m:O:", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help();
+			exit(0);
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 10);
+			if (!iterations) {
+				fprintf(stderr, "Invalid number of iterations '%s'\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'm':
+			msgs_min = msgs_max = atoi(optarg);
+			if (msgs_min < 1 || msgs_min > MAX_MSGS_PER_REQ) {
+				fprintf(stderr, "Invalid number of messages '%s'\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'O':
+			if (get_string_value(rspro_sock_profile_names, optarg) < 0) {
+				fprintf(stderr, "Unknown socket profile '%s'\n", optarg);
+				exit(2);
+			}
+			profile_filter = optarg;
+			break;
+		default:
+			print_help();
+			exit(2);
+			break;
+		}
+	}
+
+	g_tall_ctx = talloc_named_const(NULL, 0, "rspro-rtt-bench");
+	talloc_asn1_ctx = talloc_named_const(g_tall_ctx, 0, "asn1");
+	msgb_talloc_ctx_init(g_tall_ctx, 0);
+	osmo_init_logging2(g_tall_ctx, &log_info);
+	/* only complain about options we cannot set at all */
+	log_set_log_level(osmo_stderr_target, LOGL_NOTICE);
+
+	for (m = msgs_min; m <= msgs_max; m++) {
+		for (i = 0; rspro_sock_profile_names[i].str; i++) {
+			if (profile_filter && strcmp(profile_filter, rspro_sock_profile_names[i].str))
+				continue;
+			if (run_case("tcp", rspro_sock_profile_names[i].str, m, iterations) < 0)
+				exit(1);
+		}
+		if (!profile_filter && run_case("unix", "-", m, iterations) < 0)
+			exit(1);
+	}
+
+	talloc_free(g_tall_ctx);
+
+	return 0;
+}
@@ -0,0 +1,140 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* RSPRO traffic consists of small request/response messages (mostly one TPDU each way), where
+ * latency matters and throughput doesn't.  With the kernel defaults, Nagle's algorithm holds
+ * back a message while the previous one is unacknowledged, and the peer delays that ACK by up
+ * to 40ms, hoping to piggy-back it onto a response. */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+
+#include "rspro_sock_tune.h"
+#include "debug.h"
+
+/* TC_PRIO_INTERACTIVE; the highest priority not requiring CAP_NET_ADMIN */
+#define RSPRO_SOCK_PRIORITY	6
+/* DSCP EF (expedited forwarding), in the upper six bits of the TOS / traffic class */
+#define RSPRO_SOCK_DSCP		46
+/* time to busy-poll the device queue for a response before sleeping */
+#define RSPRO_SOCK_BUSY_POLL_US	50
+
+const struct value_string rspro_sock_profile_names[] = {
+	{ RSPRO_SOCK_PROFILE_NONE,		"none" },
+	{ RSPRO_SOCK_PROFILE_DEFAULT,		"default" },
+	{ RSPRO_SOCK_PROFILE_LOW_LATENCY,	"low-latency" },
+	{ 0, NULL }
+};
+
+enum rspro_sock_profile g_rspro_sock_profile = RSPRO_SOCK_PROFILE_DEFAULT;
+
+/*! Select the profile applied to all subsequently created RSPRO sockets.
+ *  \param[in] name name of the profile, see rspro_sock_profile_names
+ *  \returns 0 on success; -EINVAL if there is no such profile */
+int rspro_sock_tune_set_profile(const char *name)
+{
+	int rc = get_string_value(rspro_sock_profile_names, name);
+
+	if (rc < 0)
+		return -EINVAL;
+	g_rspro_sock_profile = rc;
+	return 0;
+}
+
+enum rspro_sock_profile rspro_sock_tune_get_profile(void)
+{
+	return g_rspro_sock_profile;
+}
+
+static int set_opt(int fd, int level, int name, int val, const char *desc, int loglevel)
+{
+	if (setsockopt(fd, level, name, &val, sizeof(val)) == 0)
+		return 0;
+
+	LOGP(DMAIN, loglevel, "Cannot set %s=%d on RSPRO socket: %s\n", desc, val, strerror(errno));
+	return -errno;
+}
+
+/*! Apply the current profile to a connected RSPRO socket (TCP or UNIX domain).
+ *  TCP_NODELAY is set regardless of the profile, the profiles only add options on top.
+ *  Options which cannot be set are logged and skipped; the socket remains usable.
+ *  \returns 0 if all options were set; negative errno of the last failure otherwise */
+int rspro_sock_tune_apply(int fd)
+{
+	struct sockaddr_storage ss;
+	socklen_t len = sizeof(ss);
+	bool is_inet;
+	int rc = 0, rc2;
+
+	if (getsockname(fd, (struct sockaddr *) &ss, &len) < 0)
+		return -errno;
+	is_inet = ss.ss_family == AF_INET || ss.ss_family == AF_INET6;
+
+	if (is_inet) {
+		rc2 = set_opt(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", LOGL_ERROR);
+		if (rc2 < 0)
+			rc = rc2;
+	}
+
+	if (g_rspro_sock_profile != RSPRO_SOCK_PROFILE_LOW_LATENCY)
+		return rc;
+
+	rc2 = set_opt(fd, SOL_SOCKET, SO_PRIORITY, RSPRO_SOCK_PRIORITY, "SO_PRIORITY", LOGL_NOTICE);
+	if (rc2 < 0)
+		rc = rc2;
+
+	if (ss.ss_family == AF_INET)
+		rc2 = set_opt(fd, IPPROTO_IP, IP_TOS, RSPRO_SOCK_DSCP << 2, "IP_TOS", LOGL_NOTICE);
+	else if (ss.ss_family == AF_INET6)
+		rc2 = set_opt(fd, IPPROTO_IPV6, IPV6_TCLASS, RSPRO_SOCK_DSCP << 2, "IPV6_TCLASS",
+			      LOGL_NOTICE);
+	if (rc2 < 0)
+		rc = rc2;
+
+	if (is_inet) {
+		rc2 = set_opt(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK", LOGL_NOTICE);
+		if (rc2 < 0)
+			rc = rc2;
+	}
+
+#ifdef SO_BUSY_POLL
+	/* exceeding net.core.busy_read requires CAP_NET_ADMIN; that's fine, it's a bonus */
+	rc2 = set_opt(fd, SOL_SOCKET, SO_BUSY_POLL, RSPRO_SOCK_BUSY_POLL_US, "SO_BUSY_POLL",
+		      LOGL_INFO);
+	if (rc2 < 0)
+		rc = rc2;
+#endif
+
+	return rc;
+}
+
+/* the kernel falls back to delayed ACKs after a while; we want them off for good */
+void _rspro_sock_tune_rx(int fd)
+{
+	int one = 1;
+
+	if (fd >= 0)
+		setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+
+/* Tuning of the sockets of RSPRO connections.  The profile is process-wide, and applied to
+ * each RSPRO socket by all components (client, bankd, server) in the same way.  Nagle's
+ * algorithm (TCP_NODELAY) is disabled on all RSPRO sockets, whatever the profile. */
+
+enum rspro_sock_profile {
+	/* no options beyond TCP_NODELAY */
+	RSPRO_SOCK_PROFILE_NONE,
+	/* no options beyond TCP_NODELAY; the profile for options suitable for everybody */
+	RSPRO_SOCK_PROFILE_DEFAULT,
+	/* additionally: no delayed ACKs, interactive priority / DSCP EF, busy polling */
+	RSPRO_SOCK_PROFILE_LOW_LATENCY,
+};
+
+extern const struct value_string rspro_sock_profile_names[];
+
+int rspro_sock_tune_set_profile(const char *name);
+enum rspro_sock_profile rspro_sock_tune_get_profile(void);
+int rspro_sock_tune_apply(int fd);
+void _rspro_sock_tune_rx(int fd);
+
+extern enum rspro_sock_profile g_rspro_sock_profile;
+
+/*! To be called after reading from an RSPRO socket: re-arms options which the kernel resets
+ *  (TCP_QUICKACK).  Cheap unless the profile requires it. */
+static inline void rspro_sock_tune_rx(int fd)
+{
+	if (g_rspro_sock_profile == RSPRO_SOCK_PROFILE_LOW_LATENCY)
+		_rspro_sock_tune_rx(fd);
+}
+
+/*! To be called for each message read from an RSPRO socket served by osmo_select_main(),
+ *  where one read can yield several messages: defers rspro_sock_tune_rx() to 'timer', so
+ *  that it's called once for all messages of the read rather than for each of them. */
+static inline void rspro_sock_tune_rx_defer(struct osmo_timer_list *timer)
+{
+	if (g_rspro_sock_profile == RSPRO_SOCK_PROFILE_LOW_LATENCY && !osmo_timer_pending(timer))
+		osmo_timer_schedule(timer, 0, 0);
+}
@@ -17,6 +17,7 @@
  */
 
 
+#include <errno.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -26,6 +27,8 @@
 #include "asn1c_helpers.h"
 
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/bit16gen.h>
 #include <osmocom/rspro/RsproPDU.h>
 
 #include "rspro_util.h"
@@ -51,15 +54,231 @@ struct msgb *rspro_msgb_alloc(void)
 	return msgb_alloc_headroom(1024, 8, "RSPRO");
 }
 
-/*! BER-Encode an RSPRO message into  msgb. 
+/***********************************************************************
+ * compact binary encoding of TPDU messages
+ ***********************************************************************/
+
+/* tpduModemToCard and tpduCardToModem make up for virtually all of the traffic on a
+ * client <-> bankd connection, and their content is of fixed structure.  If both sides
+ * have agreed on TpduEncodings_binary in ConnectClientReq/ConnectClientRes, those two
+ * messages are sent in the following fixed-layout binary encoding instead of BER:
+ *
+ *	uint8_t  type		RSPRO_BIN_TPDU_M2C or RSPRO_BIN_TPDU_C2M
+ *	uint8_t  flags		RSPRO_BIN_F_*
+ *	uint16_t from_id	client (M2C) or bank (C2M) id, network byte order
+ *	uint16_t from_slot
+ *	uint16_t to_id		bank (M2C) or client (C2M) id, network byte order
+ *	uint16_t to_slot
+ *	uint8_t  data[]		the TPDU, up to the end of the message
+ *
+ * A BER-encoded RsproPDU always starts with the SEQUENCE tag 0x30, so the receiver can
+ * tell both encodings apart by the first octet without any further state.  The RSPRO_BIN_*
+ * constants are defined in rspro_util.h */
+
+static uint8_t tpdu_flags2bin(const TpduFlags_t *in)
+{
+	uint8_t flags = 0;
+
+	if (in->tpduHeaderPresent)
+		flags |= RSPRO_BIN_F_HDR_PRESENT;
+	if (in->finalPart)
+		flags |= RSPRO_BIN_F_FINAL_PART;
+	if (in->procByteContinueTx)
+		flags |= RSPRO_BIN_F_PB_CONT_TX;
+	if (in->procByteContinueRx)
+		flags |= RSPRO_BIN_F_PB_CONT_RX;
+
+	return flags;
+}
+
+static void bin2tpdu_flags(TpduFlags_t *out, uint8_t flags)
+{
+	out->tpduHeaderPresent = !!(flags & RSPRO_BIN_F_HDR_PRESENT);
+	out->finalPart = !!(flags & RSPRO_BIN_F_FINAL_PART);
+	out->procByteContinueTx = !!(flags & RSPRO_BIN_F_PB_CONT_TX);
+	out->procByteContinueRx = !!(flags & RSPRO_BIN_F_PB_CONT_RX);
+}
+
+static struct msgb *rspro_enc_bin_tpdu(const RsproPDU_t *pdu)
+{
+	const TpduModemToCard_t *m2c = &pdu->msg.choice.tpduModemToCard;
+	const TpduCardToModem_t *c2m = &pdu->msg.choice.tpduCardToModem;
+	struct msgb *msg;
+	const OCTET_STRING_t *data;
+
+	msg = rspro_msgb_alloc();
+	if (!msg)
+		return NULL;
+	msg->l2h = msg->data;
+
+	switch (pdu->msg.present) {
+	case RsproPDUchoice_PR_tpduModemToCard:
+		msgb_put_u8(msg, RSPRO_BIN_TPDU_M2C);
+		msgb_put_u8(msg, tpdu_flags2bin(&m2c->flags));
+		msgb_put_u16(msg, m2c->fromClientSlot.clientId);
+		msgb_put_u16(msg, m2c->fromClientSlot.slotNr);
+		msgb_put_u16(msg, m2c->toBankSlot.bankId);
+		msgb_put_u16(msg, m2c->toBankSlot.slotNr);
+		data = &m2c->data;
+		break;
+	case RsproPDUchoice_PR_tpduCardToModem:
+		msgb_put_u8(msg, RSPRO_BIN_TPDU_C2M);
+		msgb_put_u8(msg, tpdu_flags2bin(&c2m->flags));
+		msgb_put_u16(msg, c2m->fromBankSlot.bankId);
+		msgb_put_u16(msg, c2m->fromBankSlot.slotNr);
+		msgb_put_u16(msg, c2m->toClientSlot.clientId);
+		msgb_put_u16(msg, c2m->toClientSlot.slotNr);
+		data = &c2m->data;
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	if (data->size > msgb_tailroom(msg)) {
+		LOGP(DRSPRO, LOGL_ERROR, "TPDU of %d bytes too large for binary encoding\n", data->size);
+		msgb_free(msg);
+		return NULL;
+	}
+	memcpy(msgb_put(msg, data->size), data->buf, data->size);
+
+	return msg;
+}
+
+static RsproPDU_t *rspro_dec_bin_tpdu(const uint8_t *buf, size_t len)
+{
+	RsproPDU_t *pdu;
+	TpduModemToCard_t *m2c;
+	TpduCardToModem_t *c2m;
+	int rc;
+
+	if (len < RSPRO_BIN_TPDU_HDR_LEN) {
+		LOGP(DRSPRO, LOGL_ERROR, "Short binary TPDU message (%zu bytes)\n", len);
+		return NULL;
+	}
+
+	pdu = CALLOC(1, sizeof(*pdu));
+	if (!pdu)
+		return NULL;
+	pdu->version = 2;
+
+	switch (buf[0]) {
+	case RSPRO_BIN_TPDU_M2C:
+		pdu->msg.present = RsproPDUchoice_PR_tpduModemToCard;
+		m2c = &pdu->msg.choice.tpduModemToCard;
+		bin2tpdu_flags(&m2c->flags, buf[1]);
+		m2c->fromClientSlot.clientId = osmo_load16be(buf + 2);
+		m2c->fromClientSlot.slotNr = osmo_load16be(buf + 4);
+		m2c->toBankSlot.bankId = osmo_load16be(buf + 6);
+		m2c->toBankSlot.slotNr = osmo_load16be(buf + 8);
+		rc = OCTET_STRING_fromBuf(&m2c->data, (const char *) buf + RSPRO_BIN_TPDU_HDR_LEN,
+					  len - RSPRO_BIN_TPDU_HDR_LEN);
+		break;
+	case RSPRO_BIN_TPDU_C2M:
+		pdu->msg.present = RsproPDUchoice_PR_tpduCardToModem;
+		c2m = &pdu->msg.choice.tpduCardToModem;
+		bin2tpdu_flags(&c2m->flags, buf[1]);
+		c2m->fromBankSlot.bankId = osmo_load16be(buf + 2);
+		c2m->fromBankSlot.slotNr = osmo_load16be(buf + 4);
+		c2m->toClientSlot.clientId = osmo_load16be(buf + 6);
+		c2m->toClientSlot.slotNr = osmo_load16be(buf + 8);
+		rc = OCTET_STRING_fromBuf(&c2m->data, (const char *) buf + RSPRO_BIN_TPDU_HDR_LEN,
+					  len - RSPRO_BIN_TPDU_HDR_LEN);
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	if (rc < 0) {
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+		return NULL;
+	}
+
+	return pdu;
+}
+
+static bool is_bin_tpdu(const uint8_t *buf, size_t len)
+{
+	return len >= 1 && (buf[0] == RSPRO_BIN_TPDU_M2C || buf[0] == RSPRO_BIN_TPDU_C2M);
+}
+
+/*! Pre-build the header of all binary TPDU messages between a given client and bank slot.
+ *  \param[out] hdr header to fill in
+ *  \param[in] type RSPRO_BIN_TPDU_M2C or RSPRO_BIN_TPDU_C2M
+ *  \param[in] from_id client (M2C) or bank (C2M) id of the sender
+ *  \param[in] from_slot slot number of the sender
+ *  \param[in] to_id bank (M2C) or client (C2M) id of the recipient
+ *  \param[in] to_slot slot number of the recipient */
+void rspro_tpdu_hdr_init(struct rspro_tpdu_hdr *hdr, uint8_t type, uint16_t from_id, uint16_t from_slot,
+			 uint16_t to_id, uint16_t to_slot)
+{
+	hdr->buf[0] = type;
+	/* like rspro_gen_TpduModem2Card() / rspro_gen_TpduCard2Modem(), we don't set any flags */
+	hdr->buf[1] = 0;
+	osmo_store16be(from_id, hdr->buf + 2);
+	osmo_store16be(from_slot, hdr->buf + 4);
+	osmo_store16be(to_id, hdr->buf + 6);
+	osmo_store16be(to_slot, hdr->buf + 8);
+}
+
+/*! Encode a TPDU message in binary encoding, straight from a pre-built header and the TPDU,
+ *  without going through an RsproPDU.  Must only be used if the peer has agreed on
+ *  RSPRO_TPDU_ENC_BINARY.
+ *  \returns callee-allocated message buffer; NULL on error */
+struct msgb *rspro_enc_tpdu_hdr(const struct rspro_tpdu_hdr *hdr, const uint8_t *data, size_t len)
+{
+	struct msgb *msg;
+
+	/* headroom for the IPA header and its extension byte */
+	msg = msgb_alloc_headroom(8 + RSPRO_BIN_TPDU_HDR_LEN + len, 8, "RSPRO-TPDU");
+	if (!msg)
+		return NULL;
+	msg->l2h = msg->data;
+	memcpy(msgb_put(msg, RSPRO_BIN_TPDU_HDR_LEN), hdr->buf, RSPRO_BIN_TPDU_HDR_LEN);
+	memcpy(msgb_put(msg, len), data, len);
+
+	return msg;
+}
+
+/*! Parse a binary TPDU message without copying the TPDU out of the buffer.
+ *  \param[out] out parsed message; out->data points into buf
+ *  \returns 0 on success; -EINVAL if buf doesn't contain a binary TPDU message */
+int rspro_dec_tpdu_view(struct rspro_tpdu_view *out, const uint8_t *buf, size_t len)
+{
+	if (!is_bin_tpdu(buf, len) || len < RSPRO_BIN_TPDU_HDR_LEN)
+		return -EINVAL;
+
+	out->type = buf[0];
+	out->flags = buf[1];
+	out->from_id = osmo_load16be(buf + 2);
+	out->from_slot = osmo_load16be(buf + 4);
+	out->to_id = osmo_load16be(buf + 6);
+	out->to_slot = osmo_load16be(buf + 8);
+	out->data = buf + RSPRO_BIN_TPDU_HDR_LEN;
+	out->len = len - RSPRO_BIN_TPDU_HDR_LEN;
+
+	return 0;
+}
+
+/*! Encode an RSPRO message into msgb.
  *  \param[in] pdu Structure describing RSPRO PDU. Is freed by this function on success
+ *  \param[in] tpdu_enc Bit-mask of RSPRO_TPDU_ENC_* negotiated with the peer; 0 for BER only
  *  \returns callee-allocated message buffer containing encoded RSPRO PDU; NULL on error.
  */
-struct msgb *rspro_enc_msg(RsproPDU_t *pdu)
+struct msgb *rspro_enc_msg_tpdu(RsproPDU_t *pdu, uint32_t tpdu_enc)
 {
-	struct msgb *msg = rspro_msgb_alloc();
+	struct msgb *msg;
 	asn_enc_rval_t rval;
 
+	if ((tpdu_enc & RSPRO_TPDU_ENC_BINARY) &&
+	    (pdu->msg.present == RsproPDUchoice_PR_tpduModemToCard ||
+	     pdu->msg.present == RsproPDUchoice_PR_tpduCardToModem)) {
+		msg = rspro_enc_bin_tpdu(pdu);
+		if (msg)
+			ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+		return msg;
+	}
+
+	msg = rspro_msgb_alloc();
 	if (!msg)
 		return NULL;
 
@@ -77,23 +296,43 @@ struct msgb *rspro_enc_msg(RsproPDU_t *pdu)
 	return msg;
 }
 
-/* caller must make sure to free msg */
-RsproPDU_t *rspro_dec_msg(struct msgb *msg)
+/*! BER-Encode an RSPRO message into  msgb. 
+ *  \param[in] pdu Structure describing RSPRO PDU. Is freed by this function on success
+ *  \returns callee-allocated message buffer containing encoded RSPRO PDU; NULL on error.
+ */
+struct msgb *rspro_enc_msg(RsproPDU_t *pdu)
+{
+	return rspro_enc_msg_tpdu(pdu, 0);
+}
+
+/*! Decode an RSPRO message from a buffer, in BER or binary TPDU encoding.
+ *  \returns callee-allocated RSPRO PDU; NULL on error. */
+RsproPDU_t *rspro_dec_buf(const uint8_t *buf, size_t len)
 {
 	RsproPDU_t *pdu = NULL;
 	asn_dec_rval_t rval;
 
-	LOGP(DRSPRO, LOGL_DEBUG, "decoding %s\n", msgb_hexdump(msg));
-	rval = ber_decode(NULL, &asn_DEF_RsproPDU, (void **) &pdu, msgb_l2(msg), msgb_l2len(msg));
+	if (is_bin_tpdu(buf, len))
+		return rspro_dec_bin_tpdu(buf, len);
+
+	rval = ber_decode(NULL, &asn_DEF_RsproPDU, (void **) &pdu, buf, len);
 	if (rval.code != RC_OK) {
-		LOGP(DRSPRO, LOGL_ERROR, "Failed to decode: %d. Consumed %zu of %u bytes\n",
-			rval.code, rval.consumed, msgb_length(msg));
+		LOGP(DRSPRO, LOGL_ERROR, "Failed to decode: %d. Consumed %zu of %zu bytes\n",
+			rval.code, rval.consumed, len);
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
 		return NULL;
 	}
 
 	return pdu;
 }
 
+/* caller must make sure to free msg */
+RsproPDU_t *rspro_dec_msg(struct msgb *msg)
+{
+	LOGP(DRSPRO, LOGL_DEBUG, "decoding %s\n", msgb_hexdump(msg));
+	return rspro_dec_buf(msgb_l2(msg), msgb_l2len(msg));
+}
+
 static void fill_comp_id(ComponentIdentity_t *out, const struct app_comp_id *in)
 {
 	out->type = in->type;
@@ -483,6 +722,236 @@ RsproPDU_t *rspro_gen_ResetStateRes(e_ResultCode res)
 	return pdu;
 }
 
+RsproPDU_t *rspro_gen_ErrorInd(enum ComponentType sender, e_ErrorSeverity severity, e_ErrorCode code,
+			       const BankSlot_t *bank, const ClientSlot_t *client, const char *text)
+{
+	RsproPDU_t *pdu = CALLOC(1, sizeof(*pdu));
+	if (!pdu)
+		return NULL;
+	pdu->version = 2;
+	pdu->msg.present = RsproPDUchoice_PR_errorInd;
+	pdu->msg.choice.errorInd.sender = sender;
+	pdu->msg.choice.errorInd.severity = severity;
+	pdu->msg.choice.errorInd.code = code;
+	if (bank) {
+		pdu->msg.choice.errorInd.bankSlot = CALLOC(1, sizeof(BankSlot_t));
+		OSMO_ASSERT(pdu->msg.choice.errorInd.bankSlot);
+		*pdu->msg.choice.errorInd.bankSlot = *bank;
+	}
+	if (client) {
+		pdu->msg.choice.errorInd.clientSlot = CALLOC(1, sizeof(ClientSlot_t));
+		OSMO_ASSERT(pdu->msg.choice.errorInd.clientSlot);
+		*pdu->msg.choice.errorInd.clientSlot = *client;
+	}
+	if (text)
+		pdu->msg.choice.errorInd.errorString = OCTET_STRING_new_fromBuf(&asn_DEF_ErrorString, text, -1);
+
+	return pdu;
+}
+
+static TpduEncodings_t *gen_tpdu_encodings(uint32_t tpdu_enc)
+{
+	TpduEncodings_t *bs;
+	int i, last = -1;
+
+	for (i = 0; i < 32; i++) {
+		if (tpdu_enc & (1U << i))
+			last = i;
+	}
+	if (last < 0)
+		return NULL;
+
+	bs = CALLOC(1, sizeof(*bs));
+	OSMO_ASSERT(bs);
+	bs->size = last / 8 + 1;
+	bs->buf = CALLOC(1, bs->size);
+	OSMO_ASSERT(bs->buf);
+	/* DER: trailing zero bits of a named bit list are removed */
+	bs->bits_unused = 7 - (last % 8);
+	for (i = 0; i <= last; i++) {
+		if (tpdu_enc & (1U << i))
+			bs->buf[i / 8] |= 0x80 >> (i % 8);
+	}
+
+	return bs;
+}
+
+/*! Set the TpduEncodings of a ConnectClientReq / ConnectClientRes.
+ *  \param[in] pdu ConnectClientReq or ConnectClientRes PDU
+ *  \param[in] tpdu_enc Bit-mask of RSPRO_TPDU_ENC_* to indicate */
+void rspro_set_tpdu_encodings(RsproPDU_t *pdu, uint32_t tpdu_enc)
+{
+	TpduEncodings_t **out;
+
+	switch (pdu->msg.present) {
+	case RsproPDUchoice_PR_connectClientReq:
+		out = &pdu->msg.choice.connectClientReq.tpduEncodings;
+		break;
+	case RsproPDUchoice_PR_connectClientRes:
+		out = &pdu->msg.choice.connectClientRes.tpduEncodings;
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	if (*out)
+		ASN_STRUCT_FREE(asn_DEF_TpduEncodings, *out);
+	*out = gen_tpdu_encodings(tpdu_enc);
+}
+
+/*! Obtain the TpduEncodings of a ConnectClientReq / ConnectClientRes.
+ *  \returns bit-mask of RSPRO_TPDU_ENC_*; 0 if absent (peer only supports BER) */
+uint32_t rspro_get_tpdu_encodings(const RsproPDU_t *pdu)
+{
+	const TpduEncodings_t *bs;
+	uint32_t tpdu_enc = 0;
+	size_t i, num_bits;
+
+	switch (pdu->msg.present) {
+	case RsproPDUchoice_PR_connectClientReq:
+		bs = pdu->msg.choice.connectClientReq.tpduEncodings;
+		break;
+	case RsproPDUchoice_PR_connectClientRes:
+		bs = pdu->msg.choice.connectClientRes.tpduEncodings;
+		break;
+	default:
+		return 0;
+	}
+
+	if (!bs || bs->size <= 0 || bs->bits_unused < 0 || bs->bits_unused > 7)
+		return 0;
+
+	num_bits = bs->size * 8 - bs->bits_unused;
+	for (i = 0; i < num_bits && i < 32; i++) {
+		if (bs->buf[i / 8] & (0x80 >> (i % 8)))
+			tpdu_enc |= (1U << i);
+	}
+
+	return tpdu_enc;
+}
+
+/*! Add the client slot to which a ConnectClientRes refers; a bankd only does so if it
+ *  accepts further client slots multiplexed over the same connection. */
+void rspro_set_connect_client_res_slot(RsproPDU_t *pdu, const ClientSlot_t *client)
+{
+	ConnectClientRes_t *res = &pdu->msg.choice.connectClientRes;
+
+	OSMO_ASSERT(pdu->msg.present == RsproPDUchoice_PR_connectClientRes);
+
+	if (!res->clientSlot) {
+		res->clientSlot = CALLOC(1, sizeof(ClientSlot_t));
+		OSMO_ASSERT(res->clientSlot);
+	}
+	*res->clientSlot = *client;
+}
+
+static SocketPath_t **bankd_socket_path_ptr(RsproPDU_t *pdu)
+{
+	switch (pdu->msg.present) {
+	case RsproPDUchoice_PR_connectBankReq:
+		return &pdu->msg.choice.connectBankReq.bankdSocketPath;
+	case RsproPDUchoice_PR_configClientBankReq:
+		return &pdu->msg.choice.configClientBankReq.bankdSocketPath;
+	default:
+		return NULL;
+	}
+}
+
+/*! Set the UNIX domain socket of the bankd in a ConnectBankReq or ConfigClientBankReq */
+void rspro_set_bankd_socket_path(RsproPDU_t *pdu, const char *path)
+{
+	SocketPath_t **sp = bankd_socket_path_ptr(pdu);
+
+	OSMO_ASSERT(sp);
+	if (*sp)
+		ASN_STRUCT_FREE(asn_DEF_SocketPath, *sp);
+	*sp = OCTET_STRING_new_fromBuf(&asn_DEF_SocketPath, path, -1);
+}
+
+/*! Obtain the UNIX domain socket of the bankd from a ConnectBankReq or ConfigClientBankReq.
+ *  \returns NUL-terminated copy allocated from ctx; NULL if the PDU carries none */
+char *rspro_get_bankd_socket_path(void *ctx, const RsproPDU_t *pdu)
+{
+	SocketPath_t **sp = bankd_socket_path_ptr((RsproPDU_t *) pdu);
+
+	if (!sp || !*sp || !(*sp)->size)
+		return NULL;
+	return talloc_strndup(ctx, (const char *) (*sp)->buf, (*sp)->size);
+}
+
+static RetryAfterMs_t **retry_after_ptr(RsproPDU_t *pdu)
+{
+	switch (pdu->msg.present) {
+	case RsproPDUchoice_PR_connectClientRes:
+		return &pdu->msg.choice.connectClientRes.retryAfterMs;
+	case RsproPDUchoice_PR_connectBankRes:
+		return &pdu->msg.choice.connectBankRes.retryAfterMs;
+	default:
+		return NULL;
+	}
+}
+
+/*! Set the delay after which the peer shall try to connect again in a ConnectClientRes or
+ *  ConnectBankRes (with result tryAgainLater) */
+void rspro_set_retry_after(RsproPDU_t *pdu, uint32_t delay_ms)
+{
+	RetryAfterMs_t **ra = retry_after_ptr(pdu);
+
+	OSMO_ASSERT(ra);
+	if (!*ra) {
+		*ra = CALLOC(1, sizeof(RetryAfterMs_t));
+		OSMO_ASSERT(*ra);
+	}
+	**ra = OSMO_MIN(delay_ms, 3600000);
+}
+
+/*! Obtain the delay after which we shall try to connect again from a ConnectClientRes or
+ *  ConnectBankRes.
+ *  \returns delay in milliseconds; negative if the PDU carries none */
+int32_t rspro_get_retry_after(const RsproPDU_t *pdu)
+{
+	RetryAfterMs_t **ra = retry_after_ptr((RsproPDU_t *) pdu);
+
+	if (!ra || !*ra)
+		return -1;
+	return **ra;
+}
+
+/*! Is the PDU an ErrorInd telling that the given client slot no longer uses a connection
+ *  multiplexing several client slots between remsim-client and remsim-bankd? */
+bool rspro_is_client_slot_detach(const RsproPDU_t *pdu)
+{
+	return pdu->msg.present == RsproPDUchoice_PR_errorInd &&
+	       pdu->msg.choice.errorInd.code == ErrorCode_unexpectedDisconnect &&
+	       pdu->msg.choice.errorInd.clientSlot;
+}
+
+/*! Obtain the client slot a PDU exchanged between remsim-client and remsim-bankd refers to.
+ *  \returns pointer to the client slot inside pdu; NULL if the PDU carries none */
+const ClientSlot_t *rspro_get_client_slot(const RsproPDU_t *pdu)
+{
+	switch (pdu->msg.present) {
+	case RsproPDUchoice_PR_connectClientReq:
+		return pdu->msg.choice.connectClientReq.clientSlot;
+	case RsproPDUchoice_PR_connectClientRes:
+		return pdu->msg.choice.connectClientRes.clientSlot;
+	case RsproPDUchoice_PR_setAtrReq:
+		return &pdu->msg.choice.setAtrReq.slot;
+	case RsproPDUchoice_PR_tpduModemToCard:
+		return &pdu->msg.choice.tpduModemToCard.fromClientSlot;
+	case RsproPDUchoice_PR_tpduCardToModem:
+		return &pdu->msg.choice.tpduCardToModem.toClientSlot;
+	case RsproPDUchoice_PR_clientSlotStatusInd:
+		return &pdu->msg.choice.clientSlotStatusInd.fromClientSlot;
+	case RsproPDUchoice_PR_bankSlotStatusInd:
+		return &pdu->msg.choice.bankSlotStatusInd.toClientSlot;
+	case RsproPDUchoice_PR_errorInd:
+		return pdu->msg.choice.errorInd.clientSlot;
+	default:
+		return NULL;
+	}
+}
+
 e_ResultCode rspro_get_result(const RsproPDU_t *pdu)
 {
 	switch (pdu->msg.present) {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include <osmocom/core/msgb.h>
 #include <osmocom/rspro/RsproPDU.h>
 #include <osmocom/rspro/ComponentType.h>
@@ -19,9 +21,48 @@ struct app_comp_id {
 
 const char *rspro_msgt_name(const RsproPDU_t *pdu);
 
+/* TPDU encodings which can be negotiated in addition to BER, see TpduEncodings in RSPRO.asn */
+#define RSPRO_TPDU_ENC_BINARY		(1U << TpduEncodings_binary)
+/* all TPDU encodings implemented by rspro_enc_msg_tpdu() / rspro_dec_buf() */
+#define RSPRO_TPDU_ENC_SUPPORTED	RSPRO_TPDU_ENC_BINARY
+
+/* compact binary encoding of TPDU messages, see rspro_util.c */
+#define RSPRO_BIN_TPDU_M2C		0xb1
+#define RSPRO_BIN_TPDU_C2M		0xb2
+#define RSPRO_BIN_TPDU_HDR_LEN		10
+
+#define RSPRO_BIN_F_HDR_PRESENT		0x01
+#define RSPRO_BIN_F_FINAL_PART		0x02
+#define RSPRO_BIN_F_PB_CONT_TX		0x04
+#define RSPRO_BIN_F_PB_CONT_RX		0x08
+
+/* header of binary TPDU messages, which is the same for all TPDUs of one slot mapping */
+struct rspro_tpdu_hdr {
+	uint8_t buf[RSPRO_BIN_TPDU_HDR_LEN];
+};
+
+/* binary TPDU message as received, referring to the receive buffer */
+struct rspro_tpdu_view {
+	uint8_t type;		/* RSPRO_BIN_TPDU_* */
+	uint8_t flags;		/* RSPRO_BIN_F_* */
+	uint16_t from_id;
+	uint16_t from_slot;
+	uint16_t to_id;
+	uint16_t to_slot;
+	const uint8_t *data;
+	size_t len;
+};
+
+void rspro_tpdu_hdr_init(struct rspro_tpdu_hdr *hdr, uint8_t type, uint16_t from_id, uint16_t from_slot,
+			 uint16_t to_id, uint16_t to_slot);
+struct msgb *rspro_enc_tpdu_hdr(const struct rspro_tpdu_hdr *hdr, const uint8_t *data, size_t len);
+int rspro_dec_tpdu_view(struct rspro_tpdu_view *out, const uint8_t *buf, size_t len);
+
 struct msgb *rspro_msgb_alloc(void);
 struct msgb *rspro_enc_msg(RsproPDU_t *pdu);
+struct msgb *rspro_enc_msg_tpdu(RsproPDU_t *pdu, uint32_t tpdu_enc);
 RsproPDU_t *rspro_dec_msg(struct msgb *msg);
+RsproPDU_t *rspro_dec_buf(const uint8_t *buf, size_t len);
 RsproPDU_t *rspro_gen_ConnectBankReq(const struct app_comp_id *a_cid,
 					uint16_t bank_id, uint16_t num_slots);
 RsproPDU_t *rspro_gen_ConnectBankRes(const struct app_comp_id *a_cid, e_ResultCode res);
@@ -50,8 +91,25 @@ RsproPDU_t *rspro_gen_ClientSlotStatusInd(const ClientSlot_t *client, const Bank
 					  int card_present);
 RsproPDU_t *rspro_gen_ResetStateReq(void);
 RsproPDU_t *rspro_gen_ResetStateRes(e_ResultCode res);
+RsproPDU_t *rspro_gen_ErrorInd(enum ComponentType sender, e_ErrorSeverity severity, e_ErrorCode code,
+			       const BankSlot_t *bank, const ClientSlot_t *client, const char *text);
 
 e_ResultCode rspro_get_result(const RsproPDU_t *pdu);
+void rspro_set_tpdu_encodings(RsproPDU_t *pdu, uint32_t tpdu_enc);
+uint32_t rspro_get_tpdu_encodings(const RsproPDU_t *pdu);
+void rspro_set_connect_client_res_slot(RsproPDU_t *pdu, const ClientSlot_t *client);
+void rspro_set_bankd_socket_path(RsproPDU_t *pdu, const char *path);
+char *rspro_get_bankd_socket_path(void *ctx, const RsproPDU_t *pdu);
+void rspro_set_retry_after(RsproPDU_t *pdu, uint32_t delay_ms);
+int32_t rspro_get_retry_after(const RsproPDU_t *pdu);
+const ClientSlot_t *rspro_get_client_slot(const RsproPDU_t *pdu);
+bool rspro_is_client_slot_detach(const RsproPDU_t *pdu);
+
+/* RSPRO peer addresses starting with a '/' refer to a UNIX domain (SOCK_SEQPACKET) socket */
+static inline bool rspro_addr_is_unix(const char *addr)
+{
+	return addr && addr[0] == '/';
+}
 
 void rspro_comp_id_retrieve(struct app_comp_id *out, const ComponentIdentity_t *in);
 const char *rspro_IpAddr2str(const IpAddress_t *in);
@@ -0,0 +1,145 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <errno.h>
+#include <time.h>
+
+#include <talloc.h>
+
+#include <osmocom/core/utils.h>
+
+#include "event_ring.h"
+
+osmo_static_assert((EVENT_RING_SIZE & (EVENT_RING_SIZE - 1)) == 0, event_ring_size_pow2);
+
+const struct value_string remsim_event_type_names[] = {
+	{ RS_EV_SLOTMAP_ADDED,		"slotmapAdded" },
+	{ RS_EV_SLOTMAP_STATE,		"slotmapState" },
+	{ RS_EV_SLOTMAP_DELETED,	"slotmapDeleted" },
+	{ RS_EV_CONN_STATE,		"connState" },
+	{ RS_EV_CONN_CLOSED,		"connClosed" },
+	{ 0, NULL }
+};
+
+static int event_ring_destructor(struct event_ring *r)
+{
+	pthread_cond_destroy(&r->wait_cond);
+	pthread_mutex_destroy(&r->wait_mutex);
+	return 0;
+}
+
+struct event_ring *event_ring_alloc(void *ctx)
+{
+	struct event_ring *r = talloc_zero(ctx, struct event_ring);
+	pthread_condattr_t attr;
+
+	if (!r)
+		return NULL;
+
+	pthread_mutex_init(&r->wait_mutex, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&r->wait_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	talloc_set_destructor(r, event_ring_destructor);
+
+	return r;
+}
+
+static void event_ring_wake(struct event_ring *r)
+{
+	pthread_mutex_lock(&r->wait_mutex);
+	pthread_cond_broadcast(&r->wait_cond);
+	pthread_mutex_unlock(&r->wait_mutex);
+}
+
+/* make any blocked consumers return, e.g. before stopping the HTTP server */
+void event_ring_shutdown(struct event_ring *r)
+{
+	atomic_store(&r->shutdown, true);
+	event_ring_wake(r);
+}
+
+void event_ring_publish(struct event_ring *r, const struct remsim_event *ev)
+{
+	uint64_t seq = atomic_fetch_add(&r->head, 1) + 1;
+	struct event_ring_slot *slot = &r->slots[seq & (EVENT_RING_SIZE - 1)];
+
+	/* invalidate the slot so concurrent readers of the previous occupant notice */
+	atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->ev = *ev;
+	slot->ev.seq = seq;
+	atomic_store_explicit(&slot->seq, seq, memory_order_release);
+
+	/* only pay for the mutex if somebody is actually sleeping */
+	if (atomic_load(&r->num_waiters))
+		event_ring_wake(r);
+}
+
+int event_ring_read(struct event_ring *r, uint64_t seq, struct remsim_event *out)
+{
+	const struct event_ring_slot *slot = &r->slots[seq & (EVENT_RING_SIZE - 1)];
+	uint64_t s1, s2;
+
+	s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+	if (s1 != seq) {
+		/* either the producer isn't finished yet, or a newer event is in its place */
+		if (s1 > seq || atomic_load(&r->head) >= seq + EVENT_RING_SIZE)
+			return -ENOENT;
+		return -EAGAIN;
+	}
+
+	*out = slot->ev;
+
+	/* seqlock-style re-check: did a producer overwrite the slot while we copied? */
+	atomic_thread_fence(memory_order_acquire);
+	s2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+	if (s2 != seq)
+		return -ENOENT;
+
+	return 0;
+}
+
+bool event_ring_wait(struct event_ring *r, uint64_t seq, unsigned int timeout_ms)
+{
+	struct timespec ts;
+	bool avail;
+
+	if (atomic_load(&r->head) > seq)
+		return true;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&r->wait_mutex);
+	atomic_fetch_add(&r->num_waiters, 1);
+	while (!(avail = atomic_load(&r->head) > seq) && !atomic_load(&r->shutdown)) {
+		if (pthread_cond_timedwait(&r->wait_cond, &r->wait_mutex, &ts) == ETIMEDOUT)
+			break;
+	}
+	atomic_fetch_sub(&r->num_waiters, 1);
+	pthread_mutex_unlock(&r->wait_mutex);
+
+	return avail;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <osmocom/core/utils.h>
+
+#include "slotmap.h"
+
+/* number of most recent events retained; must be power of two */
+#define EVENT_RING_SIZE	2048
+
+enum remsim_event_type {
+	RS_EV_SLOTMAP_ADDED,
+	RS_EV_SLOTMAP_STATE,
+	RS_EV_SLOTMAP_DELETED,
+	RS_EV_CONN_STATE,
+	RS_EV_CONN_CLOSED,
+};
+extern const struct value_string remsim_event_type_names[];
+
+/* a single state change event, as published to REST API consumers */
+struct remsim_event {
+	/* sequence number, assigned by event_ring_publish() */
+	uint64_t seq;
+	enum remsim_event_type type;
+	union {
+		struct {
+			uint32_t id;
+			struct bank_slot bank;
+			struct client_slot client;
+			enum slot_mapping_state old_state;
+			enum slot_mapping_state new_state;
+		} slotmap;
+		struct {
+			char peer[32];
+			/* static string owned by the FSM definition */
+			const char *state;
+			/* ComponentType of the peer */
+			long comp_type;
+		} conn;
+	} u;
+};
+
+struct event_ring_slot {
+	/* sequence number of the event in 'ev'; 0 while it is being written */
+	_Atomic uint64_t seq;
+	struct remsim_event ev;
+};
+
+/* Multi-producer, multi-consumer broadcast ring.  Producers never block or wait for
+ * consumers; a consumer falling behind by more than EVENT_RING_SIZE events loses the
+ * oldest ones and is told so.  Only consumers waiting for new events sleep on the
+ * condition variable. */
+struct event_ring {
+	/* sequence number of the most recently allocated slot */
+	_Atomic uint64_t head;
+	_Atomic unsigned int num_waiters;
+	_Atomic bool shutdown;
+	pthread_mutex_t wait_mutex;
+	pthread_cond_t wait_cond;
+	struct event_ring_slot slots[EVENT_RING_SIZE];
+};
+
+struct event_ring *event_ring_alloc(void *ctx);
+void event_ring_shutdown(struct event_ring *r);
+
+/* called by producers from any thread */
+void event_ring_publish(struct event_ring *r, const struct remsim_event *ev);
+
+static inline uint64_t event_ring_head(struct event_ring *r)
+{
+	return atomic_load(&r->head);
+}
+
+/* read event with sequence number 'seq'. Returns 0 on success, -EAGAIN if it has not been
+ * published yet, -ENOENT if it has already been overwritten */
+int event_ring_read(struct event_ring *r, uint64_t seq, struct remsim_event *out);
+
+/* block until an event newer than 'seq' was published or timeout_ms has expired.
+ * Returns true if new events are available */
+bool event_ring_wait(struct event_ring *r, uint64_t seq, unsigned int timeout_ms);
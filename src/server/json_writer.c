@@ -0,0 +1,226 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Streaming JSON writer for REST responses.  Unlike a jansson tree, it doesn't
+ * allocate per value via the (mutex-protected) talloc allocator, but uses plain
+ * malloc/realloc on a single, geometrically growing buffer private to the calling
+ * thread. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+
+#include "json_writer.h"
+
+/* one bit per depth in jw->non_empty */
+osmo_static_assert(JW_MAX_DEPTH <= 32, jw_max_depth_fits_non_empty);
+
+static bool jw_reserve(struct json_writer *jw, size_t len)
+{
+	size_t new_size;
+	char *new_buf;
+
+	if (jw->error)
+		return false;
+	if (jw->len + len <= jw->size)
+		return true;
+
+	new_size = jw->size ? jw->size : 256;
+	while (new_size < jw->len + len)
+		new_size *= 2;
+
+	new_buf = realloc(jw->buf, new_size);
+	if (!new_buf) {
+		jw->error = true;
+		return false;
+	}
+	jw->buf = new_buf;
+	jw->size = new_size;
+	return true;
+}
+
+static void jw_put(struct json_writer *jw, const char *str, size_t len)
+{
+	if (!jw_reserve(jw, len))
+		return;
+	memcpy(jw->buf + jw->len, str, len);
+	jw->len += len;
+}
+
+static void jw_putc(struct json_writer *jw, char c)
+{
+	jw_put(jw, &c, 1);
+}
+
+static void jw_put_escaped(struct json_writer *jw, const char *str)
+{
+	const char *start = str;
+	char esc[8];
+
+	jw_putc(jw, '"');
+	for (; *str; str++) {
+		unsigned char c = *str;
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		/* flush the run of plain characters before the one needing an escape */
+		jw_put(jw, start, str - start);
+		switch (c) {
+		case '"':
+			jw_put(jw, "\\\"", 2);
+			break;
+		case '\\':
+			jw_put(jw, "\\\\", 2);
+			break;
+		case '\n':
+			jw_put(jw, "\\n", 2);
+			break;
+		case '\r':
+			jw_put(jw, "\\r", 2);
+			break;
+		case '\t':
+			jw_put(jw, "\\t", 2);
+			break;
+		default:
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			jw_put(jw, esc, 6);
+			break;
+		}
+		start = str + 1;
+	}
+	jw_put(jw, start, str - start);
+	jw_putc(jw, '"');
+}
+
+/* emit separator + key (if any) ahead of a new member/element */
+static void jw_member(struct json_writer *jw, const char *key)
+{
+	uint32_t bit;
+
+	/* jw_open() never nests deeper */
+	OSMO_ASSERT(jw->depth < JW_MAX_DEPTH);
+	bit = 1u << jw->depth;
+
+	if (jw->non_empty & bit)
+		jw_putc(jw, ',');
+	jw->non_empty |= bit;
+
+	if (key) {
+		jw_put_escaped(jw, key);
+		jw_putc(jw, ':');
+	}
+}
+
+static void jw_open(struct json_writer *jw, const char *key, char c)
+{
+	jw_member(jw, key);
+	jw_putc(jw, c);
+	if (jw->depth + 1 >= JW_MAX_DEPTH) {
+		jw->error = true;
+		return;
+	}
+	jw->depth++;
+	jw->non_empty &= ~(1u << jw->depth);
+}
+
+static void jw_close(struct json_writer *jw, char c)
+{
+	if (jw->depth == 0) {
+		jw->error = true;
+		return;
+	}
+	jw->depth--;
+	jw_putc(jw, c);
+}
+
+void jw_init(struct json_writer *jw, size_t initial_size)
+{
+	memset(jw, 0, sizeof(*jw));
+	jw_reserve(jw, initial_size);
+}
+
+void jw_free(struct json_writer *jw)
+{
+	free(jw->buf);
+	memset(jw, 0, sizeof(*jw));
+}
+
+void jw_reset(struct json_writer *jw)
+{
+	jw->len = 0;
+	jw->depth = 0;
+	jw->non_empty = 0;
+	jw->error = false;
+}
+
+void jw_raw(struct json_writer *jw, const char *str, size_t len)
+{
+	jw_put(jw, str, len);
+	if (jw->depth == 0)
+		jw->non_empty = 0;
+}
+
+void jw_obj_open(struct json_writer *jw, const char *key)
+{
+	jw_open(jw, key, '{');
+}
+
+void jw_obj_close(struct json_writer *jw)
+{
+	jw_close(jw, '}');
+}
+
+void jw_arr_open(struct json_writer *jw, const char *key)
+{
+	jw_open(jw, key, '[');
+}
+
+void jw_arr_close(struct json_writer *jw)
+{
+	jw_close(jw, ']');
+}
+
+void jw_str(struct json_writer *jw, const char *key, const char *val)
+{
+	jw_member(jw, key);
+	if (val)
+		jw_put_escaped(jw, val);
+	else
+		jw_put(jw, "null", 4);
+}
+
+void jw_int(struct json_writer *jw, const char *key, long long val)
+{
+	char tmp[32];
+	int len;
+
+	jw_member(jw, key);
+	len = snprintf(tmp, sizeof(tmp), "%lld", val);
+	jw_put(jw, tmp, len);
+}
+
+void jw_uint(struct json_writer *jw, const char *key, unsigned long long val)
+{
+	char tmp[32];
+	int len;
+
+	jw_member(jw, key);
+	len = snprintf(tmp, sizeof(tmp), "%llu", val);
+	jw_put(jw, tmp, len);
+}
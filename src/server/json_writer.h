@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* maximum nesting depth of objects/arrays supported by the writer */
+#define JW_MAX_DEPTH	32
+
+/* minimalistic streaming JSON writer emitting directly into a growable buffer,
+ * avoiding the allocation of a json_t tree for every response */
+struct json_writer {
+	char *buf;
+	size_t len;
+	size_t size;
+	/* current nesting depth */
+	unsigned int depth;
+	/* bit-mask: has the container at given depth already got a member? */
+	uint32_t non_empty;
+	/* some allocation failed or nesting was exceeded */
+	bool error;
+};
+
+void jw_init(struct json_writer *jw, size_t initial_size);
+void jw_free(struct json_writer *jw);
+/* discard any content but keep the buffer for re-use */
+void jw_reset(struct json_writer *jw);
+/* append raw (non-JSON) text; at top level, subsequent values start without separator */
+void jw_raw(struct json_writer *jw, const char *str, size_t len);
+
+/* 'key' is the member name inside an object, or NULL inside an array / at top level */
+void jw_obj_open(struct json_writer *jw, const char *key);
+void jw_obj_close(struct json_writer *jw);
+void jw_arr_open(struct json_writer *jw, const char *key);
+void jw_arr_close(struct json_writer *jw);
+void jw_str(struct json_writer *jw, const char *key, const char *val);
+void jw_int(struct json_writer *jw, const char *key, long long val);
+void jw_uint(struct json_writer *jw, const char *key, unsigned long long val);
@@ -1,5 +1,7 @@
 #include <unistd.h>
 #include <signal.h>
+#include <errno.h>
+#include <string.h>
 
 #define _GNU_SOURCE
 #include <getopt.h>
@@ -16,7 +18,9 @@
 #include "debug.h"
 #include "slotmap.h"
 #include "rest_api.h"
+#include "rspro_capture.h"
 #include "rspro_server.h"
+#include "rspro_sock_tune.h"
 
 struct rspro_server *g_rps;
 void *g_tall_ctx;
@@ -24,6 +28,12 @@ __thread void *talloc_asn1_ctx;
 
 struct osmo_fd g_event_ofd;
 
+static const char *g_state_dir;
+static const char *g_capture_file;
+static const char *g_unix_socket;
+static bool g_admission_set;
+static unsigned int g_admission_rate, g_admission_burst;
+
 static void handle_sig_usr1(int signal)
 {
 	OSMO_ASSERT(signal == SIGUSR1);
@@ -37,9 +47,41 @@ static void print_help()
 		"  -V --version             Print version of the program\n"
 		"  -d --debug option        Enable debug logging (e.g. DMAIN:DST2)\n"
 		"  -L --disable-color       Disable colors for logging to stderr\n"
+		"  -s --state-dir PATH      Persist slot mappings in given directory\n"
+		"  -c --capture-file PATH   Capture all RSPRO connections to given file\n"
+		"  -u --unix-socket PATH    Also accept co-located bankds/clients on UNIX domain socket\n"
+		"  -O --socket-profile NAME Tuning of RSPRO sockets: none, default, low-latency\n"
+		"  -a --admission-rate RATE[:BURST]\n"
+		"                           Admit at most RATE connecting clients per second (0: any)\n"
 		);
 }
 
+/* RATE[:BURST]; BURST defaults to twice the RATE */
+static int parse_admission(const char *arg)
+{
+	char *end;
+
+	/* strtoul() would happily negate "-1" into a huge rate */
+	if (strchr(arg, '-'))
+		return -EINVAL;
+
+	errno = 0;
+	g_admission_rate = strtoul(arg, &end, 10);
+	if (errno || end == arg)
+		return -EINVAL;
+	g_admission_burst = 2 * g_admission_rate;
+	if (*end == ':') {
+		arg = end + 1;
+		g_admission_burst = strtoul(arg, &end, 10);
+		if (errno || end == arg)
+			return -EINVAL;
+	}
+	if (*end)
+		return -EINVAL;
+	g_admission_set = true;
+	return 0;
+}
+
 static void handle_options(int argc, char **argv)
 {
 	while (1) {
@@ -49,10 +91,15 @@ static void handle_options(int argc, char **argv)
 			{ "version", 0, 0, 'V' },
 			{ "debug", 1, 0, 'd' },
 			{ "disable-color", 0, 0, 'L' },
+			{ "state-dir", 1, 0, 's' },
+			{ "capture-file", 1, 0, 'c' },
+			{ "unix-socket", 1, 0, 'u' },
+			{ "socket-profile", 1, 0, 'O' },
+			{ "admission-rate", 1, 0, 'a' },
 			{ 0, 0, 0, 0 }
 		};
 
-		c = getopt_long(argc, argv, "hVd:L", long_options, &option_index);
+		c = getopt_long(argc, argv, "hVd:Ls:c:u:O:a:", long_options, &option_index);
 		if (c == -1)
 			break;
 
@@ -71,6 +118,27 @@ static void handle_options(int argc, char **argv)
 		case 'L':
 			log_set_use_color(osmo_stderr_target, 0);
 			break;
+		case 's':
+			g_state_dir = optarg;
+			break;
+		case 'c':
+			g_capture_file = optarg;
+			break;
+		case 'u':
+			g_unix_socket = optarg;
+			break;
+		case 'O':
+			if (rspro_sock_tune_set_profile(optarg) < 0) {
+				fprintf(stderr, "Unknown socket profile '%s'\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'a':
+			if (parse_admission(optarg) < 0) {
+				fprintf(stderr, "Invalid admission rate '%s'\n", optarg);
+				exit(2);
+			}
+			break;
 		default:
 			/* ignore */
 			break;
@@ -110,9 +178,28 @@ int main(int argc, char **argv)
 	g_rps = rspro_server_create(g_tall_ctx, "0.0.0.0", 9998);
 	if (!g_rps)
 		exit(1);
+	if (g_admission_set)
+		rspro_server_set_admission(g_rps, g_admission_rate, g_admission_burst);
+	if (g_unix_socket) {
+		if (rspro_server_open_unix(g_rps, g_unix_socket) < 0)
+			goto out_rspro;
+	}
+	if (g_capture_file) {
+		g_rps->capture = rspro_capture_open(g_rps, g_capture_file);
+		if (!g_rps->capture)
+			goto out_rspro;
+	}
 	g_rps->slotmaps = slotmap_init(g_rps);
 	if (!g_rps->slotmaps)
 		goto out_rspro;
+	if (g_state_dir) {
+		/* load persisted maps before installing change_cb, so they're not re-journalled */
+		g_rps->store = slotmap_store_open(g_rps, g_state_dir, g_rps->slotmaps);
+		if (!g_rps->store)
+			goto out_rps;
+	}
+	g_rps->slotmaps->change_cb = rspro_server_slotmap_change_cb;
+	g_rps->slotmaps->change_cb_data = g_rps;
 
 	g_rps->comp_id.type = ComponentType_remsimServer;
 	OSMO_STRLCPY_ARRAY(g_rps->comp_id.name, hostname);
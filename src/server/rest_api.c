@@ -1,6 +1,10 @@
 #include <string.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
 #include <pthread.h>
 
 #include <jansson.h>
@@ -13,64 +17,69 @@
 #define PREFIX	"/api/backend/v1"
 
 #include "debug.h"
+#include "event_ring.h"
+#include "json_writer.h"
 #include "rest_api.h"
 #include "slotmap.h"
 #include "rspro_server.h"
 
-static json_t *comp_id2json(const struct app_comp_id *comp_id)
-{
-	json_t *ret = json_object();
-
-	static const char *type_names[] = {
-		[ComponentType_remsimClient] = "remsimClient",
-		[ComponentType_remsimServer] = "remsimServer",
-		[ComponentType_remsimBankd] = "remsimBankd"
-	};
+static const char *comp_type_names[] = {
+	[ComponentType_remsimClient] = "remsimClient",
+	[ComponentType_remsimServer] = "remsimServer",
+	[ComponentType_remsimBankd] = "remsimBankd"
+};
 
-	json_object_set_new(ret, "type_", json_string(type_names[comp_id->type]));
-	json_object_set_new(ret, "name", json_string(comp_id->name));
-	json_object_set_new(ret, "software", json_string(comp_id->software));
-	json_object_set_new(ret, "swVersion", json_string(comp_id->sw_version));
+static void comp_id2json(struct json_writer *jw, const char *key, const struct app_comp_id *comp_id)
+{
+	jw_obj_open(jw, key);
+	jw_str(jw, "type_", comp_type_names[comp_id->type]);
+	jw_str(jw, "name", comp_id->name);
+	jw_str(jw, "software", comp_id->software);
+	jw_str(jw, "swVersion", comp_id->sw_version);
 	if (strlen(comp_id->hw_manufacturer))
-		json_object_set_new(ret, "hwManufacturer", json_string(comp_id->hw_manufacturer));
+		jw_str(jw, "hwManufacturer", comp_id->hw_manufacturer);
 	if (strlen(comp_id->hw_model))
-		json_object_set_new(ret, "hwModel", json_string(comp_id->hw_model));
+		jw_str(jw, "hwModel", comp_id->hw_model);
 	if (strlen(comp_id->hw_serial_nr))
-		json_object_set_new(ret, "hwSerialNr", json_string(comp_id->hw_serial_nr));
+		jw_str(jw, "hwSerialNr", comp_id->hw_serial_nr);
 	if (strlen(comp_id->hw_version))
-		json_object_set_new(ret, "hwVersion", json_string(comp_id->hw_version));
+		jw_str(jw, "hwVersion", comp_id->hw_version);
 	if (strlen(comp_id->fw_version))
-		json_object_set_new(ret, "fwVersion", json_string(comp_id->fw_version));
-
-	return ret;
+		jw_str(jw, "fwVersion", comp_id->fw_version);
+	jw_obj_close(jw);
 }
 
-static json_t *client2json(const struct rspro_client_conn *conn)
+/* emit the members common to clients and banks into an already opened object */
+static void conn2json_members(struct json_writer *jw, const struct rspro_client_conn *conn)
 {
-	json_t *ret = json_object();
-
-	json_object_set_new(ret, "peer", json_string(conn->fi->id));
-	json_object_set_new(ret, "state", json_string(osmo_fsm_inst_state_name(conn->fi)));
+	jw_str(jw, "peer", conn->fi->id);
+	jw_str(jw, "state", osmo_fsm_inst_state_name(conn->fi));
 	/* FIXME: only in the right state */
-	json_object_set_new(ret, "component_id", comp_id2json(&conn->comp_id));
+	comp_id2json(jw, "component_id", &conn->comp_id);
+}
 
-	return ret;
+static void client2json(struct json_writer *jw, const struct rspro_client_conn *conn)
+{
+	jw_obj_open(jw, NULL);
+	conn2json_members(jw, conn);
+	jw_obj_close(jw);
 }
 
-static json_t *bank2json(const struct rspro_client_conn *conn)
+static void bank2json(struct json_writer *jw, const struct rspro_client_conn *conn)
 {
-	json_t *ret = client2json(conn);
-	json_object_set_new(ret, "bankId", json_integer(conn->bank.bank_id));
-	json_object_set_new(ret, "numberOfSlots", json_integer(conn->bank.num_slots));
-	return ret;
+	jw_obj_open(jw, NULL);
+	conn2json_members(jw, conn);
+	jw_uint(jw, "bankId", conn->bank.bank_id);
+	jw_uint(jw, "numberOfSlots", conn->bank.num_slots);
+	jw_obj_close(jw);
 }
 
-static json_t *bank_slot2json(const struct bank_slot *bslot)
+static void bank_slot2json(struct json_writer *jw, const char *key, const struct bank_slot *bslot)
 {
-	json_t *ret = json_object();
-	json_object_set_new(ret, "bankId", json_integer(bslot->bank_id));
-	json_object_set_new(ret, "slotNr", json_integer(bslot->slot_nr));
-	return ret;
+	jw_obj_open(jw, key);
+	jw_uint(jw, "bankId", bslot->bank_id);
+	jw_uint(jw, "slotNr", bslot->slot_nr);
+	jw_obj_close(jw);
 }
 static int json2bank_slot(struct bank_slot *bslot, json_t *in)
 {
@@ -91,12 +100,12 @@ static int json2bank_slot(struct bank_slot *bslot, json_t *in)
 	return 0;
 }
 
-static json_t *client_slot2json(const struct client_slot *bslot)
+static void client_slot2json(struct json_writer *jw, const char *key, const struct client_slot *cslot)
 {
-	json_t *ret = json_object();
-	json_object_set_new(ret, "clientId", json_integer(bslot->client_id));
-	json_object_set_new(ret, "slotNr", json_integer(bslot->slot_nr));
-	return ret;
+	jw_obj_open(jw, key);
+	jw_uint(jw, "clientId", cslot->client_id);
+	jw_uint(jw, "slotNr", cslot->slot_nr);
+	jw_obj_close(jw);
 }
 static int json2client_slot(struct client_slot *cslot, json_t *in)
 {
@@ -117,14 +126,42 @@ static int json2client_slot(struct client_slot *cslot, json_t *in)
 	return 0;
 }
 
-static json_t *slotmap2json(const struct slot_mapping *slotmap)
+static void slotmap2json(struct json_writer *jw, const struct slot_mapping *slotmap)
+{
+	jw_obj_open(jw, NULL);
+	jw_uint(jw, "id", slotmap_get_id(slotmap));
+	bank_slot2json(jw, "bank", &slotmap->bank);
+	client_slot2json(jw, "client", &slotmap->client);
+	jw_str(jw, "state", slotmap_state_name(slotmap->state));
+	jw_obj_close(jw);
+}
+static void event2json(struct json_writer *jw, const struct remsim_event *ev)
 {
-	json_t *ret = json_object();
-	json_object_set_new(ret, "bank", bank_slot2json(&slotmap->bank));
-	json_object_set_new(ret, "client", client_slot2json(&slotmap->client));
-	json_object_set_new(ret, "state", json_string(slotmap_state_name(slotmap->state)));
-	return ret;
+	jw_obj_open(jw, NULL);
+	jw_uint(jw, "seq", ev->seq);
+	jw_str(jw, "type", get_value_string(remsim_event_type_names, ev->type));
+	switch (ev->type) {
+	case RS_EV_SLOTMAP_ADDED:
+	case RS_EV_SLOTMAP_STATE:
+	case RS_EV_SLOTMAP_DELETED:
+		jw_uint(jw, "id", ev->u.slotmap.id);
+		bank_slot2json(jw, "bank", &ev->u.slotmap.bank);
+		client_slot2json(jw, "client", &ev->u.slotmap.client);
+		jw_str(jw, "oldState", slotmap_state_name(ev->u.slotmap.old_state));
+		jw_str(jw, "state", slotmap_state_name(ev->u.slotmap.new_state));
+		break;
+	case RS_EV_CONN_STATE:
+	case RS_EV_CONN_CLOSED:
+		jw_str(jw, "peer", ev->u.conn.peer);
+		jw_str(jw, "state", ev->u.conn.state);
+		/* component identity is only known once the peer has identified itself */
+		if (ev->u.conn.peer[0] && ev->u.conn.comp_type < ARRAY_SIZE(comp_type_names))
+			jw_str(jw, "componentType", comp_type_names[ev->u.conn.comp_type]);
+		break;
+	}
+	jw_obj_close(jw);
 }
+
 static int json2slotmap(struct slot_mapping *out, json_t *in)
 {
 	json_t *jbank, *jclient;
@@ -148,6 +185,19 @@ static int json2slotmap(struct slot_mapping *out, json_t *in)
 
 extern struct rspro_server *g_rps;
 
+/* hand the rendered JSON over to ulfius (which copies it) and release the writer */
+static void jw_set_body_response(struct _u_response *resp, unsigned int status, struct json_writer *jw)
+{
+	if (jw->error) {
+		LOGP(DREST, LOGL_ERROR, "REST: Error rendering JSON response\n");
+		ulfius_set_empty_body_response(resp, 500);
+	} else {
+		u_map_put(resp->map_header, "Content-Type", "application/json");
+		ulfius_set_binary_body_response(resp, status, jw->buf, jw->len);
+	}
+	jw_free(jw);
+}
+
 static int api_cb_rest_ctr_get(const struct _u_request *req, struct _u_response *resp, void *user_data)
 {
 	return U_CALLBACK_CONTINUE;
@@ -156,18 +206,20 @@ static int api_cb_rest_ctr_get(const struct _u_request *req, struct _u_response
 static int api_cb_banks_get(const struct _u_request *req, struct _u_response *resp, void *user_data)
 {
 	struct rspro_client_conn *conn;
-	json_t *json_body = json_object();
-	json_t *json_banks = json_array();
+	struct json_writer jw;
 
+	jw_init(&jw, 1024);
+	jw_obj_open(&jw, NULL);
+	jw_arr_open(&jw, "banks");
 	pthread_rwlock_rdlock(&g_rps->rwlock);
 	llist_for_each_entry(conn, &g_rps->banks, list) {
-		json_array_append_new(json_banks, bank2json(conn));
+		bank2json(&jw, conn);
 	}
 	pthread_rwlock_unlock(&g_rps->rwlock);
+	jw_arr_close(&jw);
+	jw_obj_close(&jw);
 
-	json_object_set_new(json_body, "banks", json_banks);
-	ulfius_set_json_body_response(resp, 200, json_body);
-	json_decref(json_body);
+	jw_set_body_response(resp, 200, &jw);
 
 	return U_CALLBACK_COMPLETE;
 }
@@ -176,7 +228,8 @@ static int api_cb_bank_get(const struct _u_request *req, struct _u_response *res
 {
 	const char *bank_id_str = u_map_get(req->map_url, "bank_id");
 	struct rspro_client_conn *conn;
-	json_t *json_body = NULL;
+	struct json_writer jw;
+	bool found = false;
 	unsigned long bank_id;
 	int status;
 
@@ -191,20 +244,22 @@ static int api_cb_bank_get(const struct _u_request *req, struct _u_response *res
 		goto out_err;
 	}
 
+	jw_init(&jw, 512);
 	pthread_rwlock_rdlock(&g_rps->rwlock);
 	llist_for_each_entry(conn, &g_rps->banks, list) {
 		if (conn->bank.bank_id == bank_id) {
-			json_body = bank2json(conn);
+			bank2json(&jw, conn);
+			found = true;
 			break;
 		}
 	}
 	pthread_rwlock_unlock(&g_rps->rwlock);
 
-	if (json_body) {
-		ulfius_set_json_body_response(resp, 200, json_body);
-		json_decref(json_body);
+	if (found) {
+		jw_set_body_response(resp, 200, &jw);
 	} else {
-		ulfius_set_json_body_response(resp, 404, json_body);
+		jw_free(&jw);
+		ulfius_set_empty_body_response(resp, 404);
 	}
 
 	return U_CALLBACK_COMPLETE;
@@ -218,18 +273,20 @@ out_err:
 static int api_cb_clients_get(const struct _u_request *req, struct _u_response *resp, void *user_data)
 {
 	struct rspro_client_conn *conn;
-	json_t *json_body = json_object();
-	json_t *json_clients = json_array();
+	struct json_writer jw;
 
+	jw_init(&jw, 1024);
+	jw_obj_open(&jw, NULL);
+	jw_arr_open(&jw, "clients");
 	pthread_rwlock_rdlock(&g_rps->rwlock);
 	llist_for_each_entry(conn, &g_rps->clients, list) {
-		json_array_append_new(json_clients, client2json(conn));
+		client2json(&jw, conn);
 	}
 	pthread_rwlock_unlock(&g_rps->rwlock);
+	jw_arr_close(&jw);
+	jw_obj_close(&jw);
 
-	json_object_set_new(json_body, "clients", json_clients);
-	ulfius_set_json_body_response(resp, 200, json_body);
-	json_decref(json_body);
+	jw_set_body_response(resp, 200, &jw);
 
 	return U_CALLBACK_COMPLETE;
 }
@@ -238,7 +295,8 @@ static int api_cb_client_get(const struct _u_request *req, struct _u_response *r
 {
 	const char *client_id_str = u_map_get(req->map_url, "client_id");
 	struct rspro_client_conn *conn;
-	json_t *json_body = NULL;
+	struct json_writer jw;
+	bool found = false;
 	unsigned long client_id;
 	int status;
 
@@ -253,20 +311,22 @@ static int api_cb_client_get(const struct _u_request *req, struct _u_response *r
 		goto out_err;
 	}
 
+	jw_init(&jw, 512);
 	pthread_rwlock_rdlock(&g_rps->rwlock);
 	llist_for_each_entry(conn, &g_rps->clients, list) {
 		if (conn->bank.bank_id == client_id) { /* FIXME */
-			json_body = client2json(conn);
+			client2json(&jw, conn);
+			found = true;
 			break;
 		}
 	}
 	pthread_rwlock_unlock(&g_rps->rwlock);
 
-	if (json_body) {
-		ulfius_set_json_body_response(resp, 200, json_body);
-		json_decref(json_body);
+	if (found) {
+		jw_set_body_response(resp, 200, &jw);
 	} else {
-		ulfius_set_json_body_response(resp, 404, json_body);
+		jw_free(&jw);
+		ulfius_set_empty_body_response(resp, 404);
 	}
 
 	return U_CALLBACK_COMPLETE;
@@ -276,22 +336,364 @@ out_err:
 	return U_CALLBACK_COMPLETE;
 }
 
+/* parse an optional unsigned integer query parameter. Returns 1 if present, 0 if absent */
+static int get_query_ulong(const struct _u_request *req, const char *name, unsigned long long *out)
+{
+	const char *str = u_map_get(req->map_url, name);
+	char *end;
+
+	if (!str)
+		return 0;
+
+	errno = 0;
+	*out = strtoull(str, &end, 10);
+	if (errno != 0 || end == str || *end != '\0')
+		return -EINVAL;
+
+	return 1;
+}
+
+/* does an If-None-Match header value match our (strong) ETag?  The value is either '*' or a
+ * list of entity-tags, separated by commas; weak entity-tags (W/"...") match as well, as
+ * If-None-Match uses the weak comparison (RFC 9110, 13.1.2) */
+static bool etag_matches(const char *inm, const char *etag)
+{
+	size_t etag_len = strlen(etag);
+	const char *end;
+
+	while (*inm) {
+		while (*inm == ' ' || *inm == '\t' || *inm == ',')
+			inm++;
+		if (*inm == '*')
+			return true;
+		if (!strncmp(inm, "W/", 2))
+			inm += 2;
+		if (*inm != '"')
+			return false;
+		end = strchr(inm + 1, '"');
+		if (!end)
+			return false;
+		end++;
+		if ((size_t) (end - inm) == etag_len && !memcmp(inm, etag, etag_len))
+			return true;
+		inm = end;
+	}
+	return false;
+}
+
+/* GET /slotmaps with optional query parameters:
+ *  bankId, clientId, state	only return maps matching the given filter(s)
+ *  offset, limit		pagination of the (filtered) result
+ *  since			only return maps modified (and ids deleted) after given generation
+ * Deleted maps are filtered by bankId/clientId as well, but not by state.
+ * The current generation is returned as ETag; If-None-Match avoids re-transmitting an
+ * unchanged result. */
 static int api_cb_slotmaps_get(const struct _u_request *req, struct _u_response *resp, void *user_data)
 {
+	struct slotmaps *maps = g_rps->slotmaps;
+	unsigned long long bank_id = 0, client_id = 0, offset = 0, limit = ULLONG_MAX, since = 0;
+	int have_bank, have_client, have_since, state = -1;
+	const char *state_str = u_map_get(req->map_url, "state");
+	const char *inm = u_map_get_case(req->map_header, "If-None-Match");
+	unsigned long long matched = 0, emitted = 0;
 	struct slot_mapping *map;
-	json_t *json_body = json_object();
-	json_t *json_maps = json_array();
+	struct json_writer jw;
+	char etag[160];
+	uint64_t gen;
+	unsigned int i;
+
+	have_bank = get_query_ulong(req, "bankId", &bank_id);
+	have_client = get_query_ulong(req, "clientId", &client_id);
+	have_since = get_query_ulong(req, "since", &since);
+	if (have_bank < 0 || have_client < 0 || have_since < 0 ||
+	    get_query_ulong(req, "offset", &offset) < 0 || get_query_ulong(req, "limit", &limit) < 0)
+		goto err;
+	if (state_str) {
+		state = get_string_value(slot_map_state_name, state_str);
+		if (state < 0)
+			goto err;
+	}
 
-	slotmaps_rdlock(g_rps->slotmaps);
-	llist_for_each_entry(map, &g_rps->slotmaps->mappings, list) {
-		json_array_append_new(json_maps, slotmap2json(map));
+	slotmaps_rdlock(maps);
+	gen = maps->generation;
+	/* each query has a representation of its own: the ETag covers the (normalized) query
+	 * along with the generation */
+	snprintf(etag, sizeof(etag), "\"%llu;b=%lld;c=%lld;s=%d;t=%lld;o=%llu;l=%llu\"",
+		 (unsigned long long) gen, have_bank ? (long long) bank_id : -1LL,
+		 have_client ? (long long) client_id : -1LL, state,
+		 have_since ? (long long) since : -1LL, offset, limit);
+
+	if (inm && etag_matches(inm, etag)) {
+		slotmaps_unlock(maps);
+		u_map_put(resp->map_header, "ETag", etag);
+		ulfius_set_empty_body_response(resp, 304);
+		return U_CALLBACK_COMPLETE;
 	}
-	slotmaps_unlock(g_rps->slotmaps);
 
-	json_object_set_new(json_body, "slotmaps", json_maps);
-	ulfius_set_json_body_response(resp, 200, json_body);
-	json_decref(json_body);
+	if (have_since && since < maps->tombstones.floor) {
+		/* deletion history no longer reaches back that far: caller must re-sync */
+		slotmaps_unlock(maps);
+		ulfius_set_empty_body_response(resp, 410);
+		return U_CALLBACK_COMPLETE;
+	}
+
+	jw_init(&jw, 4096);
+	jw_obj_open(&jw, NULL);
+	jw_arr_open(&jw, "slotmaps");
+	llist_for_each_entry(map, &maps->mappings, list) {
+		if (have_since && map->generation <= since)
+			continue;
+		if (have_bank && map->bank.bank_id != bank_id)
+			continue;
+		if (have_client && map->client.client_id != client_id)
+			continue;
+		if (state >= 0 && map->state != state)
+			continue;
+		if (matched++ < offset)
+			continue;
+		if (emitted >= limit)
+			continue;
+		slotmap2json(&jw, map);
+		emitted++;
+	}
+	jw_arr_close(&jw);
+
+	if (have_since) {
+		jw_arr_open(&jw, "deleted");
+		/* walk the ring from oldest to newest entry */
+		for (i = 0; i < ARRAY_SIZE(maps->tombstones.ring); i++) {
+			unsigned int idx = (maps->tombstones.next + i) % ARRAY_SIZE(maps->tombstones.ring);
+			const struct slotmap_tombstone *ts = &maps->tombstones.ring[idx];
+			if (ts->generation <= since)
+				continue;
+			if (have_bank && ts->bank_id != bank_id)
+				continue;
+			if (have_client && ts->client_id != client_id)
+				continue;
+			jw_uint(&jw, NULL, ts->id);
+		}
+		jw_arr_close(&jw);
+	}
+	slotmaps_unlock(maps);
+
+	jw_uint(&jw, "generation", gen);
+	jw_uint(&jw, "total", matched);
+	jw_obj_close(&jw);
+	u_map_put(resp->map_header, "ETag", etag);
+	jw_set_body_response(resp, 200, &jw);
+
+	return U_CALLBACK_COMPLETE;
+err:
+	ulfius_set_empty_body_response(resp, 400);
+	return U_CALLBACK_COMPLETE;
+}
+
+/* maximum number of events rendered in one go */
+#define EVENTS_MAX_BATCH	256
+/* interval of SSE keep-alive comments while there are no events */
+#define EVENTS_SSE_KEEPALIVE_MS	15000
+/* maximum 'timeout' of a long-poll */
+#define EVENTS_MAX_TIMEOUT_S	60
+/* maximum number of concurrent long-polls and SSE streams; each of them occupies one of
+ * the threads of the HTTP server while waiting */
+#define EVENTS_MAX_WAITERS	32
+
+/* number of long-polls and SSE streams currently waiting for events */
+static atomic_uint g_events_waiters;
+
+/* reserve one of the EVENTS_MAX_WAITERS; false if all of them are in use */
+static bool events_waiter_get(void)
+{
+	unsigned int n = atomic_load(&g_events_waiters);
+
+	do {
+		if (n >= EVENTS_MAX_WAITERS)
+			return false;
+	} while (!atomic_compare_exchange_weak(&g_events_waiters, &n, n + 1));
+	return true;
+}
+
+static void events_waiter_put(void)
+{
+	atomic_fetch_sub(&g_events_waiters, 1);
+}
+
+/* render events following 'cursor' into jw, either as JSON array members or as SSE
+ * messages.  Returns the new cursor; events lost due to ring overrun are added to *lost */
+static uint64_t events_collect(struct json_writer *jw, uint64_t cursor, bool sse, uint64_t *lost)
+{
+	struct event_ring *r = g_rps->events;
+	uint64_t head = event_ring_head(r);
+	struct remsim_event ev;
+	unsigned int num = 0;
+	char sse_hdr[32];
+	int rc;
+
+	/* anything older than the ring size has been overwritten */
+	if (head > EVENT_RING_SIZE && cursor < head - EVENT_RING_SIZE) {
+		*lost += head - EVENT_RING_SIZE - cursor;
+		cursor = head - EVENT_RING_SIZE;
+	}
+
+	while (cursor < head && num < EVENTS_MAX_BATCH) {
+		rc = event_ring_read(r, cursor + 1, &ev);
+		if (rc == -EAGAIN) {
+			/* producer has claimed the slot but not yet finished writing it */
+			sched_yield();
+			continue;
+		}
+		cursor++;
+		if (rc < 0) {
+			(*lost)++;
+			continue;
+		}
+		if (sse) {
+			rc = snprintf(sse_hdr, sizeof(sse_hdr), "id: %llu\ndata: ", (unsigned long long) ev.seq);
+			jw_raw(jw, sse_hdr, rc);
+			event2json(jw, &ev);
+			jw_raw(jw, "\n\n", 2);
+		} else
+			event2json(jw, &ev);
+		num++;
+	}
+
+	return cursor;
+}
+
+/* state of one Server-Sent-Events stream */
+struct events_stream {
+	uint64_t cursor;
+	struct json_writer jw;
+	size_t offset;
+};
+
+static ssize_t events_stream_cb(void *cls, uint64_t pos, char *out, size_t max)
+{
+	struct events_stream *es = cls;
+	struct event_ring *r = g_rps->events;
+	uint64_t lost = 0;
+	char tmp[64];
+	size_t len;
+
+	while (es->offset >= es->jw.len) {
+		jw_reset(&es->jw);
+		es->offset = 0;
+		if (atomic_load(&r->shutdown))
+			return U_STREAM_END;
+		if (!event_ring_wait(r, es->cursor, EVENTS_SSE_KEEPALIVE_MS)) {
+			/* comment line; also makes us notice consumers which went away */
+			jw_raw(&es->jw, ": keep-alive\n\n", 14);
+			continue;
+		}
+		es->cursor = events_collect(&es->jw, es->cursor, true, &lost);
+		if (lost) {
+			len = snprintf(tmp, sizeof(tmp), "event: lost\ndata: {\"lost\":%llu}\n\n",
+				       (unsigned long long) lost);
+			jw_raw(&es->jw, tmp, len);
+			lost = 0;
+		}
+		if (es->jw.error)
+			return U_STREAM_ERROR;
+	}
 
+	len = OSMO_MIN(max, es->jw.len - es->offset);
+	memcpy(out, es->jw.buf + es->offset, len);
+	es->offset += len;
+
+	return len;
+}
+
+static void events_stream_free(void *cls)
+{
+	struct events_stream *es = cls;
+	jw_free(&es->jw);
+	free(es);
+	events_waiter_put();
+}
+
+/* GET /events: stream of slotmap and connection state changes.  Delivered as
+ * Server-Sent-Events if requested via 'Accept: text/event-stream', otherwise as
+ * long-poll returning all events after sequence number 'since' as soon as there are any.
+ * Beyond EVENTS_MAX_WAITERS concurrent consumers, we respond with 503. */
+static int api_cb_events_get(const struct _u_request *req, struct _u_response *resp, void *user_data)
+{
+	const char *accept = u_map_get_case(req->map_header, "Accept");
+	const char *last_id = u_map_get_case(req->map_header, "Last-Event-ID");
+	struct event_ring *r = g_rps->events;
+	unsigned long long since, timeout = 30;
+	uint64_t head = event_ring_head(r), cursor, lost = 0;
+	struct events_stream *es;
+	struct json_writer jw;
+	char *end;
+	int rc;
+
+	rc = get_query_ulong(req, "since", &since);
+	if (rc < 0)
+		goto err;
+	if (rc == 0 && last_id) {
+		/* the id of an event we sent: neither garbage nor from the future */
+		errno = 0;
+		since = strtoull(last_id, &end, 10);
+		if (errno != 0 || end == last_id || *end != '\0' || since > head)
+			goto err;
+		rc = 1;
+	}
+	/* without 'since', report only events happening from now on.  A 'since' from the
+	 * future means the server was restarted: report everything we have */
+	if (rc == 0)
+		cursor = head;
+	else if (since > head)
+		cursor = 0;
+	else
+		cursor = since;
+
+	if (accept && strstr(accept, "text/event-stream")) {
+		if (!events_waiter_get())
+			goto err_busy;
+		es = calloc(1, sizeof(*es));
+		if (!es) {
+			events_waiter_put();
+			ulfius_set_empty_body_response(resp, 500);
+			return U_CALLBACK_COMPLETE;
+		}
+		es->cursor = cursor;
+		jw_init(&es->jw, 4096);
+		u_map_put(resp->map_header, "Content-Type", "text/event-stream");
+		u_map_put(resp->map_header, "Cache-Control", "no-cache");
+		if (ulfius_set_stream_response(resp, 200, events_stream_cb, events_stream_free,
+						U_STREAM_SIZE_UNKNOWN, 4096, es) != U_OK) {
+			events_stream_free(es);
+			ulfius_set_empty_body_response(resp, 500);
+		}
+		return U_CALLBACK_COMPLETE;
+	}
+
+	if (get_query_ulong(req, "timeout", &timeout) < 0 || timeout > EVENTS_MAX_TIMEOUT_S)
+		goto err;
+
+	if (!events_waiter_get())
+		goto err_busy;
+	event_ring_wait(r, cursor, timeout * 1000);
+	events_waiter_put();
+
+	jw_init(&jw, 4096);
+	jw_obj_open(&jw, NULL);
+	jw_arr_open(&jw, "events");
+	cursor = events_collect(&jw, cursor, false, &lost);
+	jw_arr_close(&jw);
+	jw_uint(&jw, "next", cursor);
+	jw_uint(&jw, "lost", lost);
+	jw_obj_close(&jw);
+	u_map_put(resp->map_header, "Cache-Control", "no-cache");
+	jw_set_body_response(resp, 200, &jw);
+
+	return U_CALLBACK_COMPLETE;
+err:
+	ulfius_set_empty_body_response(resp, 400);
+	return U_CALLBACK_COMPLETE;
+err_busy:
+	u_map_put(resp->map_header, "Retry-After", "1");
+	ulfius_set_empty_body_response(resp, 503);
 	return U_CALLBACK_COMPLETE;
 }
 
@@ -365,6 +767,8 @@ static void _slotmap_mark_deleted(struct slot_mapping *map)
 	llist_del(&map->list);
 	/* safely initialize list head to avoid trouble when del_slotmap() does another llist_del() */
 	INIT_LLIST_HEAD(&map->list);
+	/* as far as REST clients are concerned, the map is gone from now on */
+	_slotmap_tombstone(map->maps, map);
 
 	switch (map->state) {
 	case SLMAP_S_NEW:
@@ -466,6 +870,8 @@ static const struct _u_endpoint api_endpoints[] = {
 	{ "POST",  PREFIX, "/slotmaps", 0, &api_cb_slotmaps_post, NULL },
 	{ "DELETE",  PREFIX, "/slotmaps/:slotmap_id", 0, &api_cb_slotmaps_del, NULL },
 	{ "POST",  PREFIX, "/global-reset", 0, &api_cb_global_reset_post, NULL },
+	/* stream of state change events */
+	{ "GET",  PREFIX, "/events", 0, &api_cb_events_get, NULL },
 };
 
 static struct _u_instance g_instance;
@@ -520,6 +926,8 @@ int rest_api_init(void *ctx, uint16_t port)
 
 void rest_api_fini(void)
 {
+	/* make any blocked event consumers return */
+	event_ring_shutdown(g_rps->events);
 	ulfius_stop_framework(&g_instance);
 	ulfius_clean_instance(&g_instance);
 }
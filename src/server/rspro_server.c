@@ -1,6 +1,9 @@
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/socket.h>
 #include <pthread.h>
 #include <errno.h>
 
@@ -9,6 +12,7 @@
 #include <osmocom/core/fsm.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/socket.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/gsm/protocol/ipaccess.h>
 #include <osmocom/netif/ipa.h>
 
@@ -16,6 +20,9 @@
 
 #include "debug.h"
 #include "rspro_util.h"
+#include "rspro_capture.h"
+#include "rspro_sock_tune.h"
+#include "rspro_keepalive.h"
 #include "rspro_server.h"
 
 #define S(x)	(1 << (x))
@@ -59,6 +66,10 @@ static void client_conn_send(struct rspro_client_conn *conn, RsproPDU_t *pdu)
 		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
 		return;
 	}
+	if (conn->srv->capture)
+		rspro_capture_frame(conn->srv->capture, conn->cap_conn_id, RSPRO_CAP_EV_TX,
+				    IPAC_PROTO_OSMO, IPAC_PROTO_EXT_RSPRO,
+				    msgb_data(msg_tx), msgb_length(msg_tx));
 	ipa_prepend_header_ext(msg_tx, IPAC_PROTO_EXT_RSPRO);
 	ipa_prepend_header(msg_tx, IPAC_PROTO_OSMO);
 	osmo_stream_srv_send(conn->peer, msg_tx);
@@ -118,6 +129,20 @@ static void clnt_st_init(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 	}
 }
 
+/* remote IP and port of a connection, for log messages */
+static void client_conn_peer(struct rspro_client_conn *conn, char *ip_str, size_t ip_len,
+			     char *port_str, size_t port_len)
+{
+	if (conn->local) {
+		/* peers on our UNIX domain socket have no address of interest */
+		osmo_strlcpy(ip_str, "local", ip_len);
+		osmo_strlcpy(port_str, "-", port_len);
+		return;
+	}
+	osmo_sock_get_ip_and_port(osmo_stream_srv_get_fd(conn->peer), ip_str, ip_len,
+				  port_str, port_len, false);
+}
+
 static void clnt_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
 	struct rspro_client_conn *conn = fi->priv;
@@ -128,11 +153,8 @@ static void clnt_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *
 	RsproPDU_t *resp = NULL;
 	char ip_str[INET6_ADDRSTRLEN];
 	char port_str[6];
-	int fd = osmo_stream_srv_get_fd(conn->peer);
 
-	/* remote IP and port */
-	osmo_sock_get_ip_and_port(fd, ip_str, sizeof(ip_str),
-				  port_str, sizeof(port_str), false);
+	client_conn_peer(conn, ip_str, sizeof(ip_str), port_str, sizeof(port_str));
 
 	switch (event) {
 	case CLNTC_E_CLIENT_CONN:
@@ -163,7 +185,6 @@ static void clnt_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *
 			rspro2client_slot(&conn->client.slot, cclreq->clientSlot);
 			osmo_fsm_inst_update_id_f(fi, "C%u:%u", conn->client.slot.client_id,
 						  conn->client.slot.slot_nr);
-			osmo_ipa_ka_fsm_set_id(conn->ka_fi, fi->id);
 			LOGPFSML(fi, LOGL_INFO, "Client connected from %s:%s\n", ip_str, port_str);
 
 			/* check for unique-ness */
@@ -176,9 +197,8 @@ static void clnt_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *
 				 * some kind of DoS. */
 				char prev_ip_str[INET6_ADDRSTRLEN];
 				char prev_port_str[6];
-				int prev_fd = osmo_stream_srv_get_fd(previous_conn->peer);
-				osmo_sock_get_ip_and_port(prev_fd, prev_ip_str, sizeof(prev_ip_str),
-							  prev_port_str, sizeof(prev_port_str), false);
+				client_conn_peer(previous_conn, prev_ip_str, sizeof(prev_ip_str),
+						 prev_port_str, sizeof(prev_port_str));
 				LOGPFSML(fi, LOGL_ERROR, "New client connection from %s:%s, but we already "
 					 "have a connection from %s:%s. Dropping new connection.\n",
 					 ip_str, port_str, prev_ip_str, prev_port_str);
@@ -210,11 +230,15 @@ static void clnt_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *
 		}
 		conn->bank.bank_id = cbreq->bankId;
 		conn->bank.num_slots = cbreq->numberOfSlots;
+		talloc_free(conn->bank.socket_path);
+		conn->bank.socket_path = rspro_get_bankd_socket_path(conn, pdu);
 		osmo_fsm_inst_update_id_f(fi, "B%u", conn->bank.bank_id);
-		osmo_ipa_ka_fsm_set_id(conn->ka_fi, fi->id);
 
 		LOGPFSML(fi, LOGL_INFO, "Bankd connected from %s:%s\n", ip_str, port_str);
-		if (!strncmp(ip_str, "127.", 4)) {
+		if (conn->bank.socket_path && conn->local) {
+			LOGPFSML(fi, LOGL_INFO, "Clients on this host will reach the bankd at %s\n",
+				 conn->bank.socket_path);
+		} else if (!strncmp(ip_str, "127.", 4)) {
 			LOGPFSML(fi, LOGL_NOTICE, "Bankd connected from %s (localhost). "
 				"This only works if your clients also all are on localhost, "
 				"as they must be able to reach the bankd!\n", ip_str);
@@ -225,9 +249,8 @@ static void clnt_st_established(struct osmo_fsm_inst *fi, uint32_t event, void *
 		if (previous_conn && previous_conn != conn) {
 			char prev_ip_str[INET6_ADDRSTRLEN];
 			char prev_port_str[6];
-			int prev_fd = osmo_stream_srv_get_fd(previous_conn->peer);
-			osmo_sock_get_ip_and_port(prev_fd, prev_ip_str, sizeof(prev_ip_str),
-							prev_port_str, sizeof(prev_port_str), false);
+			client_conn_peer(previous_conn, prev_ip_str, sizeof(prev_ip_str),
+					 prev_port_str, sizeof(prev_port_str));
 			/* we're dropping the current (new) connection as we don't really know which
 			 * is the "right" one. Dropping the new gives the old connection time to
 			 * timeout, or to continue to operate.  If we were to drop the old
@@ -286,6 +309,7 @@ static void _update_client_for_slotmap(struct slot_mapping *map, struct rspro_se
 	char port_str[6];
 	uint32_t bankd_ip;
 	int bankd_port;
+	const char *bankd_path = NULL;
 	bool changed = false;
 	int rc;
 
@@ -316,13 +340,25 @@ static void _update_client_for_slotmap(struct slot_mapping *map, struct rspro_se
 		bankd_ip = 0;
 		bankd_port = 0;
 	} else {
-		/* obtain IP and port of bankd */
-		rc = osmo_sock_get_ip_and_port(osmo_stream_srv_get_fd(bankd_conn->peer),
-					       ip_str, sizeof(ip_str),
-					       port_str, sizeof(port_str), false);
-		if (rc < 0) {
-			LOGPFSML(bankd_conn->fi, LOGL_ERROR, "Error during getpeername\n");
-			return;
+		if (bankd_conn->local) {
+			/* the bankd is on our host: a client which is as well may use the UNIX domain
+			 * socket of the bankd; all others reach it at the address they reach us */
+			if (conn->local)
+				bankd_path = bankd_conn->bank.socket_path;
+			rc = osmo_sock_get_ip_and_port(osmo_stream_srv_get_fd(conn->peer),
+						       ip_str, sizeof(ip_str),
+						       port_str, sizeof(port_str), true);
+			if (conn->local || rc < 0)
+				OSMO_STRLCPY_ARRAY(ip_str, "127.0.0.1");
+		} else {
+			/* obtain IP and port of bankd */
+			rc = osmo_sock_get_ip_and_port(osmo_stream_srv_get_fd(bankd_conn->peer),
+						       ip_str, sizeof(ip_str),
+						       port_str, sizeof(port_str), false);
+			if (rc < 0) {
+				LOGPFSML(bankd_conn->fi, LOGL_ERROR, "Error during getpeername\n");
+				return;
+			}
 		}
 		bankd_ip = ntohl(inet_addr(ip_str));
 		bankd_port = 9999; /* TODO: configurable */
@@ -336,12 +372,40 @@ static void _update_client_for_slotmap(struct slot_mapping *map, struct rspro_se
 		conn->client.bankd.port = bankd_port;
 		changed = true;
 	}
+	if (strcmp(conn->client.bankd.path ? : "", bankd_path ? : "")) {
+		LOGPFSML(conn->fi, LOGL_NOTICE, "Bankd socket changed to %s\n", bankd_path ? : "(none)");
+		osmo_talloc_replace_string(conn, &conn->client.bankd.path, bankd_path);
+		changed = true;
+	}
 
 	/* update the client with new bankd information, if any changes were made */
 	if (changed)
 		osmo_fsm_inst_dispatch(conn->fi, CLNTC_E_CL_CFG_BANKD, NULL);
 }
 
+/* publish connection state change to REST API event consumers */
+static void conn_publish_event(struct rspro_client_conn *conn, struct osmo_fsm_inst *fi,
+			       enum remsim_event_type type)
+{
+	struct remsim_event ev = {
+		.type = type,
+		.u.conn = {
+			.state = osmo_fsm_inst_state_name(fi),
+			.comp_type = conn->comp_id.type,
+		},
+	};
+
+	if (fi->id)
+		OSMO_STRLCPY_ARRAY(ev.u.conn.peer, fi->id);
+	event_ring_publish(conn->srv->events, &ev);
+}
+
+/* onenter of all states which don't have any other onenter processing */
+static void clnt_st_notify_onenter(struct osmo_fsm_inst *fi, uint32_t prev_state)
+{
+	conn_publish_event(fi->priv, fi, RS_EV_CONN_STATE);
+}
+
 static void clnt_st_connected_client_onenter(struct osmo_fsm_inst *fi, uint32_t prev_state)
 {
 	struct rspro_client_conn *conn = fi->priv;
@@ -349,6 +413,7 @@ static void clnt_st_connected_client_onenter(struct osmo_fsm_inst *fi, uint32_t
 	struct slot_mapping *map;
 
 	LOGPFSML(fi, LOGL_DEBUG, "%s\n", __func__);
+	conn_publish_event(conn, fi, RS_EV_CONN_STATE);
 
 	/* check for an existing slotmap for this client/slot */
 	slotmaps_rdlock(slotmaps);
@@ -376,6 +441,8 @@ static void clnt_st_connected_bankd_onenter(struct osmo_fsm_inst *fi, uint32_t p
 	struct slotmaps *slotmaps = conn->srv->slotmaps;
 	struct slot_mapping *map;
 
+	conn_publish_event(conn, fi, RS_EV_CONN_STATE);
+
 	LOGPFSML(fi, LOGL_DEBUG, "Associating pre-existing slotmaps (if any)\n");
 	/* Link all known mappings to this new bank */
 	slotmaps_wrlock(slotmaps);
@@ -397,6 +464,8 @@ static void clnt_st_connected_client(struct osmo_fsm_inst *fi, uint32_t event, v
 		bank_slot2rspro(&bslot, &conn->client.bankd.slot);
 		tx = rspro_gen_ConfigClientBankReq(&bslot, conn->client.bankd.ip,
 						   conn->client.bankd.port);
+		if (tx && conn->client.bankd.path)
+			rspro_set_bankd_socket_path(tx, conn->client.bankd.path);
 		client_conn_send(conn, tx);
 		break;
 	default:
@@ -505,6 +574,8 @@ static int server_client_fsm_timer_cb(struct osmo_fsm_inst *fi)
 static void server_client_cleanup(struct osmo_fsm_inst *fi, enum osmo_fsm_term_cause cause)
 {
 	struct rspro_client_conn *conn = fi->priv;
+
+	conn_publish_event(conn, fi, RS_EV_CONN_CLOSED);
 	/* this call will destroy the IPA connection, which will in turn call closed_cb()
 	 * which will try to deliver a E_TCP_DOWN event. Clear conn->fi to avoid that loop */
 	conn->fi = NULL;
@@ -524,12 +595,14 @@ static const struct osmo_fsm_state server_client_fsm_states[] = {
 		.out_state_mask = S(CLNTC_ST_CONNECTED_CLIENT) | S(CLNTC_ST_WAIT_CONF_RES) |
 				  S(CLNTC_ST_CONNECTED_BANKD) | S(CLNTC_ST_REJECTED),
 		.action = clnt_st_established,
+		.onenter = clnt_st_notify_onenter,
 	},
 	[CLNTC_ST_WAIT_CONF_RES] = {
 		.name = "WAIT_CONFIG_RES",
 		.in_event_mask = S(CLNTC_E_CONFIG_CL_RES),
 		.out_state_mask = S(CLNTC_ST_CONNECTED_CLIENT),
 		.action = clnt_st_wait_cl_conf_res,
+		.onenter = clnt_st_notify_onenter,
 	},
 	[CLNTC_ST_CONNECTED_CLIENT] = {
 		.name = "CONNECTED_CLIENT",
@@ -547,6 +620,7 @@ static const struct osmo_fsm_state server_client_fsm_states[] = {
 	[CLNTC_ST_REJECTED] = {
 		.name = "REJECTED",
 		/* no events permitted, no action required */
+		.onenter = clnt_st_notify_onenter,
 	}
 
 };
@@ -668,7 +742,6 @@ static int _ipa_srv_conn_ccm(struct rspro_client_conn *conn, struct msgb *msg)
 		return 0;
 	case IPAC_MSGT_PONG:
 		LOGPFSML(conn->fi, LOGL_DEBUG, "PONG!\n");
-		osmo_ipa_ka_fsm_pong_received(conn->ka_fi);
 		return 0;
 	case IPAC_MSGT_ID_ACK:
 		LOGPFSML(conn->fi, LOGL_DEBUG, "ID_ACK? -> ACK!\n");
@@ -708,6 +781,175 @@ err:
 	return -1;
 }
 
+/***********************************************************************
+ * admission control
+ *
+ * After a restart of the server (or a network outage), all clients reconnect at about the same
+ * time.  Each ConnectClientReq makes us look up and push slotmaps and configure the client,
+ * which the bankds then have to follow up on; too many of them at once let keep-alives and
+ * T1 time out everywhere, causing yet another round of reconnects.  Hence ConnectClientReqs
+ * pass through a token bucket: those exceeding it wait in FIFO order for up to
+ * ADMISSION_MAX_WAIT_MS, and clients which would have to wait longer are rejected with
+ * tryAgainLater and a retryAfterMs spreading them out over the time the backlog needs to drain.
+ * Bankds are few, and nothing works without them, so they are always admitted immediately.
+ ***********************************************************************/
+
+#define ADMISSION_DEFAULT_RATE		100
+#define ADMISSION_DEFAULT_BURST		200
+/* well below the T1 (10s) of both the client and our CLNTC_ST_ESTABLISHED */
+#define ADMISSION_MAX_WAIT_MS		5000
+
+static int64_t admission_now_ms(void)
+{
+	struct timespec ts;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void admission_refill(struct rspro_server *srv, int64_t now_ms)
+{
+	uint64_t max_milli = (uint64_t) srv->admission.burst * 1000;
+	int64_t elapsed_ms = now_ms - srv->admission.last_refill_ms;
+
+	srv->admission.last_refill_ms = now_ms;
+	if (elapsed_ms <= 0)
+		return;
+	/* 'rate' tokens per second are 'rate' milli-tokens per millisecond */
+	srv->admission.tokens_milli += (uint64_t) elapsed_ms * srv->admission.rate;
+	if (srv->admission.tokens_milli > max_milli)
+		srv->admission.tokens_milli = max_milli;
+}
+
+static bool admission_take(struct rspro_server *srv)
+{
+	if (srv->admission.tokens_milli < 1000)
+		return false;
+	srv->admission.tokens_milli -= 1000;
+	return true;
+}
+
+static void admission_arm(struct rspro_server *srv)
+{
+	unsigned int delay_ms;
+
+	if (!srv->admission.num_waiting || osmo_timer_pending(&srv->admission.timer))
+		return;
+	/* until the next token becomes available */
+	delay_ms = (1000 - OSMO_MIN(srv->admission.tokens_milli, 1000) + srv->admission.rate - 1) /
+		   srv->admission.rate;
+	osmo_timer_schedule(&srv->admission.timer, delay_ms / 1000, (delay_ms % 1000) * 1000);
+}
+
+static void admission_dequeue(struct rspro_client_conn *conn)
+{
+	if (llist_empty(&conn->admission.list))
+		return;
+	llist_del_init(&conn->admission.list);
+	conn->srv->admission.num_waiting--;
+}
+
+static int handle_rx_rspro(struct rspro_client_conn *conn, const RsproPDU_t *pdu);
+
+static void admission_timer_cb(void *data)
+{
+	struct rspro_server *srv = data;
+	struct rspro_client_conn *conn;
+	RsproPDU_t *pdu;
+
+	admission_refill(srv, admission_now_ms());
+	while ((conn = llist_first_entry_or_null(&srv->admission.waiting, struct rspro_client_conn,
+						 admission.list))) {
+		if (!admission_take(srv))
+			break;
+		admission_dequeue(conn);
+		conn->admission.admitted = true;
+		pdu = conn->admission.deferred_pdu;
+		conn->admission.deferred_pdu = NULL;
+		/* may destroy 'conn' */
+		handle_rx_rspro(conn, pdu);
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+	}
+	admission_arm(srv);
+}
+
+/* tell a client which would have to wait too long to come back later */
+static void admission_reject(struct rspro_client_conn *conn, int64_t now_ms)
+{
+	struct rspro_server *srv = conn->srv;
+	RsproPDU_t *resp;
+
+	/* give each rejected client a later slot than the previous one, starting from the time the
+	 * current backlog will have been admitted */
+	srv->admission.retry_end_ms = OSMO_MAX(srv->admission.retry_end_ms,
+					       now_ms + (int64_t) srv->admission.num_waiting * 1000 /
+							srv->admission.rate);
+	srv->admission.retry_end_ms += OSMO_MAX(1000 / srv->admission.rate, 1);
+
+	LOGPFSML(conn->fi, LOGL_NOTICE, "Too many connection attempts; asking client to retry in "
+		 "%" PRId64 "ms\n", srv->admission.retry_end_ms - now_ms);
+	resp = rspro_gen_ConnectClientRes(&srv->comp_id, ResultCode_tryAgainLater);
+	rspro_set_retry_after(resp, srv->admission.retry_end_ms - now_ms);
+	client_conn_send(conn, resp);
+	osmo_fsm_inst_state_chg(conn->fi, CLNTC_ST_REJECTED, 1, 2);
+}
+
+/*! Admission control of a received ConnectClientReq.
+ *  \returns true if it shall be processed right away; false if it was deferred (and is now
+ *	     owned by 'conn') or rejected */
+static bool admission_check(struct rspro_client_conn *conn, RsproPDU_t *pdu)
+{
+	struct rspro_server *srv = conn->srv;
+	int64_t now_ms;
+
+	if (conn->admission.admitted || !srv->admission.rate)
+		return true;
+	if (!llist_empty(&conn->admission.list)) {
+		/* a repeated request while waiting: the first one is as good */
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+		return false;
+	}
+
+	now_ms = admission_now_ms();
+	admission_refill(srv, now_ms);
+	if (!srv->admission.num_waiting && admission_take(srv)) {
+		conn->admission.admitted = true;
+		return true;
+	}
+
+	if ((int64_t) srv->admission.num_waiting * 1000 / srv->admission.rate >= ADMISSION_MAX_WAIT_MS) {
+		admission_reject(conn, now_ms);
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
+		return false;
+	}
+
+	LOGPFSML(conn->fi, LOGL_INFO, "Deferring ConnectClientReq; %u ahead of it\n",
+		 srv->admission.num_waiting);
+	conn->admission.deferred_pdu = pdu;
+	llist_add_tail(&conn->admission.list, &srv->admission.waiting);
+	srv->admission.num_waiting++;
+	admission_arm(srv);
+	return false;
+}
+
+/*! Configure admission control of ConnectClientReq.
+ *  \param[in] rate number of clients admitted per second; 0 disables admission control
+ *  \param[in] burst number of clients admitted at once after a quiet period */
+void rspro_server_set_admission(struct rspro_server *srv, unsigned int rate, unsigned int burst)
+{
+	srv->admission.rate = rate;
+	srv->admission.burst = OSMO_MAX(burst, 1);
+	srv->admission.tokens_milli = (uint64_t) srv->admission.burst * 1000;
+	srv->admission.last_refill_ms = admission_now_ms();
+}
+
+static void sock_tune_timer_cb(void *data)
+{
+	struct rspro_client_conn *conn = data;
+
+	if (conn->peer)
+		rspro_sock_tune_rx(osmo_stream_srv_get_fd(conn->peer));
+}
+
 /* data was received from one of the client connections to the RSPRO socket */
 static int sock_read_cb(struct osmo_stream_srv *peer, int res, struct msgb *msg)
 {
@@ -720,6 +962,14 @@ static int sock_read_cb(struct osmo_stream_srv *peer, int res, struct msgb *msg)
 		LOGPFSML(conn->fi, LOGL_NOTICE, "failed reading from socket: %d\n", res);
 		goto err;
 	}
+	if (!conn->local)
+		rspro_sock_tune_rx_defer(&conn->sock_tune_timer);
+	rspro_ka_rx(conn->ka);
+
+	if (conn->srv->capture)
+		rspro_capture_frame(conn->srv->capture, conn->cap_conn_id, RSPRO_CAP_EV_RX, ipa_proto,
+				    ipa_proto == IPAC_PROTO_OSMO ? osmo_ipa_msgb_cb_proto_ext(msg) : -1,
+				    msgb_l2(msg), msgb_l2len(msg));
 
 	switch (ipa_proto) {
 	case IPAC_PROTO_IPACCESS:
@@ -735,6 +985,11 @@ static int sock_read_cb(struct osmo_stream_srv *peer, int res, struct msgb *msg)
 				rc = -EIO;
 				break;
 			}
+			if (pdu->msg.present == RsproPDUchoice_PR_connectClientReq &&
+			    !admission_check(conn, pdu)) {
+				rc = 0;
+				break;
+			}
 			rc = handle_rx_rspro(conn, pdu);
 			ASN_STRUCT_FREE(asn_DEF_RsproPDU, pdu);
 			break;
@@ -763,10 +1018,11 @@ static int sock_closed_cb(struct osmo_stream_srv *peer)
 	struct rspro_client_conn *conn = osmo_stream_srv_get_data(peer);
 	OSMO_ASSERT(conn);
 	osmo_stream_srv_set_data(peer, NULL);
-	if (conn->ka_fi) {
-		osmo_ipa_ka_fsm_stop(conn->ka_fi);
-		osmo_ipa_ka_fsm_free(conn->ka_fi);
-		conn->ka_fi = NULL;
+	if (conn->srv->capture)
+		rspro_capture_conn_close(conn->srv->capture, conn->cap_conn_id);
+	if (conn->ka) {
+		talloc_free(conn->ka);
+		conn->ka = NULL;
 	}
 	if (conn->fi) {
 		if (conn->peer) {
@@ -777,7 +1033,7 @@ static int sock_closed_cb(struct osmo_stream_srv *peer)
 	return 0;
 }
 
-static int ipa_keepalive_send_cb(struct osmo_ipa_ka_fsm_inst *ka_fi, struct msgb *msg, void *data)
+static int ipa_keepalive_send_cb(struct rspro_ka *ka, struct msgb *msg, void *data)
 {
 	struct osmo_stream_srv *srv = data;
 	struct rspro_client_conn *conn = osmo_stream_srv_get_data(srv);
@@ -786,17 +1042,16 @@ static int ipa_keepalive_send_cb(struct osmo_ipa_ka_fsm_inst *ka_fi, struct msgb
 	return 0;
 }
 
-static int ipa_keepalive_timeout_cb(struct osmo_ipa_ka_fsm_inst *ka_fi, void *data)
+static void ipa_keepalive_timeout_cb(struct rspro_ka *ka, void *data)
 {
 	struct osmo_stream_srv *peer = data;
 	struct rspro_client_conn *conn = osmo_stream_srv_get_data(peer);
 	LOGPFSML(conn->fi, LOGL_NOTICE, "IPA PONG Timeout\n");
 	osmo_fsm_inst_dispatch(conn->fi, CLNTC_E_KA_TIMEOUT, NULL);
-	return 0;
 }
 
 
-/* a new TCP connection was accepted on the RSPRO server socket */
+/* a new connection was accepted on the RSPRO server socket (TCP or UNIX domain) */
 static int accept_cb(struct osmo_stream_srv_link *link, int fd)
 {
 	struct rspro_server *srv = osmo_stream_srv_link_get_data(link);
@@ -806,6 +1061,9 @@ static int accept_cb(struct osmo_stream_srv_link *link, int fd)
 	OSMO_ASSERT(conn);
 
 	conn->srv = srv;
+	conn->local = (link == srv->unix_link);
+	INIT_LLIST_HEAD(&conn->admission.list);
+	osmo_timer_setup(&conn->sock_tune_timer, sock_tune_timer_cb, conn);
 	/* don't allocate peer under 'conn', as it must survive 'conn' during teardown */
 	conn->peer = osmo_stream_srv_create2(link, link, fd, conn);
 	if (!conn->peer)
@@ -813,6 +1071,13 @@ static int accept_cb(struct osmo_stream_srv_link *link, int fd)
 	osmo_stream_srv_set_read_cb(conn->peer, sock_read_cb);
 	osmo_stream_srv_set_closed_cb(conn->peer, sock_closed_cb);
 	osmo_stream_srv_set_segmentation_cb(conn->peer, osmo_ipa_segmentation_cb);
+	rspro_sock_tune_apply(fd);
+
+	if (srv->capture) {
+		char peer_name[OSMO_SOCK_NAME_MAXLEN];
+		osmo_sock_get_name_buf(peer_name, sizeof(peer_name), fd);
+		conn->cap_conn_id = rspro_capture_conn_open(srv->capture, peer_name);
+	}
 
 	/* don't allocate 'fi' as slave from 'conn', as 'fi' needs to survive 'conn' during
 	 * teardown */
@@ -820,16 +1085,12 @@ static int accept_cb(struct osmo_stream_srv_link *link, int fd)
 	if (!conn->fi)
 		goto out_err_conn;
 
-	/* use ipa_keepalive_fsm to periodically send an IPA_PING and expect a PONG in response */
-	conn->ka_fi = osmo_ipa_ka_fsm_alloc(conn->peer, conn->fi->id);
-	if (!conn->ka_fi)
+	/* send an IPA_PING (and expect a PONG in response) whenever the peer was silent for 30s */
+	conn->ka = rspro_ka_alloc(conn->peer, 30, 10, ipa_keepalive_send_cb, ipa_keepalive_timeout_cb,
+				  conn->peer);
+	if (!conn->ka)
 		goto out_err_fi;
-	osmo_ipa_ka_fsm_set_data(conn->ka_fi, conn->peer);
-	osmo_ipa_ka_fsm_set_ping_interval(conn->ka_fi, 30);
-	osmo_ipa_ka_fsm_set_pong_timeout(conn->ka_fi, 10);
-	osmo_ipa_ka_fsm_set_send_cb(conn->ka_fi, ipa_keepalive_send_cb);
-	osmo_ipa_ka_fsm_set_timeout_cb(conn->ka_fi, ipa_keepalive_timeout_cb);
-	osmo_ipa_ka_fsm_start(conn->ka_fi);
+	rspro_ka_start(conn->ka);
 
 	INIT_LLIST_HEAD(&conn->bank.maps_new);
 	INIT_LLIST_HEAD(&conn->bank.maps_unack);
@@ -919,6 +1180,13 @@ static void _unlink_all_slotmaps(struct rspro_client_conn *conn)
 /* only to be used by the FSM cleanup. */
 static void rspro_client_conn_destroy(struct rspro_client_conn *conn)
 {
+	osmo_timer_del(&conn->sock_tune_timer);
+	admission_dequeue(conn);
+	if (conn->admission.deferred_pdu) {
+		ASN_STRUCT_FREE(asn_DEF_RsproPDU, conn->admission.deferred_pdu);
+		conn->admission.deferred_pdu = NULL;
+	}
+
 	/* this will internally call closed_cb() which will dispatch a TCP_DOWN event */
 	if (conn->peer) {
 		struct osmo_stream_srv *peer = conn->peer;
@@ -940,6 +1208,42 @@ static void rspro_client_conn_destroy(struct rspro_client_conn *conn)
 }
 
 
+/* slotmaps->change_cb: persist slotmap changes and publish them to REST API event consumers */
+void rspro_server_slotmap_change_cb(struct slotmaps *maps, const struct slot_mapping *map,
+				    enum slotmap_change chg, enum slot_mapping_state old_state)
+{
+	struct rspro_server *srv = maps->change_cb_data;
+	struct remsim_event ev = {
+		.u.slotmap = {
+			.id = slotmap_get_id(map),
+			.bank = map->bank,
+			.client = map->client,
+			.old_state = old_state,
+			.new_state = map->state,
+		},
+	};
+
+	switch (chg) {
+	case SLMAP_CHG_ADDED:
+		if (srv->store)
+			_slotmap_store_add(srv->store, map);
+		ev.type = RS_EV_SLOTMAP_ADDED;
+		break;
+	case SLMAP_CHG_STATE:
+		ev.type = RS_EV_SLOTMAP_STATE;
+		break;
+	case SLMAP_CHG_REMOVED:
+		if (srv->store)
+			_slotmap_store_remove(srv->store, map);
+		/* reported as RS_EV_SLOTMAP_DELETED once it is actually gone */
+		return;
+	case SLMAP_CHG_DELETED:
+		ev.type = RS_EV_SLOTMAP_DELETED;
+		break;
+	}
+	event_ring_publish(srv->events, &ev);
+}
+
 struct rspro_server *rspro_server_create(void *ctx, const char *host, uint16_t port)
 
 {
@@ -954,6 +1258,14 @@ struct rspro_server *rspro_server_create(void *ctx, const char *host, uint16_t p
 	INIT_LLIST_HEAD(&srv->banks);
 	pthread_rwlock_unlock(&srv->rwlock);
 
+	INIT_LLIST_HEAD(&srv->admission.waiting);
+	osmo_timer_setup(&srv->admission.timer, admission_timer_cb, srv);
+	rspro_server_set_admission(srv, ADMISSION_DEFAULT_RATE, ADMISSION_DEFAULT_BURST);
+
+	srv->events = event_ring_alloc(srv);
+	if (!srv->events)
+		goto out_free;
+
 	srv->link = osmo_stream_srv_link_create(ctx);
 	if (!srv->link)
 		goto out_free;
@@ -981,10 +1293,43 @@ out_free:
 	return NULL;
 }
 
+/*! Additionally accept RSPRO connections of co-located bankds/clients on a UNIX domain socket.
+ *  \param[in] path file system path of the (SOCK_SEQPACKET) socket; replaces any existing file
+ *  \returns 0 on success; negative on error */
+int rspro_server_open_unix(struct rspro_server *srv, const char *path)
+{
+	int rc;
+
+	srv->unix_link = osmo_stream_srv_link_create(srv);
+	if (!srv->unix_link)
+		return -ENOMEM;
+
+	osmo_stream_srv_link_set_domain(srv->unix_link, AF_UNIX);
+	osmo_stream_srv_link_set_type(srv->unix_link, SOCK_SEQPACKET);
+	osmo_stream_srv_link_set_addr(srv->unix_link, path);
+	osmo_stream_srv_link_set_data(srv->unix_link, srv);
+	osmo_stream_srv_link_set_accept_cb(srv->unix_link, accept_cb);
+
+	rc = osmo_stream_srv_link_open(srv->unix_link);
+	if (rc < 0) {
+		LOGP(DMAIN, LOGL_ERROR, "Cannot listen on UNIX domain socket %s\n", path);
+		osmo_stream_srv_link_destroy(srv->unix_link);
+		srv->unix_link = NULL;
+		return rc;
+	}
+
+	LOGP(DMAIN, LOGL_INFO, "Accepting local RSPRO connections on %s\n", path);
+	return 0;
+}
+
 void rspro_server_destroy(struct rspro_server *srv)
 {
 	/* FIXME: clear all lists */
 
+	osmo_timer_del(&srv->admission.timer);
+	if (srv->unix_link)
+		osmo_stream_srv_link_destroy(srv->unix_link);
+	srv->unix_link = NULL;
 	osmo_stream_srv_link_destroy(srv->link);
 	srv->link = NULL;
 	pthread_rwlock_destroy(&srv->rwlock);
@@ -2,15 +2,20 @@
 #include <pthread.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/core/fsm.h>
 #include <osmocom/netif/stream.h>
 #include <osmocom/netif/ipa.h>
 
 #include "rspro_util.h"
 #include "slotmap.h"
+#include "event_ring.h"
+#include "slotmap_store.h"
 
 struct rspro_server {
 	struct osmo_stream_srv_link *link;
+	/* optional UNIX domain socket for bankds/clients on the same host */
+	struct osmo_stream_srv_link *unix_link;
 	/* list of rspro_client_conn */
 	struct llist_head connections;
 	struct llist_head clients;
@@ -19,9 +24,30 @@ struct rspro_server {
 	pthread_rwlock_t rwlock;
 
 	struct slotmaps *slotmaps;
+	/* persistent storage of slotmaps (optional) */
+	struct slotmap_store *store;
+
+	/* state change events published to REST API consumers */
+	struct event_ring *events;
+	/* capture of all RSPRO connections (optional) */
+	struct rspro_capture *capture;
 
 	/* our own (server) component identity */
 	struct app_comp_id comp_id;
+
+	/* admission control of ConnectClientReq: token bucket of 'rate' per second, at most 'burst' */
+	struct {
+		unsigned int rate;	/* 0: disabled */
+		unsigned int burst;
+		uint64_t tokens_milli;
+		int64_t last_refill_ms;
+		/* rspro_client_conn whose ConnectClientReq is deferred until a token is available */
+		struct llist_head waiting;
+		unsigned int num_waiting;
+		/* latest retryAfterMs we handed out to a rejected client, as absolute time */
+		int64_t retry_end_ms;
+		struct osmo_timer_list timer;
+	} admission;
 };
 
 /* representing a single client connection to an RSPRO server */
@@ -36,8 +62,23 @@ struct rspro_client_conn {
 	struct osmo_fsm_inst *fi;
 	/* remote component identity (after it has been received) */
 	struct app_comp_id comp_id;
-	/* keep-alive handling FSM */
-	struct osmo_ipa_ka_fsm_inst *ka_fi;
+	/* keep-alive handling */
+	struct rspro_ka *ka;
+	/* re-arms socket options after reading, see rspro_sock_tune_rx_defer() */
+	struct osmo_timer_list sock_tune_timer;
+	/* identifier of this connection in srv->capture */
+	uint32_t cap_conn_id;
+	/* connected via our UNIX domain socket, i.e. from the same host */
+	bool local;
+
+	struct {
+		/* ConnectClientReq may be processed */
+		bool admitted;
+		/* entry in srv->admission.waiting; empty if not waiting */
+		struct llist_head list;
+		/* ConnectClientReq received while waiting */
+		RsproPDU_t *deferred_pdu;
+	} admission;
 
 	struct {
 		struct llist_head maps_new;
@@ -47,6 +88,8 @@ struct rspro_client_conn {
 		struct llist_head maps_deleting;
 		uint16_t bank_id;
 		uint16_t num_slots;
+		/* UNIX domain socket at which the bankd accepts co-located clients (if any) */
+		char *socket_path;
 	} bank;
 	struct {
 		struct client_slot slot;
@@ -55,13 +98,19 @@ struct rspro_client_conn {
 			struct bank_slot slot;
 			uint32_t ip;
 			uint16_t port;
+			/* UNIX domain socket of the bankd; only if both are on our host */
+			char *path;
 		} bankd;
 	} client;
 };
 
 struct rspro_server *rspro_server_create(void *ctx, const char *host, uint16_t port);
+int rspro_server_open_unix(struct rspro_server *srv, const char *path);
+void rspro_server_set_admission(struct rspro_server *srv, unsigned int rate, unsigned int burst);
 void rspro_server_destroy(struct rspro_server *srv);
 int event_fd_cb(struct osmo_fd *ofd, unsigned int what);
+void rspro_server_slotmap_change_cb(struct slotmaps *maps, const struct slot_mapping *map,
+				    enum slotmap_change chg, enum slot_mapping_state old_state);
 
 struct rspro_client_conn *_client_conn_by_slot(struct rspro_server *srv, const struct client_slot *cslot);
 struct rspro_client_conn *client_conn_by_slot(struct rspro_server *srv, const struct client_slot *cslot);
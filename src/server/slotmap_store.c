@@ -0,0 +1,578 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/* Persistent storage of the slot mappings, so they survive a restart of the server.
+ *
+ * The state consists of two files:
+ *  - a snapshot, containing all mappings at one point in time, written to a temporary
+ *    file and atomically renamed into place.
+ *  - an append-only journal of mappings added/removed since that snapshot.  It is
+ *    memory-mapped and pre-allocated, so appending a record is a mere memcpy.
+ *
+ * Both files and each of their records carry an 'epoch'; only journal records of the
+ * snapshot's epoch are replayed, so records left over from an earlier epoch are never
+ * replayed, whatever state a crash left the journal in.  Compaction writes a snapshot
+ * of epoch N+1 without holding the slotmaps lock; records appended to the journal in
+ * the meantime are not part of it.  The journal is then switched to N+1, keeping those
+ * records, and the snapshot remembers where they start in case we crash before that.
+ *
+ * Only the existence of maps is persisted, not their state: After loading, all maps
+ * are in state NEW and get associated with their bankd as soon as it (re)connects. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <talloc.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/crc16.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/logging.h>
+
+#include "debug.h"
+#include "slotmap_store.h"
+
+#define STORE_VERSION		2
+#define SNAPSHOT_MAGIC		"RSMS"
+#define JOURNAL_MAGIC		"RSMJ"
+#define SNAPSHOT_NAME		"slotmaps.snapshot"
+#define JOURNAL_NAME		"slotmaps.journal"
+/* number of records the journal can hold before compaction is forced */
+#define JOURNAL_NUM_RECS	65536
+/* interval at which we compact a non-empty journal */
+#define COMPACT_INTERVAL_S	300
+/* interval at which we check whether a full journal needs to be compacted */
+#define COMPACT_POLL_S		1
+
+struct store_hdr {
+	char magic[4];
+	uint32_t version;
+	uint64_t epoch;
+	/* snapshot: number of records following.
+	 * journal: end of the records carried over from the previous epoch */
+	uint32_t num_recs;
+	/* snapshot: first record of the previous epoch's journal not contained in the snapshot.
+	 * journal: first record to replay */
+	uint32_t first_rec;
+} __attribute__((packed));
+
+enum store_op {
+	STORE_OP_NONE	= 0,	/* unused journal space */
+	STORE_OP_ADD	= 1,
+	STORE_OP_REMOVE	= 2,
+};
+
+struct store_rec {
+	uint8_t op;
+	uint8_t reserved;
+	/* CRC16 over all other members; detects torn writes at the end of the journal */
+	uint16_t crc;
+	uint16_t bank_id;
+	uint16_t bank_slot;
+	uint16_t client_id;
+	uint16_t client_slot;
+	/* lower 32 bits of the epoch the record was written in */
+	uint32_t epoch;
+} __attribute__((packed));
+
+#define JOURNAL_SIZE	(sizeof(struct store_hdr) + JOURNAL_NUM_RECS * sizeof(struct store_rec))
+
+struct slotmap_store {
+	struct slotmaps *maps;
+	char *dir_path;
+	char *snapshot_path;
+	char *journal_path;
+	uint64_t epoch;
+
+	int journal_fd;
+	/* memory mapping of the entire journal file */
+	uint8_t *journal;
+	/* index of the next record to be appended to the journal */
+	unsigned int num_recs;
+	/* index of the first record in the journal which is not part of the snapshot */
+	unsigned int first_rec;
+	/* number of changes not appended to the journal as it was full */
+	unsigned int num_dropped;
+	/* the journal is full; changes since are only persisted by the next compaction */
+	bool compact_pending;
+
+	struct osmo_timer_list compact_timer;
+	/* seconds since the last compaction, counted by compact_timer */
+	unsigned int compact_age_s;
+};
+
+static uint16_t rec_crc(const struct store_rec *rec)
+{
+	struct store_rec tmp = *rec;
+
+	tmp.crc = 0;
+	return osmo_crc16(0, (const uint8_t *) &tmp, sizeof(tmp));
+}
+
+static void rec_fill(struct store_rec *rec, enum store_op op, const struct slot_mapping *map,
+		     uint64_t epoch)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->op = op;
+	rec->epoch = epoch;
+	rec->bank_id = map->bank.bank_id;
+	rec->bank_slot = map->bank.slot_nr;
+	rec->client_id = map->client.client_id;
+	rec->client_slot = map->client.slot_nr;
+	rec->crc = rec_crc(rec);
+}
+
+static struct store_rec *journal_rec(struct slotmap_store *st, unsigned int idx)
+{
+	return (struct store_rec *) (st->journal + sizeof(struct store_hdr)) + idx;
+}
+
+/* record collected from snapshot/journal during loading */
+struct load_rec {
+	struct store_rec rec;
+	/* position in snapshot + journal, as qsort() isn't stable */
+	unsigned int seq;
+};
+
+struct load_state {
+	struct load_rec *recs;
+	unsigned int num_recs;
+	unsigned int alloc_recs;
+};
+
+static int load_push(struct load_state *ls, const struct store_rec *rec)
+{
+	if (ls->num_recs >= ls->alloc_recs) {
+		unsigned int n = ls->alloc_recs ? ls->alloc_recs * 2 : 1024;
+		struct load_rec *recs = realloc(ls->recs, n * sizeof(*recs));
+		if (!recs)
+			return -ENOMEM;
+		ls->recs = recs;
+		ls->alloc_recs = n;
+	}
+	ls->recs[ls->num_recs].rec = *rec;
+	ls->recs[ls->num_recs].seq = ls->num_recs;
+	ls->num_recs++;
+	return 0;
+}
+
+static bool load_rec_same_bank_slot(const struct load_rec *a, const struct load_rec *b)
+{
+	return a->rec.bank_id == b->rec.bank_id && a->rec.bank_slot == b->rec.bank_slot;
+}
+
+static int load_rec_cmp(const void *_a, const void *_b)
+{
+	const struct load_rec *a = _a, *b = _b;
+
+	if (a->rec.bank_id != b->rec.bank_id)
+		return a->rec.bank_id < b->rec.bank_id ? -1 : 1;
+	if (a->rec.bank_slot != b->rec.bank_slot)
+		return a->rec.bank_slot < b->rec.bank_slot ? -1 : 1;
+	return a->seq < b->seq ? -1 : 1;
+}
+
+/* Resolve the collected records into the final set of maps.  Rather than applying
+ * each record via slotmap_add()/slotmap_del() with their linear lookups, we sort by
+ * bank slot and replay the history of each bank slot separately, which keeps loading
+ * of large stores fast */
+static unsigned int load_resolve(struct slotmap_store *st, struct load_state *ls)
+{
+	const struct store_rec *cur;
+	unsigned int i, j, num_maps = 0;
+
+	qsort(ls->recs, ls->num_recs, sizeof(*ls->recs), load_rec_cmp);
+
+	slotmaps_wrlock(st->maps);
+	for (i = 0; i < ls->num_recs; i = j) {
+		cur = NULL;
+		for (j = i; j < ls->num_recs && load_rec_same_bank_slot(&ls->recs[i], &ls->recs[j]); j++) {
+			const struct store_rec *rec = &ls->recs[j].rec;
+			if (rec->op == STORE_OP_ADD)
+				cur = rec;
+			else if (rec->op == STORE_OP_REMOVE && cur && cur->client_id == rec->client_id &&
+				 cur->client_slot == rec->client_slot)
+				cur = NULL;
+		}
+		if (cur) {
+			struct bank_slot bslot = { .bank_id = cur->bank_id, .slot_nr = cur->bank_slot };
+			struct client_slot cslot = { .client_id = cur->client_id, .slot_nr = cur->client_slot };
+			if (_slotmap_add(st->maps, &bslot, &cslot))
+				num_maps++;
+		}
+	}
+	slotmaps_unlock(st->maps);
+
+	return num_maps;
+}
+
+/* the position within the previous epoch's journal where the snapshot ends is returned
+ * in 'journal_pos' */
+static int load_snapshot(struct slotmap_store *st, struct load_state *ls, unsigned int *journal_pos)
+{
+	struct store_hdr hdr;
+	struct store_rec rec;
+	unsigned int i;
+	FILE *f;
+	int rc = 0;
+
+	f = fopen(st->snapshot_path, "rb");
+	if (!f) {
+		if (errno == ENOENT)
+			return 0;
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot open %s: %s\n", st->snapshot_path, strerror(errno));
+		return -errno;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, SNAPSHOT_MAGIC, 4) ||
+	    hdr.version != STORE_VERSION) {
+		LOGP(DSLOTMAP, LOGL_ERROR, "%s: invalid header\n", st->snapshot_path);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < hdr.num_recs; i++) {
+		if (fread(&rec, sizeof(rec), 1, f) != 1 || rec.crc != rec_crc(&rec) ||
+		    rec.epoch != (uint32_t) hdr.epoch) {
+			LOGP(DSLOTMAP, LOGL_ERROR, "%s: truncated/corrupt at record %u\n",
+			     st->snapshot_path, i);
+			rc = -EINVAL;
+			goto out;
+		}
+		rc = load_push(ls, &rec);
+		if (rc < 0)
+			goto out;
+	}
+	st->epoch = hdr.epoch;
+	*journal_pos = hdr.first_rec;
+out:
+	fclose(f);
+	return rc;
+}
+
+/* collect the journal records which are not contained in the snapshot we've loaded */
+static int load_journal(struct slotmap_store *st, struct load_state *ls, unsigned int journal_pos)
+{
+	const struct store_hdr *hdr = (const struct store_hdr *) st->journal;
+	const struct store_rec *rec;
+	unsigned int i, first, carried_end;
+	uint64_t epoch;
+	int rc;
+
+	if (memcmp(hdr->magic, JOURNAL_MAGIC, 4) || hdr->version != STORE_VERSION)
+		return 0;
+	if (hdr->epoch == st->epoch) {
+		first = hdr->first_rec;
+		carried_end = hdr->num_recs;
+	} else if (hdr->epoch + 1 == st->epoch) {
+		/* we crashed after writing the snapshot, before switching the journal to its
+		 * epoch: replay what was appended while the snapshot was being written */
+		first = journal_pos;
+		carried_end = journal_pos;
+	} else {
+		LOGP(DSLOTMAP, LOGL_NOTICE, "Ignoring journal of epoch %llu (snapshot epoch %llu)\n",
+		     (unsigned long long) hdr->epoch, (unsigned long long) st->epoch);
+		return 0;
+	}
+
+	for (i = first; i < JOURNAL_NUM_RECS; i++) {
+		rec = journal_rec(st, i);
+		/* records carried over from the previous epoch were written in that epoch */
+		epoch = i < carried_end ? hdr->epoch - 1 : hdr->epoch;
+		if (rec->op == STORE_OP_NONE || rec->crc != rec_crc(rec) || rec->epoch != (uint32_t) epoch)
+			break;
+		rc = load_push(ls, rec);
+		if (rc < 0)
+			return rc;
+	}
+	return i - first;
+}
+
+static int sync_dir(const char *path)
+{
+	int fd, rc = 0;
+
+	fd = open(path, O_RDONLY | O_DIRECTORY);
+	if (fd < 0 || fsync(fd) < 0) {
+		rc = -errno;
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot sync directory %s: %s\n", path, strerror(errno));
+	}
+	if (fd >= 0)
+		close(fd);
+	return rc;
+}
+
+/* collect the records of a snapshot of epoch 'epoch'; caller must hold the slotmaps lock */
+static int snapshot_collect(struct slotmap_store *st, uint64_t epoch, struct store_rec **recs,
+			    unsigned int *num_recs)
+{
+	struct slot_mapping *map;
+	unsigned int n = 0;
+
+	llist_for_each_entry(map, &st->maps->mappings, list)
+		n++;
+	/* not talloc: the talloc context isn't protected by the slotmaps lock */
+	*recs = malloc(OSMO_MAX(n, 1) * sizeof(**recs));
+	if (!*recs)
+		return -ENOMEM;
+	n = 0;
+	llist_for_each_entry(map, &st->maps->mappings, list)
+		rec_fill(&(*recs)[n++], STORE_OP_ADD, map, epoch);
+	*num_recs = n;
+	return 0;
+}
+
+static int write_snapshot(struct slotmap_store *st, uint64_t epoch, unsigned int journal_pos,
+			  const struct store_rec *recs, unsigned int num_recs)
+{
+	struct store_hdr hdr = {
+		.magic = SNAPSHOT_MAGIC,
+		.version = STORE_VERSION,
+		.epoch = epoch,
+		.num_recs = num_recs,
+		.first_rec = journal_pos,
+	};
+	char tmp_path[PATH_MAX];
+	FILE *f;
+	int rc;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", st->snapshot_path);
+	f = fopen(tmp_path, "wb");
+	if (!f) {
+		rc = -errno;
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot create %s: %s\n", tmp_path, strerror(errno));
+		return rc;
+	}
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+		goto out_wr_err;
+	if (num_recs && fwrite(recs, sizeof(*recs), num_recs, f) != num_recs)
+		goto out_wr_err;
+	if (fflush(f) != 0 || fsync(fileno(f)) < 0)
+		goto out_wr_err;
+	fclose(f);
+
+	if (rename(tmp_path, st->snapshot_path) < 0) {
+		rc = -errno;
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot rename %s: %s\n", tmp_path, strerror(errno));
+		unlink(tmp_path);
+		return rc;
+	}
+	/* the rename itself must be durable before the journal is reset to the new epoch, or the
+	 * old snapshot may re-appear after a power loss, and the journal would be ignored */
+	return sync_dir(st->dir_path);
+
+out_wr_err:
+	rc = -errno;
+	LOGP(DSLOTMAP, LOGL_ERROR, "Error writing %s: %s\n", tmp_path, strerror(errno));
+	fclose(f);
+	unlink(tmp_path);
+	return rc;
+}
+
+/* switch the journal to st->epoch, after a snapshot containing everything up to record
+ * 'journal_pos' was written; caller must hold the slotmaps write lock */
+static void journal_switch(struct slotmap_store *st, unsigned int journal_pos)
+{
+	struct store_hdr *hdr = (struct store_hdr *) st->journal;
+
+	if (journal_pos == st->num_recs) {
+		/* nothing was appended while writing the snapshot: start over.  Records of the
+		 * previous epoch are ignored when loading anyway, zeroing them is just cosmetic */
+		memset(journal_rec(st, 0), 0, st->num_recs * sizeof(struct store_rec));
+		st->num_recs = 0;
+		journal_pos = 0;
+	}
+	memcpy(hdr->magic, JOURNAL_MAGIC, 4);
+	hdr->version = STORE_VERSION;
+	hdr->epoch = st->epoch;
+	hdr->num_recs = st->num_recs;
+	hdr->first_rec = journal_pos;
+	msync(st->journal, JOURNAL_SIZE, MS_ASYNC);
+	st->first_rec = journal_pos;
+}
+
+/* Must only be called from the main thread.  The slotmaps lock is only held while copying
+ * the maps and while switching the journal, not during the I/O of writing the snapshot */
+int slotmap_store_compact(struct slotmap_store *st)
+{
+	struct store_rec *recs;
+	unsigned int num_recs, journal_pos, num_dropped;
+	uint64_t epoch;
+	int rc;
+
+	slotmaps_rdlock(st->maps);
+	epoch = st->epoch + 1;
+	journal_pos = st->num_recs;
+	num_dropped = st->num_dropped;
+	rc = snapshot_collect(st, epoch, &recs, &num_recs);
+	slotmaps_unlock(st->maps);
+	if (rc < 0)
+		return rc;
+
+	rc = write_snapshot(st, epoch, journal_pos, recs, num_recs);
+	free(recs);
+	if (rc < 0)
+		return rc;
+
+	slotmaps_wrlock(st->maps);
+	st->epoch = epoch;
+	journal_switch(st, journal_pos);
+	/* changes which didn't fit into the journal since we copied the maps still need a
+	 * snapshot of their own */
+	st->compact_pending = st->num_dropped != num_dropped;
+	slotmaps_unlock(st->maps);
+	st->compact_age_s = 0;
+
+	LOGP(DSLOTMAP, LOGL_INFO, "Compacted slot map store (epoch %llu)\n", (unsigned long long) epoch);
+	return 0;
+}
+
+static void journal_append(struct slotmap_store *st, enum store_op op, const struct slot_mapping *map)
+{
+	if (st->num_recs >= JOURNAL_NUM_RECS) {
+		/* We may be in a REST thread, with all readers of the maps waiting for us: leave
+		 * the compaction to compact_timer.  maps->mappings already reflects this change, so
+		 * the snapshot will contain it. */
+		if (!st->compact_pending)
+			LOGP(DSLOTMAP, LOGL_NOTICE, "Journal full; changes persisted at next compaction\n");
+		st->compact_pending = true;
+		st->num_dropped++;
+		return;
+	}
+
+	rec_fill(journal_rec(st, st->num_recs), op, map, st->epoch);
+	st->num_recs++;
+}
+
+void _slotmap_store_add(struct slotmap_store *st, const struct slot_mapping *map)
+{
+	journal_append(st, STORE_OP_ADD, map);
+}
+
+void _slotmap_store_remove(struct slotmap_store *st, const struct slot_mapping *map)
+{
+	journal_append(st, STORE_OP_REMOVE, map);
+}
+
+static void compact_timer_cb(void *data)
+{
+	struct slotmap_store *st = data;
+	bool due;
+
+	st->compact_age_s += COMPACT_POLL_S;
+	slotmaps_rdlock(st->maps);
+	due = st->compact_pending || (st->num_recs != st->first_rec && st->compact_age_s >= COMPACT_INTERVAL_S);
+	slotmaps_unlock(st->maps);
+
+	if (due && slotmap_store_compact(st) < 0 && st->compact_pending)
+		LOGP(DSLOTMAP, LOGL_ERROR, "Journal full and compaction failed; changes not persisted\n");
+	osmo_timer_schedule(&st->compact_timer, COMPACT_POLL_S, 0);
+}
+
+static int slotmap_store_destructor(struct slotmap_store *st)
+{
+	osmo_timer_del(&st->compact_timer);
+	if (st->journal) {
+		msync(st->journal, JOURNAL_SIZE, MS_SYNC);
+		munmap(st->journal, JOURNAL_SIZE);
+	}
+	if (st->journal_fd >= 0)
+		close(st->journal_fd);
+	return 0;
+}
+
+struct slotmap_store *slotmap_store_open(void *ctx, const char *dir, struct slotmaps *maps)
+{
+	struct slotmap_store *st = talloc_zero(ctx, struct slotmap_store);
+	struct load_state ls = { NULL, 0, 0 };
+	unsigned int num_maps, journal_pos = 0;
+	int num_journal;
+	struct stat stbuf;
+
+	if (!st)
+		return NULL;
+	st->maps = maps;
+	st->journal_fd = -1;
+	st->dir_path = talloc_strdup(st, dir);
+	st->snapshot_path = talloc_asprintf(st, "%s/%s", dir, SNAPSHOT_NAME);
+	st->journal_path = talloc_asprintf(st, "%s/%s", dir, JOURNAL_NAME);
+	osmo_timer_setup(&st->compact_timer, compact_timer_cb, st);
+	talloc_set_destructor(st, slotmap_store_destructor);
+
+	if (load_snapshot(st, &ls, &journal_pos) < 0)
+		goto out_free;
+
+	st->journal_fd = open(st->journal_path, O_RDWR | O_CREAT, 0600);
+	if (st->journal_fd < 0) {
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot open %s: %s\n", st->journal_path, strerror(errno));
+		goto out_free;
+	}
+	if (fstat(st->journal_fd, &stbuf) < 0 ||
+	    (stbuf.st_size != (off_t) JOURNAL_SIZE && ftruncate(st->journal_fd, JOURNAL_SIZE) < 0)) {
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot size %s: %s\n", st->journal_path, strerror(errno));
+		goto out_free;
+	}
+	st->journal = mmap(NULL, JOURNAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, st->journal_fd, 0);
+	if (st->journal == MAP_FAILED) {
+		st->journal = NULL;
+		LOGP(DSLOTMAP, LOGL_ERROR, "Cannot mmap %s: %s\n", st->journal_path, strerror(errno));
+		goto out_free;
+	}
+
+	/* a journal which was shorter before ftruncate() just has zero (=unused) records */
+	num_journal = 0;
+	if (stbuf.st_size >= sizeof(struct store_hdr)) {
+		num_journal = load_journal(st, &ls, journal_pos);
+		if (num_journal < 0)
+			goto out_free;
+	}
+
+	num_maps = load_resolve(st, &ls);
+	LOGP(DSLOTMAP, LOGL_NOTICE, "Restored %u slot maps from %s (epoch %llu) + %d journal records\n",
+	     num_maps, st->snapshot_path, (unsigned long long) st->epoch, num_journal);
+	free(ls.recs);
+	ls.recs = NULL;
+
+	/* fold the replayed journal into a fresh snapshot, so we start with an empty journal */
+	if (slotmap_store_compact(st) < 0)
+		goto out_free;
+
+	osmo_timer_schedule(&st->compact_timer, COMPACT_POLL_S, 0);
+
+	return st;
+
+out_free:
+	free(ls.recs);
+	talloc_free(st);
+	return NULL;
+}
+
+void slotmap_store_close(struct slotmap_store *st)
+{
+	talloc_free(st);
+}
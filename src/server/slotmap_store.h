@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+
+#include "slotmap.h"
+
+struct slotmap_store;
+
+/* load persisted maps from 'dir' into 'maps' (which must not be shared with other threads
+ * yet) and open the journal for subsequent changes */
+struct slotmap_store *slotmap_store_open(void *ctx, const char *dir, struct slotmaps *maps);
+void slotmap_store_close(struct slotmap_store *st);
+
+/* caller must hold the slotmaps write lock; to be called after maps->mappings was updated */
+void _slotmap_store_add(struct slotmap_store *st, const struct slot_mapping *map);
+void _slotmap_store_remove(struct slotmap_store *st, const struct slot_mapping *map);
+
+/* write a snapshot of all maps and truncate the journal */
+int slotmap_store_compact(struct slotmap_store *st);
@@ -86,6 +86,33 @@ struct slot_mapping *slotmap_by_bank(struct slotmaps *maps, const struct bank_sl
 
 }
 
+/* caller must hold write lock and ensure neither bank nor client slot are in use yet */
+struct slot_mapping *_slotmap_add(struct slotmaps *maps, const struct bank_slot *bank,
+				  const struct client_slot *client)
+{
+	struct slot_mapping *map;
+
+	/* allocate new mapping and add to list of mappings */
+	map = talloc_zero(maps, struct slot_mapping);
+	if (!map)
+		return NULL;
+
+	map->maps = maps;
+	map->bank = *bank;
+	map->client = *client;
+
+	llist_add_tail(&map->list, &maps->mappings);
+#ifdef REMSIM_SERVER
+	map->state = SLMAP_S_NEW;
+	INIT_LLIST_HEAD(&map->bank_list); /* to ensure llist_del() always succeeds */
+#endif
+	_slotmap_touch(maps, map);
+	if (maps->change_cb)
+		maps->change_cb(maps, map, SLMAP_CHG_ADDED, SLMAP_S_NEW);
+
+	return map;
+}
+
 /* thread-safe creating of a new bank<->client map */
 struct slot_mapping *slotmap_add(struct slotmaps *maps, const struct bank_slot *bank,
 				 const struct client_slot *client)
@@ -111,22 +138,11 @@ struct slot_mapping *slotmap_add(struct slotmaps *maps, const struct bank_slot *
 		return NULL;
 	}
 
-	/* allocate new mapping and add to list of mappings */
-	map = talloc_zero(maps, struct slot_mapping);
-	if (!map)
-		return NULL;
-
-	map->maps = maps;
-	map->bank = *bank;
-	map->client = *client;
-
 	slotmaps_wrlock(maps);
-	llist_add_tail(&map->list, &maps->mappings);
-#ifdef REMSIM_SERVER
-	map->state = SLMAP_S_NEW;
-	INIT_LLIST_HEAD(&map->bank_list); /* to ensure llist_del() always succeeds */
-#endif
+	map = _slotmap_add(maps, bank, client);
 	slotmaps_unlock(maps);
+	if (!map)
+		return NULL;
 
 	LOGP(DSLOTMAP, LOGL_INFO, "Slot Map %s added\n", slotmap_name(mapname, sizeof(mapname), map));
 
@@ -136,11 +152,17 @@ struct slot_mapping *slotmap_add(struct slotmaps *maps, const struct bank_slot *
 /* thread-safe removal of a bank<->client map */
 void _slotmap_del(struct slotmaps *maps, struct slot_mapping *map)
 {
+	bool linked = !llist_empty(&map->list);
 	char mapname[64];
 
 	LOGP(DSLOTMAP, LOGL_INFO, "Slot Map %s deleted\n", slotmap_name(mapname, sizeof(mapname), map));
 
 	llist_del(&map->list);
+	/* maps already unlinked from the global list have been recorded by whoever unlinked them */
+	if (linked)
+		_slotmap_tombstone(maps, map);
+	if (maps->change_cb)
+		maps->change_cb(maps, map, SLMAP_CHG_DELETED, map->state);
 #ifdef REMSIM_SERVER
 	llist_del(&map->bank_list);
 #endif
@@ -168,6 +190,32 @@ void slotmap_del_all(struct slotmaps *maps)
 	slotmaps_unlock(maps);
 }
 
+/* caller must hold write lock: mark map as modified in a new generation */
+void _slotmap_touch(struct slotmaps *maps, struct slot_mapping *map)
+{
+	map->generation = ++maps->generation;
+}
+
+/* caller must hold write lock: record map (already unlinked from maps->mappings)
+ * as deleted in a new generation */
+void _slotmap_tombstone(struct slotmaps *maps, const struct slot_mapping *map)
+{
+	struct slotmap_tombstone *ts = &maps->tombstones.ring[maps->tombstones.next];
+
+	/* we're about to overwrite the oldest entry; deltas from before it are incomplete */
+	if (ts->generation)
+		maps->tombstones.floor = ts->generation;
+
+	ts->id = slotmap_get_id(map);
+	ts->bank_id = map->bank.bank_id;
+	ts->client_id = map->client.client_id;
+	ts->generation = ++maps->generation;
+	maps->tombstones.next = (maps->tombstones.next + 1) % ARRAY_SIZE(maps->tombstones.ring);
+
+	if (maps->change_cb)
+		maps->change_cb(maps, map, SLMAP_CHG_REMOVED, map->state);
+}
+
 struct slotmaps *slotmap_init(void *ctx)
 {
 	struct slotmaps *sm = talloc_zero(ctx, struct slotmaps);
@@ -183,6 +231,7 @@ struct slotmaps *slotmap_init(void *ctx)
 void _Slotmap_state_change(struct slot_mapping *map, enum slot_mapping_state new_state,
 			   struct llist_head *new_bank_list, const char *file, int line)
 {
+	enum slot_mapping_state old_state = map->state;
 	char mapname[64];
 
 	LOGPSRC(DMAIN, LOGL_INFO, file, line, "Slot Map %s state change: %s -> %s\n",
@@ -191,6 +240,9 @@ void _Slotmap_state_change(struct slot_mapping *map, enum slot_mapping_state new
 		get_value_string(slot_map_state_name, new_state));
 
 	map->state = new_state;
+	_slotmap_touch(map->maps, map);
+	if (map->maps->change_cb)
+		map->maps->change_cb(map->maps, map, SLMAP_CHG_STATE, old_state);
 	llist_del(&map->bank_list);
 	if (new_bank_list)
 		llist_add_tail(&map->bank_list, new_bank_list);
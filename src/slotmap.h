@@ -60,12 +60,48 @@ struct slot_mapping {
 	struct llist_head bank_list;
 	enum slot_mapping_state state;
 #endif
+	/* value of slotmaps->generation at the time of the last modification */
+	uint64_t generation;
+};
+
+/* number of recently deleted maps we remember for delta queries */
+#define SLOTMAP_NUM_TOMBSTONES	1024
+
+/* record of a recently deleted map */
+struct slotmap_tombstone {
+	uint32_t id;
+	/* for filtering delta queries by bank or client */
+	uint16_t bank_id;
+	uint16_t client_id;
+	uint64_t generation;
+};
+
+/* kind of change reported to slotmaps->change_cb */
+enum slotmap_change {
+	SLMAP_CHG_ADDED,	/* added to maps->mappings */
+	SLMAP_CHG_STATE,
+	SLMAP_CHG_REMOVED,	/* removed from maps->mappings; may still be pending deletion at bankd */
+	SLMAP_CHG_DELETED,	/* freed */
 };
 
 /* collection of slot mappings */
 struct slotmaps {
 	struct llist_head mappings;
 	pthread_rwlock_t rwlock;
+	/* monotonically increasing; bumped on every add/delete/state change */
+	uint64_t generation;
+	/* ring buffer of recently deleted maps */
+	struct {
+		struct slotmap_tombstone ring[SLOTMAP_NUM_TOMBSTONES];
+		unsigned int next;
+		/* oldest generation for which the deletion history is complete */
+		uint64_t floor;
+	} tombstones;
+	/* optional observer of changes; called with the write lock held, after
+	 * maps->mappings has been updated */
+	void (*change_cb)(struct slotmaps *maps, const struct slot_mapping *map,
+			  enum slotmap_change chg, enum slot_mapping_state old_state);
+	void *change_cb_data;
 };
 
 uint32_t slotmap_get_id(const struct slot_mapping *map);
@@ -78,6 +114,9 @@ struct slot_mapping *slotmap_by_bank(struct slotmaps *maps, const struct bank_sl
 
 /* thread-safe creating of a new bank<->client map */
 struct slot_mapping *slotmap_add(struct slotmaps *maps, const struct bank_slot *bank, const struct client_slot *client);
+/* caller must hold write lock and ensure neither bank nor client slot are in use yet */
+struct slot_mapping *_slotmap_add(struct slotmaps *maps, const struct bank_slot *bank,
+				  const struct client_slot *client);
 
 /* thread-safe removal of a bank<->client map */
 void slotmap_del(struct slotmaps *maps, struct slot_mapping *map);
@@ -86,6 +125,12 @@ void _slotmap_del(struct slotmaps *maps, struct slot_mapping *map);
 /* thread-safe removal of all bank<->client maps */
 void slotmap_del_all(struct slotmaps *maps);
 
+/* caller must hold write lock: mark map as modified in a new generation */
+void _slotmap_touch(struct slotmaps *maps, struct slot_mapping *map);
+/* caller must hold write lock: record map (already unlinked from maps->mappings)
+ * as deleted in a new generation */
+void _slotmap_tombstone(struct slotmaps *maps, const struct slot_mapping *map);
+
 /* initialize the entire map collection */
 struct slotmaps *slotmap_init(void *ctx);
 
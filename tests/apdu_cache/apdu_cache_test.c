@@ -0,0 +1,138 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include "bankd.h"
+
+static struct bankd_apdu_cache g_cache;
+/* number of commands which reached the (simulated) card */
+static unsigned int g_card_cmds;
+
+/* pass a command through the cache like worker_handle_tpduModemToCard() does; the card responds
+ * with 'card_rsp' */
+static void xceive(const char *cmd_hex, const char *card_rsp_hex)
+{
+	uint8_t cmd[64], card_rsp[64], rsp[64];
+	size_t rsp_len = sizeof(rsp);
+	int cmd_len, card_rsp_len;
+
+	cmd_len = osmo_hexparse(cmd_hex, cmd, sizeof(cmd));
+	card_rsp_len = osmo_hexparse(card_rsp_hex, card_rsp, sizeof(card_rsp));
+	OSMO_ASSERT(cmd_len >= 5 && card_rsp_len >= 2);
+
+	if (bankd_apdu_cache_lookup(&g_cache, cmd, cmd_len, rsp, &rsp_len) == 0) {
+		printf("  %s -> %s (cache)\n", cmd_hex, osmo_hexdump_nospc(rsp, rsp_len));
+		return;
+	}
+	g_card_cmds++;
+	bankd_apdu_cache_update(&g_cache, cmd, cmd_len, card_rsp, card_rsp_len);
+	printf("  %s -> %s (card)\n", cmd_hex, card_rsp_hex);
+}
+
+static void test_start(const char *name)
+{
+	printf("%s\n", name);
+	bankd_apdu_cache_flush(&g_cache);
+	g_card_cmds = 0;
+}
+
+static void test_read_binary(void)
+{
+	test_start("READ BINARY of ICCID is served from the cache");
+	xceive("00a40004023f00", "9000");
+	xceive("00a40004022fe2", "9000");
+	xceive("00b000000a", "98103254761032547698" "9000");
+	xceive("00b000000a", "98103254761032547698" "9000");
+	OSMO_ASSERT(g_card_cmds == 3);
+}
+
+static void test_read_record_modes(void)
+{
+	test_start("READ RECORD next/previous/first/last reaches the card");
+	xceive("00a40004023f00", "9000");
+	xceive("00a40004022f00", "9000");
+	xceive("00b2000220", "61104f10a0000000871002ff" "9000");
+	xceive("00b2000220", "61104f10a0000000871004ff" "9000");
+	xceive("00b2000320", "61104f10a0000000871002ff" "9000");
+	xceive("00b2000020", "61104f10a0000000871002ff" "9000");
+	OSMO_ASSERT(g_card_cmds == 6);
+
+	test_start("READ RECORD of an absolute record number is served from the cache");
+	xceive("00a40004023f00", "9000");
+	xceive("00a40004022f00", "9000");
+	xceive("00b2010420", "61104f10a0000000871002ff" "9000");
+	xceive("00b2010420", "61104f10a0000000871002ff" "9000");
+	OSMO_ASSERT(g_card_cmds == 3);
+}
+
+static void test_sfi_invalidates_selection(void)
+{
+	test_start("READ RECORD with SFI in P2 changes the current EF");
+	xceive("00a40004023f00", "9000");
+	xceive("00a40004022f00", "9000");
+	xceive("00b2010420", "61104f10a0000000871002ff" "9000");
+	/* record 1 of the EF with SFI 3, which becomes the current EF */
+	xceive("00b2011c20", "800102" "9000");
+	xceive("00b2010420", "800102" "9000");
+	OSMO_ASSERT(g_card_cmds == 5);
+
+	test_start("SEARCH RECORD with SFI in P2 changes the current EF");
+	xceive("00a40004023f00", "9000");
+	xceive("00a40004022f00", "9000");
+	xceive("00b2010420", "61104f10a0000000871002ff" "9000");
+	xceive("00a2011c0180", "01" "9000");
+	xceive("00b2010420", "800102" "9000");
+	OSMO_ASSERT(g_card_cmds == 5);
+}
+
+static void test_logical_channels(void)
+{
+	test_start("Selection is tracked per logical channel");
+	xceive("00a40004023f00", "9000");
+	xceive("00a40004022fe2", "9000");
+	xceive("00b000000a", "98103254761032547698" "9000");
+	xceive("01a40004023f00", "9000");
+	xceive("01a40004022f06", "9000");
+	xceive("01b000000a", "800101" "9000");
+	xceive("00b000000a", "98103254761032547698" "9000");
+	OSMO_ASSERT(g_card_cmds == 6);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 0, "apdu_cache_test");
+
+	bankd_apdu_cache_init(&g_cache, ctx);
+
+	test_read_binary();
+	test_read_record_modes();
+	test_sfi_invalidates_selection();
+	test_logical_channels();
+
+	bankd_apdu_cache_flush(&g_cache);
+	OSMO_ASSERT(talloc_total_blocks(ctx) == 1);
+	talloc_free(ctx);
+	printf("done\n");
+	return 0;
+}
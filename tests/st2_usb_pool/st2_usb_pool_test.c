@@ -0,0 +1,210 @@
+/* (C) 2026 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <talloc.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+
+#include "debug.h"
+#include "st2_usb_pool.h"
+
+/* the USB back-end: a transfer is just a name and whether it is submitted */
+struct fake_xfer {
+	char name[8];
+	bool submitted;
+};
+
+static unsigned int g_num_in_xfers, g_num_irq_xfers;
+
+static void fake_init_urb(struct st2_urb *urb)
+{
+	struct fake_xfer *xfer = talloc_zero(urb->pool, struct fake_xfer);
+
+	if (urb->irq)
+		snprintf(xfer->name, sizeof(xfer->name), "IRQ%u", g_num_irq_xfers++);
+	else
+		snprintf(xfer->name, sizeof(xfer->name), "IN%u", g_num_in_xfers++);
+	urb->xfer = xfer;
+}
+
+static void fake_submit_urb(struct st2_urb *urb)
+{
+	struct fake_xfer *xfer = urb->xfer;
+
+	OSMO_ASSERT(!xfer->submitted);
+	xfer->submitted = true;
+	printf("  submit %s\n", xfer->name);
+}
+
+static void fake_process(struct st2_usb_pool *pool, const struct st2_usb_buf *buf)
+{
+	printf("  process %.*s\n", buf->len, buf->data);
+}
+
+static const struct st2_usb_pool_ops fake_ops = {
+	.init_urb = fake_init_urb,
+	.submit_urb = fake_submit_urb,
+	.process = fake_process,
+};
+
+/* the device sends 'msg' through 'urb' */
+static void complete(struct st2_urb *urb, const char *msg)
+{
+	struct fake_xfer *xfer = urb->xfer;
+
+	OSMO_ASSERT(xfer->submitted);
+	xfer->submitted = false;
+	printf("  complete %s: %s\n", xfer->name, msg);
+	memcpy(urb->buf->data, msg, strlen(msg));
+	st2_usb_pool_completed(urb, strlen(msg));
+}
+
+/* one iteration of the main loop, after 'secs' seconds */
+static void main_loop(int secs)
+{
+	osmo_clock_override_add(CLOCK_MONOTONIC, secs, 0);
+	osmo_timers_prepare();
+	osmo_timers_update();
+}
+
+static void print_pool(const struct st2_usb_pool *pool)
+{
+	printf("  num_in=%u in_starved=%lu in_no_buf=%lu max_pending=%u\n", pool->num_in,
+	       pool->stats.in_starved, pool->stats.in_no_buf, pool->stats.max_pending);
+}
+
+static struct st2_usb_pool *pool_start(void *ctx, unsigned int num_in, unsigned int max_in)
+{
+	struct st2_usb_pool *pool;
+
+	g_num_in_xfers = g_num_irq_xfers = 0;
+	pool = st2_usb_pool_alloc(ctx, &fake_ops, NULL, num_in, max_in, 1);
+	st2_usb_pool_start(pool);
+	return pool;
+}
+
+static void test_submit_complete(void *ctx)
+{
+	struct st2_usb_pool *pool;
+
+	printf("URBs are resubmitted at once, messages processed from the main loop\n");
+	pool = pool_start(ctx, 2, 2);
+	complete(&pool->in_urbs[0], "a");
+	complete(&pool->irq_urbs[0], "b");
+	main_loop(0);
+	complete(&pool->in_urbs[0], "c");
+	main_loop(0);
+	print_pool(pool);
+	talloc_free(pool);
+}
+
+static void test_grow(void *ctx)
+{
+	struct st2_usb_pool *pool;
+	unsigned int i;
+
+	printf("IN URBs are added while all of them complete in one iteration, up to max_in\n");
+	pool = pool_start(ctx, 2, 3);
+	complete(&pool->in_urbs[0], "a");
+	complete(&pool->in_urbs[1], "b");
+	main_loop(0);
+	print_pool(pool);
+	for (i = 0; i < 2; i++) {
+		complete(&pool->in_urbs[0], "c");
+		complete(&pool->in_urbs[1], "d");
+		complete(&pool->in_urbs[2], "e");
+		main_loop(0);
+		print_pool(pool);
+	}
+	talloc_free(pool);
+}
+
+static void test_no_buf(void *ctx)
+{
+	struct st2_usb_pool *pool;
+
+	printf("Without spare buffers, pending messages are processed in order before resubmitting\n");
+	pool = pool_start(ctx, 1, 1);
+	complete(&pool->in_urbs[0], "a");
+	complete(&pool->in_urbs[0], "b");
+	complete(&pool->in_urbs[0], "c");
+	main_loop(0);
+	print_pool(pool);
+	talloc_free(pool);
+}
+
+static void test_shrink(void *ctx)
+{
+	struct st2_usb_pool *pool;
+
+	printf("IN URBs are retired at their completion if the queue didn't run empty for a while\n");
+	pool = pool_start(ctx, 2, 3);
+	complete(&pool->in_urbs[0], "a");
+	complete(&pool->in_urbs[1], "b");
+	main_loop(0);
+	print_pool(pool);
+
+	/* starvation within the last interval: keep all IN URBs */
+	main_loop(10);
+	complete(&pool->in_urbs[0], "c");
+	main_loop(0);
+	print_pool(pool);
+
+	/* no starvation: the next IN URB completing is retired */
+	main_loop(10);
+	complete(&pool->in_urbs[1], "d");
+	complete(&pool->in_urbs[0], "e");
+	main_loop(0);
+	print_pool(pool);
+
+	/* never below num_in */
+	main_loop(10);
+	main_loop(10);
+	complete(&pool->in_urbs[0], "f");
+	main_loop(0);
+	print_pool(pool);
+
+	/* retired IN URBs are used again when the queue runs empty */
+	complete(&pool->in_urbs[0], "g");
+	complete(&pool->in_urbs[2], "h");
+	main_loop(0);
+	print_pool(pool);
+	talloc_free(pool);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 0, "st2_usb_pool_test");
+
+	osmo_init_logging2(ctx, &log_info);
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+
+	test_submit_complete(ctx);
+	test_grow(ctx);
+	test_no_buf(ctx);
+	test_shrink(ctx);
+
+	printf("done\n");
+	return 0;
+}